@@ -46,16 +46,19 @@
 
 #include "pros/adi.h"
 #include "pros/colors.h"
+#include "pros/datalog.h"
 #include "pros/distance.h"
 #include "pros/error.h"
 #include "pros/ext_adi.h"
 #include "pros/gps.h"
+#include "pros/hrtimer.h"
 #include "pros/imu.h"
 #include "pros/link.h"
 #include "pros/llemu.h"
 #include "pros/misc.h"
 #include "pros/motors.h"
 #include "pros/optical.h"
+#include "pros/pool.h"
 #include "pros/rotation.h"
 #include "pros/rtos.h"
 #include "pros/screen.h"
@@ -71,9 +74,11 @@
 #include "pros/misc.hpp"
 #include "pros/motors.hpp"
 #include "pros/optical.hpp"
+#include "pros/pool.hpp"
 #include "pros/rotation.hpp"
 #include "pros/rtos.hpp"
 #include "pros/screen.hpp"
+#include "pros/spsc.hpp"
 #include "pros/vision.hpp"
 #endif
 
@@ -15,6 +15,8 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define COBS_ENCODE_MEASURE_MAX(src_len) ((src_len) + (((src_len) + 253) / 254))
@@ -52,3 +54,53 @@ int cobs_encode(uint8_t* restrict dest, const uint8_t* restrict src, const size_
  * \return The size of src when encoded
  */
 size_t cobs_encode_measure(const uint8_t* restrict src, const size_t src_len, const uint32_t prefix);
+
+/**
+ * State of an incremental COBS decoder. Bytes are fed in one at a time as they
+ * arrive, so a frame never needs to be re-scanned when it is split across
+ * several reads.
+ */
+typedef struct cobs_decoder {
+	uint8_t* buf;       // destination of the decoded frame
+	size_t capacity;    // size of buf
+	size_t len;         // number of decoded bytes in buf
+	uint8_t code;       // code byte of the current block, 0 between frames
+	uint8_t remaining;  // data bytes left in the current block
+	bool overflow;      // set when the frame did not fit in buf
+} cobs_decoder_s_t;
+
+typedef enum cobs_decode_result {
+	E_COBS_DECODE_PENDING = 0,  // the frame is not finished yet
+	E_COBS_DECODE_COMPLETE,     // a frame of decoder->len bytes is in decoder->buf
+	E_COBS_DECODE_TRUNCATED,    // a delimiter arrived in the middle of a block
+	E_COBS_DECODE_OVERFLOW      // the frame was longer than the decoder's buffer
+} cobs_decode_result_e_t;
+
+/**
+ * Initializes an incremental COBS decoder.
+ *
+ * \param[out] decoder
+ *             The decoder to initialize
+ * \param[in] buf
+ *            The location to write decoded frames to
+ * \param capacity
+ *        The size of buf
+ */
+void cobs_decoder_init(cobs_decoder_s_t* decoder, uint8_t* buf, size_t capacity);
+
+/**
+ * Feeds one byte of a stuffed stream into the decoder. Frames are delimited by
+ * 0x00 bytes. A frame which is truncated or overflows the buffer is reported
+ * once its delimiter arrives, and the decoder is then ready for the next frame.
+ *
+ * When E_COBS_DECODE_COMPLETE is returned, the frame remains in decoder->buf
+ * until the next byte is fed into the decoder.
+ *
+ * \param decoder
+ *        The decoder
+ * \param byte
+ *        The next byte of the stream
+ *
+ * \return The state of the frame after this byte
+ */
+cobs_decode_result_e_t cobs_decode_byte(cobs_decoder_s_t* decoder, uint8_t byte);
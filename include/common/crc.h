@@ -0,0 +1,52 @@
+/**
+ * \file common/crc.h
+ *
+ * Cyclic redundancy check header
+ *
+ * See common/crc.c for discussion
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CRC16_INIT 0xFFFF
+#define CRC32_INIT 0xFFFFFFFF
+
+/**
+ * Updates a CRC-16/CCITT-FALSE (polynomial 0x1021, not reflected) with the
+ * given data. Start with CRC16_INIT; the result needs no final XOR.
+ *
+ * \param crc
+ *        The running CRC
+ * \param[in] data
+ *            The data to add to the CRC
+ * \param len
+ *        The length of data
+ *
+ * \return The updated CRC
+ */
+uint16_t crc16(uint16_t crc, const uint8_t* data, size_t len);
+
+/**
+ * Updates a CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320) with the given
+ * data. Start with CRC32_INIT and XOR the final result with 0xFFFFFFFF.
+ *
+ * \param crc
+ *        The running CRC
+ * \param[in] data
+ *            The data to add to the CRC
+ * \param len
+ *        The length of data
+ *
+ * \return The updated CRC
+ */
+uint32_t crc32(uint32_t crc, const uint8_t* data, size_t len);
@@ -0,0 +1,104 @@
+/**
+ * \file common/frame.h
+ *
+ * Checksummed packet framing header
+ *
+ * See common/frame.c for discussion
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/cobs.h"
+
+// sizes of the supported checksums, passed as crc_size
+#define FRAME_CRC16 2
+#define FRAME_CRC32 4
+
+// size of the identifier that leads every frame
+#define FRAME_ID_SIZE 4
+
+// size of the buffer that frame_encode() needs for a payload of len bytes
+#define FRAME_ENCODE_MEASURE_MAX(len, crc_size) (COBS_ENCODE_MEASURE_MAX(FRAME_ID_SIZE + (len) + (crc_size)) + 1)
+
+// size of the buffer that a frame decoder needs for payloads of up to len bytes
+#define FRAME_DECODE_BUFFER_SIZE(len, crc_size) (FRAME_ID_SIZE + (len) + (crc_size))
+
+typedef struct frame_decoder {
+	cobs_decoder_s_t cobs;
+	uint8_t crc_size;
+	size_t len;           // payload length of the last complete frame
+	uint32_t frames;      // frames received intact
+	uint32_t crc_errors;  // frames discarded because of a checksum mismatch
+	uint32_t resyncs;     // partial or malformed frames discarded
+	uint32_t overflows;   // frames discarded because they did not fit the buffer
+} frame_decoder_s_t;
+
+/**
+ * Encodes a frame into dest. dest must be at least
+ * FRAME_ENCODE_MEASURE_MAX(len, crc_size) bytes.
+ *
+ * The checksum is written into payload[len] (little endian) before stuffing,
+ * so payload must have crc_size bytes of space after the data.
+ *
+ * \param[out] dest
+ *             The location to write the frame to, including its delimiter
+ * \param id
+ *        The identifier of the frame
+ * \param payload
+ *        The data to send, followed by crc_size bytes of space
+ * \param len
+ *        The length of the data
+ * \param crc_size
+ *        FRAME_CRC16 or FRAME_CRC32
+ *
+ * \return The number of bytes written
+ */
+size_t frame_encode(uint8_t* dest, uint32_t id, uint8_t* payload, size_t len, uint8_t crc_size);
+
+/**
+ * Initializes a frame decoder.
+ *
+ * \param[out] decoder
+ *             The decoder to initialize
+ * \param[in] buf
+ *            The location to decode frames into. Must be at least
+ *            FRAME_DECODE_BUFFER_SIZE(max payload length, crc_size) bytes
+ * \param capacity
+ *        The size of buf
+ * \param crc_size
+ *        FRAME_CRC16 or FRAME_CRC32
+ */
+void frame_decoder_init(frame_decoder_s_t* decoder, uint8_t* buf, size_t capacity, uint8_t crc_size);
+
+/**
+ * Feeds one received byte into the decoder.
+ *
+ * When a frame is complete and its checksum matches, its identifier is in the
+ * first FRAME_ID_SIZE bytes of the buffer (see frame_decoder_get_id()) and
+ * decoder->len bytes of payload follow. Damaged frames are discarded and
+ * counted, and the decoder resynchronizes on the next delimiter.
+ *
+ * \param decoder
+ *        The decoder
+ * \param byte
+ *        The next received byte
+ *
+ * \return True if an intact frame was just completed
+ */
+bool frame_decode_byte(frame_decoder_s_t* decoder, uint8_t byte);
+
+/**
+ * Gets the identifier of the frame that was just completed.
+ */
+uint32_t frame_decoder_get_id(const frame_decoder_s_t* decoder);
@@ -15,12 +15,13 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
-#include "api.h"
 
 struct gid_metadata {
 	uint32_t* const bitmap;    // a constant pointer to a bitmap
-	const size_t max;          // Maximum gid value
+	const size_t max;          // Number of gids. Valid gids are below this value
 	const size_t reserved;     // first n GIDs may be reserved, at most 32, but at least 1
 	const size_t bitmap_size;  // Cached number of uint32_t's used to map gid_max.
 	                           // Use gid_size_to_words to compute
@@ -28,7 +29,6 @@ struct gid_metadata {
 	// internal usage to ensure that GIDs get delegated linearly before wrapping
 	// around back to 0
 	size_t _cur_val;
-	mutex_t _lock;
 };
 
 #ifndef UINT32_WIDTH
@@ -52,6 +52,8 @@ void gid_init(struct gid_metadata* const metadata);
 /**
  * Allocates a gid from the gid structure and returns it.
  *
+ * This function is lock-free, and may be called from any task.
+ *
  * \param[in] metadata
  *            The gid_metadata to record to the gid structure
  *
@@ -62,6 +64,8 @@ uint32_t gid_alloc(struct gid_metadata* const metadata);
 /**
  * Frees the gid specified from the structure.
  *
+ * This function is lock-free, and may be called from any task.
+ *
  * \param[in] metadata
  *            The gid_metadata to free from the gid structure
  * \param id
@@ -72,6 +76,8 @@ void gid_free(struct gid_metadata* const metadata, uint32_t id);
 /**
  * Checks if the gid specified is allocated.
  *
+ * This is inlined since it guards every file operation.
+ *
  * \param[in] metadata
  *            The gid_metadata to check
  * \param id
@@ -80,4 +86,10 @@ void gid_free(struct gid_metadata* const metadata, uint32_t id);
  * \return True if the given metadata/id combo is present in the gid structure,
  * false otherwise.
  */
-bool gid_check(struct gid_metadata* metadata, uint32_t id);
+static inline bool gid_check(struct gid_metadata* metadata, uint32_t id) {
+	if (id >= metadata->max) {
+		return false;
+	}
+	uint32_t word = __atomic_load_n(metadata->bitmap + id / UINT32_WIDTH, __ATOMIC_ACQUIRE);
+	return (word & (1u << (id % UINT32_WIDTH))) ? false : true;
+}
@@ -53,6 +53,12 @@ extern "C" {
 
 typedef uint32_t task_stack_t;
 
+#ifndef __cplusplus
+// user code only knows the size of a task's control block from pros/rtos.h
+_Static_assert(sizeof(static_task_s_t) <= TASK_STATIC_BUFFER_SIZE, "TASK_STATIC_BUFFER_SIZE is too small");
+_Static_assert(_Alignof(static_task_s_t) <= 8, "static_task_s_t is aligned to more than 8 bytes");
+#endif
+
 /**
  * Suspends the scheduler without disabling interrupts. context switches will
  * not occur while the scheduler is suspended. RTOS ticks that occur while the
@@ -76,36 +82,6 @@ void rtos_suspend_all(void);
  */
 int32_t rtos_resume_all(void);
 
-/**
- * Creates a task using statically allocated buffers. All tasks used by the PROS
- * system must use statically allocated buffers.
- * This function uses the following values of errno when an error state is
- * reached:
- * ENOMEM - The stack cannot be used as the TCB was not created.
- *
- * \param function
- *        Pointer to the task entry function
- * \param parameters
- *        Pointer to memory that will be used as a parameter for the task being
- *        created. This memory should not typically come from stack, but rather
- *        from dynamically (i.e., malloc'd) or statically allocated memory.
- * \param prio
- *        The priority at which the task should run.
- *        TASK_PRIO_DEFAULT plus/minus 1 or 2 is typically used.
- * \param stack_depth
- *        The number of words (i.e. 4 * stack_depth) available on the task's
- *        stack. TASK_STACK_DEPTH_DEFAULT is typically sufficienct.
- * \param name
- *        A descriptive name for the task.  This is mainly used to facilitate
- *        debugging. The name may be up to 32 characters long.
- *
- * \return A handle by which the newly created task can be referenced. If an
- * error occurred, NULL will be returned and errno can be checked for hints as
- * to why task_create failed.
- */
-task_t task_create_static(task_fn_t task_code, void* const param, uint32_t priority, const size_t stack_size,
-                          const char* const name, task_stack_t* const stack_buffer, static_task_s_t* const task_buffer);
-
 /**
  * Creates a statically allocated mutex.
  *
@@ -159,6 +135,32 @@ sem_t sem_create_static(uint32_t max_count, uint32_t init_count, static_sem_s_t*
 queue_t queue_create_static(uint32_t length, uint32_t item_size, uint8_t* storage_buffer,
                             static_queue_s_t* queue_buffer);
 
+/**
+ * Allocates a kernel object from a pool, or from the heap once every block of
+ * the pool is in use. The pool's block size must be at least size.
+ *
+ * Objects allocated with this function must be freed with kpool_free.
+ *
+ * \param pool
+ *        The pool to allocate from first
+ * \param size
+ *        The size of the object
+ *
+ * \return The object, or NULL if neither the pool nor the heap had room.
+ */
+void* kpool_alloc(pool_t pool, size_t size);
+
+/**
+ * Frees an object allocated with kpool_alloc, returning it to the pool or to
+ * the heap, wherever it came from.
+ *
+ * \param pool
+ *        The pool the object was allocated from
+ * \param object
+ *        The object to free, may be NULL
+ */
+void kpool_free(pool_t pool, void* object);
+
 /**
  * Display a non-fatal error to the built-in LCD/touch screen.
  *
@@ -198,6 +200,23 @@ int32_t xTaskGetSchedulerState();
 #define taskSCHEDULER_NOT_STARTED ((int32_t)1)
 #define taskSCHEDULER_RUNNING ((int32_t)2)
 
+// NOTE: can't just include task.h because of redefinition that goes on in kapi
+//       include chain, so we just prototype what we need here. This mirrors
+//       TaskStatus_t in rtos/task.h
+typedef struct {
+	task_t handle;
+	const char* name;
+	uint32_t number;  // uxTCBNumber, which is never reused
+	uint32_t state;   // a task_state_e_t
+	uint32_t priority;
+	uint32_t base_priority;
+	uint32_t run_time;
+	task_stack_t* stack_base;
+	uint16_t stack_high_water;
+} task_status_s_t;
+uint32_t uxTaskGetSystemState(task_status_s_t* const pxTaskStatusArray, const uint32_t uxArraySize,
+                              uint32_t* const pulTotalRunTime);
+
 #ifdef __cplusplus
 #undef task_t
 #undef task_fn_t
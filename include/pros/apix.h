@@ -356,6 +356,343 @@ void queue_delete(queue_t queue);
  */
 void queue_reset(queue_t queue);
 
+/******************************************************************************/
+/**                               RTOS Tracing                               **/
+/******************************************************************************/
+
+// The trace recorder is only built into kernels compiled with -DPROS_TRACE.
+// Without it, these functions fail with ENOSYS.
+
+/**
+ * State of the trace recorder, see trace_get_stats()
+ */
+typedef struct trace_stats_s {
+	uint32_t recorded;   // Events recorded since the buffer was last cleared
+	uint32_t buffered;   // Events held in the buffer (the newest ones)
+	uint32_t remaining;  // Events left to record before a trigger freezes the buffer
+	bool running;        // Whether events are being recorded
+} trace_stats_s_t;
+
+/**
+ * Starts (or resumes) recording trace events. Recording is started at boot, so
+ * this is only needed after trace_stop() or a trigger. A pending trigger is
+ * cancelled.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * ENOSYS - The kernel was built without -DPROS_TRACE.
+ *
+ * \return 1 if recording started, PROS_ERR otherwise.
+ */
+int32_t trace_start(void);
+
+/**
+ * Stops recording trace events. The buffer is kept.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * ENOSYS - The kernel was built without -DPROS_TRACE.
+ *
+ * \return 1 if recording stopped, PROS_ERR otherwise.
+ */
+int32_t trace_stop(void);
+
+/**
+ * Discards every event in the trace buffer.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * ENOSYS - The kernel was built without -DPROS_TRACE.
+ *
+ * \return 1 if the buffer was cleared, PROS_ERR otherwise.
+ */
+int32_t trace_clear(void);
+
+/**
+ * Freezes the trace buffer once post_events more events have been recorded,
+ * keeping what happened before and after the trigger for trace_dump().
+ *
+ * This function may be called from an ISR. Only the first trigger while
+ * recording has an effect.
+ *
+ * \param post_events
+ *        The number of events to record after the trigger. At most
+ *        TRACE_BUFFER_EVENTS (2048 by default) events are kept in total
+ *
+ * \return 1 if the trigger was armed, 0 if events were not being recorded
+ */
+int32_t trace_trigger(uint32_t post_events);
+
+/**
+ * Records a user event in the trace, which shows up as an instant event named
+ * after the ID on the track of the running task.
+ *
+ * This function may be called from an ISR.
+ *
+ * \param id
+ *        An ID for the event
+ * \param value
+ *        A value to record with the event
+ */
+void trace_mark(uint8_t id, uint32_t value);
+
+/**
+ * Gets the state of the trace recorder.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - stats is NULL.
+ * ENOSYS - The kernel was built without -DPROS_TRACE.
+ *
+ * \param stats
+ *        The location to write the state to
+ *
+ * \return 1 if the state was read, PROS_ERR otherwise.
+ */
+int32_t trace_get_stats(trace_stats_s_t* stats);
+
+/**
+ * Writes the trace buffer to a file on the microSD card (e.g.
+ * "/usd/trace.ptrc") or to a serial stream (e.g. "/ser/trce").
+ *
+ * Recording is paused while the buffer is written and resumes afterwards.
+ * Convert the dump with tools/trace_to_perfetto.py to view it in Perfetto or
+ * chrome://tracing.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - path is NULL.
+ * EBUSY - Another dump is in progress.
+ * EIO - The dump could not be written completely.
+ * ENOSYS - The kernel was built without -DPROS_TRACE.
+ * Any errno set by open() if the file cannot be created (e.g. ENXIO if there is
+ * no microSD card).
+ *
+ * \param path
+ *        The file to write the dump to
+ *
+ * \return 1 if the dump was written, PROS_ERR otherwise.
+ */
+int32_t trace_dump(const char* path);
+
+/******************************************************************************/
+/**                                Profiling                                 **/
+/******************************************************************************/
+
+// deepest call stack the profiler collects for a sample
+#define PROFILE_MAX_DEPTH 8
+
+/**
+ * Counters of the sampling profiler, see profile_get_stats()
+ */
+typedef struct profile_stats_s {
+	uint32_t samples;  // Samples taken since the profile was last cleared
+	uint32_t kernel;   // Samples that interrupted an exception handler rather than a task
+	uint32_t dropped;  // Samples with an address that did not fit in the table
+} profile_stats_s_t;
+
+/**
+ * Starts the sampling profiler.
+ *
+ * Every period ticks (milliseconds), the tick interrupt records the address
+ * that the running task was executing, and optionally the return addresses of
+ * up to depth of its callers. The samples are counted per address in RAM until
+ * they are written out with profile_dump(). Sampling only the address is cheap
+ * enough to leave enabled, while every level of depth costs a step of the
+ * stack unwinder in the tick interrupt.
+ *
+ * Calling this while the profiler is running changes the period and depth.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - The period is 0, or the depth is more than PROFILE_MAX_DEPTH.
+ * ENOMEM - The table of samples could not be allocated.
+ *
+ * \param period
+ *        How often to take a sample, in ticks
+ * \param depth
+ *        How many callers of the sampled address to record, 0 for none
+ *
+ * \return 1 if the profiler started, PROS_ERR otherwise.
+ */
+int32_t profile_start(uint32_t period, uint32_t depth);
+
+/**
+ * Stops the sampling profiler. The samples are kept.
+ *
+ * \return 1 if the profiler stopped.
+ */
+int32_t profile_stop(void);
+
+/**
+ * Discards every sample.
+ *
+ * \return 1 if the samples were discarded.
+ */
+int32_t profile_clear(void);
+
+/**
+ * Gets the counters of the sampling profiler.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - stats is NULL.
+ *
+ * \param stats
+ *        The location to write the counters to
+ *
+ * \return 1 if the counters were read, PROS_ERR otherwise.
+ */
+int32_t profile_get_stats(profile_stats_s_t* stats);
+
+/**
+ * Writes the samples to a file on the microSD card (e.g. "/usd/prof.pprf") or
+ * to a serial stream (e.g. "/ser/prof").
+ *
+ * Sampling is paused while the samples are written and resumes afterwards.
+ * Run tools/profile_report.py on the dump and the program's ELF to list the
+ * hottest functions.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - path is NULL, or the profiler has never been started.
+ * EBUSY - Another dump is in progress.
+ * EIO - The dump could not be written completely.
+ * Any errno set by open() if the file cannot be created (e.g. ENXIO if there is
+ * no microSD card).
+ *
+ * \param path
+ *        The file to write the dump to
+ *
+ * \return 1 if the dump was written, PROS_ERR otherwise.
+ */
+int32_t profile_dump(const char* path);
+
+/******************************************************************************/
+/**                              Kernel Heap                                 **/
+/******************************************************************************/
+
+// number of size classes in heap_stats_s_t.histogram. Class i counts requests
+// of up to 16 << i bytes, and the last class counts every larger request
+#define HEAP_HISTOGRAM_BUCKETS 12
+
+/**
+ * State of the kernel heap, see heap_get_stats()
+ *
+ * The kernel heap holds tasks, queues, mutexes, LVGL objects, and the kernel's
+ * own buffers. malloc() and new use a separate heap.
+ */
+typedef struct heap_stats_s {
+	uint32_t size;           // Bytes in the heap
+	uint32_t free;           // Free bytes, including the headers of the free blocks
+	uint32_t minimum_free;   // Fewest free bytes there have been since the brain started
+	uint32_t largest_free;   // Largest free block, which bounds the largest allocation that can succeed
+	uint32_t free_blocks;    // Number of free blocks
+	uint32_t allocations;    // Number of blocks currently allocated
+	uint32_t fragmentation;  // Percentage of the free space outside the largest free block
+	// The counters below are only kept when the kernel is built with -DPROS_HEAP_STATS
+	uint32_t failures;                            // Allocations that failed
+	uint32_t histogram[HEAP_HISTOGRAM_BUCKETS];  // Allocations made since the brain started, by size
+} heap_stats_s_t;
+
+/**
+ * Memory held by a task, see heap_get_task_usage()
+ */
+typedef struct heap_task_usage_s {
+	task_t task;                   // NULL for memory allocated before the scheduler started or by deleted tasks
+	char name[TASK_NAME_MAX_LEN];  // "(startup)" or "(deleted)" if task is NULL
+	uint32_t bytes;                // Bytes allocated, not counting block headers
+	uint32_t count;                // Number of blocks allocated
+} heap_task_usage_s_t;
+
+/**
+ * A block allocated from the kernel heap, see heap_get_allocations()
+ */
+typedef struct heap_allocation_s {
+	void* address;
+	uint32_t size;    // Size of the block, not counting its header. May be a little over the requested size
+	task_t task;      // The task that allocated the block, NULL if it isn't running anymore
+	uint32_t caller;  // Return address of the kmalloc() call, for arm-none-eabi-addr2line
+} heap_allocation_s_t;
+
+/**
+ * Gets the state of the kernel heap.
+ *
+ * This walks every block of the heap with the scheduler suspended, so it takes
+ * time proportional to the number of blocks.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - stats is NULL.
+ *
+ * \param stats
+ *        The location to write the state to
+ *
+ * \return 1 if the state was read, PROS_ERR otherwise.
+ */
+int32_t heap_get_stats(heap_stats_s_t* stats);
+
+/**
+ * Gets the memory held by every task. Memory allocated before the scheduler
+ * started and memory still held by deleted tasks are each reported as one
+ * entry without a task.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - usage is NULL.
+ * ENOSYS - The kernel was not built with -DPROS_HEAP_STATS.
+ *
+ * \param usage
+ *        An array to write the usage to
+ * \param max
+ *        The length of the array
+ *
+ * \return The number of entries written, or PROS_ERR if an error occurred.
+ */
+int32_t heap_get_task_usage(heap_task_usage_s_t* usage, uint32_t max);
+
+/**
+ * Lists the blocks currently allocated from the kernel heap, in address
+ * order. Blocks that stay allocated when they shouldn't be are leaks.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - allocations is NULL.
+ * ENOSYS - The kernel was not built with -DPROS_HEAP_STATS.
+ *
+ * \param allocations
+ *        An array to write the blocks to
+ * \param max
+ *        The length of the array
+ *
+ * \return The number of blocks allocated, which may be more than max, or
+ * PROS_ERR if an error occurred.
+ */
+int32_t heap_get_allocations(heap_allocation_s_t* allocations, uint32_t max);
+
+/**
+ * Writes a readable report of the kernel heap to a file on the microSD card
+ * (e.g. "/usd/heap.txt") or to a serial stream (e.g. "/ser/sout"). The report
+ * has the state from heap_get_stats() and, when the kernel is built with
+ * -DPROS_HEAP_STATS, the usage of every task and a list of every allocated
+ * block.
+ *
+ * The same report is printed to the serial port if a kernel allocation fails,
+ * before the brain halts.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - path is NULL.
+ * EIO - The report could not be written completely.
+ * Any errno set by open() if the file cannot be created.
+ *
+ * \param path
+ *        The file to write the report to
+ *
+ * \return 1 if the report was written, PROS_ERR otherwise.
+ */
+int32_t heap_report(const char* path);
+
 /******************************************************************************/
 /**                           Device Registration                            **/
 /******************************************************************************/
@@ -463,6 +800,93 @@ v5_device_e_t registry_get_plugged_type(uint8_t port);
  */
 int32_t serctl(const uint32_t action, void* const extra_arg);
 
+/*
+ * When a task's serial output buffer (see SERCTL_TASK_BUFFER) is shipped over
+ * the serial line. A full buffer is always shipped.
+ */
+typedef enum ser_flush_policy_e {
+	E_SER_FLUSH_SIZE = 0,  // only when the buffer is full
+	E_SER_FLUSH_LINE,      // whenever a newline is written
+	E_SER_FLUSH_TIME       // once the oldest buffered byte is flush_period ms old
+} ser_flush_policy_e_t;
+
+/*
+ * Configuration of a task's serial output buffer. Passed to
+ * serctl(SERCTL_TASK_BUFFER, ...)
+ */
+typedef struct ser_task_buffer_config_s {
+	uint32_t size;                      // size of the buffer in bytes, at most 1024
+	ser_flush_policy_e_t flush_policy;  // when to ship the buffer
+	uint32_t flush_period;              // maximum age (ms) of buffered data for E_SER_FLUSH_TIME
+} ser_task_buffer_config_s_t;
+
+/*
+ * Priority classes of the serial output queue. When the serial line is
+ * congested, data in a higher priority class is always sent before data in a
+ * lower one. By default, serr is high, kdbg is medium, sout is normal, and all
+ * other streams are low priority.
+ */
+typedef enum ser_priority_e {
+	E_SER_PRIORITY_HIGH = 0,
+	E_SER_PRIORITY_MEDIUM,
+	E_SER_PRIORITY_NORMAL,
+	E_SER_PRIORITY_LOW
+} ser_priority_e_t;
+
+#define SER_PRIORITY_CLASSES 4
+
+/*
+ * What happens to a write when its priority class's output queue is full
+ */
+typedef enum ser_drop_policy_e {
+	E_SER_DROP_BLOCK = 0,  // wait for space (unless the file is non-blocking)
+	E_SER_DROP_NEWEST      // drop the write immediately
+} ser_drop_policy_e_t;
+
+/*
+ * Output configuration of a stream. Passed to
+ * serctl(SERCTL_CONFIGURE_STREAM, ...)
+ */
+typedef struct ser_stream_config_s {
+	uint32_t stream_id;  // little endian stream identifier (e.g. "sout" -> 0x74756f73)
+	ser_priority_e_t priority;
+	ser_drop_policy_e_t drop_policy;
+} ser_stream_config_s_t;
+
+/*
+ * Statistics of a serial output priority class, in bytes on the wire (after
+ * COBS encoding)
+ */
+typedef struct ser_stats_s {
+	uint32_t queued;   // bytes accepted into the output queue
+	uint32_t sent;     // bytes handed to VEXos for transmission
+	uint32_t dropped;  // bytes dropped because the queue or VEXos was full
+} ser_stats_s_t;
+
+/*
+ * Statistics of a stream, in bytes written by the program. Passed to
+ * serctl(SERCTL_GET_STREAM_STATS, ...)
+ */
+typedef struct ser_stream_stats_s {
+	uint32_t stream_id;                // [in] little endian stream identifier
+	ser_priority_e_t priority;         // [out] current priority class of the stream
+	ser_drop_policy_e_t drop_policy;   // [out] current drop policy of the stream
+	uint32_t queued;                   // [out] bytes accepted into the output queue
+	uint32_t dropped;                  // [out] bytes dropped
+} ser_stream_stats_s_t;
+
+/*
+ * Statistics of a microSD file's write-behind buffer. Passed to
+ * fdctl(file, USDCTL_GET_BUFFER_STATS, ...)
+ */
+typedef struct usd_buffer_stats_s {
+	uint32_t buffered;    // bytes currently waiting to be written to the card
+	uint32_t high_water;  // largest number of bytes that were ever waiting
+	uint32_t flushed;     // bytes written to the card
+	uint32_t overruns;    // writes that were cut short because both buffers were full
+	uint32_t errors;      // chunks that the card did not accept completely
+} usd_buffer_stats_s_t;
+
 /**
  * Control settings of the microSD card driver.
  *
@@ -560,9 +984,57 @@ int32_t fdctl(int file, const uint32_t action, void* const extra_arg);
  */
 #define SERCTL_DISABLE_COBS 15
 
+/**
+ * Action macro to pass into serctl that gives the calling task its own serial
+ * output buffer.
+ *
+ * Writes from the task (except to stderr) collect in the buffer and are
+ * shipped as a single write (and a single COBS packet) according to the
+ * buffer's flush policy. This avoids contention between tasks that print
+ * frequently. Any previous buffer of the task is flushed and replaced.
+ *
+ * The extra argument is a pointer to a ser_task_buffer_config_s_t, or NULL to
+ * flush and remove the calling task's buffer.
+ */
+#define SERCTL_TASK_BUFFER 19
+
+/**
+ * Action macro to pass into serctl that ships the contents of the calling
+ * task's serial output buffer immediately.
+ *
+ * The extra argument is not used with this action, provide any value (e.g.
+ * NULL) instead
+ */
+#define SERCTL_TASK_FLUSH 20
+
+/**
+ * Action macro to pass into serctl that sets the priority class and drop policy
+ * of a stream.
+ *
+ * The extra argument is a pointer to a ser_stream_config_s_t
+ */
+#define SERCTL_CONFIGURE_STREAM 21
+
+/**
+ * Action macro to pass into serctl that gets the statistics of every serial
+ * output priority class.
+ *
+ * The extra argument is a pointer to an array of SER_PRIORITY_CLASSES
+ * ser_stats_s_t, indexed by ser_priority_e_t
+ */
+#define SERCTL_GET_STATS 22
+
+/**
+ * Action macro to pass into serctl that gets the statistics of a stream.
+ *
+ * The extra argument is a pointer to a ser_stream_stats_s_t with the stream_id
+ * filled in
+ */
+#define SERCTL_GET_STREAM_STATS 23
+
 /**
  * Action macro to check if there is data available from the Generic Serial
- * Device
+ * Device's receive buffer
  *
  * The extra argument is not used with this action, provide any value (e.g.
  * NULL) instead
@@ -585,6 +1057,61 @@ int32_t fdctl(int file, const uint32_t action, void* const extra_arg);
  */
 #define DEVCTL_SET_BAUDRATE 17
 
+/**
+ * Action macro to set how long a blocking read on a Generic Serial Device
+ * waits for data before returning 0 with errno set to EAGAIN.
+ *
+ * The extra argument is the timeout in milliseconds, or TIMEOUT_MAX (the
+ * default) to wait forever.
+ */
+#define DEVCTL_SET_READ_TIMEOUT 24
+
+/**
+ * Action macro to pass into fdctl that gives a microSD file opened for writing
+ * a write-behind buffer.
+ *
+ * Writes are then copied into one of two RAM buffers and written to the card
+ * by a low priority kernel task, so writing never waits for the card. A buffer
+ * is written once it is full, or once its oldest byte is 100 ms old. If both
+ * buffers are full, the write is cut short and counted as an overrun (errno is
+ * set to EAGAIN if nothing could be written).
+ *
+ * The extra argument is the size of each buffer in bytes, which is rounded up
+ * to a multiple of the card's 512 byte sectors. A size of 0 flushes and removes
+ * the buffers.
+ */
+#define USDCTL_SET_WRITE_BUFFER 25
+
+/**
+ * Action macro to pass into fdctl that writes everything in a microSD file's
+ * write-behind buffer to the card, waiting until it is done. fsync() does the
+ * same.
+ *
+ * The extra argument is not used with this action, provide any value (e.g.
+ * NULL) instead
+ */
+#define USDCTL_FLUSH 26
+
+/**
+ * Action macro to pass into fdctl that gets the statistics of a microSD file's
+ * write-behind buffer.
+ *
+ * The extra argument is a pointer to a usd_buffer_stats_s_t
+ */
+#define USDCTL_GET_BUFFER_STATS 27
+
+/**
+ * Action macro to pass into fdctl that sets the read-ahead chunk size of a
+ * microSD file opened read-only.
+ *
+ * Reads smaller than a chunk are served from a chunk that is read from the card
+ * in a single call, and larger reads go straight to the caller's buffer. Files
+ * opened read-only use 4096 byte chunks by default.
+ *
+ * The extra argument is the chunk size in bytes, or 0 to disable read-ahead.
+ */
+#define USDCTL_SET_READ_AHEAD 28
+
 #ifdef __cplusplus
 }
 }
@@ -0,0 +1,760 @@
+/**
+ * \file pros/coroutine.hpp
+ *
+ * Contains a cooperative coroutine runtime for running many concurrent
+ * behaviors, such as the steps of an autonomous routine, in one task.
+ *
+ * A pros::co::Task is a C++20 coroutine. It runs on a pros::co::Executor,
+ * which resumes its coroutines one at a time from a single RTOS task.
+ * Coroutines give up the CPU only at a co_await, for example on
+ * pros::co::delay() or pros::co::reached_target(). Each one needs only a heap
+ * allocated frame holding its local variables, usually a few hundred bytes,
+ * rather than a task with its own stack. Switching between them is a function
+ * call rather than a context switch.
+ *
+ * This header requires C++20 coroutines. It is empty unless the project is
+ * built with them, e.g. by adding -std=gnu++20 (and -fcoroutines on GCC 10)
+ * to EXTRA_CXXFLAGS in the project's Makefile.
+ *
+ * Example:
+ *   pros::co::Executor executor;
+ *
+ *   pros::co::Task<> raise_lift() {
+ *     lift.move_absolute(900, 100);
+ *     co_await pros::co::reached_target(lift, 10, 2000);
+ *   }
+ *
+ *   pros::co::Task<> score() {
+ *     left.move_relative(1000, 150);
+ *     right.move_relative(1000, 150);
+ *     executor.spawn(raise_lift());  // runs alongside the drive
+ *     co_await pros::co::reached_target(left);
+ *     co_await pros::co::until([] { return bumper.get_value(); }, 500);
+ *     claw.move_absolute(0, 100);
+ *   }
+ *
+ *   void autonomous() {
+ *     executor.spawn(score());
+ *     executor.run();  // returns once every coroutine has finished
+ *   }
+ *
+ * This file should not be modified by users, since it gets replaced whenever
+ * a kernel upgrade occurs.
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _PROS_COROUTINE_HPP_
+#define _PROS_COROUTINE_HPP_
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <cmath>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "pros/apix.h"
+#include "pros/motors.hpp"
+#include "pros/rtos.hpp"
+
+namespace pros::co {
+class Executor;
+template <typename T = void>
+class Task;
+
+namespace detail {
+/**
+ * A suspended coroutine waiting in one of an Executor's lists. Lives in the
+ * suspended coroutine's frame, so waiting never allocates.
+ */
+struct Waiter {
+	Waiter* next = nullptr;
+	std::coroutine_handle<> handle;
+	std::uint32_t wake_time = 0;
+	bool has_deadline = false;
+};
+
+/**
+ * A Waiter that is ready once poll() returns true, checked every time the
+ * executor wakes up. Used for conditions that can't notify the executor, such
+ * as device data.
+ */
+struct Polled : Waiter {
+	explicit Polled(std::uint32_t timeout) : timeout(timeout) {}
+	virtual ~Polled() = default;
+	virtual bool poll() = 0;
+
+	bool await_ready() {
+		ready = poll();
+		return ready;
+	}
+	template <typename Promise>
+	void await_suspend(std::coroutine_handle<Promise> handle);
+
+	std::uint32_t timeout;
+	bool ready = false;
+};
+
+struct PromiseBase {
+	std::suspend_always initial_suspend() noexcept {
+		return {};
+	}
+	void unhandled_exception() noexcept {
+		exception = std::current_exception();
+	}
+
+	Executor* executor = nullptr;
+	// the coroutine awaiting this one, or null if it was spawned
+	std::coroutine_handle<> continuation;
+	std::exception_ptr exception;
+	// spawned coroutines only: the next coroutine spawned on the same
+	// executor, and the Waiter that first resumes this one
+	PromiseBase* next_root = nullptr;
+	Waiter start;
+};
+
+template <typename Promise>
+struct FinalAwaiter;
+}  // namespace detail
+
+/**
+ * Runs coroutines cooperatively in a single RTOS task.
+ *
+ * The executor sleeps whenever none of its coroutines can make progress. It
+ * wakes up for the earliest delay, when the executor's task is notified, and
+ * every poll period while a coroutine waits on a polled condition.
+ *
+ * Coroutines may only be spawned from the executor's own task (including from
+ * its coroutines) or before it starts running.
+ */
+class Executor {
+	public:
+	/**
+	 * Creates an executor.
+	 *
+	 * \param poll_period
+	 *        How often to check polled conditions, such as until() and
+	 *        reached_target(), in milliseconds. Devices send new data every 10
+	 *        milliseconds or more.
+	 */
+	explicit Executor(std::uint32_t poll_period = 5) : _poll_period(poll_period) {}
+	Executor(const Executor&) = delete;
+	Executor& operator=(const Executor&) = delete;
+
+	/**
+	 * Destroys every coroutine that hasn't finished.
+	 */
+	~Executor() {
+		while (_roots) {
+			detail::PromiseBase* root = _roots;
+			_roots = root->next_root;
+			root->start.handle.destroy();
+		}
+	}
+
+	/**
+	 * Starts running a coroutine on this executor. The executor takes ownership
+	 * of it, and destroys it once it finishes.
+	 *
+	 * \param task
+	 *        The coroutine to run. Its result, if any, is discarded.
+	 */
+	template <typename T>
+	void spawn(Task<T> task) {
+		auto handle = task.release();
+		detail::PromiseBase& promise = handle.promise();
+		promise.executor = this;
+		promise.next_root = _roots;
+		_roots = &promise;
+		promise.start.handle = handle;
+		schedule(&promise.start);
+	}
+
+	/**
+	 * Runs coroutines in the calling task until every spawned coroutine has
+	 * finished.
+	 *
+	 * If an exception escapes a spawned coroutine, it is rethrown from here
+	 * once the other ready coroutines have had their turn. The remaining
+	 * coroutines can be resumed by calling run() again.
+	 */
+	void run() {
+		_task = c::task_get_current();
+		while (_roots) {
+			// coroutines that become ready while these run wait for the next pass,
+			// so one that keeps yielding can't starve the others
+			detail::Waiter* ready = _ready;
+			_ready = _ready_tail = nullptr;
+			while (ready) {
+				detail::Waiter* waiter = ready;
+				ready = waiter->next;
+				waiter->next = nullptr;
+				waiter->handle.resume();
+			}
+			if (_exception) {
+				std::rethrow_exception(std::exchange(_exception, nullptr));
+			}
+			if (_roots) {
+				wait();
+			}
+		}
+	}
+
+	/**
+	 * Creates a task that runs this executor.
+	 *
+	 * \param prio
+	 *        The priority of the task
+	 * \param name
+	 *        The name of the task
+	 *
+	 * \return The task, which exits once every spawned coroutine has finished
+	 */
+	task_t start(std::uint32_t prio = TASK_PRIORITY_DEFAULT, const char* name = "Executor") {
+		_task = pros::Task::create([this] { run(); }, prio, TASK_STACK_DEPTH_DEFAULT, name);
+		return _task;
+	}
+
+	/**
+	 * \return The task running this executor, which other tasks can notify to
+	 * wake coroutines waiting on notified()
+	 */
+	task_t get_task() const {
+		return _task;
+	}
+
+	/**
+	 * \return True if every spawned coroutine has finished
+	 */
+	bool empty() const {
+		return _roots == nullptr;
+	}
+
+	private:
+	template <typename Promise>
+	friend struct detail::FinalAwaiter;
+	friend struct detail::Polled;
+	friend class Delay;
+	friend class Yield;
+	friend class Notified;
+
+	void schedule(detail::Waiter* waiter) {
+		waiter->next = nullptr;
+		if (_ready_tail) {
+			_ready_tail->next = waiter;
+		} else {
+			_ready = waiter;
+		}
+		_ready_tail = waiter;
+	}
+
+	void add_timer(detail::Waiter* waiter) {
+		detail::Waiter** link = &_timers;
+		while (*link && static_cast<std::int32_t>(waiter->wake_time - (*link)->wake_time) >= 0) {
+			link = &(*link)->next;
+		}
+		waiter->next = *link;
+		*link = waiter;
+	}
+
+	void add_poll(detail::Polled* waiter) {
+		waiter->has_deadline = waiter->timeout != TIMEOUT_MAX;
+		waiter->wake_time = c::millis() + waiter->timeout;
+		waiter->next = _polls;
+		_polls = waiter;
+	}
+
+	void finish(detail::PromiseBase& promise) {
+		detail::PromiseBase** link = &_roots;
+		while (*link != &promise) {
+			link = &(*link)->next_root;
+		}
+		*link = promise.next_root;
+		if (promise.exception) {
+			_exception = promise.exception;
+		}
+		// the coroutine is suspended at its final suspend point, so this is safe
+		// even though it's still inside its await_suspend()
+		promise.start.handle.destroy();
+	}
+
+	void wait() {
+		std::uint32_t now = c::millis();
+		std::uint32_t timeout = TIMEOUT_MAX;
+		if (_ready) {
+			timeout = 0;
+		} else {
+			if (_polls) {
+				timeout = _poll_period;
+			}
+			if (_timers) {
+				std::int32_t left = static_cast<std::int32_t>(_timers->wake_time - now);
+				std::uint32_t until_timer = left > 0 ? left : 0;
+				if (until_timer < timeout) {
+					timeout = until_timer;
+				}
+			}
+		}
+		if (c::task_notify_take(true, timeout)) {
+			_notifications++;
+		}
+
+		now = c::millis();
+		while (_timers && static_cast<std::int32_t>(now - _timers->wake_time) >= 0) {
+			detail::Waiter* waiter = _timers;
+			_timers = waiter->next;
+			schedule(waiter);
+		}
+		detail::Waiter** link = &_polls;
+		while (*link) {
+			detail::Polled* waiter = static_cast<detail::Polled*>(*link);
+			waiter->ready = waiter->poll();
+			if (waiter->ready ||
+			    (waiter->has_deadline && static_cast<std::int32_t>(now - waiter->wake_time) >= 0)) {
+				*link = waiter->next;
+				schedule(waiter);
+			} else {
+				link = &waiter->next;
+			}
+		}
+	}
+
+	std::uint32_t _poll_period;
+	task_t _task = nullptr;
+	// spawned coroutines that haven't finished
+	detail::PromiseBase* _roots = nullptr;
+	// coroutines to resume on the next pass, in order
+	detail::Waiter* _ready = nullptr;
+	detail::Waiter* _ready_tail = nullptr;
+	// delays, sorted by wake time
+	detail::Waiter* _timers = nullptr;
+	detail::Waiter* _polls = nullptr;
+	// number of times the executor's task was woken by a notification
+	std::uint32_t _notifications = 0;
+	std::exception_ptr _exception;
+};
+
+namespace detail {
+template <typename Promise>
+struct FinalAwaiter {
+	bool await_ready() noexcept {
+		return false;
+	}
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+		detail::PromiseBase& promise = handle.promise();
+		if (promise.continuation) {
+			return promise.continuation;
+		}
+		promise.executor->finish(promise);
+		return std::noop_coroutine();
+	}
+	void await_resume() noexcept {}
+};
+
+template <typename Promise>
+void Polled::await_suspend(std::coroutine_handle<Promise> handle) {
+	this->handle = handle;
+	handle.promise().executor->add_poll(this);
+}
+
+template <typename T>
+struct Promise : PromiseBase {
+	template <typename U>
+	void return_value(U&& value) {
+		result.emplace(std::forward<U>(value));
+	}
+	std::optional<T> result;
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+	void return_void() {}
+};
+}  // namespace detail
+
+/**
+ * A coroutine returning T.
+ *
+ * A Task doesn't start running when it is called. It runs once it is passed
+ * to Executor::spawn(), or when another coroutine co_awaits it, in which case
+ * the co_await resumes with its result once it finishes.
+ */
+template <typename T>
+class Task {
+	public:
+	struct promise_type : detail::Promise<T> {
+		Task get_return_object() {
+			return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		detail::FinalAwaiter<promise_type> final_suspend() noexcept {
+			return {};
+		}
+	};
+
+	Task(Task&& other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+	Task& operator=(Task&& other) noexcept {
+		if (this != &other) {
+			if (_handle) _handle.destroy();
+			_handle = std::exchange(other._handle, nullptr);
+		}
+		return *this;
+	}
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+
+	~Task() {
+		if (_handle) _handle.destroy();
+	}
+
+	struct Awaiter {
+		bool await_ready() noexcept {
+			return false;
+		}
+		template <typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> parent) noexcept {
+			child.promise().executor = parent.promise().executor;
+			child.promise().continuation = parent;
+			return child;
+		}
+		T await_resume() {
+			if (child.promise().exception) {
+				std::rethrow_exception(child.promise().exception);
+			}
+			if constexpr (!std::is_void_v<T>) {
+				return std::move(*child.promise().result);
+			}
+		}
+		std::coroutine_handle<promise_type> child;
+	};
+
+	Awaiter operator co_await() noexcept {
+		return Awaiter{_handle};
+	}
+
+	private:
+	friend class Executor;
+
+	explicit Task(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+
+	std::coroutine_handle<promise_type> release() {
+		return std::exchange(_handle, nullptr);
+	}
+
+	std::coroutine_handle<promise_type> _handle;
+};
+
+/**
+ * Awaitable returned by delay() and delay_until().
+ */
+class Delay : detail::Waiter {
+	public:
+	explicit Delay(std::uint32_t wake_time) {
+		this->wake_time = wake_time;
+	}
+	bool await_ready() const noexcept {
+		return false;
+	}
+	template <typename Promise>
+	void await_suspend(std::coroutine_handle<Promise> handle) {
+		this->handle = handle;
+		handle.promise().executor->add_timer(this);
+	}
+	void await_resume() const noexcept {}
+};
+
+/**
+ * Suspends the coroutine for a given amount of time.
+ *
+ * \param milliseconds
+ *        The number of milliseconds to wait
+ */
+inline Delay delay(std::uint32_t milliseconds) {
+	return Delay(c::millis() + milliseconds);
+}
+
+/**
+ * Suspends the coroutine until a given time. Like task_delay_until(), this is
+ * useful for running a loop at a steady rate.
+ *
+ * \param prev_time
+ *        A pointer to the time of the last wake up, which is updated to the
+ *        time of this one
+ * \param delta
+ *        The number of milliseconds to wait after prev_time
+ */
+inline Delay delay_until(std::uint32_t* const prev_time, const std::uint32_t delta) {
+	*prev_time += delta;
+	return Delay(*prev_time);
+}
+
+/**
+ * Awaitable returned by yield().
+ */
+class Yield : detail::Waiter {
+	public:
+	bool await_ready() const noexcept {
+		return false;
+	}
+	template <typename Promise>
+	void await_suspend(std::coroutine_handle<Promise> handle) {
+		this->handle = handle;
+		handle.promise().executor->schedule(this);
+	}
+	void await_resume() const noexcept {}
+};
+
+/**
+ * Lets the executor's other ready coroutines run before this one continues.
+ */
+inline Yield yield() {
+	return {};
+}
+
+/**
+ * Awaitable returned by until().
+ */
+template <typename F>
+class Until : detail::Polled {
+	public:
+	Until(F&& condition, std::uint32_t timeout) : Polled(timeout), _condition(std::forward<F>(condition)) {}
+	using Polled::await_ready;
+	using Polled::await_suspend;
+	bool await_resume() const noexcept {
+		return ready;
+	}
+
+	private:
+	bool poll() override {
+		return static_cast<bool>(_condition());
+	}
+	std::decay_t<F> _condition;
+};
+
+/**
+ * Suspends the coroutine until a condition is true. The condition is checked
+ * every poll period of the executor.
+ *
+ * \param condition
+ *        A callable returning true once the coroutine should continue
+ * \param timeout
+ *        The longest time to wait, in milliseconds. TIMEOUT_MAX waits forever.
+ *
+ * \return An awaitable resuming with true if the condition became true, or
+ * false if timeout passed first
+ */
+template <typename F>
+Until<F> until(F&& condition, std::uint32_t timeout = TIMEOUT_MAX) {
+	return Until<F>(std::forward<F>(condition), timeout);
+}
+
+/**
+ * Awaitable returned by notified().
+ */
+class Notified : detail::Polled {
+	public:
+	Notified(const Executor& executor, std::uint32_t timeout)
+	    : Polled(timeout), _executor(executor), _last(executor._notifications) {}
+	using Polled::await_ready;
+	using Polled::await_suspend;
+	bool await_resume() const noexcept {
+		return ready;
+	}
+
+	private:
+	bool poll() override {
+		return _executor._notifications != _last;
+	}
+	const Executor& _executor;
+	std::uint32_t _last;
+};
+
+/**
+ * Suspends the coroutine until the executor's task receives a task
+ * notification, e.g. from another task calling
+ * task_notify(executor.get_task()). Every coroutine waiting at the time of the
+ * notification is resumed.
+ *
+ * \param executor
+ *        The executor running the coroutine
+ * \param timeout
+ *        The longest time to wait, in milliseconds. TIMEOUT_MAX waits forever.
+ *
+ * \return An awaitable resuming with true if a notification arrived, or false
+ * if timeout passed first
+ */
+inline Notified notified(const Executor& executor, std::uint32_t timeout = TIMEOUT_MAX) {
+	return Notified(executor, timeout);
+}
+
+/**
+ * Awaitable returned by receive().
+ */
+class Receive : detail::Polled {
+	public:
+	Receive(c::queue_t queue, void* const buffer, std::uint32_t timeout)
+	    : Polled(timeout), _queue(queue), _buffer(buffer) {}
+	using Polled::await_ready;
+	using Polled::await_suspend;
+	bool await_resume() const noexcept {
+		return ready;
+	}
+
+	private:
+	bool poll() override {
+		return c::queue_recv(_queue, _buffer, 0);
+	}
+	c::queue_t _queue;
+	void* _buffer;
+};
+
+/**
+ * Suspends the coroutine until an item can be received from a queue.
+ *
+ * \param queue
+ *        The queue handle
+ * \param buffer
+ *        The location to copy the item to
+ * \param timeout
+ *        The longest time to wait, in milliseconds. TIMEOUT_MAX waits forever.
+ *
+ * \return An awaitable resuming with true if an item was received, or false
+ * if timeout passed first
+ */
+inline Receive receive(c::queue_t queue, void* const buffer, std::uint32_t timeout = TIMEOUT_MAX) {
+	return Receive(queue, buffer, timeout);
+}
+
+/**
+ * Awaitable returned by pop().
+ */
+template <typename Queue>
+class Pop : detail::Polled {
+	public:
+	Pop(Queue& queue, std::uint32_t timeout) : Polled(timeout), _queue(queue) {}
+	using Polled::await_ready;
+	using Polled::await_suspend;
+	decltype(std::declval<Queue&>().pop()) await_resume() {
+		return std::move(_item);
+	}
+
+	private:
+	bool poll() override {
+		_item = _queue.pop();
+		return static_cast<bool>(_item);
+	}
+	Queue& _queue;
+	decltype(std::declval<Queue&>().pop()) _item;
+};
+
+/**
+ * Suspends the coroutine until an item can be taken from a queue whose pop()
+ * returns a std::optional, such as a pros::SpscQueue.
+ *
+ * \param queue
+ *        The queue to take from
+ * \param timeout
+ *        The longest time to wait, in milliseconds. TIMEOUT_MAX waits forever.
+ *
+ * \return An awaitable resuming with the item, or std::nullopt if timeout
+ * passed first
+ */
+template <typename Queue>
+Pop<Queue> pop(Queue& queue, std::uint32_t timeout = TIMEOUT_MAX) {
+	return Pop<Queue>(queue, timeout);
+}
+
+/**
+ * Awaitable returned by fresh_data().
+ */
+class FreshData : detail::Polled {
+	public:
+	FreshData(const Motor& motor, std::uint32_t timeout) : Polled(timeout), _motor(motor) {
+		_motor.get_raw_position(&_timestamp);
+	}
+	using Polled::await_ready;
+	using Polled::await_suspend;
+	bool await_resume() const noexcept {
+		return ready;
+	}
+
+	private:
+	bool poll() override {
+		std::uint32_t timestamp = _timestamp;
+		return _motor.get_raw_position(&timestamp) != PROS_ERR && timestamp != _timestamp;
+	}
+	const Motor& _motor;
+	std::uint32_t _timestamp = 0;
+};
+
+/**
+ * Suspends the coroutine until a motor reports new data.
+ *
+ * \param motor
+ *        The motor to wait for
+ * \param timeout
+ *        The longest time to wait, in milliseconds. TIMEOUT_MAX waits forever.
+ *
+ * \return An awaitable resuming with true if new data arrived, or false if
+ * timeout passed first
+ */
+inline FreshData fresh_data(const Motor& motor, std::uint32_t timeout = TIMEOUT_MAX) {
+	return FreshData(motor, timeout);
+}
+
+/**
+ * Awaitable returned by reached_target().
+ */
+class ReachedTarget : detail::Polled {
+	public:
+	ReachedTarget(const Motor& motor, double tolerance, std::uint32_t timeout)
+	    : Polled(timeout), _motor(motor), _tolerance(tolerance) {}
+	using Polled::await_ready;
+	using Polled::await_suspend;
+	bool await_resume() const noexcept {
+		return ready;
+	}
+
+	private:
+	bool poll() override {
+		// the motor doesn't report whether it's stopped (see motor_is_stopped()),
+		// so treat it as settled once it's nearly still
+		return std::fabs(_motor.get_position() - _motor.get_target_position()) <= _tolerance &&
+		       std::fabs(_motor.get_actual_velocity()) < 5;
+	}
+	const Motor& _motor;
+	double _tolerance;
+};
+
+/**
+ * Suspends the coroutine until a motor moving with move_absolute() or
+ * move_relative() reaches its target: its position is within tolerance of the
+ * target and it has slowed to under 5 RPM.
+ *
+ * \param motor
+ *        The motor to wait for
+ * \param tolerance
+ *        How close to the target counts as reached, in the motor's encoder
+ *        units
+ * \param timeout
+ *        The longest time to wait, in milliseconds. TIMEOUT_MAX waits forever.
+ *
+ * \return An awaitable resuming with true if the motor reached its target, or
+ * false if timeout passed first
+ */
+inline ReachedTarget reached_target(const Motor& motor, double tolerance = 5, std::uint32_t timeout = TIMEOUT_MAX) {
+	return ReachedTarget(motor, tolerance, timeout);
+}
+}  // namespace pros::co
+
+#endif  // defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#endif  // _PROS_COROUTINE_HPP_
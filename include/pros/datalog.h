@@ -0,0 +1,200 @@
+/**
+ * \file pros/datalog.h
+ *
+ * Contains prototypes for the binary data logger, which records sensor and
+ * motor values to the microSD card at a fixed rate.
+ *
+ * The log is a compact binary file. It starts with a header that describes
+ * every channel, followed by fixed-size records with periodic checksummed sync
+ * markers. tools/datalog_convert.py checks the records and converts the log to
+ * CSV or Parquet.
+ *
+ * This file should not be modified by users, since it gets replaced whenever
+ * a kernel upgrade occurs.
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _PROS_DATALOG_H_
+#define _PROS_DATALOG_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+namespace pros {
+#endif
+
+// number of channels that can be logged
+#define DATALOG_MAX_CHANNELS 32
+// longest channel name, not including the terminator
+#define DATALOG_MAX_NAME_LENGTH 31
+
+/**
+ * How a channel's value is stored in the log
+ */
+typedef enum datalog_type_e {
+	E_DATALOG_INT32 = 0,  // signed 32-bit integer
+	E_DATALOG_FLOAT       // 32-bit floating point number
+} datalog_type_e_t;
+
+/**
+ * Counters of the data logger, see datalog_get_stats()
+ */
+typedef struct datalog_stats_s {
+	uint32_t records;  // Records sampled and queued for the card
+	uint32_t dropped;  // Records discarded because the queue was full
+	uint32_t written;  // Bytes written to the log file
+	uint32_t errors;   // Writes that the card did not accept
+} datalog_stats_s_t;
+
+#ifdef __cplusplus
+namespace c {
+#endif
+
+/**
+ * Adds a channel whose value is read by calling an integer getter with a port
+ * number, such as motor_get_current_draw or adi_analog_read.
+ *
+ * Channels can only be added while the logger is stopped. Names should be
+ * unique, and are truncated to DATALOG_MAX_NAME_LENGTH characters.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - The name or getter is NULL.
+ * EBUSY - The logger is running.
+ * ENOSPC - DATALOG_MAX_CHANNELS channels have already been added.
+ *
+ * \param name
+ *        The name of the channel, which becomes the column header
+ * \param getter
+ *        The function that reads the value
+ * \param port
+ *        The port number passed to the getter
+ *
+ * \return The index of the channel, or PROS_ERR if it could not be added.
+ */
+int32_t datalog_add_int(const char* name, int32_t (*getter)(uint8_t port), uint8_t port);
+
+/**
+ * Adds a channel whose value is read by calling a floating point getter with a
+ * port number, such as motor_get_position or imu_get_heading. The value is
+ * stored as a 32-bit float.
+ *
+ * Channels can only be added while the logger is stopped. Names should be
+ * unique, and are truncated to DATALOG_MAX_NAME_LENGTH characters.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - The name or getter is NULL.
+ * EBUSY - The logger is running.
+ * ENOSPC - DATALOG_MAX_CHANNELS channels have already been added.
+ *
+ * \param name
+ *        The name of the channel, which becomes the column header
+ * \param getter
+ *        The function that reads the value
+ * \param port
+ *        The port number passed to the getter
+ *
+ * \return The index of the channel, or PROS_ERR if it could not be added.
+ */
+int32_t datalog_add_double(const char* name, double (*getter)(uint8_t port), uint8_t port);
+
+/**
+ * Adds a channel that records a variable of the program, such as the output
+ * of a controller.
+ *
+ * The variable is read without any locking, so it should be a naturally
+ * aligned 32-bit value that is updated with single stores.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - The name or variable is NULL, or the type is invalid.
+ * EBUSY - The logger is running.
+ * ENOSPC - DATALOG_MAX_CHANNELS channels have already been added.
+ *
+ * \param name
+ *        The name of the channel, which becomes the column header
+ * \param type
+ *        The type of the variable, an int32_t or a float
+ * \param variable
+ *        The address of the variable, which must stay valid while logging
+ *
+ * \return The index of the channel, or PROS_ERR if it could not be added.
+ */
+int32_t datalog_add_variable(const char* name, datalog_type_e_t type, const volatile void* variable);
+
+/**
+ * Removes every channel. The logger must be stopped.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EBUSY - The logger is running.
+ *
+ * \return 1 if the channels were removed, PROS_ERR otherwise.
+ */
+int32_t datalog_clear_channels(void);
+
+/**
+ * Starts logging every channel to a file on the microSD card.
+ *
+ * A kernel task samples the channels every period milliseconds into a queue
+ * in RAM, and a low priority task writes the queue to the card. If the card
+ * falls behind far enough to fill the queue, records are dropped and counted.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - No channels have been added, or the period is 0.
+ * EBUSY - The logger is already running.
+ * ENOMEM - The queue could not be allocated.
+ * Any errno set by open() if the file cannot be created (e.g. ENXIO if there is
+ * no microSD card).
+ *
+ * \param path
+ *        The file to create, e.g. "/usd/match.plog"
+ * \param period
+ *        How often to sample the channels, in milliseconds
+ *
+ * \return 1 if logging started, PROS_ERR otherwise.
+ */
+int32_t datalog_start(const char* path, uint32_t period);
+
+/**
+ * Stops logging, waiting until every queued record has been written and the
+ * file is closed.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - The logger is not running.
+ *
+ * \return 1 if logging stopped, PROS_ERR otherwise.
+ */
+int32_t datalog_stop(void);
+
+/**
+ * Gets the counters of the current (or last) log.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - stats is NULL.
+ *
+ * \param stats
+ *        The location to write the counters to
+ *
+ * \return 1 if the counters were read, PROS_ERR otherwise.
+ */
+int32_t datalog_get_stats(datalog_stats_s_t* stats);
+
+#ifdef __cplusplus
+}
+}
+}
+#endif
+
+#endif  // _PROS_DATALOG_H_
@@ -0,0 +1,108 @@
+/**
+ * \file pros/hrtimer.h
+ *
+ * Contains prototypes for high-resolution timers, which run a function at a
+ * given time with microsecond resolution.
+ *
+ * The RTOS tick is 1 millisecond, so task_delay() and the other RTOS timeouts
+ * can't wait for less than that. High-resolution timers use a separate
+ * hardware timer instead. Their callbacks run one at a time in a kernel task at
+ * the highest priority, on a stack of 0x800 words, so they may call any
+ * function that does not block for long. For waiting in a task, see
+ * task_delay_us_until() and usleep(), which use the same hardware timer.
+ *
+ * This file should not be modified by users, since it gets replaced whenever
+ * a kernel upgrade occurs.
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _PROS_HRTIMER_H_
+#define _PROS_HRTIMER_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+namespace pros {
+#endif
+
+typedef void (*hrtimer_fn_t)(void*);
+
+/**
+ * A high-resolution timer. Timers are usually global or static variables, and
+ * must stay valid while they are started.
+ *
+ * The fields are private. They are only visible so that timers can be declared
+ * without allocating them, and may change between kernel versions.
+ */
+typedef struct hrtimer_s {
+	struct hrtimer_s* _next;  // next timer in the list the timer is in
+	uint64_t _deadline;       // micros() time of the next expiry
+	uint32_t _period;
+	hrtimer_fn_t _callback;
+	void* _arg;
+	uint8_t _state;
+} hrtimer_s_t;
+
+#ifdef __cplusplus
+namespace c {
+#endif
+
+/**
+ * Starts a timer that calls callback at the given time, and then every period
+ * microseconds if period is not 0. Starting a timer that is already started
+ * restarts it.
+ *
+ * Periodic timers are scheduled from their previous deadline, so they do not
+ * drift. If a callback runs late enough that deadlines were missed, the missed
+ * calls are skipped.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - timer or callback is NULL.
+ * ENXIO - The hardware timer is not available.
+ *
+ * \param timer
+ *        The timer to start
+ * \param deadline
+ *        The micros() time of the first call. A time in the past calls
+ *        callback as soon as possible.
+ * \param period
+ *        The number of microseconds between calls, or 0 for a single call
+ * \param callback
+ *        The function to call
+ * \param arg
+ *        The argument to pass to callback
+ *
+ * \return 1 if the timer was started, PROS_ERR otherwise.
+ */
+int32_t hrtimer_start(hrtimer_s_t* timer, uint64_t deadline, uint32_t period, hrtimer_fn_t callback, void* arg);
+
+/**
+ * Stops a timer. A callback that has already started running is not
+ * interrupted.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - timer is NULL.
+ *
+ * \param timer
+ *        The timer to stop
+ *
+ * \return 1 if the timer was stopped or was not started, PROS_ERR otherwise.
+ */
+int32_t hrtimer_stop(hrtimer_s_t* timer);
+
+#ifdef __cplusplus
+}
+}
+}
+#endif
+
+#endif  // _PROS_HRTIMER_H_
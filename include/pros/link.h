@@ -50,6 +50,73 @@ typedef enum link_type_e {
 
 #define LINK_BUFFER_SIZE 512
 
+// Version of the packeted message protocol used by link_transmit and
+// link_receive, sent in the header of every message
+#define LINK_PROTOCOL_VERSION 1
+
+/**
+ * Counters of a link's streaming receiver, see link_get_stats()
+ */
+typedef struct link_stats_s {
+    uint32_t messages;    // Messages received intact and queued
+    uint32_t crc_errors;  // Frames discarded because their checksum did not match
+    uint32_t resyncs;     // Times the receiver skipped bytes to find a start byte
+    uint32_t dropped;     // Intact messages discarded because the queue was full
+} link_stats_s_t;
+
+// number of channels that can share a link, see link_channel_open()
+#define LINK_MAX_CHANNELS 8
+// largest number of unacknowledged messages on a reliable channel
+#define LINK_MAX_WINDOW 16
+// largest message that can be sent on a channel
+#define LINK_MAX_CHANNEL_MESSAGE_SIZE (LINK_BUFFER_SIZE - 12)
+
+typedef enum link_channel_mode_e {
+    E_LINK_CHANNEL_RELIABLE = 0,  // Every message is delivered once, in order
+    E_LINK_CHANNEL_LATEST         // Only the newest message is kept, losses are not repaired
+} link_channel_mode_e_t;
+
+/**
+ * Configuration of a channel, see link_channel_open()
+ */
+typedef struct link_channel_config_s {
+    link_channel_mode_e_t mode;
+    uint16_t max_size;  // Largest message, at most LINK_MAX_CHANNEL_MESSAGE_SIZE
+    uint8_t window;     // Reliable only: unacknowledged messages in flight, 1 to LINK_MAX_WINDOW
+    uint8_t queue_len;  // Reliable only: received messages that can be waiting to be read
+} link_channel_config_s_t;
+
+/**
+ * Counters of a channel, see link_channel_get_stats()
+ */
+typedef struct link_channel_stats_s {
+    uint32_t sent;         // Messages sent, not counting retransmissions
+    uint32_t retransmits;  // Messages sent again because they were not acknowledged in time
+    uint32_t acked;        // Messages acknowledged by the other robot
+    uint32_t received;     // Messages received and queued
+    uint32_t duplicates;   // Duplicate, stale, or out of order messages discarded
+    uint32_t dropped;      // Messages discarded because the queue was full or they were too long
+    uint32_t resyncs;      // Times the other robot restarted or reopened the channel
+    uint32_t rtt;          // Smoothed round trip time in milliseconds
+    uint32_t rtt_var;      // Round trip time variation in milliseconds
+    uint32_t rto;          // Current retransmit timeout in milliseconds
+    uint32_t goodput;      // Acknowledged message bytes per second, over the last second
+} link_channel_stats_s_t;
+
+// number of topics that can be registered, see link_topic_register()
+#define LINK_MAX_TOPICS 32
+
+/**
+ * Counters of a topic, see link_topic_get_stats()
+ */
+typedef struct link_topic_stats_s {
+    uint32_t published;   // Values published by this robot
+    uint32_t coalesced;   // Published values replaced by a newer one before they were sent
+    uint32_t sent;        // Values sent over the radio
+    uint32_t received;    // Values received from the other robot
+    uint32_t mismatched;  // Received values discarded because their size differs from the registered size
+} link_topic_stats_s_t;
+
 #ifdef __cplusplus
 namespace c {
 #endif
@@ -202,7 +269,9 @@ uint32_t link_transmit_raw(uint8_t port, void* data, uint16_t data_size);
 uint32_t link_receive_raw(uint8_t port, void* dest, uint16_t data_size);
 
 /**
- * Send packeted message through vexlink, with a checksum and start byte.
+ * Send packeted message through vexlink, with a start byte, protocol version,
+ * and CRC-16. The message is sent with a single transmit, so it is never
+ * interleaved with other data.
  * 
  * This function uses the following values of errno when an error state is
  * reached:
@@ -211,7 +280,8 @@ uint32_t link_receive_raw(uint8_t port, void* dest, uint16_t data_size);
  * ENXIO - The sensor is still calibrating, or no link is connected via the radio.
  * EBUSY - The transmitter buffer is still busy with a previous transmission, and there is no 
  * room in the FIFO buffer (queue) to transmit the data.
- * EINVAL - The data given is NULL
+ * EINVAL - The data given is NULL, or data_size is larger than
+ * LINK_BUFFER_SIZE - 6 bytes of protocol overhead
  * 
  * \param port 
  *      The port of the radio for the intended link.
@@ -226,7 +296,8 @@ uint32_t link_receive_raw(uint8_t port, void* dest, uint16_t data_size);
 uint32_t link_transmit(uint8_t port, void* data, uint16_t data_size);
 
 /**
- * Receive packeted message through vexlink, with a checksum and start byte.
+ * Receive packeted message through vexlink, with a start byte, protocol
+ * version, and CRC-16.
  * 
  * This function uses the following values of errno when an error state is
  * reached:
@@ -236,6 +307,8 @@ uint32_t link_transmit(uint8_t port, void* data, uint16_t data_size);
  * EINVAL - The destination given is NULL, or the size given is larger than the FIFO buffer 
  * or destination buffer. 
  * EBADMSG - Protocol error related to start byte, data size, or checksum.
+ * EPROTONOSUPPORT - The message was sent with a newer protocol version than
+ * LINK_PROTOCOL_VERSION.
  * 
  * \param port 
  *      The port of the radio for the intended link.
@@ -266,6 +339,382 @@ uint32_t link_receive(uint8_t port, void* dest, uint16_t data_size);
  */
 uint32_t link_clear_receive_buf(uint8_t port);
 
+/**
+ * Starts receiving packeted messages on a link in the background.
+ *
+ * Frames are reassembled as their bytes arrive, so messages of any size up to
+ * max_size can be received without knowing their size in advance. Damaged
+ * frames only cost the receiver their start byte, so good messages that follow
+ * them are not lost. Completed messages are queued for link_receive_message().
+ *
+ * \note link_receive and link_receive_raw must not be used on a link while its
+ * streaming receiver is running, since they would steal bytes from it.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * ENXIO - The given value is not within the range of V5 ports (1-21).
+ * ENODEV - The port cannot be configured as a radio.
+ * EINVAL - max_size or queue_len is 0, or max_size is larger than
+ * LINK_BUFFER_SIZE - 6 bytes of protocol overhead.
+ * EEXIST - The streaming receiver is already running.
+ * ENOMEM - The message queue could not be allocated.
+ *
+ * \param port
+ *      The port of the radio for the intended link.
+ * \param max_size
+ *      The size of the largest message to accept
+ * \param queue_len
+ *      The number of received messages that can be waiting to be read
+ *
+ * \return PROS_ERR if the receiver could not be started, 1 otherwise.
+ */
+uint32_t link_stream_enable(uint8_t port, uint16_t max_size, uint32_t queue_len);
+
+/**
+ * Stops the streaming receiver of a link, discarding any unread messages.
+ *
+ * Tasks waiting in link_receive_message() on the link return PROS_ERR with
+ * errno set to EINVAL.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * ENXIO - The given value is not within the range of V5 ports (1-21).
+ * ENODEV - The port cannot be configured as a radio.
+ * EINVAL - The streaming receiver is not running.
+ *
+ * \param port
+ *      The port of the radio for the intended link.
+ *
+ * \return PROS_ERR if the receiver could not be stopped, 1 otherwise.
+ */
+uint32_t link_stream_disable(uint8_t port);
+
+/**
+ * Waits for the next message from a link's streaming receiver.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - The port is invalid, the destination is NULL, or the streaming
+ * receiver is not running or was stopped while waiting.
+ * EACCES - Another resource is currently trying to access the port.
+ * EAGAIN - No message arrived before the timeout.
+ *
+ * \param port
+ *      The port of the radio for the intended link.
+ * \param dest
+ *      Destination buffer to read the message to
+ * \param dest_size
+ *      Size of the destination buffer. Longer messages are truncated
+ * \param timeout
+ *      How long to wait for a message in milliseconds, TIMEOUT_MAX to wait
+ *      forever
+ *
+ * \return PROS_ERR if no message was received, and the size of the message
+ * (which may exceed dest_size if it was truncated) otherwise.
+ */
+uint32_t link_receive_message(uint8_t port, void* dest, uint16_t dest_size, uint32_t timeout);
+
+/**
+ * Gets the counters of a link's streaming receiver.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * ENXIO - The given value is not within the range of V5 ports (1-21).
+ * ENODEV - The port cannot be configured as a radio.
+ * EINVAL - The streaming receiver is not running.
+ *
+ * \param port
+ *      The port of the radio for the intended link.
+ * \param stats
+ *      The location to write the counters to
+ *
+ * \return PROS_ERR if the counters could not be read, 1 otherwise.
+ */
+uint32_t link_get_stats(uint8_t port, link_stats_s_t* stats);
+
+/**
+ * Opens a channel on a link. Channels share the radio with each other and with
+ * plain packeted messages, and require the streaming receiver to be running
+ * (see link_stream_enable) since acknowledgements are processed in the
+ * background.
+ *
+ * On a reliable channel, messages carry sequence numbers and are acknowledged
+ * by the other robot. Unacknowledged messages are retransmitted by the kernel
+ * with a timeout that adapts to the measured round trip time, and duplicates
+ * are discarded, so every message is received exactly once and in order. Up to
+ * config->window messages can be in flight at once.
+ *
+ * On a latest value channel, messages are sent once and only the newest
+ * received message is kept, which suits values like positions that are
+ * replaced faster than lost ones could be repaired.
+ *
+ * \note Both robots must open a channel with the same number and mode. If
+ * either robot restarts or reopens the channel, the other one picks up its new
+ * sequence numbers by itself, though messages that were in flight at the time
+ * may be lost.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * ENXIO - The given value is not within the range of V5 ports (1-21).
+ * ENODEV - The port cannot be configured as a radio.
+ * EINVAL - The channel or configuration (such as its mode) is invalid, or the
+ * streaming receiver is not running.
+ * EEXIST - The channel is already open.
+ * ENOMEM - The channel's buffers could not be allocated.
+ *
+ * \param port
+ *      The port of the radio for the intended link.
+ * \param channel
+ *      The channel number, from 0 to LINK_MAX_CHANNELS - 1
+ * \param config
+ *      The configuration of the channel
+ *
+ * \return PROS_ERR if the channel could not be opened, 1 otherwise.
+ */
+uint32_t link_channel_open(uint8_t port, uint8_t channel, const link_channel_config_s_t* config);
+
+/**
+ * Closes a channel, discarding any unread or unacknowledged messages.
+ *
+ * Tasks waiting in link_channel_send() or link_channel_receive() on the
+ * channel return PROS_ERR with errno set to EINVAL. Stopping the streaming
+ * receiver with link_stream_disable() closes all of its channels.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * ENXIO - The given value is not within the range of V5 ports (1-21).
+ * ENODEV - The port cannot be configured as a radio.
+ * EINVAL - The channel is not open.
+ *
+ * \param port
+ *      The port of the radio for the intended link.
+ * \param channel
+ *      The channel number
+ *
+ * \return PROS_ERR if the channel could not be closed, 1 otherwise.
+ */
+uint32_t link_channel_close(uint8_t port, uint8_t channel);
+
+/**
+ * Sends a message on a channel.
+ *
+ * On a reliable channel, this waits up to timeout milliseconds for room in the
+ * window, and returns once the message is queued for delivery. On a latest
+ * value channel, the message is sent immediately or not at all.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * ENXIO - The given value is not within the range of V5 ports (1-21).
+ * ENODEV - The port cannot be configured as a radio.
+ * EINVAL - The channel is not open or was closed while waiting, the data is
+ * NULL, or data_size is larger than the channel's max_size.
+ * EACCES - Another resource is currently trying to access the port.
+ * EBUSY - The window stayed full for the whole timeout, or there is no room in
+ * the radio's buffer for a latest value message.
+ *
+ * \param port
+ *      The port of the radio for the intended link.
+ * \param channel
+ *      The channel number
+ * \param data
+ *      The message to send
+ * \param data_size
+ *      The size of the message
+ * \param timeout
+ *      How long to wait for room in the window in milliseconds
+ *
+ * \return PROS_ERR if the message was not sent, and data_size otherwise.
+ */
+uint32_t link_channel_send(uint8_t port, uint8_t channel, const void* data, uint16_t data_size, uint32_t timeout);
+
+/**
+ * Waits for the next message on a channel.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - The port is invalid, the channel is not open or was closed while
+ * waiting, or the destination is NULL.
+ * EACCES - Another resource is currently trying to access the port.
+ * EAGAIN - No message arrived before the timeout.
+ *
+ * \param port
+ *      The port of the radio for the intended link.
+ * \param channel
+ *      The channel number
+ * \param dest
+ *      Destination buffer to read the message to
+ * \param dest_size
+ *      Size of the destination buffer. Longer messages are truncated
+ * \param timeout
+ *      How long to wait for a message in milliseconds
+ *
+ * \return PROS_ERR if no message was received, and the size of the message
+ * (which may exceed dest_size if it was truncated) otherwise.
+ */
+uint32_t link_channel_receive(uint8_t port, uint8_t channel, void* dest, uint16_t dest_size, uint32_t timeout);
+
+/**
+ * Gets the counters and round trip time measurements of a channel.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * ENXIO - The given value is not within the range of V5 ports (1-21).
+ * ENODEV - The port cannot be configured as a radio.
+ * EINVAL - The channel is not open, or stats is NULL.
+ *
+ * \param port
+ *      The port of the radio for the intended link.
+ * \param channel
+ *      The channel number
+ * \param stats
+ *      The location to write the counters to
+ *
+ * \return PROS_ERR if the counters could not be read, 1 otherwise.
+ */
+uint32_t link_channel_get_stats(uint8_t port, uint8_t channel, link_channel_stats_s_t* stats);
+
+/**
+ * Starts publish/subscribe topics on a link.
+ *
+ * Every period milliseconds, the topics whose value changed since they were
+ * last sent are packed into a single message on the given channel, which is
+ * opened as a latest value channel. Higher priority topics are sent first, and
+ * at most budget bytes per second (including protocol overhead) are used.
+ * Topics that don't fit wait for the next period, during which newer values
+ * replace theirs. Only one link can run topics.
+ *
+ * The streaming receiver must be running (see link_stream_enable) so that the
+ * other robot's topics are received.
+ *
+ * \note Topics can't be stopped once started. They run until the program
+ * ends, so neither the channel nor the streaming receiver may be closed.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * ENXIO - The given value is not within the range of V5 ports (1-21).
+ * ENODEV - The port cannot be configured as a radio.
+ * EINVAL - period or budget is 0, or the channel could not be opened.
+ * EEXIST - Topics are already running.
+ * ENOMEM - There wasn't enough memory to start topics.
+ *
+ * \param port
+ *      The port of the radio for the intended link.
+ * \param channel
+ *      The channel to send and receive topics on, see link_channel_open()
+ * \param period
+ *      How often changed topics are sent, in milliseconds
+ * \param budget
+ *      The radio bandwidth that topics may use, in bytes per second
+ *
+ * \return PROS_ERR if topics could not be started, 1 otherwise.
+ */
+uint32_t link_topics_start(uint8_t port, uint8_t channel, uint32_t period, uint32_t budget);
+
+/**
+ * Registers a topic. Both robots must register a topic with the same number
+ * and size to exchange its values.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - Topics are not running on the port, or the topic or size is invalid.
+ * EEXIST - The topic is already registered.
+ * ENOMEM - The topic's buffers could not be allocated.
+ *
+ * \param port
+ *      The port of the radio for the intended link.
+ * \param topic
+ *      The topic number, from 0 to LINK_MAX_TOPICS - 1
+ * \param size
+ *      The size of the topic's value in bytes
+ * \param priority
+ *      The priority of the topic. Changed topics with higher priorities are sent
+ *      first when the budget runs short
+ * \param refresh
+ *      If not 0, the topic is resent after this many milliseconds even if it
+ *      did not change, so that the other robot recovers from lost messages
+ *
+ * \return PROS_ERR if the topic could not be registered, 1 otherwise.
+ */
+uint32_t link_topic_register(uint8_t port, uint8_t topic, uint8_t size, uint8_t priority, uint16_t refresh);
+
+/**
+ * Publishes a new value of a topic. The value is copied, and is only sent if it
+ * differs from the previous one.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - Topics are not running on the port, the topic is not registered, or
+ * the value is NULL.
+ *
+ * \param port
+ *      The port of the radio for the intended link.
+ * \param topic
+ *      The topic number
+ * \param value
+ *      The new value, of the topic's registered size
+ *
+ * \return PROS_ERR if the value could not be published, 1 otherwise.
+ */
+uint32_t link_topic_publish(uint8_t port, uint8_t topic, const void* value);
+
+/**
+ * Reads the newest value of a topic received from the other robot.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - Topics are not running on the port, the topic is not registered, or
+ * the destination is NULL.
+ * EAGAIN - No value has been received yet.
+ *
+ * \param port
+ *      The port of the radio for the intended link.
+ * \param topic
+ *      The topic number
+ * \param dest
+ *      Destination buffer of at least the topic's registered size
+ * \param age
+ *      If not NULL, receives how many milliseconds ago the value arrived
+ *
+ * \return PROS_ERR if no value could be read, and the topic's size otherwise.
+ */
+uint32_t link_topic_read(uint8_t port, uint8_t topic, void* dest, uint32_t* age);
+
+/**
+ * Gets the counters of a topic.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - Topics are not running on the port, the topic is not registered, or
+ * stats is NULL.
+ *
+ * \param port
+ *      The port of the radio for the intended link.
+ * \param topic
+ *      The topic number
+ * \param stats
+ *      The location to write the counters to
+ *
+ * \return PROS_ERR if the counters could not be read, 1 otherwise.
+ */
+uint32_t link_topic_get_stats(uint8_t port, uint8_t topic, link_topic_stats_s_t* stats);
+
+/**
+ * Gets the protocol version of the last packeted message received through
+ * vexlink, so that programs can adapt to a peer running an older or newer
+ * kernel.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * ENXIO - The given value is not within the range of V5 ports (1-21).
+ *
+ * \param port
+ *      The port of the radio for the intended link.
+ *
+ * \return PROS_ERR if the port is invalid, 0 if no message has been received
+ * yet, and the peer's LINK_PROTOCOL_VERSION otherwise.
+ */
+uint32_t link_get_peer_version(uint8_t port);
+
 #ifdef __cplusplus
 }
 }
@@ -22,6 +22,7 @@
 #include <string>
 
 #include "pros/link.h"
+#include "pros/rtos.h"
 
 namespace pros {
 class Link {
@@ -139,7 +140,8 @@ class Link {
 	std::uint32_t receive_raw(void* dest, std::uint16_t data_size);
 
 	/**
-	 * Send packeted message through vexlink, with a checksum and start byte.
+	 * Send packeted message through vexlink, with a start byte, protocol version,
+	 * and CRC-16. The message is sent with a single transmit.
 	 *
 	 * This function uses the following values of errno when an error state is
 	 * reached:
@@ -148,7 +150,8 @@ class Link {
 	 * ENXIO - The sensor is still calibrating, or no link is connected via the radio.
 	 * EBUSY - The transmitter buffer is still busy with a previous transmission, and there is no
 	 * room in the FIFO buffer (queue) to transmit the data.
-	 * EINVAL - The data given is NULL
+	 * EINVAL - The data given is NULL, or data_size is larger than
+	 * LINK_BUFFER_SIZE - 6 bytes of protocol overhead
 	 *
 	 * \param data
 	 *      Buffer with data to send
@@ -161,7 +164,8 @@ class Link {
 	std::uint32_t transmit(void* data, std::uint16_t data_size);
 
 	/**
-	 * Receive packeted message through vexlink, with a checksum and start byte.
+	 * Receive packeted message through vexlink, with a start byte, protocol
+	 * version, and CRC-16.
 	 *
 	 * This function uses the following values of errno when an error state is
 	 * reached:
@@ -171,6 +175,8 @@ class Link {
 	 * EINVAL - The destination given is NULL, or the size given is larger than the FIFO buffer
 	 * or destination buffer.
 	 * EBADMSG - Protocol error related to start byte, data size, or checksum.
+	 * EPROTONOSUPPORT - The message was sent with a newer protocol version than
+	 * LINK_PROTOCOL_VERSION.
 
 	 * \param dest
 	 *      Destination buffer to read data to
@@ -194,6 +200,307 @@ class Link {
 	 * \return PROS_ERR if port is not a link, 1 if the operation succeeded.
 	 */
 	std::uint32_t clear_receive_buf();
+
+	/**
+	 * Gets the protocol version of the last packeted message received through
+	 * vexlink.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * ENXIO - The given value is not within the range of V5 ports (1-21).
+	 *
+	 * \return PROS_ERR if the port is invalid, 0 if no message has been received
+	 * yet, and the peer's LINK_PROTOCOL_VERSION otherwise.
+	 */
+	std::uint32_t get_peer_version();
+
+	/**
+	 * Starts receiving packeted messages in the background. Frames are
+	 * reassembled as their bytes arrive and completed messages are queued for
+	 * receive_message(). receive() and receive_raw() must not be used while the
+	 * streaming receiver is running.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * ENXIO - The given value is not within the range of V5 ports (1-21).
+	 * ENODEV - The port cannot be configured as a radio.
+	 * EINVAL - max_size or queue_len is 0, or max_size is larger than
+	 * LINK_BUFFER_SIZE - 6 bytes of protocol overhead.
+	 * EEXIST - The streaming receiver is already running.
+	 * ENOMEM - The message queue could not be allocated.
+	 *
+	 * \param max_size
+	 *      The size of the largest message to accept
+	 * \param queue_len
+	 *      The number of received messages that can be waiting to be read
+	 *
+	 * \return PROS_ERR if the receiver could not be started, 1 otherwise.
+	 */
+	std::uint32_t stream_enable(std::uint16_t max_size, std::uint32_t queue_len);
+
+	/**
+	 * Stops the streaming receiver, discarding any unread messages.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * ENXIO - The given value is not within the range of V5 ports (1-21).
+	 * ENODEV - The port cannot be configured as a radio.
+	 * EINVAL - The streaming receiver is not running.
+	 *
+	 * \return PROS_ERR if the receiver could not be stopped, 1 otherwise.
+	 */
+	std::uint32_t stream_disable();
+
+	/**
+	 * Waits for the next message from the streaming receiver.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * EINVAL - The port is invalid, the destination is NULL, or the streaming
+	 * receiver is not running or was stopped while waiting.
+	 * EACCES - Another resource is currently trying to access the port.
+	 * EAGAIN - No message arrived before the timeout.
+	 *
+	 * \param dest
+	 *      Destination buffer to read the message to
+	 * \param dest_size
+	 *      Size of the destination buffer. Longer messages are truncated
+	 * \param timeout
+	 *      How long to wait for a message in milliseconds
+	 *
+	 * \return PROS_ERR if no message was received, and the size of the message
+	 * otherwise.
+	 */
+	std::uint32_t receive_message(void* dest, std::uint16_t dest_size, std::uint32_t timeout = TIMEOUT_MAX);
+
+	/**
+	 * Gets the counters of the streaming receiver.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * ENXIO - The given value is not within the range of V5 ports (1-21).
+	 * ENODEV - The port cannot be configured as a radio.
+	 * EINVAL - The streaming receiver is not running.
+	 *
+	 * \return The counters. If the operation failed, all counters are 0 and
+	 * errno is set.
+	 */
+	link_stats_s_t get_stats();
+
+	/**
+	 * Opens a channel on the link. The streaming receiver must be running (see
+	 * stream_enable()). See link_channel_open() for the delivery guarantees of
+	 * each channel mode.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * ENXIO - The given value is not within the range of V5 ports (1-21).
+	 * ENODEV - The port cannot be configured as a radio.
+	 * EINVAL - The channel or configuration is invalid, or the streaming
+	 * receiver is not running.
+	 * EEXIST - The channel is already open.
+	 * ENOMEM - The channel's buffers could not be allocated.
+	 *
+	 * \param channel
+	 *      The channel number, from 0 to LINK_MAX_CHANNELS - 1
+	 * \param config
+	 *      The configuration of the channel
+	 *
+	 * \return PROS_ERR if the channel could not be opened, 1 otherwise.
+	 */
+	std::uint32_t channel_open(std::uint8_t channel, const link_channel_config_s_t& config);
+
+	/**
+	 * Closes a channel, discarding any unread or unacknowledged messages. Tasks
+	 * waiting to send or receive on it return PROS_ERR with errno set to EINVAL.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * ENXIO - The given value is not within the range of V5 ports (1-21).
+	 * ENODEV - The port cannot be configured as a radio.
+	 * EINVAL - The channel is not open.
+	 *
+	 * \param channel
+	 *      The channel number
+	 *
+	 * \return PROS_ERR if the channel could not be closed, 1 otherwise.
+	 */
+	std::uint32_t channel_close(std::uint8_t channel);
+
+	/**
+	 * Sends a message on a channel, waiting up to timeout milliseconds for room
+	 * in a reliable channel's window.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * ENXIO - The given value is not within the range of V5 ports (1-21).
+	 * ENODEV - The port cannot be configured as a radio.
+	 * EINVAL - The channel is not open or was closed while waiting, the data
+	 * is NULL, or data_size is larger than the channel's max_size.
+	 * EACCES - Another resource is currently trying to access the port.
+	 * EBUSY - The window stayed full for the whole timeout, or there is no room
+	 * in the radio's buffer for a latest value message.
+	 *
+	 * \param channel
+	 *      The channel number
+	 * \param data
+	 *      The message to send
+	 * \param data_size
+	 *      The size of the message
+	 * \param timeout
+	 *      How long to wait for room in the window in milliseconds
+	 *
+	 * \return PROS_ERR if the message was not sent, and data_size otherwise.
+	 */
+	std::uint32_t channel_send(std::uint8_t channel, const void* data, std::uint16_t data_size,
+	                           std::uint32_t timeout = TIMEOUT_MAX);
+
+	/**
+	 * Waits for the next message on a channel.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * EINVAL - The port is invalid, the channel is not open or was closed while
+	 * waiting, or the destination is NULL.
+	 * EACCES - Another resource is currently trying to access the port.
+	 * EAGAIN - No message arrived before the timeout.
+	 *
+	 * \param channel
+	 *      The channel number
+	 * \param dest
+	 *      Destination buffer to read the message to
+	 * \param dest_size
+	 *      Size of the destination buffer. Longer messages are truncated
+	 * \param timeout
+	 *      How long to wait for a message in milliseconds
+	 *
+	 * \return PROS_ERR if no message was received, and the size of the message
+	 * otherwise.
+	 */
+	std::uint32_t channel_receive(std::uint8_t channel, void* dest, std::uint16_t dest_size,
+	                              std::uint32_t timeout = TIMEOUT_MAX);
+
+	/**
+	 * Gets the counters and round trip time measurements of a channel.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * ENXIO - The given value is not within the range of V5 ports (1-21).
+	 * ENODEV - The port cannot be configured as a radio.
+	 * EINVAL - The channel is not open.
+	 *
+	 * \param channel
+	 *      The channel number
+	 *
+	 * \return The counters. If the operation failed, all counters are 0 and
+	 * errno is set.
+	 */
+	link_channel_stats_s_t channel_get_stats(std::uint8_t channel);
+
+	/**
+	 * Starts publish/subscribe topics on the link. See link_topics_start() for
+	 * how changed topics are scheduled onto the radio. Topics can't be stopped
+	 * once started.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * ENXIO - The given value is not within the range of V5 ports (1-21).
+	 * ENODEV - The port cannot be configured as a radio.
+	 * EINVAL - period or budget is 0, or the channel could not be opened.
+	 * EEXIST - Topics are already running.
+	 * ENOMEM - There wasn't enough memory to start topics.
+	 *
+	 * \param channel
+	 *      The channel to send and receive topics on
+	 * \param period
+	 *      How often changed topics are sent, in milliseconds
+	 * \param budget
+	 *      The radio bandwidth that topics may use, in bytes per second
+	 *
+	 * \return PROS_ERR if topics could not be started, 1 otherwise.
+	 */
+	std::uint32_t topics_start(std::uint8_t channel, std::uint32_t period, std::uint32_t budget);
+
+	/**
+	 * Registers a topic. Both robots must register a topic with the same number
+	 * and size to exchange its values.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * EINVAL - Topics are not running on the port, or the topic or size is
+	 * invalid.
+	 * EEXIST - The topic is already registered.
+	 * ENOMEM - The topic's buffers could not be allocated.
+	 *
+	 * \param topic
+	 *      The topic number, from 0 to LINK_MAX_TOPICS - 1
+	 * \param size
+	 *      The size of the topic's value in bytes
+	 * \param priority
+	 *      Changed topics with higher priorities are sent first
+	 * \param refresh
+	 *      If not 0, the topic is resent after this many milliseconds even if
+	 *      it did not change
+	 *
+	 * \return PROS_ERR if the topic could not be registered, 1 otherwise.
+	 */
+	std::uint32_t topic_register(std::uint8_t topic, std::uint8_t size, std::uint8_t priority,
+	                             std::uint16_t refresh = 0);
+
+	/**
+	 * Publishes a new value of a topic. The value is only sent if it differs from
+	 * the previous one.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * EINVAL - Topics are not running on the port, the topic is not registered,
+	 * or the value is NULL.
+	 *
+	 * \param topic
+	 *      The topic number
+	 * \param value
+	 *      The new value, of the topic's registered size
+	 *
+	 * \return PROS_ERR if the value could not be published, 1 otherwise.
+	 */
+	std::uint32_t topic_publish(std::uint8_t topic, const void* value);
+
+	/**
+	 * Reads the newest value of a topic received from the other robot.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * EINVAL - Topics are not running on the port, the topic is not registered,
+	 * or the destination is NULL.
+	 * EAGAIN - No value has been received yet.
+	 *
+	 * \param topic
+	 *      The topic number
+	 * \param dest
+	 *      Destination buffer of at least the topic's registered size
+	 * \param age
+	 *      If not nullptr, receives how many milliseconds ago the value arrived
+	 *
+	 * \return PROS_ERR if no value could be read, and the topic's size
+	 * otherwise.
+	 */
+	std::uint32_t topic_read(std::uint8_t topic, void* dest, std::uint32_t* age = nullptr);
+
+	/**
+	 * Gets the counters of a topic.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * EINVAL - Topics are not running on the port, or the topic is not
+	 * registered.
+	 *
+	 * \param topic
+	 *      The topic number
+	 *
+	 * \return The counters. If the operation failed, all counters are 0 and
+	 * errno is set.
+	 */
+	link_topic_stats_s_t topic_get_stats(std::uint8_t topic);
 };
 }  // namespace pros
 
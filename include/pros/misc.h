@@ -21,6 +21,7 @@
 #ifndef _PROS_MISC_H_
 #define _PROS_MISC_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define NUM_V5_PORTS (22)
@@ -474,6 +475,35 @@ double battery_get_capacity(void);
  */
 int32_t usd_is_installed(void);
 
+/**
+ * Loads a whole file from the SD card into memory with as few card accesses as
+ * possible. This is much faster than reading large files (such as paths or
+ * lookup tables) through fread or fgets.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - path or size is NULL.
+ * ENOBUFS - The file is larger than the given buffer. size is set to the
+ * size of the file, so that a big enough buffer can be provided.
+ * ENOMEM - The file's allocation failed.
+ * EIO - The file could not be read completely.
+ * Any errno set by open() if the file cannot be opened (e.g. ENXIO if there is
+ * no SD card).
+ *
+ * \param path
+ *        The file to load, e.g. "/usd/path.bin"
+ * \param buffer
+ *        Where to load the file, or NULL to allocate a buffer with malloc. The
+ *        caller must free() an allocated buffer
+ * \param[in,out] size
+ *        The size of buffer if one is given. Set to the size of the file,
+ *        also when the file doesn't fit in buffer
+ *
+ * \return The buffer holding the file, or NULL if the file could not be
+ * loaded.
+ */
+void* usd_load_file(const char* path, void* buffer, size_t* size);
+
 #ifdef __cplusplus
 }
 }
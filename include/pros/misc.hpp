@@ -23,6 +23,7 @@
 
 #include "pros/misc.h"
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 
@@ -325,6 +326,35 @@ namespace usd {
  * \return 1 if the SD card is installed, 0 otherwise
  */
 std::int32_t is_installed(void);
+
+/**
+ * Loads a whole file from the SD card into memory with as few card accesses as
+ * possible. This is much faster than reading large files (such as paths or
+ * lookup tables) through fread or fgets.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - path or size is NULL.
+ * ENOBUFS - The file is larger than the given buffer. size is set to the
+ * size of the file, so that a big enough buffer can be provided.
+ * ENOMEM - The file's allocation failed.
+ * EIO - The file could not be read completely.
+ * Any errno set by open() if the file cannot be opened (e.g. ENXIO if there is
+ * no SD card).
+ *
+ * \param path
+ *        The file to load, e.g. "/usd/path.bin"
+ * \param buffer
+ *        Where to load the file, or nullptr to allocate a buffer with malloc.
+ *        The caller must free() an allocated buffer
+ * \param[in,out] size
+ *        The size of buffer if one is given. Set to the size of the file,
+ *        also when the file doesn't fit in buffer
+ *
+ * \return The buffer holding the file, or nullptr if the file could not be
+ * loaded.
+ */
+void* load_file(const char* path, void* buffer, std::size_t* size);
 }  // namespace usd
 }  // namespace pros
 
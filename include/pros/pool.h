@@ -0,0 +1,236 @@
+/**
+ * \file pros/pool.h
+ *
+ * Contains prototypes for fixed-size object pools.
+ *
+ * A pool hands out blocks of one size from a fixed array, so allocating and
+ * freeing take the same few instructions every time and never fragment the
+ * heap. They are meant for objects that are created and destroyed while the
+ * robot runs, such as messages passed between tasks every loop. Pools are safe
+ * to use from any task and from interrupt handlers.
+ *
+ * The storage of a pool can be a static array (see POOL_STATIC and pool_init)
+ * or come from the heap once, when the pool is created (see pool_create).
+ *
+ * This file should not be modified by users, since it gets replaced whenever
+ * a kernel upgrade occurs.
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _PROS_POOL_H_
+#define _PROS_POOL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+namespace pros {
+#endif
+
+// alignment of every block, and of the storage given to pool_init
+#define POOL_ALIGN 8
+
+/**
+ * The size of each block of a pool of objects of the given size. Sizes are
+ * rounded up to a multiple of POOL_ALIGN.
+ */
+#define POOL_BLOCK_SIZE(size) (((size) + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1))
+
+/**
+ * The number of bytes of storage needed by a pool of count objects of the
+ * given size.
+ */
+#define POOL_STORAGE_SIZE(size, count) (POOL_BLOCK_SIZE(size) * (count))
+
+/**
+ * A pool of fixed-size blocks.
+ *
+ * The fields are private. They are only visible so that pools can be declared
+ * statically, and may change between kernel versions.
+ */
+typedef struct pool_s {
+	void* _free;         // most recently freed block, which links to the next
+	uint8_t* _storage;   // first block
+	uint8_t* _unused;    // first block that has never been handed out
+	uint32_t _block_size;
+	uint32_t _capacity;
+	uint32_t _used;
+	uint32_t _peak;
+	uint32_t _failures;
+	bool _heap;  // created by pool_create
+} pool_s_t;
+
+typedef pool_s_t* pool_t;
+
+/**
+ * Usage counters of a pool, see pool_get_stats()
+ */
+typedef struct pool_stats_s {
+	uint32_t block_size;  // Bytes per block, after rounding
+	uint32_t capacity;    // Number of blocks
+	uint32_t used;        // Blocks currently allocated
+	uint32_t peak;        // Most blocks ever allocated at once
+	uint32_t failures;    // Allocations that failed because every block was in use
+} pool_stats_s_t;
+
+/**
+ * Initializer of a pool of count objects of the given size that uses storage,
+ * which must be an array of at least POOL_STORAGE_SIZE(size, count) bytes
+ * aligned to POOL_ALIGN. Equivalent to calling pool_init, for C code.
+ */
+#define POOL_INITIALIZER(storage, size, count)                                                   \
+	{                                                                                            \
+		._free = NULL, ._storage = (uint8_t*)(storage), ._unused = (uint8_t*)(storage),          \
+		._block_size = POOL_BLOCK_SIZE(size), ._capacity = (count), ._used = 0, ._peak = 0,      \
+		._failures = 0, ._heap = false                                                           \
+	}
+
+/**
+ * Defines a static pool called name of count objects of the given size,
+ * together with its storage. Pass &name to the pool functions. C++ code should
+ * use pros::Pool (see pros/pool.hpp) instead.
+ *
+ * Example:
+ *   POOL_STATIC(message_pool, sizeof(message_s_t), 16);
+ *   message_s_t* message = pool_alloc(&message_pool);
+ */
+#define POOL_STATIC(name, size, count)                                                           \
+	static uint64_t name##_storage[POOL_STORAGE_SIZE(size, count) / sizeof(uint64_t)];          \
+	static pool_s_t name = POOL_INITIALIZER(name##_storage, size, count)
+
+#ifdef __cplusplus
+namespace c {
+#endif
+
+/**
+ * Initializes a pool of count blocks of block_size bytes in the given storage.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - pool or storage is NULL, storage is not aligned to POOL_ALIGN, or
+ *          block_size or count is 0.
+ *
+ * \param pool
+ *        The pool to initialize
+ * \param storage
+ *        At least POOL_STORAGE_SIZE(block_size, count) bytes, which must stay
+ *        valid as long as the pool is used
+ * \param block_size
+ *        The size of the objects that will be allocated from the pool
+ * \param count
+ *        The number of blocks
+ *
+ * \return 1 if the pool was initialized, PROS_ERR otherwise.
+ */
+int32_t pool_init(pool_s_t* pool, void* storage, size_t block_size, size_t count);
+
+/**
+ * Creates a pool of count blocks of block_size bytes, with storage allocated
+ * from the heap. The heap is used once here, never by pool_alloc or pool_free.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - block_size or count is 0, or the pool would be too large.
+ * ENOMEM - The heap does not have room for the pool.
+ *
+ * \param block_size
+ *        The size of the objects that will be allocated from the pool
+ * \param count
+ *        The number of blocks
+ *
+ * \return The new pool, or NULL if it could not be created.
+ */
+pool_t pool_create(size_t block_size, size_t count);
+
+/**
+ * Deletes a pool created by pool_create, returning its storage to the heap.
+ * Every block of the pool becomes invalid. Does nothing for pools initialized
+ * with pool_init.
+ *
+ * \param pool
+ *        The pool to delete
+ */
+void pool_delete(pool_t pool);
+
+/**
+ * Takes a block from a pool. The block is aligned to POOL_ALIGN and its
+ * contents are undefined.
+ *
+ * This function takes constant time and may be called from an interrupt.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - pool is NULL.
+ * ENOMEM - Every block of the pool is in use.
+ *
+ * \param pool
+ *        The pool to allocate from
+ *
+ * \return The block, or NULL if none is free.
+ */
+void* pool_alloc(pool_t pool);
+
+/**
+ * Returns a block to the pool it was allocated from. Freeing NULL does
+ * nothing.
+ *
+ * This function takes constant time and may be called from an interrupt.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - pool is NULL, or block was not allocated from pool.
+ *
+ * \param pool
+ *        The pool that block was allocated from
+ * \param block
+ *        The block to free
+ *
+ * \return 1 if the block was freed, PROS_ERR otherwise.
+ */
+int32_t pool_free(pool_t pool, void* block);
+
+/**
+ * Checks whether a pointer is one of the blocks of a pool, which lets code
+ * that falls back to another allocator when a pool is full tell where a block
+ * came from.
+ *
+ * \param pool
+ *        The pool to check
+ * \param block
+ *        The pointer to check
+ *
+ * \return True if block is a block of the pool, false otherwise.
+ */
+bool pool_contains(pool_t pool, const void* block);
+
+/**
+ * Gets the usage counters of a pool.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - pool or stats is NULL.
+ *
+ * \param pool
+ *        The pool to read
+ * \param stats
+ *        The location to write the counters to
+ *
+ * \return 1 if the counters were read, PROS_ERR otherwise.
+ */
+int32_t pool_get_stats(pool_t pool, pool_stats_s_t* stats);
+
+#ifdef __cplusplus
+}
+}
+}
+#endif
+
+#endif  // _PROS_POOL_H_
@@ -0,0 +1,159 @@
+/**
+ * \file pros/pool.hpp
+ *
+ * Contains the C++ interface to fixed-size object pools.
+ *
+ * This file should not be modified by users, since it gets replaced whenever
+ * a kernel upgrade occurs.
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _PROS_POOL_HPP_
+#define _PROS_POOL_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "pros/pool.h"
+
+namespace pros {
+/**
+ * A pool of N objects of type T, stored inside the Pool object itself.
+ *
+ * Objects are created and destroyed in constant time without touching the
+ * heap, from any task or interrupt. Declare the pool as a global or static
+ * variable to give it static storage, or create it with new to allocate all of
+ * its storage from the heap at once.
+ *
+ * Example:
+ *   pros::Pool<Message, 16> messages;
+ *   Message* message = messages.create(...);
+ *   messages.destroy(message);
+ */
+template <typename T, std::size_t N>
+class Pool {
+	static_assert(N > 0, "a pool must have at least one object");
+	static_assert(alignof(T) <= POOL_ALIGN, "pool blocks are only aligned to POOL_ALIGN");
+
+	public:
+	/**
+	 * Destroys objects that came from a Pool when a std::unique_ptr releases
+	 * them
+	 */
+	struct Deleter {
+		Pool* pool;
+		void operator()(T* object) const {
+			pool->destroy(object);
+		}
+	};
+
+	using unique_ptr = std::unique_ptr<T, Deleter>;
+
+	Pool() {
+		c::pool_init(&_pool, _storage, sizeof(T), N);
+	}
+
+	Pool(const Pool&) = delete;
+	Pool& operator=(const Pool&) = delete;
+
+	/**
+	 * Constructs an object in the pool.
+	 *
+	 * T's constructor should not throw, since the object's block is not
+	 * returned to the pool if it does.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * ENOMEM - Every object of the pool is in use.
+	 *
+	 * \param args
+	 *        The arguments to T's constructor
+	 *
+	 * \return The new object, or nullptr if the pool is full.
+	 */
+	template <typename... Args>
+	T* create(Args&&... args) {
+		void* block = c::pool_alloc(&_pool);
+		if (block == nullptr) {
+			return nullptr;
+		}
+		return new (block) T(std::forward<Args>(args)...);
+	}
+
+	/**
+	 * Constructs an object in the pool, owned by a std::unique_ptr that
+	 * returns it to the pool.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * ENOMEM - Every object of the pool is in use.
+	 *
+	 * \param args
+	 *        The arguments to T's constructor
+	 *
+	 * \return The new object, or an empty pointer if the pool is full.
+	 */
+	template <typename... Args>
+	unique_ptr make_unique(Args&&... args) {
+		return unique_ptr(create(std::forward<Args>(args)...), Deleter{this});
+	}
+
+	/**
+	 * Destroys an object created by this pool and returns its block to the
+	 * pool. Destroying nullptr does nothing.
+	 *
+	 * \param object
+	 *        The object to destroy
+	 */
+	void destroy(T* object) {
+		if (object != nullptr) {
+			object->~T();
+			c::pool_free(&_pool, object);
+		}
+	}
+
+	/**
+	 * Checks whether an object belongs to this pool.
+	 *
+	 * \param object
+	 *        The object to check
+	 *
+	 * \return True if the object is one of the pool's blocks, false otherwise.
+	 */
+	bool contains(const T* object) {
+		return c::pool_contains(&_pool, object);
+	}
+
+	/**
+	 * Gets the usage counters of the pool.
+	 *
+	 * \return The counters, see pool_stats_s_t
+	 */
+	pool_stats_s_t get_stats() {
+		pool_stats_s_t stats;
+		c::pool_get_stats(&_pool, &stats);
+		return stats;
+	}
+
+	/**
+	 * \return The number of objects the pool holds.
+	 */
+	static constexpr std::size_t capacity() {
+		return N;
+	}
+
+	private:
+	alignas(POOL_ALIGN) unsigned char _storage[POOL_STORAGE_SIZE(sizeof(T), N)];
+	pool_s_t _pool;
+};
+}  // namespace pros
+
+#endif  // _PROS_POOL_HPP_
@@ -22,6 +22,7 @@
 #define _PROS_RTOS_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -57,6 +58,15 @@ namespace pros {
 
 typedef void* task_t;
 typedef void (*task_fn_t)(void*);
+typedef uint32_t task_stack_t;
+
+/**
+ * The number of bytes, aligned to 8, to reserve for the control block of a
+ * task created with task_create_static(). The control block itself is private
+ * to the kernel, so static_task_s_t can only be used through pointers.
+ */
+#define TASK_STATIC_BUFFER_SIZE 1536
+typedef struct static_task_s static_task_s_t;
 
 typedef enum {
 	E_TASK_STATE_RUNNING = 0,
@@ -105,6 +115,25 @@ typedef enum {
 
 typedef void* mutex_t;
 
+// CPU usage is measured over roughly this many milliseconds, see task_get_usage()
+#define TASK_USAGE_WINDOW 1000
+// most tasks that can be measured. If more tasks exist, the task usage functions
+// fail with ENOBUFS
+#define TASK_USAGE_MAX_TASKS 32
+
+/**
+ * CPU usage and stack information of a task, see task_get_usage()
+ */
+typedef struct task_usage_s {
+	task_t task;
+	char name[TASK_NAME_MAX_LEN];
+	task_state_e_t state;
+	uint32_t priority;          // current priority, which may be inherited from a mutex
+	uint32_t stack_high_water;  // least free stack space the task has ever had, in words
+	uint32_t run_time;          // total time the task has run, in run time counter ticks
+	float cpu_percent;          // share of the CPU the task used over the last TASK_USAGE_WINDOW
+} task_usage_s_t;
+
 /**
  * Refers to the current task handle
  */
@@ -162,6 +191,58 @@ uint64_t micros(void);
 task_t task_create(task_fn_t function, void* const parameters, uint32_t prio, const uint16_t stack_depth,
                    const char* const name);
 
+/**
+ * Creates a new task that uses the given buffers for its stack and control
+ * block instead of allocating them from the heap.
+ *
+ * The buffers belong to the task until it is deleted. A task that deletes
+ * itself (including by returning) is only cleaned up later by the idle task,
+ * so use task_delete_static() before freeing the buffers. Creating another task
+ * in the same buffers is always allowed once the previous task was deleted.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - stack_buffer or task_buffer is NULL.
+ *
+ * \param function
+ *        Pointer to the task entry function
+ * \param parameters
+ *        Pointer to memory that will be used as a parameter for the task being
+ *        created.
+ * \param prio
+ *        The priority at which the task should run.
+ *        TASK_PRIO_DEFAULT plus/minus 1 or 2 is typically used.
+ * \param stack_depth
+ *        The number of words in stack_buffer
+ * \param name
+ *        A descriptive name for the task.  This is mainly used to facilitate
+ *        debugging. The name may be up to 32 characters long.
+ * \param stack_buffer
+ *        An array of stack_depth words to use as the task's stack
+ * \param task_buffer
+ *        At least TASK_STATIC_BUFFER_SIZE bytes aligned to 8 to use as the
+ *        task's control block
+ *
+ * \return A handle by which the newly created task can be referenced. If an
+ * error occurred, NULL will be returned and errno can be checked for hints as
+ * to why task_create_static failed.
+ */
+task_t task_create_static(task_fn_t function, void* const parameters, uint32_t prio, const size_t stack_depth,
+                          const char* const name, task_stack_t* const stack_buffer, static_task_s_t* const task_buffer);
+
+/**
+ * Deletes a task created with task_create_static() and finishes cleaning it
+ * up, so that its buffers may be reused or freed once this returns.
+ *
+ * Unlike task_delete(), this may be called on a task that has already been
+ * deleted, including one that deleted itself and has not been cleaned up by
+ * the idle task yet. It must not be called by the task being deleted.
+ *
+ * \param task
+ *        The handle returned by task_create_static()
+ */
+void task_delete_static(task_t task);
+
 /**
  * Removes a task from the RTOS real time kernel's management. The task being
  * deleted will be removed from all ready, blocked, suspended and event lists.
@@ -204,6 +285,22 @@ void delay(const uint32_t milliseconds);
  */
 void task_delay_until(uint32_t* const prev_time, const uint32_t delta);
 
+/**
+ * Delays a task until a specified time in microseconds. This is the same as
+ * task_delay_until(), but uses the high-resolution timer (see pros/hrtimer.h)
+ * so it can run tasks faster than once per millisecond.
+ *
+ * The task will be woken up at the time *prev_time + delta, and *prev_time will
+ * be updated to reflect the time at which the task will unblock.
+ *
+ * \param prev_time
+ *        A pointer to the location storing the setpoint time. This should
+ *        typically be initialized to the return value of micros().
+ * \param delta
+ *        The number of microseconds to wait (1000000 microseconds per second)
+ */
+void task_delay_us_until(uint64_t* const prev_time, const uint32_t delta);
+
 /**
  * Gets the priority of the specified task.
  *
@@ -274,6 +371,75 @@ uint32_t task_get_count(void);
  */
 char* task_get_name(task_t task);
 
+/**
+ * Gets the CPU usage, state, priority, and stack high-water mark of a task.
+ *
+ * CPU usage is measured by a low priority kernel task that is started by the
+ * first call to any task usage function. Until it has run for
+ * TASK_USAGE_WINDOW, cpu_percent covers the time since the brain started.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - usage is NULL.
+ * ESRCH - The task does not exist.
+ * ENOBUFS - More than TASK_USAGE_MAX_TASKS tasks exist.
+ *
+ * \param task
+ *        The task to check, or CURRENT_TASK
+ * \param[out] usage
+ *        The location to write the task's usage to
+ *
+ * \return 1 on success, PROS_ERR otherwise.
+ */
+uint32_t task_get_usage(task_t task, task_usage_s_t* usage);
+
+/**
+ * Gets the CPU usage, state, priority, and stack high-water mark of every task,
+ * including the kernel's. See task_get_usage() for how usage is measured.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - usage is NULL.
+ * ENOBUFS - More than TASK_USAGE_MAX_TASKS tasks exist.
+ *
+ * \param[out] usage
+ *        An array to write the usage of each task to
+ * \param max
+ *        The length of the array. At most TASK_USAGE_MAX_TASKS tasks are
+ *        reported
+ *
+ * \return The number of tasks written, or PROS_ERR on failure.
+ */
+uint32_t task_get_usage_all(task_usage_s_t* usage, uint32_t max);
+
+/**
+ * Starts writing the usage of every task to a file every period milliseconds
+ * (at most four times a second), such as a serial stream ("/ser/tusg") or a file on the microSD card
+ * ("/usd/cpu.bin"). Records are written in a compact binary form that
+ * tools/task_usage_decode.py turns into a table. Any log that is already
+ * running is stopped first.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - path is NULL or period is 0.
+ * Any errno set by open() if the file cannot be opened.
+ *
+ * \param path
+ *        The file to write to
+ * \param period
+ *        How often to write the usage of every task, in milliseconds
+ *
+ * \return 1 on success, PROS_ERR otherwise.
+ */
+uint32_t task_usage_log_start(const char* path, uint32_t period);
+
+/**
+ * Stops the task usage log and closes its file.
+ *
+ * \return 1 if a log was stopped, 0 if none was running.
+ */
+uint32_t task_usage_log_stop(void);
+
 /**
  * Gets a task handle from the specified name
  *
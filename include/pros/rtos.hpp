@@ -23,13 +23,17 @@
 
 #include "pros/rtos.h"
 #undef delay
+#include <cerrno>
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <memory>
+#include <new>
 #include <optional>
 #include <type_traits>
+#include <utility>
 
 namespace pros {
 class Task {
@@ -262,6 +266,20 @@ class Task {
 	 */
 	const char* get_name();
 
+	/**
+	 * Gets the CPU usage, state, priority, and stack high-water mark of the task.
+	 * See task_get_usage() for how usage is measured.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * ESRCH - The task does not exist.
+	 * ENOBUFS - More than TASK_USAGE_MAX_TASKS tasks exist.
+	 *
+	 * \return The usage of the task. If the operation failed, the task field is
+	 * NULL and errno is set.
+	 */
+	task_usage_s_t get_usage();
+
 	/**
 	 * Convert this object to a C task_t handle
 	 */
@@ -370,6 +388,21 @@ class Task {
 	 */
 	static void delay_until(std::uint32_t* const prev_time, const std::uint32_t delta);
 
+	/**
+	 * Delays a task until a specified time in microseconds, using the
+	 * high-resolution timer (see pros/hrtimer.h).
+	 *
+	 * The task will be woken up at the time *prev_time + delta, and *prev_time
+	 * will be updated to reflect the time at which the task will unblock.
+	 *
+	 * \param prev_time
+	 *        A pointer to the location storing the setpoint time. This should
+	 *        typically be initialized to the return value from pros::micros().
+	 * \param delta
+	 *        The number of microseconds to wait (1000000 microseconds per second)
+	 */
+	static void delay_us_until(std::uint64_t* const prev_time, const std::uint32_t delta);
+
 	/**
 	 * Gets the number of tasks the kernel is currently managing, including all
 	 * ready, blocked, or suspended tasks. A task that has been deleted, but not
@@ -384,6 +417,135 @@ class Task {
 	task_t task{};
 };
 
+/**
+ * A task whose stack, control block and entry function are stored inside the
+ * StaticTask object, so starting it does not use the heap.
+ *
+ * StackWords is the size of the stack in words, like the stack_depth of
+ * task_create(). The entry function is stored in CallableSize bytes, which is
+ * enough for a lambda capturing four pointers by default; a larger one is a
+ * compile error.
+ *
+ * The object must outlive its task. It is usually a global or static
+ * variable that is started whenever the work is needed, for example:
+ *
+ *   pros::StaticTask<0x800> intake_task;
+ *
+ *   void autonomous() {
+ *     intake_task.start([&intake, speed] { intake.move(speed); });
+ *   }
+ *
+ * Destroying a StaticTask deletes its task if it is still running.
+ */
+template <std::size_t StackWords, std::size_t CallableSize = 4 * sizeof(void*)>
+class StaticTask : public Task {
+	static_assert(StackWords >= TASK_STACK_DEPTH_MIN, "the stack must have at least TASK_STACK_DEPTH_MIN words");
+
+	public:
+	StaticTask() : Task(task_t{}) {}
+
+	/**
+	 * Creates a StaticTask and starts it, see start()
+	 */
+	template <class F>
+	explicit StaticTask(F&& function, std::uint32_t prio = TASK_PRIORITY_DEFAULT, const char* name = "")
+	    : Task(task_t{}) {
+		start(std::forward<F>(function), prio, name);
+	}
+
+	/**
+	 * Creates a StaticTask and starts it, see start()
+	 */
+	template <class F>
+	StaticTask(F&& function, const char* name) : StaticTask(std::forward<F>(function), TASK_PRIORITY_DEFAULT, name) {}
+
+	StaticTask(const StaticTask&) = delete;
+	StaticTask& operator=(const StaticTask&) = delete;
+
+	~StaticTask() {
+		release();
+	}
+
+	/**
+	 * Starts a new task that runs function. The previous task started by this
+	 * object must have finished (or been removed).
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * EBUSY - The previous task is still running.
+	 *
+	 * \param function
+	 *        Callable object to use as entry function, which is moved or copied
+	 *        into this object
+	 * \param prio
+	 *        The priority at which the task should run.
+	 *        TASK_PRIO_DEFAULT plus/minus 1 or 2 is typically used.
+	 * \param name
+	 *        A descriptive name for the task.  This is mainly used to facilitate
+	 *        debugging. The name may be up to 32 characters long.
+	 *
+	 * \return The handle of the new task, or NULL if it could not be started.
+	 */
+	template <class F>
+	task_t start(F&& function, std::uint32_t prio = TASK_PRIORITY_DEFAULT, const char* name = "") {
+		using Fn = std::decay_t<F>;
+		static_assert(std::is_invocable_r_v<void, Fn&>);
+		static_assert(sizeof(Fn) <= CallableSize, "the function is larger than CallableSize");
+		static_assert(alignof(Fn) <= alignof(std::max_align_t));
+
+		if (is_running()) {
+			errno = EBUSY;
+			return nullptr;
+		}
+		release();
+
+		new (_callable) Fn(std::forward<F>(function));
+		_destroy = [](void* callable) { static_cast<Fn*>(callable)->~Fn(); };
+		task_t task = c::task_create_static(
+		    [](void* parameters) {
+			    StaticTask* self = static_cast<StaticTask*>(parameters);
+			    (*std::launder(reinterpret_cast<Fn*>(self->_callable)))();
+			    std::exchange(self->_destroy, nullptr)(self->_callable);
+		    },
+		    this, prio, StackWords, name, _stack, reinterpret_cast<static_task_s_t*>(_task_buffer));
+		if (task == nullptr) {
+			std::exchange(_destroy, nullptr)(_callable);
+		}
+		Task::operator=(task);
+		return task;
+	}
+
+	/**
+	 * Checks whether the task started by this object is still running (or
+	 * ready, blocked or suspended).
+	 *
+	 * \return False if the task was never started or has been deleted.
+	 */
+	bool is_running() {
+		task_t task = static_cast<task_t>(*this);
+		return task != nullptr && c::task_get_state(task) != E_TASK_STATE_DELETED;
+	}
+
+	private:
+	// deletes the task, if any, and destroys the function if the task did not
+	// finish running it
+	void release() {
+		task_t task = static_cast<task_t>(*this);
+		if (task != nullptr) {
+			c::task_delete_static(task);
+			Task::operator=(nullptr);
+		}
+		if (_destroy != nullptr) {
+			std::exchange(_destroy, nullptr)(_callable);
+		}
+	}
+
+	alignas(8) unsigned char _task_buffer[TASK_STATIC_BUFFER_SIZE];
+	task_stack_t _stack[StackWords];
+	alignas(std::max_align_t) unsigned char _callable[CallableSize];
+	void (*_destroy)(void*) = nullptr;
+};
+
 // STL Clock compliant clock
 struct Clock {
 	using rep = std::uint32_t;
@@ -25,6 +25,28 @@
 #ifdef __cplusplus
 extern "C" {
 namespace pros {
+#endif
+
+/**
+ * The checksum appended to each frame in framed mode
+ */
+typedef enum serial_frame_crc_e {
+	E_SERIAL_FRAME_CRC16 = 2,  // CRC-16/CCITT-FALSE
+	E_SERIAL_FRAME_CRC32 = 4   // CRC-32 (IEEE 802.3)
+} serial_frame_crc_e_t;
+
+/**
+ * Counters of a port in framed mode, see serial_frame_get_stats()
+ */
+typedef struct __attribute__((__packed__)) serial_frame_stats_s {
+	uint32_t frames;      // Frames received intact
+	uint32_t crc_errors;  // Frames discarded because their checksum did not match
+	uint32_t resyncs;     // Partial or malformed frames discarded
+	uint32_t overflows;   // Frames discarded because they were longer than max_len
+	uint32_t dropped;     // Intact frames discarded because the frame queue was full
+} serial_frame_stats_s_t;
+
+#ifdef __cplusplus
 namespace c {
 #endif
 
@@ -238,6 +260,142 @@ int32_t serial_write_byte(uint8_t port, uint8_t buffer);
  */
 int32_t serial_write(uint8_t port, uint8_t* buffer, int32_t length);
 
+/******************************************************************************/
+/**                              Framed mode                                 **/
+/**                                                                          **/
+/**  In framed mode the kernel delimits, checksums, and reassembles packets  **/
+/**  so that tasks only ever see whole, intact frames.                       **/
+/******************************************************************************/
+
+/**
+ * Switches a generic serial port into framed mode.
+ *
+ * Each frame on the wire is a 4 byte identifier, the payload, and a checksum of
+ * both (little endian), stuffed with Consistent Overhead Byte Stuffing and
+ * terminated with a 0x00 byte. Received bytes are decoded in the background as
+ * they arrive and intact frames are queued for serial_frame_read(). Damaged
+ * frames are discarded and counted, see serial_frame_get_stats().
+ *
+ * \note The other serial_read functions must not be used on a port in framed
+ * mode, since they would steal bytes from the decoder.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - The given value is not within the range of V5 ports (1-21), or
+ *          max_len or queue_len is 0.
+ * EACCES - Another resource is currently trying to access the port.
+ * EEXIST - The port is already in framed mode.
+ * ENOMEM - The frame buffers could not be allocated.
+ *
+ * \param port
+ *        The V5 port number from 1-21
+ * \param max_len
+ *        The longest payload that can be sent or received
+ * \param queue_len
+ *        The number of received frames that can be waiting to be read
+ * \param crc
+ *        The checksum to append to each frame
+ *
+ * \return 1 if the operation was successful or PROS_ERR if the operation
+ * failed, setting errno.
+ */
+int32_t serial_frame_enable(uint8_t port, uint32_t max_len, uint32_t queue_len, serial_frame_crc_e_t crc);
+
+/**
+ * Switches a generic serial port out of framed mode, discarding any frames that
+ * have not been read.
+ *
+ * \note No task may be using the port's framed functions while it is disabled.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - The given value is not within the range of V5 ports (1-21), or the
+ *          port is not in framed mode.
+ * EACCES - Another resource is currently trying to access the port.
+ *
+ * \param port
+ *        The V5 port number from 1-21
+ *
+ * \return 1 if the operation was successful or PROS_ERR if the operation
+ * failed, setting errno.
+ */
+int32_t serial_frame_disable(uint8_t port);
+
+/**
+ * Sends a frame on a port in framed mode.
+ *
+ * The frame is only written if it fits entirely in the port's output buffer,
+ * so frames are never split.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - The given value is not within the range of V5 ports (1-21), the
+ *          port is not in framed mode, or length is longer than max_len.
+ * EACCES - Another resource is currently trying to access the port.
+ * EAGAIN - There is not enough space in the output buffer for the frame.
+ * EIO - Serious internal write error.
+ *
+ * \param port
+ *        The V5 port number from 1-21
+ * \param id
+ *        The identifier of the frame
+ * \param buffer
+ *        The payload to send
+ * \param length
+ *        The length of the payload
+ *
+ * \return The length of the payload or PROS_ERR if the operation failed,
+ * setting errno.
+ */
+int32_t serial_frame_write(uint8_t port, uint32_t id, const uint8_t* buffer, uint32_t length);
+
+/**
+ * Receives the next intact frame from a port in framed mode, waiting up to
+ * timeout milliseconds for one to arrive.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - The given value is not within the range of V5 ports (1-21), or the
+ *          port is not in framed mode (or left it while waiting).
+ * EACCES - Another resource is currently trying to access the port.
+ * EAGAIN - No frame arrived before the timeout.
+ *
+ * \param port
+ *        The V5 port number from 1-21
+ * \param[out] id
+ *             The identifier of the frame. May be NULL
+ * \param[out] buffer
+ *             The location to write the payload to
+ * \param length
+ *        The size of buffer. Longer payloads are truncated
+ * \param timeout
+ *        How long to wait for a frame, in milliseconds. TIMEOUT_MAX waits
+ *        forever
+ *
+ * \return The length of the frame's payload (which may exceed length if it was
+ * truncated) or PROS_ERR if the operation failed, setting errno.
+ */
+int32_t serial_frame_read(uint8_t port, uint32_t* id, uint8_t* buffer, uint32_t length, uint32_t timeout);
+
+/**
+ * Gets the counters of a port in framed mode.
+ *
+ * This function uses the following values of errno when an error state is
+ * reached:
+ * EINVAL - The given value is not within the range of V5 ports (1-21), or the
+ *          port is not in framed mode.
+ * EACCES - Another resource is currently trying to access the port.
+ *
+ * \param port
+ *        The V5 port number from 1-21
+ * \param[out] stats
+ *             The location to write the counters to
+ *
+ * \return 1 if the operation was successful or PROS_ERR if the operation
+ * failed, setting errno.
+ */
+int32_t serial_frame_get_stats(uint8_t port, serial_frame_stats_s_t* stats);
+
 #ifdef __cplusplus
 }  // namespace c
 }  // namespace pros
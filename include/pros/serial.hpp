@@ -217,6 +217,112 @@ class Serial {
 	 */
 	virtual std::int32_t write(std::uint8_t* buffer, std::int32_t length) const;
 
+	/**
+	 * Switches the port into framed mode.
+	 *
+	 * Each frame on the wire is a 4 byte identifier, the payload, and a checksum
+	 * of both, stuffed with Consistent Overhead Byte Stuffing and terminated with
+	 * a 0x00 byte. Received frames are decoded in the background and queued for
+	 * frame_read(). The other read functions must not be used in framed mode.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * EINVAL - The given value is not within the range of V5 ports (1-21), or
+	 *          max_len or queue_len is 0.
+	 * EACCES - Another resource is currently trying to access the port.
+	 * EEXIST - The port is already in framed mode.
+	 * ENOMEM - The frame buffers could not be allocated.
+	 *
+	 * \param max_len
+	 *        The longest payload that can be sent or received
+	 * \param queue_len
+	 *        The number of received frames that can be waiting to be read
+	 * \param crc
+	 *        The checksum to append to each frame
+	 *
+	 * \return 1 if the operation was successful or PROS_ERR if the operation
+	 * failed, setting errno.
+	 */
+	virtual std::int32_t frame_enable(std::uint32_t max_len, std::uint32_t queue_len,
+	                                  serial_frame_crc_e_t crc = E_SERIAL_FRAME_CRC16) const;
+
+	/**
+	 * Switches the port out of framed mode, discarding any unread frames.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * EINVAL - The given value is not within the range of V5 ports (1-21), or the
+	 *          port is not in framed mode.
+	 * EACCES - Another resource is currently trying to access the port.
+	 *
+	 * \return 1 if the operation was successful or PROS_ERR if the operation
+	 * failed, setting errno.
+	 */
+	virtual std::int32_t frame_disable() const;
+
+	/**
+	 * Sends a frame. The frame is only written if it fits entirely in the port's
+	 * output buffer.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * EINVAL - The given value is not within the range of V5 ports (1-21), the
+	 *          port is not in framed mode, or length is longer than max_len.
+	 * EACCES - Another resource is currently trying to access the port.
+	 * EAGAIN - There is not enough space in the output buffer for the frame.
+	 * EIO - Serious internal write error.
+	 *
+	 * \param id
+	 *        The identifier of the frame
+	 * \param buffer
+	 *        The payload to send
+	 * \param length
+	 *        The length of the payload
+	 *
+	 * \return The length of the payload or PROS_ERR if the operation failed,
+	 * setting errno.
+	 */
+	virtual std::int32_t frame_write(std::uint32_t id, const std::uint8_t* buffer, std::uint32_t length) const;
+
+	/**
+	 * Receives the next intact frame, waiting up to timeout milliseconds for one
+	 * to arrive.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * EINVAL - The given value is not within the range of V5 ports (1-21), or the
+	 *          port is not in framed mode.
+	 * EAGAIN - No frame arrived before the timeout.
+	 *
+	 * \param[out] id
+	 *             The identifier of the frame. May be nullptr
+	 * \param[out] buffer
+	 *             The location to write the payload to
+	 * \param length
+	 *        The size of buffer. Longer payloads are truncated
+	 * \param timeout
+	 *        How long to wait for a frame, in milliseconds
+	 *
+	 * \return The length of the frame's payload or PROS_ERR if the operation
+	 * failed, setting errno.
+	 */
+	virtual std::int32_t frame_read(std::uint32_t* id, std::uint8_t* buffer, std::uint32_t length,
+	                                std::uint32_t timeout) const;
+
+	/**
+	 * Gets the framed mode counters of the port.
+	 *
+	 * This function uses the following values of errno when an error state is
+	 * reached:
+	 * EINVAL - The given value is not within the range of V5 ports (1-21), or the
+	 *          port is not in framed mode.
+	 * EACCES - Another resource is currently trying to access the port.
+	 *
+	 * \return The counters. If the operation failed, all counters are 0 and
+	 * errno is set.
+	 */
+	virtual serial_frame_stats_s_t frame_get_stats() const;
+
 	private:
 	const std::uint8_t _port;
 };
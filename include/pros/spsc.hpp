@@ -0,0 +1,400 @@
+/**
+ * \file pros/spsc.hpp
+ *
+ * Contains single-producer/single-consumer queues for passing data between two
+ * tasks without locking.
+ *
+ * pros::SpscQueue holds objects and pros::SpscByteRing holds bytes. Exactly
+ * one task may add to a given queue and exactly one task may take from it.
+ * Adding and taking never block or enter a critical section: each side only
+ * writes its own index and publishes it with a release store, which costs a
+ * memory barrier rather than the critical section and extra copies of a
+ * queue_t. This makes them a good fit for streaming samples from a
+ * high-priority task to a slower one, such as a logger.
+ *
+ * Both also have blocking versions of their functions. A task blocked on an
+ * empty or full queue is woken with a task notification by the other side, so
+ * notifications are only sent when the other side is actually waiting. The
+ * blocking functions use the calling task's notification value, so they
+ * should not be mixed with task_notify_take() in the same task.
+ *
+ * This file should not be modified by users, since it gets replaced whenever
+ * a kernel upgrade occurs.
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _PROS_SPSC_HPP_
+#define _PROS_SPSC_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <utility>
+
+#include "pros/rtos.h"
+
+namespace pros {
+/**
+ * The task waiting on one side of an SpscQueue or SpscByteRing. Not meant to
+ * be used on its own.
+ */
+class SpscWaiter {
+	public:
+	/**
+	 * Wakes the waiting task, if there is one. Called by the other side after
+	 * it published a change to its index.
+	 */
+	void wake() {
+		// pairs with the fence in wait(): either the waiter sees the new index
+		// or this sees the waiter
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_task.load(std::memory_order_relaxed) != nullptr) {
+			task_t task = _task.exchange(nullptr, std::memory_order_relaxed);
+			if (task != nullptr) {
+				c::task_notify(task);
+			}
+		}
+	}
+
+	/**
+	 * Blocks until ready() returns true or timeout milliseconds pass.
+	 *
+	 * \return The last value of ready()
+	 */
+	template <class Ready>
+	bool wait(Ready ready, std::uint32_t timeout) {
+		std::uint32_t start = c::millis();
+		for (;;) {
+			_task.store(c::task_get_current(), std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (ready()) {
+				_task.store(nullptr, std::memory_order_relaxed);
+				return true;
+			}
+			std::uint32_t elapsed = c::millis() - start;
+			if (elapsed >= timeout) {
+				_task.store(nullptr, std::memory_order_relaxed);
+				return false;
+			}
+			c::task_notify_take(true, timeout == TIMEOUT_MAX ? TIMEOUT_MAX : timeout - elapsed);
+		}
+	}
+
+	private:
+	std::atomic<task_t> _task{nullptr};
+};
+
+/**
+ * A queue of up to N objects of type T, passed from one producer task to one
+ * consumer task without locking. N must be a power of 2.
+ *
+ * Example:
+ *   pros::SpscQueue<Sample, 64> samples;
+ *
+ *   // acquisition task
+ *   samples.push(read_sample());
+ *
+ *   // logger task
+ *   if (std::optional<Sample> sample = samples.pop(TIMEOUT_MAX)) {
+ *     log(*sample);
+ *   }
+ */
+template <typename T, std::size_t N>
+class SpscQueue {
+	static_assert(N > 0 && (N & (N - 1)) == 0, "the capacity of an SpscQueue must be a power of 2");
+	static_assert(N <= UINT32_MAX / 2, "the capacity of an SpscQueue must fit its indices");
+
+	public:
+	SpscQueue() = default;
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	~SpscQueue() {
+		while (pop()) {
+		}
+	}
+
+	/**
+	 * Constructs an object at the back of the queue. Only the producer task may
+	 * call this. Never blocks.
+	 *
+	 * \param args
+	 *        The arguments to T's constructor
+	 *
+	 * \return True if the object was added, false if the queue was full.
+	 */
+	template <typename... Args>
+	bool emplace(Args&&... args) {
+		std::uint32_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail - _head.load(std::memory_order_acquire) == N) {
+			return false;
+		}
+		new (slot(tail)) T(std::forward<Args>(args)...);
+		_tail.store(tail + 1, std::memory_order_release);
+		_consumer.wake();
+		return true;
+	}
+
+	/**
+	 * Adds an object to the back of the queue. Only the producer task may call
+	 * this. Never blocks.
+	 *
+	 * \return True if the object was added, false if the queue was full.
+	 */
+	bool push(const T& value) {
+		return emplace(value);
+	}
+
+	bool push(T&& value) {
+		return emplace(std::move(value));
+	}
+
+	/**
+	 * Adds an object to the back of the queue, waiting for room if the queue is
+	 * full. Only the producer task may call this.
+	 *
+	 * \param value
+	 *        The object to add
+	 * \param timeout
+	 *        The longest time to wait, in milliseconds. TIMEOUT_MAX waits
+	 *        forever.
+	 *
+	 * \return True if the object was added, false if the queue was still full
+	 * after timeout.
+	 */
+	bool push(T value, std::uint32_t timeout) {
+		if (emplace(std::move(value))) {
+			return true;
+		}
+		if (!_producer.wait([this] { return !full(); }, timeout)) {
+			return false;
+		}
+		return emplace(std::move(value));
+	}
+
+	/**
+	 * Takes the object at the front of the queue. Only the consumer task may
+	 * call this. Never blocks.
+	 *
+	 * \return The object, or std::nullopt if the queue was empty.
+	 */
+	std::optional<T> pop() {
+		std::uint32_t head = _head.load(std::memory_order_relaxed);
+		if (_tail.load(std::memory_order_acquire) == head) {
+			return std::nullopt;
+		}
+		T* item = slot(head);
+		std::optional<T> value(std::move(*item));
+		item->~T();
+		_head.store(head + 1, std::memory_order_release);
+		_producer.wake();
+		return value;
+	}
+
+	/**
+	 * Takes the object at the front of the queue, waiting for one if the queue
+	 * is empty. Only the consumer task may call this.
+	 *
+	 * \param timeout
+	 *        The longest time to wait, in milliseconds. TIMEOUT_MAX waits
+	 *        forever.
+	 *
+	 * \return The object, or std::nullopt if the queue was still empty after
+	 * timeout.
+	 */
+	std::optional<T> pop(std::uint32_t timeout) {
+		std::optional<T> value = pop();
+		if (value || !_consumer.wait([this] { return !empty(); }, timeout)) {
+			return value;
+		}
+		return pop();
+	}
+
+	/**
+	 * \return The number of objects in the queue. Exact when called by the
+	 * producer or the consumer, approximate otherwise.
+	 */
+	std::size_t size() const {
+		return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	bool full() const {
+		return size() == N;
+	}
+
+	static constexpr std::size_t capacity() {
+		return N;
+	}
+
+	private:
+	T* slot(std::uint32_t index) {
+		return std::launder(reinterpret_cast<T*>(_slots + (index & (N - 1)) * sizeof(T)));
+	}
+
+	alignas(T) unsigned char _slots[N * sizeof(T)];
+	// free-running indices of the next object to take and the next slot to
+	// fill, written only by the consumer and only by the producer
+	std::atomic<std::uint32_t> _head{0};
+	std::atomic<std::uint32_t> _tail{0};
+	SpscWaiter _consumer;
+	SpscWaiter _producer;
+};
+
+/**
+ * A ring of N bytes, passed from one producer task to one consumer task
+ * without locking. N must be a power of 2.
+ *
+ * Unlike a stream buffer, reads and writes copy straight between the caller's
+ * buffer and the ring, with at most two memcpy() calls each.
+ */
+template <std::size_t N>
+class SpscByteRing {
+	static_assert(N > 0 && (N & (N - 1)) == 0, "the size of an SpscByteRing must be a power of 2");
+	static_assert(N <= UINT32_MAX / 2, "the size of an SpscByteRing must fit its indices");
+
+	public:
+	SpscByteRing() = default;
+	SpscByteRing(const SpscByteRing&) = delete;
+	SpscByteRing& operator=(const SpscByteRing&) = delete;
+
+	/**
+	 * Writes as many bytes as there is room for. Only the producer task may call
+	 * this. Never blocks.
+	 *
+	 * \param data
+	 *        The bytes to write
+	 * \param length
+	 *        The number of bytes to write
+	 *
+	 * \return The number of bytes written, which is less than length if the
+	 * ring filled up.
+	 */
+	std::size_t write(const void* data, std::size_t length) {
+		std::uint32_t tail = _tail.load(std::memory_order_relaxed);
+		std::size_t room = N - (tail - _head.load(std::memory_order_acquire));
+		if (length > room) {
+			length = room;
+		}
+		if (length == 0) {
+			return 0;
+		}
+		std::size_t offset = tail & (N - 1);
+		std::size_t first = length < N - offset ? length : N - offset;
+		std::memcpy(_buffer + offset, data, first);
+		std::memcpy(_buffer, static_cast<const std::uint8_t*>(data) + first, length - first);
+		_tail.store(tail + length, std::memory_order_release);
+		_consumer.wake();
+		return length;
+	}
+
+	/**
+	 * Writes all of the bytes, waiting for room whenever the ring is full.
+	 * Only the producer task may call this.
+	 *
+	 * \param data
+	 *        The bytes to write
+	 * \param length
+	 *        The number of bytes to write
+	 * \param timeout
+	 *        The longest time to wait for room each time the ring fills up, in
+	 *        milliseconds. TIMEOUT_MAX waits forever.
+	 *
+	 * \return The number of bytes written, which is less than length if the
+	 * ring stayed full for timeout.
+	 */
+	std::size_t write(const void* data, std::size_t length, std::uint32_t timeout) {
+		std::size_t written = write(data, length);
+		while (written < length && _producer.wait([this] { return size() < N; }, timeout)) {
+			written += write(static_cast<const std::uint8_t*>(data) + written, length - written);
+		}
+		return written;
+	}
+
+	/**
+	 * Reads as many bytes as are available, up to length. Only the consumer
+	 * task may call this. Never blocks.
+	 *
+	 * \param buffer
+	 *        The location to copy the bytes to
+	 * \param length
+	 *        The most bytes to read
+	 *
+	 * \return The number of bytes read.
+	 */
+	std::size_t read(void* buffer, std::size_t length) {
+		std::uint32_t head = _head.load(std::memory_order_relaxed);
+		std::size_t available = _tail.load(std::memory_order_acquire) - head;
+		if (length > available) {
+			length = available;
+		}
+		if (length == 0) {
+			return 0;
+		}
+		std::size_t offset = head & (N - 1);
+		std::size_t first = length < N - offset ? length : N - offset;
+		std::memcpy(buffer, _buffer + offset, first);
+		std::memcpy(static_cast<std::uint8_t*>(buffer) + first, _buffer, length - first);
+		_head.store(head + length, std::memory_order_release);
+		_producer.wake();
+		return length;
+	}
+
+	/**
+	 * Reads up to length bytes, waiting for at least one if the ring is empty.
+	 * Only the consumer task may call this.
+	 *
+	 * \param buffer
+	 *        The location to copy the bytes to
+	 * \param length
+	 *        The most bytes to read
+	 * \param timeout
+	 *        The longest time to wait, in milliseconds. TIMEOUT_MAX waits
+	 *        forever.
+	 *
+	 * \return The number of bytes read, which is 0 if the ring stayed empty for
+	 * timeout.
+	 */
+	std::size_t read(void* buffer, std::size_t length, std::uint32_t timeout) {
+		std::size_t count = read(buffer, length);
+		if (count > 0 || length == 0 || !_consumer.wait([this] { return size() > 0; }, timeout)) {
+			return count;
+		}
+		return read(buffer, length);
+	}
+
+	/**
+	 * \return The number of bytes in the ring. Exact when called by the
+	 * producer or the consumer, approximate otherwise.
+	 */
+	std::size_t size() const {
+		return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+	}
+
+	static constexpr std::size_t capacity() {
+		return N;
+	}
+
+	private:
+	std::uint8_t _buffer[N];
+	// free-running byte counts read and written, each written by only one side
+	std::atomic<std::uint32_t> _head{0};
+	std::atomic<std::uint32_t> _tail{0};
+	SpscWaiter _consumer;
+	SpscWaiter _producer;
+};
+}  // namespace pros
+
+#endif  // _PROS_SPSC_HPP_
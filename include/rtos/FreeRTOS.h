@@ -983,8 +983,11 @@ typedef struct xSTATIC_LIST
  * architecture is being used, and no matter how the values in FreeRTOSConfig.h
  * are set.  Its contents are somewhat obfuscated in the hope users will
  * recognise that it would be unwise to make direct use of the structure members.
+ *
+ * pros/rtos.h declares this structure without its members for user code, which
+ * only sees TASK_STATIC_BUFFER_SIZE. kapi.h checks that the structure fits.
  */
-typedef struct xSTATIC_TCB
+typedef struct static_task_s
 {
 	void				*pxDummy1;
 	#if ( portUSING_MPU_WRAPPERS == 1 )
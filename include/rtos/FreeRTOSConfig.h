@@ -119,10 +119,11 @@
 #define configPERIPHERAL_CLOCK_HZ               ( 33333000UL )
 #define configUSE_PREEMPTION                    1
 #define configUSE_IDLE_HOOK                     1
-#define configUSE_TICK_HOOK                     0
+#define configUSE_TICK_HOOK                     1
 #define configMAX_PRIORITIES                    ( 16 )
 #define configMINIMAL_STACK_SIZE                ( ( unsigned short ) 250 )
-// allocate 1 MB for FreeRTOS heap
+// allocate 1 MB for FreeRTOS heap. Build with -DPROS_HEAP_TLSF to manage it
+// with heap_tlsf.c (bounded time kmalloc/kfree) instead of heap_4.c
 #define configTOTAL_HEAP_SIZE                   ( 0x100000 )
 #define configMAX_TASK_NAME_LEN                 ( 32 )
 #define configUSE_TRACE_FACILITY                1
@@ -141,7 +142,9 @@
 #define configUSE_NEWLIB_REENTRANT              1
 #define configSTACK_DEPTH_TYPE                  size_t
 
-#define configNUM_THREAD_LOCAL_STORAGE_POINTERS 2
+/* Indices 0 and 1 are used by task_notify_when_deleting, 2 by the serial
+driver's per-task output buffers. */
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS 3
 
 /* Include the query-heap CLI command to query the free heap space. */
 #define configINCLUDE_QUERY_HEAP_COMMAND        1
@@ -231,4 +234,10 @@ Zynq MPU. */
 #define configINTERRUPT_CONTROLLER_CPU_INTERFACE_OFFSET ( -0xf00 )
 #define configUNIQUE_INTERRUPT_PRIORITIES               32
 
+/* The kernel can be built with -DPROS_TRACE to record context switches and
+queue/mutex operations into a trace buffer, see system/trace.h. */
+#ifdef PROS_TRACE
+#include "system/trace.h"
+#endif
+
 #endif /* FREERTOS_CONFIG_H */
@@ -613,7 +613,7 @@ void vMessageBufferDelete( msg_buf_t xMessageBuffer );
  * @param xMessageBuffer The handle of the message buffer to be deleted.
  *
  */
-#define vMessageBufferDelete( xMessageBuffer ) vStreamBufferDelete( ( stream_buf_t ) xMessageBuffer )
+#define vMessageBufferDelete( xMessageBuffer ) stream_buf_delete( ( stream_buf_t ) xMessageBuffer )
 
 /**
  * message_buffer.h
@@ -589,7 +589,7 @@ size_t xStreamBufferReceiveFromISR( stream_buf_t xStreamBuffer,
  * stream_buffer.h
  *
 <pre>
-void vStreamBufferDelete( stream_buf_t xStreamBuffer );
+void stream_buf_delete( stream_buf_t xStreamBuffer );
 </pre>
  *
  * Deletes a stream buffer that was previously created using a call to
@@ -602,10 +602,10 @@ void vStreamBufferDelete( stream_buf_t xStreamBuffer );
  *
  * @param xStreamBuffer The handle of the stream buffer to be deleted.
  *
- * \defgroup vStreamBufferDelete vStreamBufferDelete
+ * \defgroup stream_buf_delete stream_buf_delete
  * \ingroup StreamBufferManagement
  */
-void vStreamBufferDelete( stream_buf_t xStreamBuffer ) ;
+void stream_buf_delete( stream_buf_t xStreamBuffer ) ;
 
 /**
  * stream_buffer.h
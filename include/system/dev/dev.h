@@ -18,3 +18,4 @@
 extern const struct fs_driver* const dev_driver;
 int dev_open_r(struct _reent* r, const char* path, int flags, int mode);
 void dev_initialize(void);
+void dev_background_processing(void);
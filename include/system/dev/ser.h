@@ -15,8 +15,27 @@
 
 #pragma once
 
+#include <stdbool.h>
+
 #include "vfs.h"
 
+#define STDIN_STREAM_ID 0x706e6973   // 'sinp' little endian
+#define STDOUT_STREAM_ID 0x74756f73  // 'sout' little endian
+#define STDERR_STREAM_ID 0x72726573  // 'serr' little endian
+#define KDBG_STREAM_ID 0x6762646b    // 'kdbg' little endian
+
 extern const struct fs_driver* const ser_driver;
 int ser_open_r(struct _reent* r, const char* path, int flags, int mode);
 void ser_initialize(void);
+
+// returns true if data written to the stream would be sent over the serial line
+bool ser_stream_enabled(uint32_t stream_id);
+
+// queues a packet without taking locks or blocking, for fatal error reports
+// that are printed after the rest of the system has stopped. See
+// system/dev/ser_driver.c
+void ser_output_write_fatal(uint32_t stream_id, const uint8_t* buf, size_t len);
+
+// ends a packet whose writer was stopped halfway, so that fatal error reports
+// can still get out. See system/dev/ser_driver.c
+void ser_output_end_partial(void);
@@ -0,0 +1,83 @@
+/**
+ * \file system/heap_stats.h
+ *
+ * Kernel heap instrumentation header
+ *
+ * Both kernel heaps (heap_4.c and heap_tlsf.c) implement heap_walk(), which
+ * the heap statistics in system/heap_stats.c are computed from. When the kernel
+ * is built with -DPROS_HEAP_STATS, the heaps also tag every block with the task
+ * that allocated it and the address kmalloc() was called from, and report every
+ * kmalloc() call to heap_stats_malloc().
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Extra block header fields kept when the kernel is built with
+ * -DPROS_HEAP_STATS
+ */
+typedef struct heap_tag {
+	uint32_t owner;   // TCB number of the task that allocated the block, 0 if none
+	uint32_t caller;  // return address of the kmalloc() call
+} heap_tag_s_t;
+
+/**
+ * A block of the heap, as passed to a heap_walk_fn_t
+ */
+typedef struct heap_block_info {
+	void* ptr;     // start of the payload
+	size_t size;   // size of the payload
+	size_t total;  // size of the block, including its header
+	bool allocated;
+	const heap_tag_s_t* tag;  // NULL for free blocks, or without PROS_HEAP_STATS
+} heap_block_info_s_t;
+
+typedef void (*heap_walk_fn_t)(const heap_block_info_s_t* block, void* arg);
+
+/**
+ * Calls fn for every block of the heap, free or allocated, in address order.
+ *
+ * The scheduler is suspended for the whole walk, so fn must not block or
+ * allocate.
+ */
+void heap_walk(heap_walk_fn_t fn, void* arg);
+
+/**
+ * Counts a kmalloc() call and fills in the tag of the block it allocated.
+ *
+ * Called by the heap with the scheduler suspended.
+ *
+ * \param size
+ *        The size that was requested
+ * \param tag
+ *        The tag of the new block, or NULL if the allocation failed
+ * \param caller
+ *        The return address of the kmalloc() call
+ */
+void heap_stats_malloc(size_t size, heap_tag_s_t* tag, void* caller);
+
+/**
+ * Prints the heap report to the serial port without using the serial driver,
+ * for the malloc failed hook. The caller should keep the scheduler suspended
+ * and call vexBackgroundProcessing() afterwards so the output is sent.
+ */
+void heap_stats_print_fatal(void);
+
+#ifdef __cplusplus
+}
+#endif
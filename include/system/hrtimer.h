@@ -0,0 +1,50 @@
+/**
+ * \file system/hrtimer.h
+ *
+ * Kernel side of the high-resolution timers, see pros/hrtimer.h
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// GIC interrupt ID of the Cortex-A9 global timer comparator
+#define HRTIMER_INTERRUPT_ID 27
+
+/**
+ * Takes over the global timer comparator and creates the callback task.
+ * Called once at startup, before the scheduler starts.
+ */
+void hrtimer_initialize(void);
+
+/**
+ * Handles the global timer comparator interrupt. Called from the IRQ handler
+ * for HRTIMER_INTERRUPT_ID.
+ */
+void hrtimer_interrupt(void);
+
+/**
+ * Blocks the calling task until micros() reaches deadline. The whole
+ * milliseconds of the wait are spent in task_delay(), and only the rest on the
+ * hardware timer. The rest is spun instead if the hardware timer is not
+ * available, and all of the wait is if the scheduler is not running.
+ *
+ * \param deadline
+ *        The micros() time to wait for
+ */
+void hrtimer_wait_until(uint64_t deadline);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,113 @@
+/**
+ * \file system/klog.h
+ *
+ * Deferred kernel logging facility header
+ *
+ * See system/klog.c for discussion
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define KLOG_LEVEL_DEBUG 0
+#define KLOG_LEVEL_INFO 1
+#define KLOG_LEVEL_WARN 2
+#define KLOG_LEVEL_ERROR 3
+#define KLOG_LEVEL_NONE 4
+
+// Messages below this level are compiled out entirely. Can be overridden with
+// -DKLOG_LEVEL=KLOG_LEVEL_xxx
+#ifndef KLOG_LEVEL
+#ifdef PROS_RELEASING
+#define KLOG_LEVEL KLOG_LEVEL_WARN
+#else
+#define KLOG_LEVEL KLOG_LEVEL_DEBUG
+#endif
+#endif
+
+// maximum number of 32-bit arguments that a single log record can carry
+#define KLOG_MAX_ARGS 4
+
+// Stream which raw (unformatted) records are sent over for host-side decoding
+#define KLOG_STREAM_ID 0x676f6c6b  // 'klog' little endian
+
+// Format strings are collected into their own section so that the host-side
+// decoder (tools/klog_decode.py) can build the string table from the ELF
+#define KLOG_FMT_SECTION ".rodata.klog_fmt"
+
+#define _KLOG_STR(x) #x
+#define _KLOG_XSTR(x) _KLOG_STR(x)
+#define _KLOG_NARGS(...) _KLOG_NARGS_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define _KLOG_NARGS_(_0, _1, _2, _3, _4, N, ...) N
+
+/**
+ * Records a log message without formatting it.
+ *
+ * Only the address of the format string, a timestamp, and the raw arguments are
+ * copied into the log ring buffer. Formatting happens later in the log daemon,
+ * or on the host if the 'klog' stream is enabled.
+ *
+ * Arguments are captured as 32-bit words, so only integer, character, and
+ * pointer conversions are supported (no %f or %lld). %s arguments must point
+ * to storage that outlives the record (e.g. string literals).
+ *
+ * Messages with a level below KLOG_LEVEL compile to nothing.
+ */
+#define klog(level, fmt, ...)                                                                            \
+	do {                                                                                                   \
+		if ((level) >= KLOG_LEVEL) {                                                                         \
+			static const char _klog_fmt[] __attribute__((section(KLOG_FMT_SECTION))) =                         \
+			    __FILE__ ":" _KLOG_XSTR(__LINE__) " -- " fmt;                                                  \
+			klog_record((level), _klog_fmt, _KLOG_NARGS(__VA_ARGS__), ##__VA_ARGS__);                          \
+		}                                                                                                    \
+	} while (0)
+
+#define klog_debug(fmt, ...) klog(KLOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define klog_info(fmt, ...) klog(KLOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define klog_warn(fmt, ...) klog(KLOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define klog_error(fmt, ...) klog(KLOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+
+/**
+ * Appends a record to the log ring buffer. Use the klog macros instead of
+ * calling this directly.
+ *
+ * This function is lock-free and may be called from any task or ISR. If the
+ * ring buffer is full, the record is dropped and counted.
+ *
+ * \param level
+ *        The KLOG_LEVEL_* of the message
+ * \param fmt
+ *        The printf-style format string. Must have static storage duration
+ * \param nargs
+ *        The number of 32-bit arguments that follow, at most KLOG_MAX_ARGS
+ */
+void klog_record(uint32_t level, const char* fmt, uint32_t nargs, ...);
+
+/**
+ * Gets the number of records which were dropped because the ring buffer was
+ * full.
+ *
+ * \return The number of dropped records since startup
+ */
+uint32_t klog_get_dropped(void);
+
+/**
+ * Starts the log daemon. Called by pros_init after the serial driver is up.
+ */
+void klog_initialize(void);
+
+#ifdef __cplusplus
+}
+#endif
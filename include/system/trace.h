@@ -0,0 +1,105 @@
+/**
+ * \file system/trace.h
+ *
+ * RTOS trace recorder header
+ *
+ * When the kernel is built with -DPROS_TRACE, FreeRTOSConfig.h includes this
+ * file, which fills in the FreeRTOS trace hooks so that every context switch,
+ * queue/mutex operation, priority inheritance, delay, and task notification is
+ * recorded into the trace buffer. See system/trace.c for discussion.
+ *
+ * The hooks are expanded inside tasks.c and queue.c, so they may only refer to
+ * names which are in scope there (pxCurrentTCB, pxQueue, ...).
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of events the trace buffer holds. Each event takes 12 bytes. Can be
+// overridden with -DTRACE_BUFFER_EVENTS=n
+#ifndef TRACE_BUFFER_EVENTS
+#define TRACE_BUFFER_EVENTS 2048
+#endif
+
+// Event types. Keep in sync with tools/trace_to_perfetto.py
+#define TRACE_EVENT_TASK_SWITCH 1       // object: TCB, value: priority
+#define TRACE_EVENT_TASK_CREATE 2       // object: TCB, value: priority
+#define TRACE_EVENT_TASK_DELETE 3       // object: TCB
+#define TRACE_EVENT_TASK_DELAY 4        // object: tick to wake at
+#define TRACE_EVENT_PRIO_INHERIT 5      // object: TCB of the mutex holder, value: new priority
+#define TRACE_EVENT_PRIO_DISINHERIT 6   // object: TCB of the mutex holder, value: restored priority
+#define TRACE_EVENT_QUEUE_SEND 7        // object: queue, value: queue type (a mutex give for mutexes)
+#define TRACE_EVENT_QUEUE_RECEIVE 8     // object: queue, value: queue type (a mutex take for mutexes)
+#define TRACE_EVENT_QUEUE_BLOCK_SEND 9  // object: queue, value: queue type
+#define TRACE_EVENT_QUEUE_BLOCK_RECEIVE 10  // object: queue, value: queue type
+#define TRACE_EVENT_QUEUE_FAILED 11     // object: queue, value: queue type
+#define TRACE_EVENT_NOTIFY 12           // object: TCB of the notified task
+#define TRACE_EVENT_NOTIFY_BLOCK 13     // object: TCB of the waiting task
+#define TRACE_EVENT_ISR_ENTER 14        // object: interrupt ID
+#define TRACE_EVENT_ISR_EXIT 15         // object: interrupt ID
+#define TRACE_EVENT_USER 16             // object: user value, value: user ID
+#define TRACE_EVENT_TRIGGER 17          // object: events recorded after the trigger
+
+/**
+ * Appends an event to the trace buffer.
+ *
+ * This function may be called from any task or ISR, including from within
+ * critical sections. It only masks interrupts for the duration of the copy.
+ *
+ * \param event
+ *        The TRACE_EVENT_* type
+ * \param value
+ *        8 bits of event specific data
+ * \param object
+ *        32 bits of event specific data, typically a handle
+ */
+void trace_record(uint8_t event, uint8_t value, uint32_t object);
+
+#ifdef PROS_TRACE
+
+#define traceTASK_SWITCHED_IN() \
+	trace_record(TRACE_EVENT_TASK_SWITCH, pxCurrentTCB->uxPriority, (uint32_t)pxCurrentTCB)
+#define traceTASK_CREATE(pxNewTCB) trace_record(TRACE_EVENT_TASK_CREATE, (pxNewTCB)->uxPriority, (uint32_t)(pxNewTCB))
+#define traceTASK_DELETE(pxTCB) trace_record(TRACE_EVENT_TASK_DELETE, 0, (uint32_t)(pxTCB))
+#define traceTASK_DELAY() trace_record(TRACE_EVENT_TASK_DELAY, 0, xTickCount + milliseconds)
+#define traceTASK_DELAY_UNTIL(xTimeToWake) trace_record(TRACE_EVENT_TASK_DELAY, 0, (xTimeToWake))
+
+#define traceTASK_PRIORITY_INHERIT(pxTCB, uxPriority) \
+	trace_record(TRACE_EVENT_PRIO_INHERIT, (uxPriority), (uint32_t)(pxTCB))
+#define traceTASK_PRIORITY_DISINHERIT(pxTCB, uxPriority) \
+	trace_record(TRACE_EVENT_PRIO_DISINHERIT, (uxPriority), (uint32_t)(pxTCB))
+
+#define _TRACE_QUEUE(event, pxQueue) trace_record((event), (pxQueue)->ucQueueType, (uint32_t)(pxQueue))
+#define traceQUEUE_SEND(pxQueue) _TRACE_QUEUE(TRACE_EVENT_QUEUE_SEND, pxQueue)
+#define traceQUEUE_SEND_FROM_ISR(pxQueue) _TRACE_QUEUE(TRACE_EVENT_QUEUE_SEND, pxQueue)
+#define traceQUEUE_RECEIVE(pxQueue) _TRACE_QUEUE(TRACE_EVENT_QUEUE_RECEIVE, pxQueue)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue) _TRACE_QUEUE(TRACE_EVENT_QUEUE_RECEIVE, pxQueue)
+#define traceBLOCKING_ON_QUEUE_SEND(pxQueue) _TRACE_QUEUE(TRACE_EVENT_QUEUE_BLOCK_SEND, pxQueue)
+#define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue) _TRACE_QUEUE(TRACE_EVENT_QUEUE_BLOCK_RECEIVE, pxQueue)
+#define traceBLOCKING_ON_QUEUE_PEEK(pxQueue) _TRACE_QUEUE(TRACE_EVENT_QUEUE_BLOCK_RECEIVE, pxQueue)
+#define traceQUEUE_SEND_FAILED(pxQueue) _TRACE_QUEUE(TRACE_EVENT_QUEUE_FAILED, pxQueue)
+#define traceQUEUE_RECEIVE_FAILED(pxQueue) _TRACE_QUEUE(TRACE_EVENT_QUEUE_FAILED, pxQueue)
+
+#define traceTASK_NOTIFY() trace_record(TRACE_EVENT_NOTIFY, 0, (uint32_t)pxTCB)
+#define traceTASK_NOTIFY_FROM_ISR() trace_record(TRACE_EVENT_NOTIFY, 0, (uint32_t)pxTCB)
+#define traceTASK_NOTIFY_GIVE_FROM_ISR() trace_record(TRACE_EVENT_NOTIFY, 0, (uint32_t)pxTCB)
+#define traceTASK_NOTIFY_TAKE_BLOCK() trace_record(TRACE_EVENT_NOTIFY_BLOCK, 0, (uint32_t)pxCurrentTCB)
+#define traceTASK_NOTIFY_WAIT_BLOCK() trace_record(TRACE_EVENT_NOTIFY_BLOCK, 0, (uint32_t)pxCurrentTCB)
+
+#endif  // PROS_TRACE
+
+#ifdef __cplusplus
+}
+#endif
@@ -231,6 +231,20 @@ int internal_port_mutex_take(uint8_t port);
  */
 int internal_port_mutex_give(uint8_t port);
 
+/**
+ * Feeds the bytes received by every generic serial port in framed mode into its
+ * frame decoder. Called by vdml_background_processing() while all the port
+ * mutexes are held.
+ */
+void serial_frame_background_processing(void);
+
+/**
+ * Reassembles the messages received by every VEXlink with its streaming
+ * receiver running. Called by vdml_background_processing() while all the port
+ * mutexes are held.
+ */
+void link_background_processing(void);
+
 #define V5_PORT_BATTERY 24
 #define V5_PORT_CONTROLLER_1 25
 #define V5_PORT_CONTROLLER_2 26
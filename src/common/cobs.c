@@ -97,3 +97,61 @@ int cobs_encode(uint8_t* restrict dest, const uint8_t* restrict src, const size_
 
 	return write_idx;
 }
+
+void cobs_decoder_init(cobs_decoder_s_t* decoder, uint8_t* buf, size_t capacity) {
+	decoder->buf = buf;
+	decoder->capacity = capacity;
+	decoder->len = 0;
+	decoder->code = 0;
+	decoder->remaining = 0;
+	decoder->overflow = false;
+}
+
+cobs_decode_result_e_t cobs_decode_byte(cobs_decoder_s_t* decoder, uint8_t byte) {
+	if (byte == 0) {
+		if (decoder->code == 0) {
+			// repeated delimiters carry no frame (e.g. used by senders to resync)
+			decoder->len = 0;
+			return E_COBS_DECODE_PENDING;
+		}
+		cobs_decode_result_e_t result = E_COBS_DECODE_COMPLETE;
+		if (decoder->overflow) {
+			result = E_COBS_DECODE_OVERFLOW;
+		} else if (decoder->remaining != 0) {
+			result = E_COBS_DECODE_TRUNCATED;
+		}
+		// the length of the finished frame is left for the caller, and is reset
+		// when the next frame starts (code == 0)
+		if (result != E_COBS_DECODE_COMPLETE) {
+			decoder->len = 0;
+		}
+		decoder->code = 0;
+		decoder->remaining = 0;
+		decoder->overflow = false;
+		return result;
+	}
+
+	if (decoder->remaining == 0) {
+		// a code byte. the previous block ended in an implied zero unless it was a
+		// maximum length block, or this is the first block of the frame
+		if (decoder->code == 0) {
+			decoder->len = 0;
+		} else if (decoder->code != 0xff) {
+			if (decoder->len < decoder->capacity) {
+				decoder->buf[decoder->len++] = 0;
+			} else {
+				decoder->overflow = true;
+			}
+		}
+		decoder->code = byte;
+		decoder->remaining = byte - 1;
+	} else {
+		if (decoder->len < decoder->capacity) {
+			decoder->buf[decoder->len++] = byte;
+		} else {
+			decoder->overflow = true;
+		}
+		decoder->remaining--;
+	}
+	return E_COBS_DECODE_PENDING;
+}
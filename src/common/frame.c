@@ -0,0 +1,100 @@
+/**
+ * \file common/frame.c
+ *
+ * Checksummed packet framing
+ *
+ * A frame is a 4 byte identifier, the payload, and a CRC-16 or CRC-32 of both
+ * (little endian), stuffed with COBS and terminated with a 0x00 delimiter:
+ *
+ *   COBS(id | payload | crc) 0x00
+ *
+ * Because the delimiter can never appear inside a stuffed frame, a receiver that
+ * joins mid-stream or loses bytes resynchronizes on the next delimiter. The
+ * decoder is fed one byte at a time so that it never re-scans partial frames.
+ *
+ * This file has no kernel dependencies so that it can be compiled and tested on
+ * a host.
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <string.h>
+
+#include "common/crc.h"
+#include "common/frame.h"
+
+static uint32_t frame_crc(const uint8_t* data, size_t len, uint8_t crc_size) {
+	if (crc_size == FRAME_CRC16) {
+		return crc16(CRC16_INIT, data, len);
+	}
+	return crc32(CRC32_INIT, data, len) ^ 0xFFFFFFFF;
+}
+
+size_t frame_encode(uint8_t* dest, uint32_t id, uint8_t* payload, size_t len, uint8_t crc_size) {
+	uint32_t crc;
+	if (crc_size == FRAME_CRC16) {
+		crc = crc16(crc16(CRC16_INIT, (uint8_t*)&id, FRAME_ID_SIZE), payload, len);
+	} else {
+		crc = crc32(crc32(CRC32_INIT, (uint8_t*)&id, FRAME_ID_SIZE), payload, len) ^ 0xFFFFFFFF;
+	}
+	for (size_t i = 0; i < crc_size; i++) {
+		payload[len + i] = crc >> (8 * i);
+	}
+
+	size_t written = cobs_encode(dest, payload, len + crc_size, id);
+	dest[written++] = 0;
+	return written;
+}
+
+void frame_decoder_init(frame_decoder_s_t* decoder, uint8_t* buf, size_t capacity, uint8_t crc_size) {
+	memset(decoder, 0, sizeof(*decoder));
+	cobs_decoder_init(&decoder->cobs, buf, capacity);
+	decoder->crc_size = crc_size;
+}
+
+bool frame_decode_byte(frame_decoder_s_t* decoder, uint8_t byte) {
+	switch (cobs_decode_byte(&decoder->cobs, byte)) {
+		case E_COBS_DECODE_PENDING:
+			return false;
+		case E_COBS_DECODE_TRUNCATED:
+			decoder->resyncs++;
+			return false;
+		case E_COBS_DECODE_OVERFLOW:
+			decoder->overflows++;
+			return false;
+		case E_COBS_DECODE_COMPLETE:
+			break;
+	}
+
+	size_t len = decoder->cobs.len;
+	if (len < FRAME_ID_SIZE + decoder->crc_size) {
+		decoder->resyncs++;
+		return false;
+	}
+	len -= decoder->crc_size;
+
+	const uint8_t* crc_bytes = decoder->cobs.buf + len;
+	uint32_t crc = 0;
+	for (size_t i = 0; i < decoder->crc_size; i++) {
+		crc |= (uint32_t)crc_bytes[i] << (8 * i);
+	}
+	if (crc != frame_crc(decoder->cobs.buf, len, decoder->crc_size)) {
+		decoder->crc_errors++;
+		return false;
+	}
+
+	decoder->len = len - FRAME_ID_SIZE;
+	decoder->frames++;
+	return true;
+}
+
+uint32_t frame_decoder_get_id(const frame_decoder_s_t* decoder) {
+	uint32_t id;
+	memcpy(&id, decoder->cobs.buf, FRAME_ID_SIZE);
+	return id;
+}
@@ -6,6 +6,11 @@
  * Contains an implementation to efficiently assign globally unique IDs
  * e.g. to assign entries in a global table
  *
+ * A set bit in the bitmap is a free gid. Gids are claimed by clearing their bit
+ * with a compare-and-swap and freed with an atomic OR (LDREX/STREX on the V5),
+ * so neither operation takes a lock and a free can never race an allocation in
+ * the same word.
+ *
  * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
  * All rights reserved.
  *
@@ -30,66 +35,58 @@ void gid_init(struct gid_metadata* const metadata) {
 		metadata->bitmap[i] = ~0;
 	}
 
-	metadata->bitmap[0] = (~0 << (metadata->reserved));
+	metadata->bitmap[0] &= (~0 << (metadata->reserved));
+	// the bits past max in the last word are never handed out
+	if (metadata->max % UINT32_WIDTH) {
+		metadata->bitmap[metadata->bitmap_size - 1] &= ~(~0u << (metadata->max % UINT32_WIDTH));
+	}
+	metadata->_cur_val = 0;
+}
 
-	metadata->_lock = mutex_create();
-	return;
+// clears a free bit in word, returning false if it was already taken
+static bool _gid_claim(uint32_t* word, uint32_t bit) {
+	uint32_t value = __atomic_load_n(word, __ATOMIC_RELAXED);
+	while (value & bit) {
+		if (__atomic_compare_exchange_n(word, &value, value & ~bit, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			return true;
+		}
+	}
+	return false;
 }
 
 uint32_t gid_alloc(struct gid_metadata* const metadata) {
-	if (mutex_take(metadata->_lock, TIMEOUT_MAX)) {
-		size_t i;
-		uint32_t gid = 0;
-		uint32_t* gid_word = NULL;
-		uint32_t gid_idx = 0;
-		// check if the _cur_val + 1 is free
-		if (!gid_check(metadata, (metadata->_cur_val + 1) % metadata->max)) {
-			// that gid was free! so allocate it
-			gid = metadata->_cur_val = (metadata->_cur_val + 1) % metadata->max;
-			gid_word = metadata->bitmap + (gid / UINT32_WIDTH);
-			gid_idx = gid % UINT32_WIDTH;
-			goto return_gid;
-		} else {
-			for (i = 0; i < metadata->bitmap_size; i++) {
-				gid_word = metadata->bitmap + i;
-				if (*gid_word == 0) {  // all GIDs in this word are assigned
-					continue;
-				}
-				// __builtin_ctz counts trailing zeros. This effectively returns the
-				// position of the first unassigned gid withing the word
-				gid_idx = __builtin_ctz(*gid_word);
+	// try the gid after the last one that was handed out first
+	uint32_t gid = (__atomic_load_n(&metadata->_cur_val, __ATOMIC_RELAXED) + 1) % metadata->max;
+	if (_gid_claim(metadata->bitmap + gid / UINT32_WIDTH, 1u << (gid % UINT32_WIDTH))) {
+		goto return_gid;
+	}
+	for (size_t i = 0; i < metadata->bitmap_size; i++) {
+		uint32_t* gid_word = metadata->bitmap + i;
+		uint32_t value = __atomic_load_n(gid_word, __ATOMIC_RELAXED);
+		while (value != 0) {
+			// __builtin_ctz counts trailing zeros. This effectively returns the
+			// position of the first unassigned gid within the word
+			uint32_t gid_idx = __builtin_ctz(value);
+			if (__atomic_compare_exchange_n(gid_word, &value, value & ~(1u << gid_idx), true, __ATOMIC_ACQUIRE,
+			                                __ATOMIC_RELAXED)) {
 				gid = gid_idx + (i * UINT32_WIDTH);
-				// mark the id as allocated
 				goto return_gid;
 			}
+			// value now holds the word's current contents, try again
 		}
-	return_gid:
-		if (gid > metadata->max || gid == 0) {
-			mutex_give(metadata->_lock);
-			return 0;
-		}
-		*gid_word &= ~(1 << gid_idx);
-		metadata->_cur_val = gid;
-		mutex_give(metadata->_lock);
-		return gid;
 	}
 	return 0;
+
+return_gid:
+	__atomic_store_n(&metadata->_cur_val, gid, __ATOMIC_RELAXED);
+	return gid;
 }
 
 void gid_free(struct gid_metadata* const metadata, uint32_t id) {
-	if (id > metadata->max || id == 0) {
+	if (id >= metadata->max || id < metadata->reserved) {
 		return;
 	}
 
 	size_t word_idx = id / UINT32_WIDTH;
-	metadata->bitmap[word_idx] |= 1 << (id % UINT32_WIDTH);
-}
-
-bool gid_check(struct gid_metadata* metadata, uint32_t id) {
-	if (id > metadata->max) {
-		return false;
-	}
-
-	size_t word_idx = id / UINT32_WIDTH;
-	return (metadata->bitmap[word_idx] & (1 << (id % UINT32_WIDTH))) ? false : true;
+	__atomic_fetch_or(metadata->bitmap + word_idx, 1u << (id % UINT32_WIDTH), __ATOMIC_RELEASE);
 }
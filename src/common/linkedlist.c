@@ -21,8 +21,15 @@
 // NOTE: Do not intermix data and function payloads. This may cause data to be 
 // re-evaluated as a pointer to an area in memory and a false free or add.
 
+// Nodes and lists come from pools so that adding and removing entries doesn't
+// fragment the heap. The heap is only used once a pool runs out
+#define LL_NODE_POOL_SIZE 32
+#define LL_LIST_POOL_SIZE 16
+POOL_STATIC(node_pool, sizeof(ll_node_s_t), LL_NODE_POOL_SIZE);
+POOL_STATIC(list_pool, sizeof(linked_list_s_t), LL_LIST_POOL_SIZE);
+
 ll_node_s_t* linked_list_init_func_node(generic_fn_t func) {
-	ll_node_s_t* node = (ll_node_s_t*)kmalloc(sizeof *node);
+	ll_node_s_t* node = (ll_node_s_t*)kpool_alloc(&node_pool, sizeof *node);
 	node->payload.func = func;
 	node->next = NULL;
 
@@ -30,7 +37,7 @@ ll_node_s_t* linked_list_init_func_node(generic_fn_t func) {
 }
 
 ll_node_s_t* linked_list_init_data_node(void* data) {
-	ll_node_s_t* node = (ll_node_s_t*)kmalloc(sizeof *node);
+	ll_node_s_t* node = (ll_node_s_t*)kpool_alloc(&node_pool, sizeof *node);
 	node->payload.data = data;
 	node->next = NULL;
 
@@ -38,7 +45,7 @@ ll_node_s_t* linked_list_init_data_node(void* data) {
 }
 
 linked_list_s_t* linked_list_init() {
-	linked_list_s_t* list = (linked_list_s_t*)kmalloc(sizeof *list);
+	linked_list_s_t* list = (linked_list_s_t*)kpool_alloc(&list_pool, sizeof *list);
 	list->head = NULL;
 
 	return list;
@@ -89,7 +96,7 @@ void linked_list_remove_func(linked_list_s_t* list, generic_fn_t func) {
 				list->head = it->next;
 			else
 				p->next = it->next;
-			kfree(it);
+			kpool_free(&node_pool, it);
 			break;
 		}
 
@@ -125,7 +132,7 @@ void linked_list_remove_data(linked_list_s_t* list, void* data) {
 				list->head = it->next;
 			else
 				p->next = it->next;
-			kfree(it);
+			kpool_free(&node_pool, it);
 			break;
 		}
 
@@ -145,12 +152,12 @@ void linked_list_foreach(linked_list_s_t* list, linked_list_foreach_fn_t cb, voi
 }
 
 void linked_list_free(linked_list_s_t* list) {
-	if (list == NULL || list->head == NULL) return;
+	if (list == NULL) return;
 
 	while (list->head != NULL) {
 		ll_node_s_t* node = list->head;
 		list->head = node->next;
-		kfree(node);
+		kpool_free(&node_pool, node);
 	}
-	kfree(list);
+	kpool_free(&list_pool, list);
 }
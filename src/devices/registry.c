@@ -18,6 +18,7 @@
 #include "api.h"
 #include "kapi.h"
 #include "pros/misc.h"
+#include "system/klog.h"
 #include "v5_api.h"
 #include "vdml/registry.h"
 #include "vdml/vdml.h"
@@ -27,16 +28,16 @@ static V5_DeviceType registry_types[V5_MAX_DEVICE_PORTS];
 
 void registry_init() {
 	int i;
-	kprint("[VDML][INFO]Initializing registry\n");
+	klog_info("[VDML] Initializing registry");
 	registry_update_types();
 	for (i = 0; i < NUM_V5_PORTS; i++) {
 		registry[i].device_type = (v5_device_e_t)registry_types[i];
 		registry[i].device_info = vexDeviceGetByIndex(i);
 		if (registry[i].device_type != E_DEVICE_NONE) {
-			kprintf("[VDML][INFO]Register device in port %d", i + 1);
+			klog_info("[VDML] Register device in port %d", i + 1);
 		}
 	}
-	kprint("[VDML][INFO]Done initializing registry\n");
+	klog_info("[VDML] Done initializing registry");
 }
 
 void registry_update_types() {
@@ -45,21 +46,21 @@ void registry_update_types() {
 
 int registry_bind_port(uint8_t port, v5_device_e_t device_type) {
 	if (!VALIDATE_PORT_NO(port)) {
-		kprintf("[VDML][ERROR]Registration: Invalid port number %d\n", port + 1);
+		klog_error("[VDML] Registration: Invalid port number %d", port + 1);
 		errno = ENXIO;
 		return PROS_ERR;
 	}
 	if (registry[port].device_type != E_DEVICE_NONE) {
-		kprintf("[VDML][ERROR]Registration: Port already in use %d\n", port + 1);
+		klog_error("[VDML] Registration: Port already in use %d", port + 1);
 		errno = EADDRINUSE;
 		return PROS_ERR;
 	}
 	if ((v5_device_e_t)registry_types[port] != device_type && (v5_device_e_t)registry_types[port] != E_DEVICE_NONE) {
-		kprintf("[VDML][ERROR]Registration: Device mismatch in port %d\n", port + 1);
+		klog_error("[VDML] Registration: Device mismatch in port %d", port + 1);
 		errno = EADDRINUSE;
 		return PROS_ERR;
 	}
-	kprintf("[VDML][INFO]Registering device in port %d\n", port + 1);
+	klog_info("[VDML] Registering device in port %d", port + 1);
 	v5_smart_device_s_t device;
 	device.device_type = device_type;
 	device.device_info = vexDeviceGetByIndex(port);
@@ -133,7 +134,7 @@ int32_t registry_validate_binding(uint8_t port, v5_device_e_t expected_t) {
 	} else if (actual_t == E_DEVICE_NONE) {
 		// Warn about nothing plugged
 		if (!vdml_get_port_error(port)) {
-			kprintf("[VDML][WARNING] No device in port %d. Is it plugged in?\n", port + 1);
+			klog_warn("[VDML] No device in port %d. Is it plugged in?", port + 1);
 			vdml_set_port_error(port);
 		}
 		errno = ENODEV;
@@ -141,7 +142,7 @@ int32_t registry_validate_binding(uint8_t port, v5_device_e_t expected_t) {
 	} else {
 		// Warn about a mismatch
 		if (!vdml_get_port_error(port)) {
-			kprintf("[VDML][WARNING] Device mismatch in port %d.\n", port + 1);
+			klog_warn("[VDML] Device mismatch in port %d.", port + 1);
 			vdml_set_port_error(port);
 		}
 		errno = EADDRINUSE;
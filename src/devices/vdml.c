@@ -16,6 +16,7 @@
 #include "vdml/vdml.h"
 #include "kapi.h"
 #include "v5_api.h"
+#include "system/dev/dev.h"
 #include "vdml/registry.h"
 
 #include <errno.h>
@@ -172,6 +173,13 @@ void vdml_background_processing() {
 	// Refresh actual device types
 	registry_update_types();
 
+	// Service the rx/tx rings of ports opened through /dev
+	dev_background_processing();
+	// Decode frames received by ports in framed mode
+	serial_frame_background_processing();
+	// Reassemble messages received by VEXlinks with a streaming receiver
+	link_background_processing();
+
 	// Validate the ports. Warn if mismatch.
 	uint8_t error_arr[NUM_V5_PORTS];
 	int num_errors = 0;
@@ -17,15 +17,140 @@
  */
 
  #include "pros/link.h"
+ #include "common/crc.h"
  #include "kapi.h"
  #include "pros/apix.h"
+ #include "system/klog.h"
  #include "vdml/vdml.h"
  #include <string.h>
 
-#define PROTOCOL_SIZE         4 // Protocol Size 
+/**
+ * Packeted messages are sent as a single frame:
+ *
+ *   start byte (1) | protocol version (1) | payload size (2) | payload | CRC-16 (2)
+ *
+ * Multi-byte fields are little endian, and the CRC-16/CCITT-FALSE covers every
+ * byte before it. The version lets either end detect a peer speaking a newer
+ * protocol, see link_get_peer_version().
+ *
+ * Frames belonging to a channel (see link_channel_open) have CHANNEL_FLAG set
+ * in the version byte, and their payload starts with a channel header:
+ *
+ *   kind (1) | channel (1) | epoch (2) | sequence number (2) | message
+ *
+ * The epoch is picked by the sender whenever the channel is opened, so when
+ * the other robot restarts or reopens its channel, its frames arrive with an
+ * epoch that the receiver hasn't seen. The receiver then adopts the sequence
+ * numbers of the new epoch instead of waiting for ones that will never come.
+ *
+ * Reliable channels are go-back-N: the receiver only accepts the next expected
+ * sequence number and answers every data frame with a cumulative ACK carrying
+ * the sequence number it expects next. The sender keeps up to a window of
+ * unacknowledged messages and retransmits all of them when the oldest one has
+ * not been acknowledged within the retransmit timeout, which adapts to the
+ * measured round trip time (RFC 6298, with Karn's algorithm). ACKs carry the
+ * epoch they acknowledge, and a sender ignores ACKs for any epoch but its own.
+ * Reliable frames carrying the oldest unacknowledged message have SYNC_FLAG
+ * set in their kind, and are the only ones a receiver may adopt a new epoch
+ * from, so no message before them can be skipped.
+ */
+#define HEADER_SIZE           4 // start byte, version, and payload size
+#define CRC_SIZE              2
+#define PROTOCOL_SIZE         (HEADER_SIZE + CRC_SIZE) // Protocol Size
+#define CHANNEL_FLAG          0x80
+#define CHANNEL_HEADER_SIZE   6
+
+// kinds of channel frames
+#define KIND_RELIABLE         0
+#define KIND_LATEST           1
+#define KIND_ACK              2
+#define SYNC_FLAG             0x80
+
+// bounds of the retransmit timeout, in milliseconds
+#define RTO_INITIAL           250
+#define RTO_MIN               20
+#define RTO_MAX               2000
 
 static const uint8_t START_BYTE = 0x33;
 
+// protocol version of the last frame received on each port, 0 if none yet
+static uint8_t peer_versions[NUM_V5_PORTS];
+
+typedef struct link_message {
+    uint16_t size;
+    uint8_t data[];
+} link_message_s_t;
+
+typedef struct link_segment {
+    uint16_t size;
+    bool transmitted;
+    bool retransmitted;
+    uint32_t sent_at;
+    uint8_t* data;
+} link_segment_s_t;
+
+typedef struct link_channel {
+    link_channel_config_s_t config;
+    // sender state, protected by the port mutex
+    uint16_t epoch;            // never 0, which stands for no epoch seen yet
+    uint16_t next_seq;         // sequence number of the next new message
+    uint16_t base_seq;         // oldest unacknowledged sequence number
+    uint8_t base_slot;         // index of base_seq in window
+    link_segment_s_t* window;  // config.window in flight messages
+    sem_t window_free;         // counts the free slots of window
+    uint32_t timer;            // when the retransmit timer was last started
+    uint32_t rto;
+    uint32_t srtt;
+    uint32_t rttvar;
+    uint32_t acked_bytes;
+    uint32_t goodput_time;
+    uint32_t goodput_bytes;
+    // receiver state
+    uint16_t peer_epoch;       // epoch of the other robot's channel, 0 if not known
+    uint16_t expected_seq;
+    queue_t messages;
+    mutex_t read_mtx;
+    link_message_s_t* read_msg;  // receive target, protected by read_mtx
+    link_channel_stats_s_t stats;
+    // link_channel_send() and link_channel_receive() calls using the channel.
+    // They wait without the port mutex, so closing the channel leaves freeing it
+    // to the last one
+    uint32_t users;  // protected by the port mutex
+    bool closing;
+} link_channel_s_t;
+
+/**
+ * State of the streaming receiver of a port (see link_stream_enable).
+ *
+ * Received bytes are appended to buf and parsed by link_stream_parse(), which
+ * only consumes bytes once it knows what they are. A frame with a bad header
+ * or checksum only costs its start byte, so a real frame hiding behind a
+ * false start byte is still found.
+ */
+typedef struct link_stream {
+    uint8_t buf[LINK_BUFFER_SIZE];
+    uint16_t len;
+    uint16_t max_size;
+    link_message_s_t* read_msg;  // receive target, protected by read_mtx
+    queue_t messages;
+    mutex_t read_mtx;
+    link_stats_s_t stats;
+    link_channel_s_t* channels[LINK_MAX_CHANNELS];
+    uint8_t tx_frame[LINK_BUFFER_SIZE];  // protected by the port mutex
+    // link_receive_message() calls using the stream. They wait without the port
+    // mutex, so link_stream_disable() leaves freeing the stream to the last one
+    uint32_t readers;  // protected by the port mutex
+    bool closing;
+} link_stream_s_t;
+
+// entries are only created or destroyed while holding the port's mutex, which
+// the system daemon also holds during link_background_processing
+static link_stream_s_t* streams[NUM_V5_PORTS];
+
+// a queued message with this size tells a waiting reader that the stream or
+// channel was closed. Real messages are never this large
+#define LINK_MESSAGE_CLOSED UINT16_MAX
+
 // internal function for clearing the rx buffer 
 static uint32_t _clear_rx_buf(v5_smart_device_s_t* device) {
     uint8_t buf[LINK_BUFFER_SIZE];
@@ -34,6 +159,36 @@ static uint32_t _clear_rx_buf(v5_smart_device_s_t* device) {
     vexDeviceGenericRadioReceiveAvail(device->device_info));
 }
 
+// assembles a frame from an optional channel header and a message, returning
+// its size
+static uint16_t _build_frame(uint8_t* frame, uint8_t version, const uint8_t* head, uint16_t head_size,
+                             const void* data, uint16_t data_size) {
+    uint16_t size = head_size + data_size;
+    frame[0] = START_BYTE;
+    frame[1] = version;
+    frame[2] = (size) & 0xff;
+    frame[3] = (size >> 8) & 0xff;
+    if (head_size) memcpy(frame + HEADER_SIZE, head, head_size);
+    if (data_size) memcpy(frame + HEADER_SIZE + head_size, data, data_size);
+    uint16_t crc = crc16(CRC16_INIT, frame, HEADER_SIZE + size);
+    frame[HEADER_SIZE + size] = crc & 0xff;
+    frame[HEADER_SIZE + size + 1] = (crc >> 8) & 0xff;
+    return size + PROTOCOL_SIZE;
+}
+
+// transmits a channel frame if there is room for all of it. the port mutex must
+// be held
+static bool _transmit_channel_frame(V5_DeviceT device, link_stream_s_t* stream, uint8_t kind, uint8_t channel,
+                                    uint16_t epoch, uint16_t seq, const void* data, uint16_t data_size) {
+    uint8_t head[CHANNEL_HEADER_SIZE] = {kind, channel, epoch & 0xff, (epoch >> 8) & 0xff, seq & 0xff, (seq >> 8) & 0xff};
+    if (data_size + CHANNEL_HEADER_SIZE + PROTOCOL_SIZE > vexDeviceGenericRadioWriteFree(device)) {
+        return false;
+    }
+    uint16_t len = _build_frame(stream->tx_frame, LINK_PROTOCOL_VERSION | CHANNEL_FLAG, head, CHANNEL_HEADER_SIZE,
+                                data, data_size);
+    return vexDeviceGenericRadioTransmit(device, stream->tx_frame, len) == len;
+}
+
 //custom claim_port style wrapper for link_init due to type mismatching otherwise, limit of one radio per brain
 static uint32_t _link_init(uint8_t port, const char* link_id, link_type_e_t type, bool ov)
 {
@@ -120,7 +275,7 @@ uint32_t link_receive_raw(uint8_t port, void* dest, uint16_t data_size) {
 }
 
 uint32_t link_transmit(uint8_t port, void* data, uint16_t data_size) {
-    if(data == NULL) {
+    if(data == NULL || data_size > LINK_BUFFER_SIZE - PROTOCOL_SIZE) {
         errno = EINVAL;
         return PROS_ERR;
     }
@@ -133,28 +288,15 @@ uint32_t link_transmit(uint8_t port, void* data, uint16_t data_size) {
         errno = EBUSY;
         return_port(port - 1, PROS_ERR);
     }
-    // calculated checksum
-    uint8_t checksum = START_BYTE;
-    uint8_t size_tx_buf[2];
-    size_tx_buf[1] = (data_size >> 8) & 0xff;
-    size_tx_buf[0] = (data_size) & 0xff;
-    checksum ^= size_tx_buf[1];
-    checksum ^= size_tx_buf[0];
-    
-    for(int i = 0; i < data_size; i++) {
-        checksum ^= ((uint8_t*)data)[i];
-    }
-    uint32_t rtv = 0;
-    // send protocol
-    rtv += vexDeviceGenericRadioTransmit(device->device_info, (uint8_t*)&START_BYTE, 1);
-    rtv += vexDeviceGenericRadioTransmit(device->device_info, size_tx_buf, 2);
-    rtv += vexDeviceGenericRadioTransmit(device->device_info, (uint8_t*)data, data_size);
-    rtv += vexDeviceGenericRadioTransmit(device->device_info, &checksum, 1);
+    // assemble the frame so that it goes out in a single transmit
+    uint8_t frame[LINK_BUFFER_SIZE];
+    uint16_t len = _build_frame(frame, LINK_PROTOCOL_VERSION, NULL, 0, data, data_size);
+    uint32_t rtv = vexDeviceGenericRadioTransmit(device->device_info, frame, len);
     return_port(port - 1, rtv);
 }
 
 uint32_t link_receive(uint8_t port, void* dest, uint16_t data_size) {
-    if(dest == NULL) {
+    if(dest == NULL || data_size > LINK_BUFFER_SIZE - PROTOCOL_SIZE) {
         errno = EINVAL;
         return PROS_ERR;
     }
@@ -167,47 +309,691 @@ uint32_t link_receive(uint8_t port, void* dest, uint16_t data_size) {
         errno = EBUSY;
         return_port(port - 1, PROS_ERR);
     }
-    uint8_t header_byte;
-    uint8_t received_size;
-    // process protocol
-    received_size = vexDeviceGenericRadioReceive(device->device_info, &header_byte, 1); // 0x33
-    if(START_BYTE != header_byte || received_size != 1) {
-        kprintf("[VEXLINK] Invalid Header Byte Received Port %d, header byte: %x", port, header_byte);
+    uint8_t frame[LINK_BUFFER_SIZE];
+    int32_t received_size = vexDeviceGenericRadioReceive(device->device_info, frame, data_size + PROTOCOL_SIZE);
+    if(received_size != data_size + PROTOCOL_SIZE || frame[0] != START_BYTE) {
+        klog_warn("[VEXLINK] Invalid Header Byte Received Port %d, header byte: %x", port, frame[0]);
+        _clear_rx_buf(device);
         errno = EBADMSG;
         return_port(port - 1, PROS_ERR);
     }
-    // datasize
-    uint16_t received_data_size;
-    received_size = vexDeviceGenericRadioReceive(device->device_info, (uint8_t*)&received_data_size, 2);
-    if(received_size != 2 || received_data_size != data_size) {
+    uint16_t received_data_size = frame[2] | (frame[3] << 8);
+    if(received_data_size != data_size) {
+        klog_warn("[VEXLINK] Invalid Data Size (Size: %d ) Received Port %d, flushing RX buffer!", received_data_size, port);
         _clear_rx_buf(device);
-        kprintf("[VEXLINK] Invalid Data Size (Size: %d ) Received Port %d, flushing RX buffer!\n", received_data_size, port);
         errno = EBADMSG;
         return_port(port - 1, PROS_ERR);
     }
-    // receive data
-    uint32_t rtv = vexDeviceGenericRadioReceive(device->device_info, (uint8_t*)dest, data_size);
-    if(rtv != data_size || received_data_size != data_size) {
-        kprintf("[VEXLINK] Invalid Data Received Port %d, flushing RX buffer!\n", port);
+    uint16_t received_crc = frame[HEADER_SIZE + data_size] | (frame[HEADER_SIZE + data_size + 1] << 8);
+    if(received_crc != crc16(CRC16_INIT, frame, HEADER_SIZE + data_size)) {
+        klog_warn("[VEXLINK] Checksum Mismatch Port %d!, Checksum: %x", port, received_crc);
         errno = EBADMSG;
-        _clear_rx_buf(device);
         return_port(port - 1, PROS_ERR);
     }
-    uint8_t received_checksum;
-    received_size = vexDeviceGenericRadioReceive(device->device_info, &received_checksum, 1);
-    // check checksum
-    uint8_t calculated_checksum = START_BYTE;
-    calculated_checksum ^= (data_size >> 8) & 0xff;
-    calculated_checksum ^= (data_size) & 0xff;
-    for(int i = 0; i < data_size; i++) {
-        calculated_checksum ^= ((uint8_t*)dest)[i];
+    // the version byte is only trusted once the checksum has vouched for it
+    peer_versions[port - 1] = frame[1];
+    if(frame[1] > LINK_PROTOCOL_VERSION) {
+        klog_warn("[VEXLINK] Unsupported Protocol Version %d Received Port %d", frame[1], port);
+        errno = EPROTONOSUPPORT;
+        return_port(port - 1, PROS_ERR);
     }
-    if(calculated_checksum != received_checksum || received_size != 1) {
-        kprintf("[VEXLINK] Checksum Mismatch Port %d!, Checksum: %x\n", port, received_checksum);
-        errno = EBADMSG;
+    memcpy(dest, frame + HEADER_SIZE, data_size);
+    return_port(port - 1, data_size);
+}
+
+static void link_stream_consume(link_stream_s_t* stream, uint16_t count) {
+    stream->len -= count;
+    memmove(stream->buf, stream->buf + count, stream->len);
+}
+
+static void link_channel_handle_ack(link_channel_s_t* chan, uint16_t epoch, uint16_t ack) {
+    if (epoch != chan->epoch) {
+        // meant for an earlier opening of this channel
+        return;
+    }
+    uint16_t in_flight = chan->next_seq - chan->base_seq;
+    uint16_t acked = ack - chan->base_seq;
+    if (acked == 0 || acked > in_flight) {
+        // stale or bogus acknowledgement
+        return;
+    }
+    uint32_t now = millis();
+    for (uint16_t i = 0; i < acked; i++) {
+        link_segment_s_t* seg = &chan->window[(chan->base_slot + i) % chan->config.window];
+        // Karn's algorithm: retransmitted messages give ambiguous samples
+        if (i == acked - 1 && !seg->retransmitted && seg->transmitted) {
+            uint32_t rtt = now - seg->sent_at;
+            if (chan->srtt == 0) {
+                chan->srtt = rtt;
+                chan->rttvar = rtt / 2;
+            } else {
+                uint32_t delta = chan->srtt > rtt ? chan->srtt - rtt : rtt - chan->srtt;
+                chan->rttvar = (3 * chan->rttvar + delta) / 4;
+                chan->srtt = (7 * chan->srtt + rtt) / 8;
+            }
+            chan->rto = chan->srtt + 4 * chan->rttvar;
+            chan->rto = chan->rto < RTO_MIN ? RTO_MIN : chan->rto > RTO_MAX ? RTO_MAX : chan->rto;
+        }
+        chan->acked_bytes += seg->size;
+        chan->stats.acked++;
+        sem_post(chan->window_free);
+    }
+    chan->base_seq = ack;
+    chan->base_slot = (chan->base_slot + acked) % chan->config.window;
+    chan->timer = now;
+}
+
+// handles a channel frame of size bytes at the front of the receive buffer
+static void link_channel_receive_frame(uint8_t port, link_stream_s_t* stream, uint16_t size) {
+    uint8_t* head = stream->buf + HEADER_SIZE;
+    uint8_t kind = head[0] & ~SYNC_FLAG;
+    uint16_t epoch = head[2] | (head[3] << 8);
+    uint16_t seq = head[4] | (head[5] << 8);
+    link_channel_s_t* chan = head[1] < LINK_MAX_CHANNELS ? stream->channels[head[1]] : NULL;
+    if (chan == NULL) {
+        // nobody is listening. a reliable sender will retry until the channel is opened
+        return;
+    }
+
+    if (kind == KIND_ACK) {
+        if (chan->config.mode == E_LINK_CHANNEL_RELIABLE) {
+            link_channel_handle_ack(chan, epoch, seq);
+        }
+        return;
+    }
+
+    // the sequence number sits right before the message, so the frame can be
+    // queued in place as a link_message_s_t once it has been parsed
+    link_message_s_t* msg = (link_message_s_t*)(head + 4);
+    msg->size = size - CHANNEL_HEADER_SIZE;
+    if (msg->size > chan->config.max_size) {
+        chan->stats.dropped++;
+        return;
+    }
+
+    if (kind == KIND_LATEST) {
+        if (epoch != chan->peer_epoch) {
+            // the other robot restarted or reopened its channel
+            if (chan->peer_epoch != 0) chan->stats.resyncs++;
+            chan->peer_epoch = epoch;
+            chan->expected_seq = seq;
+        }
+        if ((int16_t)(seq - chan->expected_seq) < 0) {
+            // arrived after a newer value
+            chan->stats.duplicates++;
+            return;
+        }
+        chan->expected_seq = seq + 1;
+        queue_reset(chan->messages);
+        queue_append(chan->messages, msg, 0);
+        chan->stats.received++;
+        return;
+    }
+
+    if (epoch != chan->peer_epoch) {
+        if (!(head[0] & SYNC_FLAG)) {
+            // messages before this one may have been lost, so wait for the
+            // sender to go back to its oldest unacknowledged message
+            chan->stats.duplicates++;
+            return;
+        }
+        if (chan->peer_epoch != 0) chan->stats.resyncs++;
+        chan->peer_epoch = epoch;
+        chan->expected_seq = seq;
+    }
+    if (seq == chan->expected_seq) {
+        if (queue_append(chan->messages, msg, 0)) {
+            chan->expected_seq++;
+            chan->stats.received++;
+        } else {
+            // not acknowledged, so the sender will retransmit it once the
+            // program has caught up
+            chan->stats.dropped++;
+        }
+    } else {
+        // a duplicate or a message after a lost one, neither of which is kept
+        chan->stats.duplicates++;
+    }
+    // acknowledge everything received so far, even for duplicates in case the
+    // previous acknowledgement was lost
+    _transmit_channel_frame(registry_get_device(port)->device_info, stream, KIND_ACK, head[1], chan->peer_epoch,
+                            chan->expected_seq, NULL, 0);
+}
+
+// (re)transmits the messages of a reliable channel as needed
+static void link_channel_service(V5_DeviceT device, link_stream_s_t* stream, uint8_t channel) {
+    link_channel_s_t* chan = stream->channels[channel];
+    uint32_t now = millis();
+    uint16_t in_flight = chan->next_seq - chan->base_seq;
+
+    if (in_flight > 0 && now - chan->timer >= chan->rto) {
+        // go-back-N: everything from the oldest unacknowledged message is resent
+        for (uint16_t i = 0; i < in_flight; i++) {
+            link_segment_s_t* seg = &chan->window[(chan->base_slot + i) % chan->config.window];
+            if (seg->transmitted) {
+                seg->transmitted = false;
+                seg->retransmitted = true;
+                chan->stats.retransmits++;
+            }
+        }
+        chan->rto = chan->rto * 2 > RTO_MAX ? RTO_MAX : chan->rto * 2;
+        chan->timer = now;
+    }
+
+    for (uint16_t i = 0; i < in_flight; i++) {
+        link_segment_s_t* seg = &chan->window[(chan->base_slot + i) % chan->config.window];
+        if (seg->transmitted) {
+            continue;
+        }
+        uint8_t kind = i == 0 ? KIND_RELIABLE | SYNC_FLAG : KIND_RELIABLE;
+        if (!_transmit_channel_frame(device, stream, kind, channel, chan->epoch, chan->base_seq + i, seg->data,
+                                     seg->size)) {
+            break;
+        }
+        seg->transmitted = true;
+        seg->sent_at = now;
+    }
+
+    if (now - chan->goodput_time >= 1000) {
+        chan->stats.goodput = (chan->acked_bytes - chan->goodput_bytes) * 1000 / (now - chan->goodput_time);
+        chan->goodput_bytes = chan->acked_bytes;
+        chan->goodput_time = now;
+    }
+}
+
+static void link_stream_parse(uint8_t port, link_stream_s_t* stream) {
+    while (stream->len > 0) {
+        if (stream->buf[0] != START_BYTE) {
+            uint8_t* start = memchr(stream->buf, START_BYTE, stream->len);
+            link_stream_consume(stream, start ? start - stream->buf : stream->len);
+            stream->stats.resyncs++;
+            continue;
+        }
+        if (stream->len < HEADER_SIZE) {
+            return;
+        }
+        uint16_t size = stream->buf[2] | (stream->buf[3] << 8);
+        uint8_t version = stream->buf[1] & ~CHANNEL_FLAG;
+        bool is_channel = stream->buf[1] & CHANNEL_FLAG;
+        uint16_t max_size = is_channel ? LINK_BUFFER_SIZE - PROTOCOL_SIZE : stream->max_size;
+        if (version > LINK_PROTOCOL_VERSION || size > max_size || (is_channel && size < CHANNEL_HEADER_SIZE)) {
+            // not a frame that we can accept, so this can't be a real start byte
+            link_stream_consume(stream, 1);
+            stream->stats.resyncs++;
+            continue;
+        }
+        if (stream->len < size + PROTOCOL_SIZE) {
+            return;
+        }
+        uint16_t received_crc = stream->buf[HEADER_SIZE + size] | (stream->buf[HEADER_SIZE + size + 1] << 8);
+        if (received_crc != crc16(CRC16_INIT, stream->buf, HEADER_SIZE + size)) {
+            link_stream_consume(stream, 1);
+            stream->stats.crc_errors++;
+            continue;
+        }
+
+        peer_versions[port] = version;
+        if (is_channel) {
+            link_channel_receive_frame(port, stream, size);
+        } else {
+            // the size field sits right before the payload, so the frame can be
+            // queued in place as a link_message_s_t
+            link_message_s_t* msg = (link_message_s_t*)(stream->buf + 2);
+            msg->size = size;
+            if (queue_append(stream->messages, msg, 0)) {
+                stream->stats.messages++;
+            } else {
+                stream->stats.dropped++;
+            }
+        }
+        link_stream_consume(stream, size + PROTOCOL_SIZE);
+    }
+}
+
+void link_background_processing(void) {
+    for (uint8_t port = 0; port < NUM_V5_PORTS; port++) {
+        link_stream_s_t* stream = streams[port];
+        if (stream == NULL) {
+            continue;
+        }
+        V5_DeviceT device = registry_get_device(port)->device_info;
+        int32_t avail = vexDeviceGenericRadioReceiveAvail(device);
+        while (avail > 0 && stream->len < sizeof(stream->buf)) {
+            int32_t space = sizeof(stream->buf) - stream->len;
+            int32_t received = vexDeviceGenericRadioReceive(device, stream->buf + stream->len, avail < space ? avail : space);
+            if (received <= 0) {
+                break;
+            }
+            stream->len += received;
+            avail -= received;
+            link_stream_parse(port, stream);
+        }
+        for (uint8_t channel = 0; channel < LINK_MAX_CHANNELS; channel++) {
+            if (stream->channels[channel] != NULL && stream->channels[channel]->config.mode == E_LINK_CHANNEL_RELIABLE) {
+                link_channel_service(device, stream, channel);
+            }
+        }
+    }
+}
+
+uint32_t link_stream_enable(uint8_t port, uint16_t max_size, uint32_t queue_len) {
+    if (max_size == 0 || max_size > LINK_BUFFER_SIZE - PROTOCOL_SIZE || queue_len == 0) {
+        errno = EINVAL;
+        return PROS_ERR;
+    }
+    claim_port_i(port - 1, E_DEVICE_SERIAL);
+    if (streams[port - 1] != NULL) {
+        errno = EEXIST;
         return_port(port - 1, PROS_ERR);
     }
-    return_port(port - 1, rtv);
+    link_stream_s_t* stream = (link_stream_s_t*)kmalloc(sizeof(link_stream_s_t));
+    if (stream == NULL) {
+        errno = ENOMEM;
+        return_port(port - 1, PROS_ERR);
+    }
+    memset(stream, 0, sizeof(*stream));
+    stream->max_size = max_size;
+    stream->read_msg = (link_message_s_t*)kmalloc(sizeof(link_message_s_t) + max_size);
+    stream->messages = queue_create(queue_len, sizeof(link_message_s_t) + max_size);
+    stream->read_mtx = mutex_create();
+    if (!stream->read_msg || !stream->messages || !stream->read_mtx) {
+        if (stream->messages) queue_delete(stream->messages);
+        if (stream->read_mtx) mutex_delete(stream->read_mtx);
+        kfree(stream->read_msg);
+        kfree(stream);
+        errno = ENOMEM;
+        return_port(port - 1, PROS_ERR);
+    }
+    streams[port - 1] = stream;
+    return_port(port - 1, PROS_SUCCESS);
+}
+
+static void link_channel_free(link_channel_s_t* chan) {
+    if (chan->window) {
+        for (uint8_t i = 0; i < chan->config.window; i++) {
+            kfree(chan->window[i].data);
+        }
+        kfree(chan->window);
+    }
+    if (chan->window_free) sem_delete(chan->window_free);
+    if (chan->messages) queue_delete(chan->messages);
+    if (chan->read_mtx) mutex_delete(chan->read_mtx);
+    kfree(chan->read_msg);
+    kfree(chan);
+}
+
+static void link_stream_free(link_stream_s_t* stream) {
+    queue_delete(stream->messages);
+    mutex_delete(stream->read_mtx);
+    kfree(stream->read_msg);
+    kfree(stream);
+}
+
+/**
+ * Marks a channel as closing and wakes the tasks waiting on it. The caller must
+ * hold the port mutex and have made the channel unreachable from streams.
+ *
+ * \return True if tasks are still using the channel, in which case the last
+ * of them frees it, and false if the caller must free it.
+ */
+static bool link_channel_shut(link_stream_s_t* stream, link_channel_s_t* chan) {
+    chan->closing = true;
+    if (chan->users == 0) {
+        return false;
+    }
+    // a receiver blocked on the queue gets a message saying so, and a sender
+    // blocked on the window gets a slot, which it passes on to the next one.
+    // tx_frame is only used while holding the port mutex, so it can hold the
+    // message until it is copied into the queue
+    link_message_s_t* closed = (link_message_s_t*)stream->tx_frame;
+    closed->size = LINK_MESSAGE_CLOSED;
+    queue_reset(chan->messages);
+    queue_append(chan->messages, closed, 0);
+    if (chan->window_free) sem_post(chan->window_free);
+    return true;
+}
+
+uint32_t link_stream_disable(uint8_t port) {
+    claim_port_i(port - 1, E_DEVICE_SERIAL);
+    link_stream_s_t* stream = streams[port - 1];
+    if (stream == NULL) {
+        errno = EINVAL;
+        return_port(port - 1, PROS_ERR);
+    }
+    streams[port - 1] = NULL;
+    // channels nobody is using, freed once the port is given back. The stream
+    // itself may be freed by its last reader by then
+    link_channel_s_t* unused[LINK_MAX_CHANNELS] = {NULL};
+    for (uint8_t channel = 0; channel < LINK_MAX_CHANNELS; channel++) {
+        link_channel_s_t* chan = stream->channels[channel];
+        if (chan != NULL && !link_channel_shut(stream, chan)) {
+            unused[channel] = chan;
+        }
+    }
+    stream->closing = true;
+    const bool in_use = stream->readers > 0;
+    if (in_use) {
+        // wake a reader blocked on the queue. Readers waiting for read_mtx check
+        // closing once they get it. The system daemon is done with buf since the
+        // stream is no longer in streams
+        link_message_s_t* closed = (link_message_s_t*)(stream->buf + 2);
+        closed->size = LINK_MESSAGE_CLOSED;
+        queue_reset(stream->messages);
+        queue_append(stream->messages, closed, 0);
+    }
+    port_mutex_give(port - 1);
+
+    for (uint8_t channel = 0; channel < LINK_MAX_CHANNELS; channel++) {
+        if (unused[channel] != NULL) {
+            link_channel_free(unused[channel]);
+        }
+    }
+    if (!in_use) {
+        link_stream_free(stream);
+    }
+    return PROS_SUCCESS;
+}
+
+// drops a reader's hold on a stream, freeing it if the stream was disabled and
+// this was the last reader
+static void link_stream_release(uint8_t port, link_stream_s_t* stream) {
+    port_mutex_take(port - 1);
+    const bool last = --stream->readers == 0 && stream->closing;
+    port_mutex_give(port - 1);
+    if (last) {
+        link_stream_free(stream);
+    }
+}
+
+uint32_t link_receive_message(uint8_t port, void* dest, uint16_t dest_size, uint32_t timeout) {
+    if (dest == NULL || !VALIDATE_PORT_NO(port - 1)) {
+        errno = EINVAL;
+        return PROS_ERR;
+    }
+    if (!port_mutex_take(port - 1)) {
+        errno = EACCES;
+        return PROS_ERR;
+    }
+    link_stream_s_t* stream = streams[port - 1];
+    if (stream == NULL) {
+        port_mutex_give(port - 1);
+        errno = EINVAL;
+        return PROS_ERR;
+    }
+    stream->readers++;
+    // the port mutex isn't held while waiting so that the background processing
+    // can keep filling the queue
+    port_mutex_give(port - 1);
+
+    uint32_t rtv = PROS_ERR;
+    mutex_take(stream->read_mtx, TIMEOUT_MAX);
+    if (stream->closing) {
+        errno = EINVAL;
+    } else if (!queue_recv(stream->messages, stream->read_msg, timeout)) {
+        errno = EAGAIN;
+    } else if (stream->read_msg->size == LINK_MESSAGE_CLOSED) {
+        errno = EINVAL;
+    } else {
+        uint16_t size = stream->read_msg->size;
+        memcpy(dest, stream->read_msg->data, size < dest_size ? size : dest_size);
+        rtv = size;
+    }
+    mutex_give(stream->read_mtx);
+    link_stream_release(port, stream);
+    return rtv;
+}
+
+uint32_t link_get_stats(uint8_t port, link_stats_s_t* stats) {
+    claim_port_i(port - 1, E_DEVICE_SERIAL);
+    if (streams[port - 1] == NULL) {
+        errno = EINVAL;
+        return_port(port - 1, PROS_ERR);
+    }
+    *stats = streams[port - 1]->stats;
+    return_port(port - 1, PROS_SUCCESS);
+}
+
+uint32_t link_channel_open(uint8_t port, uint8_t channel, const link_channel_config_s_t* config) {
+    if (channel >= LINK_MAX_CHANNELS || config == NULL ||
+        (config->mode != E_LINK_CHANNEL_RELIABLE && config->mode != E_LINK_CHANNEL_LATEST) || config->max_size == 0 ||
+        config->max_size > LINK_MAX_CHANNEL_MESSAGE_SIZE ||
+        (config->mode == E_LINK_CHANNEL_RELIABLE &&
+         (config->window == 0 || config->window > LINK_MAX_WINDOW || config->queue_len == 0))) {
+        errno = EINVAL;
+        return PROS_ERR;
+    }
+    claim_port_i(port - 1, E_DEVICE_SERIAL);
+    link_stream_s_t* stream = streams[port - 1];
+    if (stream == NULL) {
+        errno = EINVAL;
+        return_port(port - 1, PROS_ERR);
+    }
+    if (stream->channels[channel] != NULL) {
+        errno = EEXIST;
+        return_port(port - 1, PROS_ERR);
+    }
+
+    link_channel_s_t* chan = (link_channel_s_t*)kmalloc(sizeof(link_channel_s_t));
+    if (chan == NULL) {
+        errno = ENOMEM;
+        return_port(port - 1, PROS_ERR);
+    }
+    memset(chan, 0, sizeof(*chan));
+    chan->config = *config;
+    bool ok = true;
+    if (config->mode == E_LINK_CHANNEL_RELIABLE) {
+        chan->window = (link_segment_s_t*)kmalloc(config->window * sizeof(link_segment_s_t));
+        if (chan->window) {
+            memset(chan->window, 0, config->window * sizeof(link_segment_s_t));
+            for (uint8_t i = 0; i < config->window; i++) {
+                chan->window[i].data = (uint8_t*)kmalloc(config->max_size);
+                ok &= chan->window[i].data != NULL;
+            }
+        }
+        chan->window_free = sem_create(config->window, config->window);
+        chan->messages = queue_create(config->queue_len, sizeof(link_message_s_t) + config->max_size);
+        ok &= chan->window && chan->window_free;
+    } else {
+        chan->messages = queue_create(1, sizeof(link_message_s_t) + config->max_size);
+    }
+    chan->read_mtx = mutex_create();
+    chan->read_msg = (link_message_s_t*)kmalloc(sizeof(link_message_s_t) + config->max_size);
+    if (!ok || !chan->messages || !chan->read_mtx || !chan->read_msg) {
+        link_channel_free(chan);
+        errno = ENOMEM;
+        return_port(port - 1, PROS_ERR);
+    }
+    chan->rto = RTO_INITIAL;
+    chan->goodput_time = millis();
+    // the time of opening differs from one run of a program to the next, so a
+    // restarted robot is very unlikely to reuse the epoch the other one knows
+    chan->epoch = micros() & 0xffff;
+    if (chan->epoch == 0) chan->epoch = 1;
+
+    stream->channels[channel] = chan;
+    return_port(port - 1, PROS_SUCCESS);
+}
+
+uint32_t link_channel_close(uint8_t port, uint8_t channel) {
+    if (channel >= LINK_MAX_CHANNELS) {
+        errno = EINVAL;
+        return PROS_ERR;
+    }
+    claim_port_i(port - 1, E_DEVICE_SERIAL);
+    link_stream_s_t* stream = streams[port - 1];
+    link_channel_s_t* chan = stream ? stream->channels[channel] : NULL;
+    if (chan == NULL) {
+        errno = EINVAL;
+        return_port(port - 1, PROS_ERR);
+    }
+    stream->channels[channel] = NULL;
+    const bool in_use = link_channel_shut(stream, chan);
+    port_mutex_give(port - 1);
+
+    if (!in_use) {
+        link_channel_free(chan);
+    }
+    return PROS_SUCCESS;
+}
+
+/**
+ * Gets an open channel for a function that may block without the port mutex.
+ * The channel stays allocated until the matching link_channel_release(), even
+ * if it is closed in the meantime.
+ *
+ * \return The channel, or NULL with errno set if it isn't open.
+ */
+static link_channel_s_t* link_channel_acquire(uint8_t port, uint8_t channel) {
+    if (!VALIDATE_PORT_NO(port - 1) || channel >= LINK_MAX_CHANNELS) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!port_mutex_take(port - 1)) {
+        errno = EACCES;
+        return NULL;
+    }
+    link_channel_s_t* chan = streams[port - 1] ? streams[port - 1]->channels[channel] : NULL;
+    if (chan == NULL) {
+        errno = EINVAL;
+    } else {
+        chan->users++;
+    }
+    port_mutex_give(port - 1);
+    return chan;
+}
+
+// drops a task's hold on a channel, freeing it if the channel was closed and
+// this was the last user
+static void link_channel_release(uint8_t port, link_channel_s_t* chan) {
+    port_mutex_take(port - 1);
+    const bool last = --chan->users == 0 && chan->closing;
+    port_mutex_give(port - 1);
+    if (last) {
+        link_channel_free(chan);
+    }
+}
+
+static uint32_t _link_channel_send(uint8_t port, uint8_t channel, link_channel_s_t* chan, const void* data,
+                                   uint16_t data_size, uint32_t timeout) {
+    bool reliable = chan->config.mode == E_LINK_CHANNEL_RELIABLE;
+    if (reliable && !sem_wait(chan->window_free, timeout)) {
+        errno = EBUSY;
+        return PROS_ERR;
+    }
+    if (!claim_port_try(port - 1, E_DEVICE_SERIAL)) {
+        if (reliable) sem_post(chan->window_free);
+        return PROS_ERR;
+    }
+    if (chan->closing) {
+        // pass the wakeup on to the next sender blocked on the window
+        if (reliable) sem_post(chan->window_free);
+        errno = EINVAL;
+        return_port(port - 1, PROS_ERR);
+    }
+    v5_smart_device_s_t* device = registry_get_device(port - 1);
+    link_stream_s_t* stream = streams[port - 1];
+
+    if (chan->config.mode == E_LINK_CHANNEL_LATEST) {
+        if (!_transmit_channel_frame(device->device_info, stream, KIND_LATEST, channel, chan->epoch, chan->next_seq,
+                                     data, data_size)) {
+            errno = EBUSY;
+            return_port(port - 1, PROS_ERR);
+        }
+        chan->next_seq++;
+        chan->stats.sent++;
+        return_port(port - 1, data_size);
+    }
+
+    uint16_t in_flight = chan->next_seq - chan->base_seq;
+    link_segment_s_t* seg = &chan->window[(chan->base_slot + in_flight) % chan->config.window];
+    memcpy(seg->data, data, data_size);
+    seg->size = data_size;
+    seg->retransmitted = false;
+    seg->transmitted = false;
+    if (in_flight == 0) {
+        chan->timer = millis();
+    }
+    chan->next_seq++;
+    chan->stats.sent++;
+    // send it right away if nothing older is waiting, otherwise the background
+    // processing sends it in order
+    if (in_flight == 0 || chan->window[(chan->base_slot + in_flight - 1) % chan->config.window].transmitted) {
+        uint8_t kind = in_flight == 0 ? KIND_RELIABLE | SYNC_FLAG : KIND_RELIABLE;
+        if (_transmit_channel_frame(device->device_info, stream, kind, channel, chan->epoch, chan->next_seq - 1, data,
+                                    data_size)) {
+            seg->transmitted = true;
+            seg->sent_at = millis();
+        }
+    }
+    return_port(port - 1, data_size);
+}
+
+uint32_t link_channel_send(uint8_t port, uint8_t channel, const void* data, uint16_t data_size, uint32_t timeout) {
+    link_channel_s_t* chan = link_channel_acquire(port, channel);
+    if (chan == NULL) {
+        return PROS_ERR;
+    }
+    uint32_t rtv = PROS_ERR;
+    if (data == NULL || data_size > chan->config.max_size) {
+        errno = EINVAL;
+    } else {
+        rtv = _link_channel_send(port, channel, chan, data, data_size, timeout);
+    }
+    link_channel_release(port, chan);
+    return rtv;
+}
+
+uint32_t link_channel_receive(uint8_t port, uint8_t channel, void* dest, uint16_t dest_size, uint32_t timeout) {
+    if (dest == NULL) {
+        errno = EINVAL;
+        return PROS_ERR;
+    }
+    link_channel_s_t* chan = link_channel_acquire(port, channel);
+    if (chan == NULL) {
+        return PROS_ERR;
+    }
+    uint32_t rtv = PROS_ERR;
+    mutex_take(chan->read_mtx, TIMEOUT_MAX);
+    if (chan->closing) {
+        errno = EINVAL;
+    } else if (!queue_recv(chan->messages, chan->read_msg, timeout)) {
+        errno = EAGAIN;
+    } else if (chan->read_msg->size == LINK_MESSAGE_CLOSED) {
+        errno = EINVAL;
+    } else {
+        uint16_t size = chan->read_msg->size;
+        memcpy(dest, chan->read_msg->data, size < dest_size ? size : dest_size);
+        rtv = size;
+    }
+    mutex_give(chan->read_mtx);
+    link_channel_release(port, chan);
+    return rtv;
+}
+
+uint32_t link_channel_get_stats(uint8_t port, uint8_t channel, link_channel_stats_s_t* stats) {
+    if (channel >= LINK_MAX_CHANNELS || stats == NULL) {
+        errno = EINVAL;
+        return PROS_ERR;
+    }
+    claim_port_i(port - 1, E_DEVICE_SERIAL);
+    link_channel_s_t* chan = streams[port - 1] ? streams[port - 1]->channels[channel] : NULL;
+    if (chan == NULL) {
+        errno = EINVAL;
+        return_port(port - 1, PROS_ERR);
+    }
+    *stats = chan->stats;
+    stats->rtt = chan->srtt;
+    stats->rtt_var = chan->rttvar;
+    stats->rto = chan->rto;
+    return_port(port - 1, PROS_SUCCESS);
+}
+
+uint32_t link_get_peer_version(uint8_t port) {
+    if(!VALIDATE_PORT_NO(port - 1)) {
+        errno = ENXIO;
+        return PROS_ERR;
+    }
+    return peer_versions[port - 1];
 }
 
 uint32_t link_clear_receive_buf(uint8_t port) {
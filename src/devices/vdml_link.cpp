@@ -54,4 +54,73 @@ namespace pros {
     std::uint32_t Link::clear_receive_buf() {
         return pros::c::link_clear_receive_buf(_port);
     }
+
+    std::uint32_t Link::get_peer_version() {
+        return pros::c::link_get_peer_version(_port);
+    }
+
+    std::uint32_t Link::stream_enable(std::uint16_t max_size, std::uint32_t queue_len) {
+        return pros::c::link_stream_enable(_port, max_size, queue_len);
+    }
+
+    std::uint32_t Link::stream_disable() {
+        return pros::c::link_stream_disable(_port);
+    }
+
+    std::uint32_t Link::receive_message(void* dest, std::uint16_t dest_size, std::uint32_t timeout) {
+        return pros::c::link_receive_message(_port, dest, dest_size, timeout);
+    }
+
+    link_stats_s_t Link::get_stats() {
+        link_stats_s_t stats = {};
+        pros::c::link_get_stats(_port, &stats);
+        return stats;
+    }
+
+    std::uint32_t Link::channel_open(std::uint8_t channel, const link_channel_config_s_t& config) {
+        return pros::c::link_channel_open(_port, channel, &config);
+    }
+
+    std::uint32_t Link::channel_close(std::uint8_t channel) {
+        return pros::c::link_channel_close(_port, channel);
+    }
+
+    std::uint32_t Link::channel_send(std::uint8_t channel, const void* data, std::uint16_t data_size,
+                                     std::uint32_t timeout) {
+        return pros::c::link_channel_send(_port, channel, data, data_size, timeout);
+    }
+
+    std::uint32_t Link::channel_receive(std::uint8_t channel, void* dest, std::uint16_t dest_size,
+                                        std::uint32_t timeout) {
+        return pros::c::link_channel_receive(_port, channel, dest, dest_size, timeout);
+    }
+
+    link_channel_stats_s_t Link::channel_get_stats(std::uint8_t channel) {
+        link_channel_stats_s_t stats = {};
+        pros::c::link_channel_get_stats(_port, channel, &stats);
+        return stats;
+    }
+
+    std::uint32_t Link::topics_start(std::uint8_t channel, std::uint32_t period, std::uint32_t budget) {
+        return pros::c::link_topics_start(_port, channel, period, budget);
+    }
+
+    std::uint32_t Link::topic_register(std::uint8_t topic, std::uint8_t size, std::uint8_t priority,
+                                       std::uint16_t refresh) {
+        return pros::c::link_topic_register(_port, topic, size, priority, refresh);
+    }
+
+    std::uint32_t Link::topic_publish(std::uint8_t topic, const void* value) {
+        return pros::c::link_topic_publish(_port, topic, value);
+    }
+
+    std::uint32_t Link::topic_read(std::uint8_t topic, void* dest, std::uint32_t* age) {
+        return pros::c::link_topic_read(_port, topic, dest, age);
+    }
+
+    link_topic_stats_s_t Link::topic_get_stats(std::uint8_t topic) {
+        link_topic_stats_s_t stats = {};
+        pros::c::link_topic_get_stats(_port, topic, &stats);
+        return stats;
+    }
 }
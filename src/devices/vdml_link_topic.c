@@ -0,0 +1,330 @@
+/**
+ * \file devices/vdml_link_topic.c
+ *
+ * Contains source code for publish/subscribe topics over VEXlink.
+ *
+ * Topics are fixed size values identified by a small number. Publishing only
+ * records the newest value of a topic. Every period, a daemon packs the topics
+ * that changed since they were last sent into a single message on a latest
+ * value channel (see link_channel_open), highest priority first and within the
+ * bandwidth budget. Topics that don't fit wait for the next period, and any
+ * value published in the meantime replaces theirs, so the radio only ever
+ * carries the newest value of each changed topic. Topics with a refresh period
+ * are resent even when unchanged so that receivers recover from lost messages.
+ *
+ * Each message is a sequence of records:
+ *
+ *   topic (1) | size (1) | value
+ *
+ * Received values are kept in a per-topic cache which link_topic_read() reads.
+ *
+ * Visit https://pros.cs.purdue.edu/v5/api/c/link.html to learn
+ * more.
+ *
+ * This file should not be modified by users, since it gets replaced whenever
+ * a kernel upgrade occurs.
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <string.h>
+
+#include "kapi.h"
+#include "pros/link.h"
+
+#define RECORD_HEADER_SIZE 2
+// framing and channel overhead of every message, counted against the budget
+#define MESSAGE_OVERHEAD 12
+
+_Static_assert(LINK_MAX_TOPICS <= 32, "topic_pack() records the packed topics in a uint32_t");
+
+typedef struct link_topic {
+	uint8_t size;
+	uint8_t priority;
+	uint16_t refresh;
+	bool dirty;
+	bool cached;
+	uint32_t last_sent;
+	uint32_t received_at;
+	uint8_t* value;  // newest published value
+	uint8_t* cache;  // newest received value
+	link_topic_stats_s_t stats;
+} link_topic_s_t;
+
+static struct {
+	uint8_t port;  // 0 when not started
+	uint8_t channel;
+	uint32_t period;
+	uint32_t budget;  // bytes per second
+	int32_t tokens;   // bytes that may be sent right now
+	mutex_t mtx;      // protects topics
+	link_topic_s_t* topics[LINK_MAX_TOPICS];
+	uint8_t msg[LINK_MAX_CHANNEL_MESSAGE_SIZE];
+} topic_link;
+
+static task_stack_t topic_daemon_stack[TASK_STACK_DEPTH_MIN];
+static static_task_s_t topic_daemon_task_buffer;
+
+static void topic_unpack(uint16_t size) {
+	uint32_t now = millis();
+	mutex_take(topic_link.mtx, TIMEOUT_MAX);
+	for (uint16_t i = 0; i + RECORD_HEADER_SIZE <= size;) {
+		uint8_t id = topic_link.msg[i];
+		uint8_t len = topic_link.msg[i + 1];
+		i += RECORD_HEADER_SIZE;
+		if (i + len > size) {
+			break;
+		}
+		link_topic_s_t* topic = id < LINK_MAX_TOPICS ? topic_link.topics[id] : NULL;
+		if (topic != NULL) {
+			if (len == topic->size) {
+				memcpy(topic->cache, topic_link.msg + i, len);
+				topic->cached = true;
+				topic->received_at = now;
+				topic->stats.received++;
+			} else {
+				topic->stats.mismatched++;
+			}
+		}
+		i += len;
+	}
+	mutex_give(topic_link.mtx);
+}
+
+// packs changed topics into topic_link.msg by priority, returning the size.
+// the packed topics are marked clean and recorded in packed, for topic_settle()
+// to deal with once the message has been sent or not
+static uint16_t topic_pack(uint32_t* packed) {
+	uint32_t now = millis();
+	uint16_t size = 0;
+	*packed = 0;
+	mutex_take(topic_link.mtx, TIMEOUT_MAX);
+	for (uint8_t id = 0; id < LINK_MAX_TOPICS; id++) {
+		link_topic_s_t* topic = topic_link.topics[id];
+		if (topic && !topic->dirty && topic->refresh && now - topic->last_sent >= topic->refresh) {
+			topic->dirty = true;
+		}
+	}
+	while (true) {
+		// the highest priority changed topic, and among those the one that has
+		// waited the longest
+		link_topic_s_t* next = NULL;
+		uint8_t next_id = 0;
+		for (uint8_t id = 0; id < LINK_MAX_TOPICS; id++) {
+			link_topic_s_t* topic = topic_link.topics[id];
+			if (topic == NULL || !topic->dirty) continue;
+			if (next == NULL || topic->priority > next->priority ||
+			    (topic->priority == next->priority && (int32_t)(topic->last_sent - next->last_sent) < 0)) {
+				next = topic;
+				next_id = id;
+			}
+		}
+		int32_t cost = next ? RECORD_HEADER_SIZE + next->size + (size == 0 ? MESSAGE_OVERHEAD : 0) : 0;
+		if (next == NULL || size + RECORD_HEADER_SIZE + next->size > sizeof(topic_link.msg) ||
+		    cost > topic_link.tokens) {
+			break;
+		}
+		topic_link.msg[size] = next_id;
+		topic_link.msg[size + 1] = next->size;
+		memcpy(topic_link.msg + size + RECORD_HEADER_SIZE, next->value, next->size);
+		size += RECORD_HEADER_SIZE + next->size;
+		topic_link.tokens -= cost;
+		next->dirty = false;
+		*packed |= 1u << next_id;
+	}
+	mutex_give(topic_link.mtx);
+	return size;
+}
+
+// accounts for the topics of a packed message once it has been sent, or marks
+// them changed again so that the next period retries them if it wasn't
+static void topic_settle(uint32_t packed, bool sent) {
+	uint32_t now = millis();
+	mutex_take(topic_link.mtx, TIMEOUT_MAX);
+	for (uint8_t id = 0; id < LINK_MAX_TOPICS; id++) {
+		link_topic_s_t* topic = topic_link.topics[id];
+		if (topic == NULL || !(packed & (1u << id))) continue;
+		if (sent) {
+			topic->last_sent = now;
+			topic->stats.sent++;
+		} else {
+			topic->dirty = true;
+		}
+	}
+	mutex_give(topic_link.mtx);
+}
+
+static void topic_daemon_task(void* ign) {
+	uint32_t next_tick = millis();
+	while (true) {
+		int32_t remaining;
+		while ((remaining = (int32_t)(next_tick - millis())) > 0) {
+			uint32_t size = link_channel_receive(topic_link.port, topic_link.channel, topic_link.msg,
+			                                     sizeof(topic_link.msg), remaining);
+			if (size != PROS_ERR) {
+				topic_unpack(size < sizeof(topic_link.msg) ? size : sizeof(topic_link.msg));
+			}
+		}
+		next_tick += topic_link.period;
+
+		// the bucket holds at most one period's worth of budget plus one full
+		// message, so idle periods can't save up for a burst
+		int32_t refill = topic_link.budget * topic_link.period / 1000;
+		topic_link.tokens += refill;
+		if (topic_link.tokens > refill + (int32_t)sizeof(topic_link.msg) + MESSAGE_OVERHEAD) {
+			topic_link.tokens = refill + sizeof(topic_link.msg) + MESSAGE_OVERHEAD;
+		}
+
+		uint32_t packed;
+		uint16_t size = topic_pack(&packed);
+		if (size > 0) {
+			bool sent = link_channel_send(topic_link.port, topic_link.channel, topic_link.msg, size, 0) != PROS_ERR;
+			topic_settle(packed, sent);
+			if (!sent) {
+				// nothing went out, so nothing is charged against the budget
+				topic_link.tokens += size + MESSAGE_OVERHEAD;
+			}
+		}
+	}
+}
+
+uint32_t link_topics_start(uint8_t port, uint8_t channel, uint32_t period, uint32_t budget) {
+	if (period == 0 || budget == 0) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	if (topic_link.port != 0) {
+		errno = EEXIST;
+		return PROS_ERR;
+	}
+	link_channel_config_s_t config = {
+	    .mode = E_LINK_CHANNEL_LATEST, .max_size = LINK_MAX_CHANNEL_MESSAGE_SIZE, .window = 0, .queue_len = 0};
+	if (link_channel_open(port, channel, &config) == PROS_ERR) {
+		return PROS_ERR;
+	}
+	topic_link.mtx = mutex_create();
+	if (topic_link.mtx == NULL) {
+		link_channel_close(port, channel);
+		errno = ENOMEM;
+		return PROS_ERR;
+	}
+	topic_link.channel = channel;
+	topic_link.period = period;
+	topic_link.budget = budget;
+	topic_link.port = port;
+	if (task_create_static(topic_daemon_task, NULL, TASK_PRIORITY_DEFAULT + 1, TASK_STACK_DEPTH_MIN,
+	                       "Link Topics (PROS)", topic_daemon_stack, &topic_daemon_task_buffer) == NULL) {
+		// leave topic_link as if topics were never started, so they can be again
+		mutex_delete(topic_link.mtx);
+		memset(&topic_link, 0, sizeof(topic_link));
+		link_channel_close(port, channel);
+		return PROS_ERR;
+	}
+	return PROS_SUCCESS;
+}
+
+static link_topic_s_t* _get_topic(uint8_t port, uint8_t topic) {
+	if (topic_link.port == 0 || port != topic_link.port || topic >= LINK_MAX_TOPICS) {
+		errno = EINVAL;
+		return NULL;
+	}
+	link_topic_s_t* t = topic_link.topics[topic];
+	if (t == NULL) {
+		errno = EINVAL;
+	}
+	return t;
+}
+
+uint32_t link_topic_register(uint8_t port, uint8_t topic, uint8_t size, uint8_t priority, uint16_t refresh) {
+	if (topic_link.port == 0 || port != topic_link.port || topic >= LINK_MAX_TOPICS || size == 0) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	link_topic_s_t* t = (link_topic_s_t*)kmalloc(sizeof(link_topic_s_t));
+	uint8_t* value = (uint8_t*)kmalloc(size);
+	uint8_t* cache = (uint8_t*)kmalloc(size);
+	if (!t || !value || !cache) {
+		kfree(t);
+		kfree(value);
+		kfree(cache);
+		errno = ENOMEM;
+		return PROS_ERR;
+	}
+	memset(t, 0, sizeof(*t));
+	memset(value, 0, size);
+	t->size = size;
+	t->priority = priority;
+	t->refresh = refresh;
+	t->value = value;
+	t->cache = cache;
+
+	mutex_take(topic_link.mtx, TIMEOUT_MAX);
+	if (topic_link.topics[topic] != NULL) {
+		mutex_give(topic_link.mtx);
+		kfree(t);
+		kfree(value);
+		kfree(cache);
+		errno = EEXIST;
+		return PROS_ERR;
+	}
+	topic_link.topics[topic] = t;
+	mutex_give(topic_link.mtx);
+	return PROS_SUCCESS;
+}
+
+uint32_t link_topic_publish(uint8_t port, uint8_t topic, const void* value) {
+	link_topic_s_t* t = _get_topic(port, topic);
+	if (t == NULL || value == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	mutex_take(topic_link.mtx, TIMEOUT_MAX);
+	t->stats.published++;
+	// the first value is always sent, even if it matches the zeroed initial one
+	if (t->stats.published == 1 || memcmp(t->value, value, t->size) != 0) {
+		if (t->dirty) {
+			// the previous value never made it onto the radio
+			t->stats.coalesced++;
+		}
+		memcpy(t->value, value, t->size);
+		t->dirty = true;
+	}
+	mutex_give(topic_link.mtx);
+	return PROS_SUCCESS;
+}
+
+uint32_t link_topic_read(uint8_t port, uint8_t topic, void* dest, uint32_t* age) {
+	link_topic_s_t* t = _get_topic(port, topic);
+	if (t == NULL || dest == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	mutex_take(topic_link.mtx, TIMEOUT_MAX);
+	if (!t->cached) {
+		mutex_give(topic_link.mtx);
+		errno = EAGAIN;
+		return PROS_ERR;
+	}
+	memcpy(dest, t->cache, t->size);
+	if (age != NULL) {
+		*age = millis() - t->received_at;
+	}
+	mutex_give(topic_link.mtx);
+	return t->size;
+}
+
+uint32_t link_topic_get_stats(uint8_t port, uint8_t topic, link_topic_stats_s_t* stats) {
+	link_topic_s_t* t = _get_topic(port, topic);
+	if (t == NULL || stats == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	mutex_take(topic_link.mtx, TIMEOUT_MAX);
+	*stats = t->stats;
+	mutex_give(topic_link.mtx);
+	return PROS_SUCCESS;
+}
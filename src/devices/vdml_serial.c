@@ -13,7 +13,9 @@
 #include <errno.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 
+#include "common/frame.h"
 #include "kapi.h"
 #include "pros/serial.h"
 #include "v5_api.h"
@@ -109,3 +111,225 @@ int32_t serial_write(uint8_t port, uint8_t* buffer, int32_t length) {
 	}
 	return_port(port - 1, rtn);
 }
+
+// Framed mode
+
+typedef struct serial_frame_item {
+	uint32_t len;
+	// the decoder writes the frame identifier here and the payload right after it,
+	// so decoded frames can be queued without another copy
+	uint32_t id;
+	uint8_t data[];
+} serial_frame_item_s_t;
+
+typedef struct serial_framer {
+	frame_decoder_s_t decoder;
+	serial_frame_item_s_t* rx_item;    // decode target, only used by the system daemon
+	serial_frame_item_s_t* read_item;  // receive target, protected by read_mtx
+	uint8_t* tx_payload;               // protected by the port mutex
+	uint8_t* tx_buf;                   // protected by the port mutex
+	uint32_t max_len;
+	uint8_t crc_size;
+	queue_t frames;
+	mutex_t read_mtx;
+	uint32_t dropped;
+	// serial_frame_read() calls using the framer. They wait without the port
+	// mutex, so serial_frame_disable() leaves freeing the framer to the last one
+	uint32_t readers;  // protected by the port mutex
+	bool closing;
+} serial_framer_s_t;
+
+// entries are only created or destroyed while holding the port's mutex, which
+// the system daemon also holds during serial_frame_background_processing (see
+// do_background_operations). Every access must hold the port's mutex
+static serial_framer_s_t* framers[NUM_V5_PORTS];
+
+// a queued item with this length tells serial_frame_read() that the port left
+// framed mode
+#define SERIAL_FRAME_CLOSED UINT32_MAX
+
+static void serial_framer_free(serial_framer_s_t* framer) {
+	if (framer->frames) queue_delete(framer->frames);
+	if (framer->read_mtx) mutex_delete(framer->read_mtx);
+	kfree(framer->rx_item);
+	kfree(framer->read_item);
+	kfree(framer->tx_payload);
+	kfree(framer->tx_buf);
+	kfree(framer);
+}
+
+void serial_frame_background_processing(void) {
+	static uint8_t chunk[64];
+	for (uint8_t port = 0; port < NUM_V5_PORTS; port++) {
+		serial_framer_s_t* framer = framers[port];
+		if (framer == NULL) {
+			continue;
+		}
+		V5_DeviceT device = registry_get_device(port)->device_info;
+		int32_t len;
+		while ((len = vexDeviceGenericSerialReceive(device, chunk, sizeof(chunk))) > 0) {
+			for (int32_t i = 0; i < len; i++) {
+				if (frame_decode_byte(&framer->decoder, chunk[i])) {
+					framer->rx_item->len = framer->decoder.len;
+					if (!queue_append(framer->frames, framer->rx_item, 0)) {
+						framer->dropped++;
+					}
+				}
+			}
+		}
+	}
+}
+
+int32_t serial_frame_enable(uint8_t port, uint32_t max_len, uint32_t queue_len, serial_frame_crc_e_t crc) {
+	if (max_len == 0 || queue_len == 0 || (crc != E_SERIAL_FRAME_CRC16 && crc != E_SERIAL_FRAME_CRC32)) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	claim_port_i(port - 1, E_DEVICE_SERIAL);
+	if (framers[port - 1] != NULL) {
+		errno = EEXIST;
+		return_port(port - 1, PROS_ERR);
+	}
+
+	size_t item_size = sizeof(serial_frame_item_s_t) + max_len;
+	size_t decode_size = FRAME_DECODE_BUFFER_SIZE(max_len, crc);
+	serial_framer_s_t* framer = (serial_framer_s_t*)kmalloc(sizeof(serial_framer_s_t));
+	if (framer == NULL) {
+		errno = ENOMEM;
+		return_port(port - 1, PROS_ERR);
+	}
+	memset(framer, 0, sizeof(*framer));
+	// the crc lands after the payload in rx_item, but isn't copied into the queue
+	framer->rx_item = (serial_frame_item_s_t*)kmalloc(item_size + crc);
+	framer->read_item = (serial_frame_item_s_t*)kmalloc(item_size);
+	framer->tx_payload = (uint8_t*)kmalloc(max_len + crc);
+	framer->tx_buf = (uint8_t*)kmalloc(FRAME_ENCODE_MEASURE_MAX(max_len, crc));
+	framer->frames = queue_create(queue_len, item_size);
+	framer->read_mtx = mutex_create();
+	if (!framer->rx_item || !framer->read_item || !framer->tx_payload || !framer->tx_buf || !framer->frames ||
+	    !framer->read_mtx) {
+		serial_framer_free(framer);
+		errno = ENOMEM;
+		return_port(port - 1, PROS_ERR);
+	}
+	framer->max_len = max_len;
+	framer->crc_size = crc;
+	frame_decoder_init(&framer->decoder, (uint8_t*)&framer->rx_item->id, decode_size, crc);
+
+	framers[port - 1] = framer;
+	return_port(port - 1, PROS_SUCCESS);
+}
+
+int32_t serial_frame_disable(uint8_t port) {
+	claim_port_i(port - 1, E_DEVICE_SERIAL);
+	serial_framer_s_t* framer = framers[port - 1];
+	if (framer == NULL) {
+		errno = EINVAL;
+		return_port(port - 1, PROS_ERR);
+	}
+	framers[port - 1] = NULL;
+	framer->closing = true;
+	const bool in_use = framer->readers > 0;
+	if (in_use) {
+		// wake a reader blocked on the queue. Readers waiting for read_mtx check
+		// closing once they get it. The system daemon is done with rx_item since
+		// the framer is no longer in framers
+		queue_reset(framer->frames);
+		framer->rx_item->len = SERIAL_FRAME_CLOSED;
+		queue_append(framer->frames, framer->rx_item, 0);
+	}
+	port_mutex_give(port - 1);
+
+	if (!in_use) {
+		serial_framer_free(framer);
+	}
+	return PROS_SUCCESS;
+}
+
+int32_t serial_frame_write(uint8_t port, uint32_t id, const uint8_t* buffer, uint32_t length) {
+	claim_port_i(port - 1, E_DEVICE_SERIAL);
+	serial_framer_s_t* framer = framers[port - 1];
+	if (framer == NULL || length > framer->max_len) {
+		errno = EINVAL;
+		return_port(port - 1, PROS_ERR);
+	}
+
+	memcpy(framer->tx_payload, buffer, length);
+	size_t frame_len = frame_encode(framer->tx_buf, id, framer->tx_payload, length, framer->crc_size);
+	if (vexDeviceGenericSerialWriteFree(device->device_info) < (int32_t)frame_len) {
+		errno = EAGAIN;
+		return_port(port - 1, PROS_ERR);
+	}
+	if (vexDeviceGenericSerialTransmit(device->device_info, framer->tx_buf, frame_len) == -1) {
+		errno = EIO;
+		return_port(port - 1, PROS_ERR);
+	}
+	return_port(port - 1, length);
+}
+
+// drops a reader's hold on a framer, freeing it if the port left framed mode
+// and this was the last reader
+static void serial_framer_release(uint8_t port, serial_framer_s_t* framer) {
+	port_mutex_take(port - 1);
+	const bool last = --framer->readers == 0 && framer->closing;
+	port_mutex_give(port - 1);
+	if (last) {
+		serial_framer_free(framer);
+	}
+}
+
+int32_t serial_frame_read(uint8_t port, uint32_t* id, uint8_t* buffer, uint32_t length, uint32_t timeout) {
+	if (!VALIDATE_PORT_NO(port - 1)) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	if (!port_mutex_take(port - 1)) {
+		errno = EACCES;
+		return PROS_ERR;
+	}
+	serial_framer_s_t* framer = framers[port - 1];
+	if (framer == NULL) {
+		port_mutex_give(port - 1);
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	framer->readers++;
+	// the port mutex isn't held while waiting so that the port can still be
+	// written to and serviced by the system daemon
+	port_mutex_give(port - 1);
+
+	int32_t rtn = PROS_ERR;
+	mutex_take(framer->read_mtx, TIMEOUT_MAX);
+	if (framer->closing) {
+		errno = EINVAL;
+	} else if (!queue_recv(framer->frames, framer->read_item, timeout)) {
+		errno = EAGAIN;
+	} else if (framer->read_item->len == SERIAL_FRAME_CLOSED) {
+		errno = EINVAL;
+	} else {
+		if (id != NULL) {
+			*id = framer->read_item->id;
+		}
+		uint32_t len = framer->read_item->len;
+		memcpy(buffer, framer->read_item->data, len < length ? len : length);
+		rtn = len;
+	}
+	mutex_give(framer->read_mtx);
+	serial_framer_release(port, framer);
+	return rtn;
+}
+
+int32_t serial_frame_get_stats(uint8_t port, serial_frame_stats_s_t* stats) {
+	claim_port_i(port - 1, E_DEVICE_SERIAL);
+	serial_framer_s_t* framer = framers[port - 1];
+	if (framer == NULL) {
+		errno = EINVAL;
+		return_port(port - 1, PROS_ERR);
+	}
+	stats->frames = framer->decoder.frames;
+	stats->crc_errors = framer->decoder.crc_errors;
+	stats->resyncs = framer->decoder.resyncs;
+	stats->overflows = framer->decoder.overflows;
+	stats->dropped = framer->dropped;
+	return_port(port - 1, PROS_SUCCESS);
+}
@@ -65,6 +65,29 @@ std::int32_t Serial::write(std::uint8_t* buffer, std::int32_t length) const {
 	return serial_write(_port, buffer, length);
 }
 
+std::int32_t Serial::frame_enable(std::uint32_t max_len, std::uint32_t queue_len, serial_frame_crc_e_t crc) const {
+	return serial_frame_enable(_port, max_len, queue_len, crc);
+}
+
+std::int32_t Serial::frame_disable() const {
+	return serial_frame_disable(_port);
+}
+
+std::int32_t Serial::frame_write(std::uint32_t id, const std::uint8_t* buffer, std::uint32_t length) const {
+	return serial_frame_write(_port, id, buffer, length);
+}
+
+std::int32_t Serial::frame_read(std::uint32_t* id, std::uint8_t* buffer, std::uint32_t length,
+                                std::uint32_t timeout) const {
+	return serial_frame_read(_port, id, buffer, length, timeout);
+}
+
+serial_frame_stats_s_t Serial::frame_get_stats() const {
+	serial_frame_stats_s_t stats = {};
+	serial_frame_get_stats(_port, &stats);
+	return stats;
+}
+
 namespace literals {
 const pros::Serial operator"" _ser(const unsigned long long int m) {
 	return pros::Serial(m);
@@ -11,9 +11,68 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "kapi.h"
 #include "v5_api.h"
 
 int32_t usd_is_installed(void) {
 	return vexFileDriveStatus(0);
 }
+
+void* usd_load_file(const char* path, void* buffer, size_t* size) {
+	if (path == NULL || size == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return NULL;
+	}
+	size_t file_size = st.st_size;
+	void* dest = buffer;
+	if (dest == NULL) {
+		// +1 so that empty files still get a unique allocation
+		dest = malloc(file_size + 1);
+		if (dest == NULL) {
+			close(fd);
+			errno = ENOMEM;
+			return NULL;
+		}
+	} else if (*size < file_size) {
+		close(fd);
+		// tell the caller how big a buffer it needs
+		*size = file_size;
+		errno = ENOBUFS;
+		return NULL;
+	}
+
+	// a read at least as big as the read-ahead chunk goes straight from the card
+	// into dest in a single call
+	size_t loaded = 0;
+	while (loaded < file_size) {
+		ssize_t n = read(fd, (uint8_t*)dest + loaded, file_size - loaded);
+		if (n <= 0) {
+			break;
+		}
+		loaded += n;
+	}
+	close(fd);
+	if (loaded < file_size) {
+		if (buffer == NULL) {
+			free(dest);
+		}
+		errno = EIO;
+		return NULL;
+	}
+	*size = loaded;
+	return dest;
+}
@@ -21,5 +21,9 @@ std::int32_t is_installed(void) {
 	return usd_is_installed();
 }
 
+void* load_file(const char* path, void* buffer, std::size_t* size) {
+	return usd_load_file(path, buffer, size);
+}
+
 }  // namespace usd
 }  // namespace pros
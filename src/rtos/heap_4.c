@@ -37,6 +37,11 @@
 
 #include "FreeRTOS.h"
 #include "task.h"
+#include "system/heap_stats.h"
+
+/* heap_tlsf.c replaces this heap when the kernel is built with
+-DPROS_HEAP_TLSF */
+#ifndef PROS_HEAP_TLSF
 
 #if( configSUPPORT_DYNAMIC_ALLOCATION == 0 )
 	#error This file must not be used if configSUPPORT_DYNAMIC_ALLOCATION is 0
@@ -63,6 +68,9 @@ typedef struct A_BLOCK_LINK
 {
 	struct A_BLOCK_LINK *pxNextFreeBlock;	/*<< The next free block in the list. */
 	size_t xBlockSize;						/*<< The size of the free block. */
+	#ifdef PROS_HEAP_STATS
+		heap_tag_s_t xTag;					/*<< Who allocated the block, see system/heap_stats.h. */
+	#endif
 } BlockLink_t;
 
 /*-----------------------------------------------------------*/
@@ -90,6 +98,10 @@ static const size_t xHeapStructSize	= ( sizeof( BlockLink_t ) + ( ( size_t ) ( p
 /* Create a couple of list links to mark the start and end of the list. */
 static BlockLink_t xStart, *pxEnd = NULL;
 
+/* The first block of the heap.  Blocks are contiguous from here up to pxEnd,
+which lets heap_walk() visit the allocated blocks as well as the free ones. */
+static uint8_t *pucHeapStart = NULL;
+
 /* Keeps track of the number of free bytes remaining, but says nothing about
 fragmentation. */
 static size_t xFreeBytesRemaining = 0U;
@@ -107,6 +119,9 @@ void *kmalloc( size_t xWantedSize )
 {
 BlockLink_t *pxBlock, *pxPreviousBlock, *pxNewBlockLink;
 void *pvReturn = NULL;
+#ifdef PROS_HEAP_STATS
+	const size_t xRequestedSize = xWantedSize;
+#endif
 
 	rtos_suspend_all();
 	{
@@ -230,6 +245,17 @@ void *pvReturn = NULL;
 			mtCOVERAGE_TEST_MARKER();
 		}
 
+		#ifdef PROS_HEAP_STATS
+		{
+			heap_tag_s_t *pxTag = NULL;
+			if( pvReturn != NULL )
+			{
+				pxTag = &( ( BlockLink_t * ) ( ( ( uint8_t * ) pvReturn ) - xHeapStructSize ) )->xTag;
+			}
+			heap_stats_malloc( xRequestedSize, pxTag, __builtin_return_address( 0 ) );
+		}
+		#endif
+
 		traceMALLOC( pvReturn, xWantedSize );
 	}
 	( void ) rtos_resume_all();
@@ -319,6 +345,36 @@ void vPortInitialiseBlocks( void )
 }
 /*-----------------------------------------------------------*/
 
+void heap_walk( heap_walk_fn_t pxFunction, void *pvArg )
+{
+BlockLink_t *pxBlock;
+heap_block_info_s_t xInfo;
+
+	rtos_suspend_all();
+	{
+		if( pxEnd == NULL )
+		{
+			prvHeapInit();
+		}
+
+		for( pxBlock = ( void * ) pucHeapStart; pxBlock != pxEnd; pxBlock = ( void * ) ( ( ( uint8_t * ) pxBlock ) + xInfo.total ) )
+		{
+			xInfo.total = pxBlock->xBlockSize & ~xBlockAllocatedBit;
+			xInfo.allocated = ( pxBlock->xBlockSize & xBlockAllocatedBit ) != 0;
+			xInfo.ptr = ( ( uint8_t * ) pxBlock ) + xHeapStructSize;
+			xInfo.size = xInfo.total - xHeapStructSize;
+			#ifdef PROS_HEAP_STATS
+				xInfo.tag = xInfo.allocated ? &pxBlock->xTag : NULL;
+			#else
+				xInfo.tag = NULL;
+			#endif
+			pxFunction( &xInfo, pvArg );
+		}
+	}
+	( void ) rtos_resume_all();
+}
+/*-----------------------------------------------------------*/
+
 static void prvHeapInit( void )
 {
 BlockLink_t *pxFirstFreeBlock;
@@ -337,6 +393,7 @@ size_t xTotalHeapSize = configTOTAL_HEAP_SIZE;
 	}
 
 	pucAlignedHeap = ( uint8_t * ) uxAddress;
+	pucHeapStart = pucAlignedHeap;
 
 	/* xStart is used to hold a pointer to the first item in the list of free
 	blocks.  The void cast is used to prevent compiler warnings. */
@@ -426,3 +483,5 @@ uint8_t *puc;
 		mtCOVERAGE_TEST_MARKER();
 	}
 }
+
+#endif /* PROS_HEAP_TLSF */
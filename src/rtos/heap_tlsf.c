@@ -0,0 +1,365 @@
+/**
+ * \file rtos/heap_tlsf.c
+ *
+ * Two-level segregated fit (TLSF) implementation of kmalloc() and kfree()
+ *
+ * heap_4 keeps a single address-ordered free list, so an allocation walks the
+ * list until a block fits and a free walks it to find the neighbours to merge
+ * with. Both get slower as the heap fragments. TLSF keeps one free list per
+ * size class instead: the first level splits sizes by power of two, and the
+ * second level splits every power of two into TLSF_SL_COUNT linear steps. Two
+ * levels of bitmaps record which lists have blocks, so finding a block that
+ * fits takes two count-trailing-zeros instructions. Every block knows its
+ * physical neighbours, so merging on free needs no search either. Allocation
+ * and free take a bounded number of steps no matter how fragmented the heap
+ * is.
+ *
+ * Build the kernel with -DPROS_HEAP_TLSF to use this heap in place of heap_4.
+ * src/tests/heap_benchmark.c compares the worst-case latency of the two.
+ *
+ * Block layout: every block starts with an 8 byte header, which holds the
+ * physically previous block and the size of the payload (16 bytes when built
+ * with -DPROS_HEAP_STATS, which adds a heap_tag_s_t). The low bits of the
+ * size are flags, since sizes are multiples of portBYTE_ALIGNMENT. Free blocks
+ * keep their free list links in the payload. The heap ends with a zero-sized
+ * block that is never free, so there is no need to check for the end.
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "system/heap_stats.h"
+
+#ifdef PROS_HEAP_TLSF
+
+#if (configSUPPORT_DYNAMIC_ALLOCATION == 0)
+#error This file must not be used if configSUPPORT_DYNAMIC_ALLOCATION is 0
+#endif
+
+// log2 of the number of second level lists per power of two
+#define TLSF_SL_LOG2 5
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_ALIGN_LOG2 3
+// blocks below this size all fall in the first first level list, which is
+// split into TLSF_SL_COUNT steps of portBYTE_ALIGNMENT bytes
+#define TLSF_FL_SHIFT (TLSF_SL_LOG2 + TLSF_ALIGN_LOG2)
+#define TLSF_SMALL_BLOCK (1 << TLSF_FL_SHIFT)
+// largest block is just under 2^TLSF_FL_MAX bytes
+#define TLSF_FL_MAX 24
+#define TLSF_FL_COUNT (TLSF_FL_MAX - TLSF_FL_SHIFT + 1)
+
+#define BLOCK_FREE 0x1       // the block is free
+#define BLOCK_PREV_FREE 0x2  // the physically previous block is free
+#define BLOCK_FLAGS 0x7
+
+_Static_assert(portBYTE_ALIGNMENT == (1 << TLSF_ALIGN_LOG2), "TLSF_ALIGN_LOG2 must match portBYTE_ALIGNMENT");
+_Static_assert(configTOTAL_HEAP_SIZE < (1UL << TLSF_FL_MAX), "TLSF_FL_MAX is too small for configTOTAL_HEAP_SIZE");
+
+typedef struct tlsf_block {
+	struct tlsf_block* prev_phys;
+	size_t size;  // size of the payload | BLOCK_* flags
+#ifdef PROS_HEAP_STATS
+	heap_tag_s_t tag;
+#endif
+	// the payload starts here. Free blocks use it for their free list links
+	struct tlsf_block* next_free;
+	struct tlsf_block* prev_free;
+} tlsf_block_s_t;
+
+#define BLOCK_HEADER_SIZE (offsetof(tlsf_block_s_t, next_free))
+// a free block needs room for its links
+#define BLOCK_MIN_SIZE (sizeof(tlsf_block_s_t) - BLOCK_HEADER_SIZE)
+#define BLOCK_MAX_SIZE ((1UL << TLSF_FL_MAX) - 1)
+
+_Static_assert((BLOCK_HEADER_SIZE & portBYTE_ALIGNMENT_MASK) == 0, "the payload must be aligned");
+
+#if (configAPPLICATION_ALLOCATED_HEAP == 1)
+extern uint8_t ucHeap[configTOTAL_HEAP_SIZE];
+#else
+static uint8_t ucHeap[configTOTAL_HEAP_SIZE] __attribute__((aligned(portBYTE_ALIGNMENT)));
+#endif
+
+static uint32_t fl_bitmap;
+static uint32_t sl_bitmap[TLSF_FL_COUNT];
+static tlsf_block_s_t* free_lists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+static bool heap_ready;
+
+// counted like heap_4: free payload plus the headers of the free blocks
+static size_t free_bytes;
+static size_t min_free_bytes;
+
+static inline size_t block_size(const tlsf_block_s_t* block) {
+	return block->size & ~(size_t)BLOCK_FLAGS;
+}
+
+static inline void* block_to_ptr(tlsf_block_s_t* block) {
+	return (uint8_t*)block + BLOCK_HEADER_SIZE;
+}
+
+static inline tlsf_block_s_t* block_from_ptr(void* ptr) {
+	return (tlsf_block_s_t*)((uint8_t*)ptr - BLOCK_HEADER_SIZE);
+}
+
+static inline tlsf_block_s_t* block_next(tlsf_block_s_t* block) {
+	return (tlsf_block_s_t*)((uint8_t*)block_to_ptr(block) + block_size(block));
+}
+
+// index of the most significant set bit
+static inline uint32_t tlsf_fls(size_t x) {
+	return 31 - __builtin_clz(x);
+}
+
+// index of the least significant set bit
+static inline uint32_t tlsf_ffs(uint32_t x) {
+	return __builtin_ctz(x);
+}
+
+// the list that a free block of this size belongs in
+static inline void mapping_insert(size_t size, uint32_t* fl, uint32_t* sl) {
+	if (size < TLSF_SMALL_BLOCK) {
+		*fl = 0;
+		*sl = size >> TLSF_ALIGN_LOG2;
+	} else {
+		uint32_t bit = tlsf_fls(size);
+		*sl = (size >> (bit - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+		*fl = bit - TLSF_FL_SHIFT + 1;
+	}
+}
+
+// the first list whose blocks are all at least this size. Rounding up means
+// that the first block of the list always fits, so no list is ever searched
+static inline void mapping_search(size_t size, uint32_t* fl, uint32_t* sl) {
+	if (size >= TLSF_SMALL_BLOCK) {
+		size += (1UL << (tlsf_fls(size) - TLSF_SL_LOG2)) - 1;
+	}
+	mapping_insert(size, fl, sl);
+}
+
+static tlsf_block_s_t* find_suitable_block(uint32_t* fl, uint32_t* sl) {
+	uint32_t sl_map = sl_bitmap[*fl] & (~0UL << *sl);
+	if (!sl_map) {
+		// nothing at this first level, so take the next larger one with blocks
+		uint32_t fl_map = *fl + 1 < 32 ? fl_bitmap & (~0UL << (*fl + 1)) : 0;
+		if (!fl_map) {
+			return NULL;
+		}
+		*fl = tlsf_ffs(fl_map);
+		sl_map = sl_bitmap[*fl];
+	}
+	*sl = tlsf_ffs(sl_map);
+	return free_lists[*fl][*sl];
+}
+
+static void remove_free_block(tlsf_block_s_t* block, uint32_t fl, uint32_t sl) {
+	tlsf_block_s_t* prev = block->prev_free;
+	tlsf_block_s_t* next = block->next_free;
+	if (next) {
+		next->prev_free = prev;
+	}
+	if (prev) {
+		prev->next_free = next;
+	} else {
+		free_lists[fl][sl] = next;
+		if (next == NULL) {
+			sl_bitmap[fl] &= ~(1UL << sl);
+			if (!sl_bitmap[fl]) {
+				fl_bitmap &= ~(1UL << fl);
+			}
+		}
+	}
+}
+
+static void remove_block(tlsf_block_s_t* block) {
+	uint32_t fl, sl;
+	mapping_insert(block_size(block), &fl, &sl);
+	remove_free_block(block, fl, sl);
+}
+
+static void insert_block(tlsf_block_s_t* block) {
+	uint32_t fl, sl;
+	mapping_insert(block_size(block), &fl, &sl);
+	tlsf_block_s_t* head = free_lists[fl][sl];
+	block->next_free = head;
+	block->prev_free = NULL;
+	if (head) {
+		head->prev_free = block;
+	}
+	free_lists[fl][sl] = block;
+	fl_bitmap |= 1UL << fl;
+	sl_bitmap[fl] |= 1UL << sl;
+}
+
+static void heap_init(void) {
+	// the first block spans the whole heap except for the end marker. The marker
+	// is only a header, but leave room for a whole block so it can be accessed as
+	// one
+	tlsf_block_s_t* first = (tlsf_block_s_t*)ucHeap;
+	size_t size = (configTOTAL_HEAP_SIZE - BLOCK_HEADER_SIZE - sizeof(tlsf_block_s_t)) & ~(size_t)portBYTE_ALIGNMENT_MASK;
+	first->prev_phys = NULL;
+	first->size = size | BLOCK_FREE;
+	tlsf_block_s_t* end = block_next(first);
+	end->prev_phys = first;
+	end->size = BLOCK_PREV_FREE;
+	insert_block(first);
+
+	free_bytes = size + BLOCK_HEADER_SIZE;
+	min_free_bytes = free_bytes;
+	heap_ready = true;
+}
+
+void* kmalloc(size_t xWantedSize) {
+	void* pvReturn = NULL;
+
+	rtos_suspend_all();
+	{
+		if (!heap_ready) {
+			heap_init();
+		}
+
+		if (xWantedSize > 0 && xWantedSize <= BLOCK_MAX_SIZE) {
+			size_t size = (xWantedSize + portBYTE_ALIGNMENT_MASK) & ~(size_t)portBYTE_ALIGNMENT_MASK;
+			if (size < BLOCK_MIN_SIZE) {
+				size = BLOCK_MIN_SIZE;
+			}
+
+			uint32_t fl, sl;
+			mapping_search(size, &fl, &sl);
+			tlsf_block_s_t* block = fl < TLSF_FL_COUNT ? find_suitable_block(&fl, &sl) : NULL;
+			if (block == NULL) {
+				// The rounding skips the list the size itself falls in, whose
+				// blocks may or may not fit. Only its first block is checked so
+				// that this stays bounded, which still lets an almost empty heap
+				// serve a request for almost all of it
+				mapping_insert(size, &fl, &sl);
+				block = free_lists[fl][sl];
+				if (block && block_size(block) < size) {
+					block = NULL;
+				}
+			}
+			if (block) {
+				remove_free_block(block, fl, sl);
+
+				// give back what isn't needed, if it's big enough to be a block
+				tlsf_block_s_t* next = block_next(block);
+				size_t remaining = block_size(block) - size;
+				if (remaining >= BLOCK_HEADER_SIZE + BLOCK_MIN_SIZE) {
+					tlsf_block_s_t* rest = (tlsf_block_s_t*)((uint8_t*)block_to_ptr(block) + size);
+					rest->prev_phys = block;
+					rest->size = (remaining - BLOCK_HEADER_SIZE) | BLOCK_FREE;
+					next->prev_phys = rest;
+					insert_block(rest);
+					block->size = size | (block->size & BLOCK_PREV_FREE);
+				} else {
+					block->size &= ~(size_t)BLOCK_FREE;
+					next->size &= ~(size_t)BLOCK_PREV_FREE;
+				}
+
+				free_bytes -= block_size(block) + BLOCK_HEADER_SIZE;
+				if (free_bytes < min_free_bytes) {
+					min_free_bytes = free_bytes;
+				}
+				pvReturn = block_to_ptr(block);
+			}
+		}
+
+#ifdef PROS_HEAP_STATS
+		heap_stats_malloc(xWantedSize, pvReturn ? &block_from_ptr(pvReturn)->tag : NULL, __builtin_return_address(0));
+#endif
+		traceMALLOC(pvReturn, xWantedSize);
+	}
+	(void)rtos_resume_all();
+
+#if (configUSE_MALLOC_FAILED_HOOK == 1)
+	if (pvReturn == NULL) {
+		extern void vApplicationMallocFailedHook(void);
+		vApplicationMallocFailedHook();
+	}
+#endif
+
+	configASSERT((((size_t)pvReturn) & (size_t)portBYTE_ALIGNMENT_MASK) == 0);
+	return pvReturn;
+}
+
+void kfree(void* pv) {
+	if (pv == NULL) {
+		return;
+	}
+	tlsf_block_s_t* block = block_from_ptr(pv);
+	configASSERT((block->size & BLOCK_FREE) == 0);
+	if (block->size & BLOCK_FREE) {
+		return;
+	}
+
+	rtos_suspend_all();
+	{
+		free_bytes += block_size(block) + BLOCK_HEADER_SIZE;
+		traceFREE(pv, block_size(block));
+
+		// merge with the free neighbours. Each merge absorbs a header
+		if (block->size & BLOCK_PREV_FREE) {
+			tlsf_block_s_t* prev = block->prev_phys;
+			remove_block(prev);
+			prev->size += block_size(block) + BLOCK_HEADER_SIZE;
+			block = prev;
+		}
+		tlsf_block_s_t* next = block_next(block);
+		if (next->size & BLOCK_FREE) {
+			remove_block(next);
+			block->size += block_size(next) + BLOCK_HEADER_SIZE;
+			next = block_next(block);
+		}
+
+		block->size |= BLOCK_FREE;
+		next->prev_phys = block;
+		next->size |= BLOCK_PREV_FREE;
+		insert_block(block);
+	}
+	(void)rtos_resume_all();
+}
+
+size_t xPortGetFreeHeapSize(void) {
+	return free_bytes;
+}
+
+size_t xPortGetMinimumEverFreeHeapSize(void) {
+	return min_free_bytes;
+}
+
+void vPortInitialiseBlocks(void) {
+	// This just exists to keep the linker quiet.
+}
+
+void heap_walk(heap_walk_fn_t fn, void* arg) {
+	rtos_suspend_all();
+	{
+		if (!heap_ready) {
+			heap_init();
+		}
+		// the end marker is the only block with no payload
+		for (tlsf_block_s_t* block = (tlsf_block_s_t*)ucHeap; block_size(block) != 0; block = block_next(block)) {
+			heap_block_info_s_t info = {.ptr = block_to_ptr(block),
+			                            .size = block_size(block),
+			                            .total = block_size(block) + BLOCK_HEADER_SIZE,
+			                            .allocated = !(block->size & BLOCK_FREE),
+			                            .tag = NULL};
+#ifdef PROS_HEAP_STATS
+			if (info.allocated) {
+				info.tag = &block->tag;
+			}
+#endif
+			fn(&info, arg);
+		}
+	}
+	(void)rtos_resume_all();
+}
+
+#endif  // PROS_HEAP_TLSF
@@ -0,0 +1,150 @@
+/**
+ * \file rtos/pool.c
+ *
+ * Fixed-size object pools
+ *
+ * Free blocks form a singly linked list through their first word, so taking or
+ * returning a block is a push or pop at the head. Blocks that have never been
+ * handed out are not on the list: they are taken in order from the end of the
+ * used part of the storage, which lets a pool be initialized in constant time
+ * (and statically, see POOL_INITIALIZER).
+ *
+ * The list is updated with the kernel interrupt mask set rather than with a
+ * compare-and-swap, since the V5 has a single core and a lock-free pop needs
+ * ABA protection that costs more than masking interrupts for a few
+ * instructions. This also makes the pools safe to use from interrupts.
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "kapi.h"
+
+int32_t pool_init(pool_s_t* pool, void* storage, size_t block_size, size_t count) {
+	if (pool == NULL || storage == NULL || ((uintptr_t)storage & (POOL_ALIGN - 1)) || block_size == 0 ||
+	    count == 0 || block_size > UINT32_MAX / 2 || count > UINT32_MAX / POOL_BLOCK_SIZE(block_size)) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	*pool = (pool_s_t)POOL_INITIALIZER(storage, block_size, count);
+	return PROS_SUCCESS;
+}
+
+pool_t pool_create(size_t block_size, size_t count) {
+	// the pool and its storage are one allocation, with the storage after the
+	// pool rounded up to the block alignment (kmalloc returns 8 byte aligned
+	// memory)
+	size_t header = POOL_BLOCK_SIZE(sizeof(pool_s_t));
+	if (block_size == 0 || count == 0 || block_size > UINT32_MAX / 2 ||
+	    count > (UINT32_MAX - header) / POOL_BLOCK_SIZE(block_size)) {
+		errno = EINVAL;
+		return NULL;
+	}
+	uint8_t* memory = kmalloc(header + POOL_STORAGE_SIZE(block_size, count));
+	if (memory == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	pool_t pool = (pool_t)memory;
+	*pool = (pool_s_t)POOL_INITIALIZER(memory + header, block_size, count);
+	pool->_heap = true;
+	return pool;
+}
+
+void pool_delete(pool_t pool) {
+	if (pool != NULL && pool->_heap) {
+		kfree(pool);
+	}
+}
+
+void* pool_alloc(pool_t pool) {
+	if (pool == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	uint8_t* block = NULL;
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	if (pool->_free != NULL) {
+		block = pool->_free;
+		pool->_free = *(void**)block;
+	} else if (pool->_unused < pool->_storage + pool->_capacity * pool->_block_size) {
+		block = pool->_unused;
+		pool->_unused += pool->_block_size;
+	}
+	if (block != NULL) {
+		if (++pool->_used > pool->_peak) {
+			pool->_peak = pool->_used;
+		}
+	} else {
+		pool->_failures++;
+	}
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+
+	if (block == NULL) {
+		errno = ENOMEM;
+	}
+	return block;
+}
+
+bool pool_contains(pool_t pool, const void* block) {
+	if (pool == NULL || (const uint8_t*)block < pool->_storage) {
+		return false;
+	}
+	uint32_t offset = (const uint8_t*)block - pool->_storage;
+	return offset < pool->_capacity * pool->_block_size && offset % pool->_block_size == 0;
+}
+
+int32_t pool_free(pool_t pool, void* block) {
+	if (block == NULL) {
+		return PROS_SUCCESS;
+	}
+	if (!pool_contains(pool, block)) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	*(void**)block = pool->_free;
+	pool->_free = block;
+	pool->_used--;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+	return PROS_SUCCESS;
+}
+
+int32_t pool_get_stats(pool_t pool, pool_stats_s_t* stats) {
+	if (pool == NULL || stats == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	stats->block_size = pool->_block_size;
+	stats->capacity = pool->_capacity;
+	stats->used = pool->_used;
+	stats->peak = pool->_peak;
+	stats->failures = pool->_failures;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+	return PROS_SUCCESS;
+}
+
+void* kpool_alloc(pool_t pool, size_t size) {
+	kassert(size <= pool->_block_size);
+	// a full pool isn't an error for the kernel, so don't leave errno behind
+	int err = errno;
+	void* object = pool_alloc(pool);
+	if (object == NULL) {
+		errno = err;
+		object = kmalloc(size);
+	}
+	return object;
+}
+
+void kpool_free(pool_t pool, void* object) {
+	if (pool_contains(pool, object)) {
+		pool_free(pool, object);
+	} else {
+		kfree(object);
+	}
+}
@@ -205,6 +205,10 @@ volatile uint32_t ulPortYieldRequired = pdFALSE;
 if the nesting depth is 0. */
 volatile uint32_t ulPortInterruptNesting = 0UL;
 
+/* The registers of the code interrupted by the outermost interrupt: r4-r11,
+SP, LR, SPSR and PC.  Written by FreeRTOS_IRQ_Handler for the profiler. */
+volatile uint32_t ulPortInterruptedContext[ 12 ];
+
 /* Used in the asm file. */
 __attribute__(( used )) const uint32_t ulICCIAR = portICCIAR_INTERRUPT_ACKNOWLEDGE_REGISTER_ADDRESS;
 __attribute__(( used )) const uint32_t ulICCEOIR = portICCEOIR_END_OF_INTERRUPT_REGISTER_ADDRESS;
@@ -68,6 +68,12 @@ const char* Task::get_name() {
 	return task_get_name(task);
 }
 
+task_usage_s_t Task::get_usage() {
+	task_usage_s_t usage = {};
+	task_get_usage(task, &usage);
+	return usage;
+}
+
 std::uint32_t Task::notify() {
 	return task_notify(task);
 }
@@ -96,6 +102,10 @@ void Task::delay_until(std::uint32_t* const prev_time, const std::uint32_t delta
 	task_delay_until(prev_time, delta);
 }
 
+void Task::delay_us_until(std::uint64_t* const prev_time, const std::uint32_t delta) {
+	task_delay_us_until(prev_time, delta);
+}
+
 std::uint32_t Task::get_count() {
 	return task_get_count();
 }
@@ -332,7 +332,7 @@ static void prvInitialiseNewStreamBuffer( StreamBuffer_t * const pxStreamBuffer,
 #endif /* ( configSUPPORT_STATIC_ALLOCATION == 1 ) */
 /*-----------------------------------------------------------*/
 
-void vStreamBufferDelete( stream_buf_t xStreamBuffer )
+void stream_buf_delete( stream_buf_t xStreamBuffer )
 {
 StreamBuffer_t * pxStreamBuffer = ( StreamBuffer_t * ) xStreamBuffer; /*lint !e9087 !e9079 Safe cast as stream_buf_t is opaque Streambuffer_t. */
 
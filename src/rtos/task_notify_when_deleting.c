@@ -22,6 +22,9 @@ struct notify_delete_action {
   notify_action_e_t notify_action;
 };
 
+#define NOTIFY_DELETE_ACTION_POOL_SIZE 16
+POOL_STATIC(action_pool, sizeof(struct notify_delete_action), NOTIFY_DELETE_ACTION_POOL_SIZE);
+
 struct _find_task_args {
   task_t task;
   struct notify_delete_action* found_action;
@@ -105,7 +108,7 @@ void task_notify_when_deleting(task_t target_task, task_t task_to_notify,
 
     // action wasn't found, so add it to the linked list
     if (action == NULL) {
-      action = (struct notify_delete_action*)kmalloc(sizeof(struct notify_delete_action));
+      action = (struct notify_delete_action*)kpool_alloc(&action_pool, sizeof(struct notify_delete_action));
       if (action != NULL) {
         linked_list_prepend_data(target_ll, action);
       }
@@ -135,7 +138,7 @@ void task_notify_when_deleting(task_t target_task, task_t task_to_notify,
 //     struct notify_delete_action* action = _find_task(ll, task_to_notify);
 //     if (action != NULL) {
 //       linked_list_remove_data(ll, action);
-//       kfree(action);
+//       kpool_free(&action_pool, action);
 //     }
 //   }
 // }
@@ -153,7 +156,7 @@ static void delete_hook_cb(ll_node_s_t* node, void* ignore) {
   struct notify_delete_action* action = node->payload.data;
   if (action != NULL) {
     task_notify_ext(action->task_to_notify, action->value, action->notify_action, NULL);
-    kfree(action);
+    kpool_free(&action_pool, action);
     node->payload.data = NULL;
   }
 }
@@ -0,0 +1,266 @@
+/**
+ * \file rtos/task_usage.c
+ *
+ * Per-task CPU usage
+ *
+ * FreeRTOS keeps a run time counter for every task (see
+ * configGENERATE_RUN_TIME_STATS). The usage task snapshots every task's counter
+ * every TASK_USAGE_PERIOD milliseconds into a small ring, and a task's CPU
+ * share is the growth of its counter since the oldest snapshot divided by the
+ * growth of the total. Nothing is formatted on the brain: the optional usage
+ * log writes binary records which tools/task_usage_decode.py formats.
+ *
+ * Log record format (little endian):
+ *
+ *   "TUSG" | timestamp ms (4) | task count (1) |
+ *   per task: state (1) | priority (1) | stack high water words (2) |
+ *             run time (4) | CPU share in hundredths of a percent (2) |
+ *             name length (1) | name
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "kapi.h"
+
+#define TASK_USAGE_PERIOD 250
+// one more snapshot than the window spans, so the oldest one is a window old
+#define TASK_USAGE_SLOTS (TASK_USAGE_WINDOW / TASK_USAGE_PERIOD + 1)
+#define TASK_USAGE_LOG_MAGIC "TUSG"
+#define TASK_USAGE_LOG_SIZE_MAX (9 + TASK_USAGE_MAX_TASKS * (11 + TASK_NAME_MAX_LEN))
+
+typedef struct task_usage_snapshot {
+	uint32_t total;
+	uint32_t count;
+	task_t tasks[TASK_USAGE_MAX_TASKS];
+	uint32_t run_times[TASK_USAGE_MAX_TASKS];
+} task_usage_snapshot_s_t;
+
+static task_usage_snapshot_s_t snapshots[TASK_USAGE_SLOTS];
+static uint32_t snapshot_count;  // snapshots taken so far
+static task_status_s_t status[TASK_USAGE_MAX_TASKS];
+
+static static_sem_s_t usage_mtx_buf;
+static mutex_t usage_mtx;  // protects everything above
+
+static static_sem_s_t log_mtx_buf;
+static mutex_t log_mtx;  // protects the log, and is held while it is written
+static int log_fd = -1;
+static uint32_t log_period;
+static uint32_t log_last;
+static uint8_t log_record[TASK_USAGE_LOG_SIZE_MAX];
+
+static task_stack_t usage_task_stack[TASK_STACK_DEPTH_MIN];
+static static_task_s_t usage_task_buffer;
+static task_t usage_task;
+
+// Reads every task's status, returning the number of tasks, or 0 if there are
+// more than status can hold. Must be called with usage_mtx held
+static uint32_t _read_status(uint32_t* total) {
+	return uxTaskGetSystemState(status, TASK_USAGE_MAX_TASKS, total);
+}
+
+// fills usage from status[i], measured against the oldest snapshot
+static void _fill_usage(task_usage_s_t* usage, uint32_t i, uint32_t total) {
+	const task_status_s_t* st = &status[i];
+	usage->task = st->handle;
+	strncpy(usage->name, st->name, TASK_NAME_MAX_LEN - 1);
+	usage->name[TASK_NAME_MAX_LEN - 1] = '\0';
+	usage->state = st->state;
+	usage->priority = st->priority;
+	usage->stack_high_water = st->stack_high_water;
+	usage->run_time = st->run_time;
+
+	// until the ring fills up, measure against the first snapshot (or boot)
+	uint32_t prev_total = 0;
+	uint32_t prev_run = 0;
+	if (snapshot_count > 0) {
+		const task_usage_snapshot_s_t* oldest =
+		    &snapshots[snapshot_count < TASK_USAGE_SLOTS ? 0 : snapshot_count % TASK_USAGE_SLOTS];
+		prev_total = oldest->total;
+		for (uint32_t j = 0; j < oldest->count; j++) {
+			if (oldest->tasks[j] == st->handle) {
+				prev_run = oldest->run_times[j];
+				break;
+			}
+		}
+	}
+	uint32_t elapsed = total - prev_total;
+	usage->cpu_percent = elapsed ? 100.0f * (float)(st->run_time - prev_run) / (float)elapsed : 0.0f;
+}
+
+// builds a log record in log_record, returning its size. Must be called with
+// both locks held
+static size_t _build_log_record(uint32_t count, uint32_t total) {
+	uint8_t* record = log_record;
+	uint32_t now = millis();
+	memcpy(record, TASK_USAGE_LOG_MAGIC, 4);
+	memcpy(record + 4, &now, 4);
+	record[8] = count;
+	size_t len = 9;
+	for (uint32_t i = 0; i < count; i++) {
+		task_usage_s_t usage;
+		_fill_usage(&usage, i, total);
+		uint16_t stack = usage.stack_high_water > UINT16_MAX ? UINT16_MAX : usage.stack_high_water;
+		uint16_t share = (uint16_t)(usage.cpu_percent * 100.0f + 0.5f);
+		size_t name_len = strlen(usage.name);
+		record[len++] = usage.state;
+		record[len++] = usage.priority;
+		memcpy(record + len, &stack, 2);
+		memcpy(record + len + 2, &usage.run_time, 4);
+		memcpy(record + len + 6, &share, 2);
+		record[len + 8] = name_len;
+		memcpy(record + len + 9, usage.name, name_len);
+		len += 9 + name_len;
+	}
+	return len;
+}
+
+static void usage_task_fn(void* ign) {
+	uint32_t time = millis();
+	while (true) {
+		mutex_take(log_mtx, TIMEOUT_MAX);
+		mutex_take(usage_mtx, TIMEOUT_MAX);
+		uint32_t total;
+		uint32_t count = _read_status(&total);
+		if (count == 0) {
+			// too many tasks to measure. Skip this period rather than record an
+			// empty snapshot that later measurements would be taken against
+			mutex_give(usage_mtx);
+			mutex_give(log_mtx);
+			task_delay_until(&time, TASK_USAGE_PERIOD);
+			continue;
+		}
+		size_t log_len = 0;
+		if (log_fd >= 0 && millis() - log_last >= log_period) {
+			log_last = millis();
+			log_len = _build_log_record(count, total);
+		}
+		task_usage_snapshot_s_t* snapshot = &snapshots[snapshot_count % TASK_USAGE_SLOTS];
+		snapshot->total = total;
+		snapshot->count = count;
+		for (uint32_t i = 0; i < count; i++) {
+			snapshot->tasks[i] = status[i].handle;
+			snapshot->run_times[i] = status[i].run_time;
+		}
+		snapshot_count++;
+		mutex_give(usage_mtx);
+		if (log_len > 0) {
+			// outside of usage_mtx since the file may be slow. A single write so
+			// that a serial stream gets the record as one packet
+			write(log_fd, log_record, log_len);
+		}
+		mutex_give(log_mtx);
+		task_delay_until(&time, TASK_USAGE_PERIOD);
+	}
+}
+
+// starts the usage task on first use
+static void _usage_start(void) {
+	static bool started = false;
+	static bool ready = false;
+	if (!__atomic_load_n(&ready, __ATOMIC_ACQUIRE)) {
+		if (!__atomic_exchange_n(&started, true, __ATOMIC_ACQ_REL)) {
+			usage_mtx = mutex_create_static(&usage_mtx_buf);
+			log_mtx = mutex_create_static(&log_mtx_buf);
+			usage_task = task_create_static(usage_task_fn, NULL, TASK_PRIORITY_MIN + 1, TASK_STACK_DEPTH_MIN,
+			                                "Task Usage (PROS)", usage_task_stack, &usage_task_buffer);
+			__atomic_store_n(&ready, true, __ATOMIC_RELEASE);
+		}
+		while (!__atomic_load_n(&ready, __ATOMIC_ACQUIRE)) {
+			task_delay(1);
+		}
+	}
+}
+
+uint32_t task_get_usage(task_t task, task_usage_s_t* usage) {
+	if (usage == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	_usage_start();
+	if (task == NULL) {
+		task = task_get_current();
+	}
+	mutex_take(usage_mtx, TIMEOUT_MAX);
+	uint32_t total;
+	uint32_t count = _read_status(&total);
+	if (count == 0) {
+		mutex_give(usage_mtx);
+		errno = ENOBUFS;
+		return PROS_ERR;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		if (status[i].handle == task) {
+			_fill_usage(usage, i, total);
+			mutex_give(usage_mtx);
+			return PROS_SUCCESS;
+		}
+	}
+	mutex_give(usage_mtx);
+	errno = ESRCH;
+	return PROS_ERR;
+}
+
+uint32_t task_get_usage_all(task_usage_s_t* usage, uint32_t max) {
+	if (usage == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	_usage_start();
+	mutex_take(usage_mtx, TIMEOUT_MAX);
+	uint32_t total;
+	uint32_t count = _read_status(&total);
+	if (count == 0) {
+		mutex_give(usage_mtx);
+		errno = ENOBUFS;
+		return PROS_ERR;
+	}
+	if (count > max) {
+		count = max;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		_fill_usage(&usage[i], i, total);
+	}
+	mutex_give(usage_mtx);
+	return count;
+}
+
+uint32_t task_usage_log_start(const char* path, uint32_t period) {
+	if (path == NULL || period == 0) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	_usage_start();
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC);
+	if (fd < 0) {
+		return PROS_ERR;
+	}
+	task_usage_log_stop();
+	mutex_take(log_mtx, TIMEOUT_MAX);
+	log_fd = fd;
+	log_period = period;
+	log_last = millis() - period;
+	mutex_give(log_mtx);
+	return PROS_SUCCESS;
+}
+
+uint32_t task_usage_log_stop(void) {
+	_usage_start();
+	mutex_take(log_mtx, TIMEOUT_MAX);
+	int fd = log_fd;
+	log_fd = -1;
+	if (fd >= 0) {
+		close(fd);
+	}
+	mutex_give(log_mtx);
+	return fd >= 0 ? 1 : 0;
+}
@@ -529,7 +529,8 @@ static void prvAddNewTaskToReadyList( TCB_t *pxNewTCB ) ;
       /* Finish task termination if the TCB is awaiting termination by the IDLE
       task. xTasksWaitingTermination list would then have a pointer to (this)
       task in an active task list, which would end up destroying that list in
-      unexpected ways */
+      unexpected ways. The buffer usually never held a task, which
+      task_finish_termination() tells apart without reading it. */
 			void task_finish_termination(TCB_t*);
 			task_finish_termination((TCB_t*)task_buffer);
 			/* The memory used for the task's TCB and stack are passed into this
@@ -916,6 +917,10 @@ static void prvAddNewTaskToReadyList( TCB_t *pxNewTCB )
 
 		void task_notify_when_deleting_hook(task_t);
 		task_notify_when_deleting_hook(task);
+		void* ser_task_buf_delete_hook(task_t);
+		void* ser_task_buf = ser_task_buf_delete_hook(task);
+		void hrtimer_task_delete_hook(task_t);
+		hrtimer_task_delete_hook(task);
 
 		taskENTER_CRITICAL();
 		{
@@ -984,6 +989,11 @@ static void prvAddNewTaskToReadyList( TCB_t *pxNewTCB )
 		}
 		taskEXIT_CRITICAL();
 
+		/* PROS: ship what another task left in its output buffer, now that it
+		can't run anymore. Only set when the task didn't delete itself. */
+		void ser_task_buf_deleted_hook(void*, task_t);
+		ser_task_buf_deleted_hook( ser_task_buf, task );
+
 		/* Force a reschedule if it is the currently running task that has just
 		been deleted. */
 		if( xSchedulerRunning != pdFALSE )
@@ -1000,23 +1010,26 @@ static void prvAddNewTaskToReadyList( TCB_t *pxNewTCB )
 		}
 	}
 
-  // Check if a task is awaiting termination and finish termination if it is
+  // Check if a task is awaiting termination and finish termination if it is.
+  // pxTCB may point to memory that never held a task (e.g. a buffer passed to
+  // task_create_static for the first time), so it is only read once it has been
+  // found on xTasksWaitingTermination
 	void task_finish_termination(TCB_t* pxTCB)
 	{
 			uint8_t doCleanup = 0;
 
 			taskENTER_CRITICAL();
 			{
-			list_item_t* pxStateListItem = &( pxTCB->xStateListItem );
-			if (pxStateListItem != NULL)
+			list_item_t const* pxEnd = listGET_END_MARKER( &xTasksWaitingTermination );
+			for( list_item_t* pxItem = listGET_HEAD_ENTRY( &xTasksWaitingTermination ); pxItem != pxEnd; pxItem = listGET_NEXT( pxItem ) )
 			{
-				List_t* pxStateList = ( List_t * ) listLIST_ITEM_CONTAINER( pxStateListItem );
-				if (pxStateList == &xTasksWaitingTermination && listGET_NEXT( pxStateListItem )->pxPrevious == pxStateListItem)
+				if( listGET_LIST_ITEM_OWNER( pxItem ) == pxTCB )
 				{
 					( void ) uxListRemove( &( pxTCB->xStateListItem ) );
 					--uxCurrentNumberOfTasks;
 					--uxDeletedTasksWaitingCleanUp;
 					doCleanup = 1;
+					break;
 				}
 			}
 			}
@@ -1027,6 +1040,39 @@ static void prvAddNewTaskToReadyList( TCB_t *pxNewTCB )
 				prvDeleteTCB(pxTCB);
 			}
 	}
+
+	void task_delete_static(task_t task)
+	{
+	TCB_t *pxTCB = ( TCB_t * ) task;
+	int32_t xDeleted;
+
+		configASSERT( pxTCB );
+		configASSERT( pxTCB != pxCurrentTCB );
+
+		/* task_delete() can block in its hooks, so it can't be called with the
+		scheduler suspended. Suspend the task instead, which keeps it from
+		deleting itself between checking its state and deleting it. */
+		rtos_suspend_all();
+		{
+			xDeleted = ( task_get_state( task ) == E_TASK_STATE_DELETED );
+			if( xDeleted == pdFALSE )
+			{
+				task_suspend( task );
+			}
+		}
+		( void ) rtos_resume_all();
+
+		if( xDeleted != pdFALSE )
+		{
+			/* The task deleted itself and may still be waiting for the idle
+			task. */
+			task_finish_termination( pxTCB );
+		}
+		else
+		{
+			task_delete( task );
+		}
+	}
 #endif /* INCLUDE_vTaskDelete */
 /*-----------------------------------------------------------*/
 
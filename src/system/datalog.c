@@ -0,0 +1,413 @@
+/**
+ * \file system/datalog.c
+ *
+ * Binary data logger
+ *
+ * The sampler task reads every channel once per period and stores the values
+ * as a fixed-size record in a single-producer/single-consumer ring. The writer
+ * task drains the ring into a buffered microSD file (see USDCTL_SET_WRITE_BUFFER)
+ * at low priority, so neither formatting nor the card's latency ever delays
+ * sampling. If the ring fills up, new records are dropped and counted.
+ *
+ * File format (all fields little endian):
+ *
+ *   header: "PLOG" | version (1) | channel count (1) | record size (2) |
+ *           period ms (4) | start time ms (4) |
+ *           per channel: type (1) | name length (1) | name |
+ *           CRC-32 of everything before it (4)
+ *
+ *   record: timestamp us (4) | one 4 byte value per channel
+ *
+ *   sync:   "PLSY" | records written so far (4) | records dropped so far (4) |
+ *           CRC-32 of the records since the previous sync (4)
+ *
+ * A sync marker follows every DATALOG_SYNC_INTERVAL records and the last
+ * record. A reader can verify each block of records against its sync marker,
+ * and after a crash or a damaged write it can find the next block by searching
+ * for "PLSY". tools/datalog_convert.py does both.
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common/crc.h"
+#include "kapi.h"
+#include "pros/datalog.h"
+#include "system/optimizers.h"
+
+#define DATALOG_VERSION 1
+#define DATALOG_MAGIC "PLOG"
+#define DATALOG_SYNC_MAGIC "PLSY"
+#define DATALOG_SYNC_SIZE 16
+#define DATALOG_TIMESTAMP_SIZE 4
+#define DATALOG_VALUE_SIZE 4
+#define DATALOG_HEADER_SIZE_MAX (16 + DATALOG_MAX_CHANNELS * (2 + DATALOG_MAX_NAME_LENGTH) + 4)
+
+// records between sync markers
+#define DATALOG_SYNC_INTERVAL 64
+// records the ring holds, must be a power of 2 so the free-running indices wrap
+#define DATALOG_RING_LENGTH 128
+// size of each of the file's write-behind buffers
+#define DATALOG_WRITE_BUFFER 4096
+// how often the writer drains the ring
+#define DATALOG_WRITER_PERIOD 20
+
+typedef enum datalog_source_e {
+	E_DATALOG_SOURCE_INT_GETTER,
+	E_DATALOG_SOURCE_DOUBLE_GETTER,
+	E_DATALOG_SOURCE_VARIABLE
+} datalog_source_e_t;
+
+typedef struct datalog_channel {
+	char name[DATALOG_MAX_NAME_LENGTH + 1];
+	datalog_type_e_t type;
+	datalog_source_e_t source;
+	uint8_t port;
+	union {
+		int32_t (*int_getter)(uint8_t);
+		double (*double_getter)(uint8_t);
+		const volatile void* variable;
+	};
+} datalog_channel_s_t;
+
+typedef enum datalog_state_e { E_DATALOG_IDLE = 0, E_DATALOG_RUNNING, E_DATALOG_STOPPING } datalog_state_e_t;
+
+static datalog_channel_s_t channels[DATALOG_MAX_CHANNELS];
+static uint32_t channel_count;
+
+static static_sem_s_t datalog_mtx_buf;
+static mutex_t datalog_mtx;  // serializes the API functions
+static static_sem_s_t datalog_done_buf;
+static sem_t datalog_done;  // posted by the writer once a stopped log is closed
+
+static volatile datalog_state_e_t state;
+static volatile bool sampler_idle = true;  // the sampler has seen that state isn't running
+static uint32_t period;
+static int fd = -1;
+static datalog_stats_s_t stats;
+
+static uint8_t* ring;
+static uint32_t record_size;
+static uint32_t ring_head;  // next record to be filled by the sampler
+static uint32_t ring_tail;  // next record to be written by the writer
+
+// writer state for the current block of records
+static uint32_t block_records;
+static uint32_t block_crc;
+static uint32_t records_written;
+
+static task_stack_t sampler_task_stack[TASK_STACK_DEPTH_MIN];
+static static_task_s_t sampler_task_buffer;
+static task_t sampler_task;
+static task_stack_t writer_task_stack[TASK_STACK_DEPTH_MIN];
+static static_task_s_t writer_task_buffer;
+static task_t writer_task;
+
+static inline void _put_u16(uint8_t* dest, uint16_t value) {
+	dest[0] = value & 0xFF;
+	dest[1] = value >> 8;
+}
+
+static inline void _put_u32(uint8_t* dest, uint32_t value) {
+	_put_u16(dest, value & 0xFFFF);
+	_put_u16(dest + 2, value >> 16);
+}
+
+/******************************************************************************/
+/**                                 Sampler                                  **/
+/******************************************************************************/
+static void _sample(uint8_t* record) {
+	_put_u32(record, (uint32_t)micros());
+	uint8_t* value = record + DATALOG_TIMESTAMP_SIZE;
+	for (uint32_t i = 0; i < channel_count; i++, value += DATALOG_VALUE_SIZE) {
+		datalog_channel_s_t* ch = &channels[i];
+		union {
+			int32_t i;
+			float f;
+			uint32_t raw;
+		} v;
+		switch (ch->source) {
+			case E_DATALOG_SOURCE_INT_GETTER:
+				v.i = ch->int_getter(ch->port);
+				break;
+			case E_DATALOG_SOURCE_DOUBLE_GETTER:
+				v.f = (float)ch->double_getter(ch->port);
+				break;
+			case E_DATALOG_SOURCE_VARIABLE:
+			default:
+				v.raw = *(const volatile uint32_t*)ch->variable;
+				break;
+		}
+		_put_u32(value, v.raw);
+	}
+}
+
+static void sampler_task_fn(void* ign) {
+	uint32_t next = millis();
+	while (true) {
+		if (state != E_DATALOG_RUNNING) {
+			sampler_idle = true;
+			task_notify_take(true, TIMEOUT_MAX);
+			next = millis();
+			continue;
+		}
+
+		uint32_t head = ring_head;
+		if (unlikely(head - __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) >= DATALOG_RING_LENGTH)) {
+			stats.dropped++;
+		} else {
+			_sample(ring + (head % DATALOG_RING_LENGTH) * record_size);
+			__atomic_store_n(&ring_head, head + 1, __ATOMIC_RELEASE);
+			stats.records++;
+		}
+		task_delay_until(&next, period);
+	}
+}
+
+/******************************************************************************/
+/**                                  Writer                                  **/
+/******************************************************************************/
+// Writes all of data to the log. The file's write-behind buffer only accepts
+// part of a write when it is full, so wait for it to drain instead of leaving
+// a torn record in the file
+static void _write_all(const uint8_t* data, size_t len) {
+	while (len > 0 && fd >= 0) {
+		ssize_t n = write(fd, data, len);
+		if (n > 0) {
+			data += n;
+			len -= n;
+			stats.written += n;
+		} else if (errno == EAGAIN) {
+			task_delay(DATALOG_WRITER_PERIOD);
+		} else {
+			stats.errors++;
+			return;
+		}
+	}
+}
+
+static void _write_sync(void) {
+	uint8_t sync[DATALOG_SYNC_SIZE];
+	memcpy(sync, DATALOG_SYNC_MAGIC, 4);
+	_put_u32(sync + 4, records_written);
+	_put_u32(sync + 8, stats.dropped);
+	_put_u32(sync + 12, block_crc ^ 0xFFFFFFFF);
+	_write_all(sync, sizeof(sync));
+	block_records = 0;
+	block_crc = CRC32_INIT;
+}
+
+static void _drain(void) {
+	uint32_t head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+	while (ring_tail != head) {
+		// a contiguous run of records that doesn't wrap or cross a sync marker
+		uint32_t slot = ring_tail % DATALOG_RING_LENGTH;
+		uint32_t count = head - ring_tail;
+		if (count > DATALOG_RING_LENGTH - slot) {
+			count = DATALOG_RING_LENGTH - slot;
+		}
+		if (count > DATALOG_SYNC_INTERVAL - block_records) {
+			count = DATALOG_SYNC_INTERVAL - block_records;
+		}
+		const uint8_t* data = ring + slot * record_size;
+		block_crc = crc32(block_crc, data, count * record_size);
+		_write_all(data, count * record_size);
+		block_records += count;
+		records_written += count;
+		__atomic_store_n(&ring_tail, ring_tail + count, __ATOMIC_RELEASE);
+		if (block_records == DATALOG_SYNC_INTERVAL) {
+			_write_sync();
+		}
+	}
+}
+
+static void writer_task_fn(void* ign) {
+	while (true) {
+		if (state == E_DATALOG_IDLE) {
+			task_notify_take(true, TIMEOUT_MAX);
+			continue;
+		}
+		_drain();
+		if (state == E_DATALOG_STOPPING && sampler_idle) {
+			// the sampler won't add anything else
+			_drain();
+			if (block_records > 0) {
+				_write_sync();
+			}
+			close(fd);
+			fd = -1;
+			state = E_DATALOG_IDLE;
+			sem_post(datalog_done);
+			continue;
+		}
+		task_delay(DATALOG_WRITER_PERIOD);
+	}
+}
+
+/******************************************************************************/
+/**                               Public API                                 **/
+/******************************************************************************/
+void datalog_initialize(void) {
+	datalog_mtx = mutex_create_static(&datalog_mtx_buf);
+	datalog_done = sem_create_static(1, 0, &datalog_done_buf);
+	sampler_task = task_create_static(sampler_task_fn, NULL, TASK_PRIORITY_DEFAULT + 2, TASK_STACK_DEPTH_MIN,
+	                                  "Data Log Sampler (PROS)", sampler_task_stack, &sampler_task_buffer);
+	writer_task = task_create_static(writer_task_fn, NULL, TASK_PRIORITY_MIN + 1, TASK_STACK_DEPTH_MIN,
+	                                 "Data Log Writer (PROS)", writer_task_stack, &writer_task_buffer);
+}
+
+static int32_t _add_channel(const char* name, datalog_type_e_t type, datalog_source_e_t source, uint8_t port,
+                            const void* fn) {
+	if (name == NULL || fn == NULL || type > E_DATALOG_FLOAT) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	mutex_take(datalog_mtx, TIMEOUT_MAX);
+	if (state != E_DATALOG_IDLE) {
+		mutex_give(datalog_mtx);
+		errno = EBUSY;
+		return PROS_ERR;
+	}
+	if (channel_count == DATALOG_MAX_CHANNELS) {
+		mutex_give(datalog_mtx);
+		errno = ENOSPC;
+		return PROS_ERR;
+	}
+	datalog_channel_s_t* ch = &channels[channel_count];
+	strncpy(ch->name, name, DATALOG_MAX_NAME_LENGTH);
+	ch->name[DATALOG_MAX_NAME_LENGTH] = '\0';
+	ch->type = type;
+	ch->source = source;
+	ch->port = port;
+	ch->variable = fn;
+	int32_t index = channel_count++;
+	mutex_give(datalog_mtx);
+	return index;
+}
+
+int32_t datalog_add_int(const char* name, int32_t (*getter)(uint8_t port), uint8_t port) {
+	return _add_channel(name, E_DATALOG_INT32, E_DATALOG_SOURCE_INT_GETTER, port, (const void*)getter);
+}
+
+int32_t datalog_add_double(const char* name, double (*getter)(uint8_t port), uint8_t port) {
+	return _add_channel(name, E_DATALOG_FLOAT, E_DATALOG_SOURCE_DOUBLE_GETTER, port, (const void*)getter);
+}
+
+int32_t datalog_add_variable(const char* name, datalog_type_e_t type, const volatile void* variable) {
+	return _add_channel(name, type, E_DATALOG_SOURCE_VARIABLE, 0, (const void*)variable);
+}
+
+int32_t datalog_clear_channels(void) {
+	mutex_take(datalog_mtx, TIMEOUT_MAX);
+	if (state != E_DATALOG_IDLE) {
+		mutex_give(datalog_mtx);
+		errno = EBUSY;
+		return PROS_ERR;
+	}
+	channel_count = 0;
+	mutex_give(datalog_mtx);
+	return PROS_SUCCESS;
+}
+
+static void _write_header(void) {
+	// too big for the stack of the calling task
+	static uint8_t header[DATALOG_HEADER_SIZE_MAX];
+	memcpy(header, DATALOG_MAGIC, 4);
+	header[4] = DATALOG_VERSION;
+	header[5] = channel_count;
+	_put_u16(header + 6, record_size);
+	_put_u32(header + 8, period);
+	_put_u32(header + 12, millis());
+	size_t len = 16;
+	for (uint32_t i = 0; i < channel_count; i++) {
+		size_t name_len = strlen(channels[i].name);
+		header[len++] = channels[i].type;
+		header[len++] = name_len;
+		memcpy(header + len, channels[i].name, name_len);
+		len += name_len;
+	}
+	_put_u32(header + len, crc32(CRC32_INIT, header, len) ^ 0xFFFFFFFF);
+	len += 4;
+	_write_all(header, len);
+}
+
+int32_t datalog_start(const char* path, uint32_t sample_period) {
+	mutex_take(datalog_mtx, TIMEOUT_MAX);
+	if (state != E_DATALOG_IDLE) {
+		mutex_give(datalog_mtx);
+		errno = EBUSY;
+		return PROS_ERR;
+	}
+	if (channel_count == 0 || sample_period == 0) {
+		mutex_give(datalog_mtx);
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+
+	uint32_t size = DATALOG_TIMESTAMP_SIZE + channel_count * DATALOG_VALUE_SIZE;
+	if (size != record_size || ring == NULL) {
+		kfree(ring);
+		ring = (uint8_t*)kmalloc(size * DATALOG_RING_LENGTH);
+		if (ring == NULL) {
+			mutex_give(datalog_mtx);
+			errno = ENOMEM;
+			return PROS_ERR;
+		}
+		record_size = size;
+	}
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC);
+	if (fd < 0) {
+		mutex_give(datalog_mtx);
+		return PROS_ERR;
+	}
+	// if the buffer can't be allocated, the writer still works unbuffered
+	fdctl(fd, USDCTL_SET_WRITE_BUFFER, (void*)DATALOG_WRITE_BUFFER);
+
+	memset(&stats, 0, sizeof(stats));
+	period = sample_period;
+	ring_head = ring_tail = 0;
+	block_records = 0;
+	block_crc = CRC32_INIT;
+	records_written = 0;
+	_write_header();
+
+	sampler_idle = false;
+	state = E_DATALOG_RUNNING;
+	task_notify(sampler_task);
+	task_notify(writer_task);
+	mutex_give(datalog_mtx);
+	return PROS_SUCCESS;
+}
+
+int32_t datalog_stop(void) {
+	mutex_take(datalog_mtx, TIMEOUT_MAX);
+	if (state != E_DATALOG_RUNNING) {
+		mutex_give(datalog_mtx);
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	state = E_DATALOG_STOPPING;
+	// the writer closes the file once the sampler has stopped and the ring is
+	// empty
+	sem_wait(datalog_done, TIMEOUT_MAX);
+	mutex_give(datalog_mtx);
+	return PROS_SUCCESS;
+}
+
+int32_t datalog_get_stats(datalog_stats_s_t* dest) {
+	if (dest == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	*dest = stats;
+	return PROS_SUCCESS;
+}
@@ -6,6 +6,12 @@
  * Contains the driver for writing to any smart port with no regard to the
  * device on the other end.
  *
+ * Data is exchanged with the device through kernel rings which are serviced by
+ * the VDML background processing, so blocked readers and writers are woken as
+ * soon as data arrives or space frees up instead of polling the port. Using the
+ * pros/serial.h functions on a port that is open through /dev bypasses the
+ * rings and will steal data from the file.
+ *
  * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
  * All rights reserved.
  *
@@ -31,30 +37,174 @@
 
 #define ASCII_ZERO 48
 
+// size of the kernel side receive and transmit rings of each open port
+#define DEV_RX_BUFFER_SIZE 1024
+#define DEV_TX_BUFFER_SIZE 512
+
 typedef struct dev_file_arg {
 	uint32_t port;
 	int flags;
+	uint32_t read_timeout;
 } dev_file_arg_t;
 
+#define DEV_FILE_POOL_SIZE 8
+POOL_STATIC(dev_file_pool, sizeof(dev_file_arg_t), DEV_FILE_POOL_SIZE);
+
+/**
+ * Kernel side state of a smart port opened through /dev/N, shared by every file
+ * open on the port.
+ *
+ * The VDML background processing (see dev_background_processing) is the only
+ * writer of the rx ring and the only reader of the tx ring. Stream buffers
+ * only support a single blocked reader and a single blocked writer, so tasks
+ * serialize on read_mtx and write_mtx before touching the rings.
+ *
+ * Tasks reading or writing count themselves in readers and writers, so that
+ * closing the last file doesn't free the state under them. Instead, the port
+ * is marked as closing, blocked readers are woken, and whoever leaves last
+ * frees it. The counts and closing are protected by the port mutex.
+ */
+typedef struct dev_port {
+	stream_buf_t rx;
+	stream_buf_t tx;
+	mutex_t read_mtx;
+	mutex_t write_mtx;
+	uint32_t refs;     // open files
+	uint32_t readers;  // tasks in dev_read_r
+	uint32_t writers;  // tasks in dev_write_r
+	bool closing;
+} dev_port_s_t;
+
+// entries are only created or destroyed while holding the port's mutex, which
+// the system daemon also holds during dev_background_processing
+static dev_port_s_t* dev_ports[NUM_V5_PORTS];
+
+static uint8_t dev_scratch_buf[DEV_RX_BUFFER_SIZE];
+
+/**
+ * Moves data between the generic serial devices and the kernel rings of every
+ * port open through /dev/N. Receiving into the rx ring wakes a blocked reader,
+ * and draining the tx ring wakes a blocked writer.
+ *
+ * Called by vdml_background_processing() while all the port mutexes are held.
+ */
+void dev_background_processing(void) {
+	for (uint8_t port = 0; port < NUM_V5_PORTS; port++) {
+		dev_port_s_t* state = dev_ports[port];
+		if (state == NULL) {
+			continue;
+		}
+		V5_DeviceT device = registry_get_device(port)->device_info;
+
+		int32_t avail = vexDeviceGenericSerialReceiveAvail(device);
+		size_t space = stream_buf_get_unused(state->rx);
+		if (avail > 0 && space > 0) {
+			int32_t len = vexDeviceGenericSerialReceive(device, dev_scratch_buf, (size_t)avail < space ? avail : space);
+			if (len > 0) {
+				stream_buf_send(state->rx, dev_scratch_buf, len, 0);
+			}
+		}
+
+		int32_t write_free = vexDeviceGenericSerialWriteFree(device);
+		if (write_free > 0 && stream_buf_get_used(state->tx) > 0) {
+			if (write_free > DEV_TX_BUFFER_SIZE) {
+				write_free = DEV_TX_BUFFER_SIZE;
+			}
+			size_t len = stream_buf_recv(state->tx, dev_scratch_buf, write_free, 0);
+			if (len > 0) {
+				vexDeviceGenericSerialTransmit(device, dev_scratch_buf, len);
+			}
+		}
+	}
+}
+
+// frees the state of a port, which may be partly created
+static void dev_port_free(dev_port_s_t* state) {
+	if (state->rx) stream_buf_delete(state->rx);
+	if (state->tx) stream_buf_delete(state->tx);
+	if (state->read_mtx) mutex_delete(state->read_mtx);
+	if (state->write_mtx) mutex_delete(state->write_mtx);
+	kfree(state);
+}
+
+// drops a file's reference to a port, tearing the port down with the last one
+static void dev_port_unref(uint8_t port) {
+	port_mutex_take(port);
+	dev_port_s_t* state = dev_ports[port];
+	if (--state->refs == 0) {
+		if (state->readers == 0 && state->writers == 0) {
+			dev_ports[port] = NULL;
+			dev_port_free(state);
+		} else {
+			state->closing = true;
+			if (state->readers > 0) {
+				// wakes a reader blocked on the empty ring, which then sees that
+				// the port is closing and never hands this byte out. Blocked
+				// writers wake as the background processing drains the tx ring
+				uint8_t wake = 0;
+				stream_buf_send(state->rx, &wake, 1, 0);
+			}
+		}
+	}
+	port_mutex_give(port);
+}
+
+// gets the state of a port for a read or write, or NULL if it is closing
+static dev_port_s_t* dev_port_enter(uint8_t port, bool reading) {
+	port_mutex_take(port);
+	dev_port_s_t* state = dev_ports[port];
+	if (state == NULL || state->closing) {
+		state = NULL;
+	} else if (reading) {
+		state->readers++;
+	} else {
+		state->writers++;
+	}
+	port_mutex_give(port);
+	return state;
+}
+
+// ends a read or write, freeing the port if it was closed in the meantime and
+// this was the last task using it
+static void dev_port_leave(uint8_t port, dev_port_s_t* state, bool reading) {
+	port_mutex_take(port);
+	if (reading) {
+		state->readers--;
+	} else {
+		state->writers--;
+	}
+	if (state->closing && state->readers == 0 && state->writers == 0) {
+		dev_ports[port] = NULL;
+		dev_port_free(state);
+	}
+	port_mutex_give(port);
+}
+
 /******************************************************************************/
 /**                         newlib driver functions                          **/
 /******************************************************************************/
 int dev_read_r(struct _reent* r, void* const arg, uint8_t* buffer, const size_t len) {
 	dev_file_arg_t* file_arg = (dev_file_arg_t*)arg;
-	uint32_t port = file_arg->port;
-	int32_t recv = 0;
-	while (true) {
-		recv = serial_read(port, (uint8_t*)(buffer + recv), len - recv);
-		if (recv == PROS_ERR) {
-			return 0;
-		}
-		if (file_arg->flags & O_NONBLOCK || recv >= 1) {
-			break;
-		}
-		task_delay(2);
+	uint8_t port = file_arg->port - 1;
+	uint32_t timeout = file_arg->flags & O_NONBLOCK ? 0 : file_arg->read_timeout;
+	dev_port_s_t* state = dev_port_enter(port, true);
+	if (state == NULL) {
+		r->_errno = EBADF;
+		return 0;
+	}
+
+	mutex_take(state->read_mtx, TIMEOUT_MAX);
+	size_t recv = state->closing ? 0 : stream_buf_recv(state->rx, buffer, len, timeout);
+	mutex_give(state->read_mtx);
+	bool closing = state->closing;
+	dev_port_leave(port, state, true);
+
+	if (closing) {
+		r->_errno = EBADF;
+		return 0;
 	}
 	if (recv == 0) {
-		errno = EAGAIN;
+		r->_errno = EAGAIN;
 		return 0;
 	}
 	return recv;
@@ -62,27 +212,40 @@ int dev_read_r(struct _reent* r, void* const arg, uint8_t* buffer, const size_t
 
 int dev_write_r(struct _reent* r, void* const arg, const uint8_t* buf, const size_t len) {
 	dev_file_arg_t* file_arg = (dev_file_arg_t*)arg;
-	uint32_t port = file_arg->port;
-	int32_t wrtn = 0;
-	while (true) {
-		int32_t w = serial_write(port, (uint8_t*)(buf + wrtn), len - wrtn);
-		if (w == PROS_ERR) {
-			return wrtn;
-		}
-		wrtn += w;
-		if (file_arg->flags & O_NONBLOCK || wrtn >= len) {
-			break;
+	uint8_t port = file_arg->port - 1;
+	size_t wrtn = 0;
+	dev_port_s_t* state = dev_port_enter(port, false);
+	if (state == NULL) {
+		r->_errno = EBADF;
+		return 0;
+	}
+
+	mutex_take(state->write_mtx, TIMEOUT_MAX);
+	if (file_arg->flags & O_NONBLOCK) {
+		size_t space = stream_buf_get_unused(state->tx);
+		wrtn = stream_buf_send(state->tx, buf, len < space ? len : space, 0);
+	} else {
+		// a stream buffer only unblocks a sender once the whole payload fits, so
+		// never ask for more than the ring can hold
+		while (wrtn < len && !state->closing) {
+			size_t chunk = len - wrtn < DEV_TX_BUFFER_SIZE ? len - wrtn : DEV_TX_BUFFER_SIZE;
+			wrtn += stream_buf_send(state->tx, buf + wrtn, chunk, TIMEOUT_MAX);
 		}
-		task_delay(2);
 	}
+	mutex_give(state->write_mtx);
+	dev_port_leave(port, state, false);
+
 	if (wrtn == 0) {
-		errno = EAGAIN;
+		r->_errno = EAGAIN;
 		return 0;
 	}
 	return wrtn;
 }
 
 int dev_close_r(struct _reent* r, void* const arg) {
+	dev_file_arg_t* file_arg = (dev_file_arg_t*)arg;
+	dev_port_unref(file_arg->port - 1);
+	kpool_free(&dev_file_pool, file_arg);
 	return 0;
 }
 
@@ -106,13 +269,17 @@ off_t dev_lseek_r(struct _reent* r, void* const arg, off_t ptr, int dir) {
 int dev_ctl(void* const arg, const uint32_t cmd, void* const extra_arg) {
 	dev_file_arg_t* file_arg = (dev_file_arg_t*)arg;
 	uint32_t port = file_arg->port;
+	dev_port_s_t* state = dev_ports[port - 1];
 	switch (cmd) {
 		case DEVCTL_FIONREAD:
-			return serial_get_read_avail(port);
+			return stream_buf_get_used(state->rx);
 		case DEVCTL_FIONWRITE:
-			return serial_get_write_free(port);
+			return stream_buf_get_unused(state->tx);
 		case DEVCTL_SET_BAUDRATE:
 			return serial_set_baudrate(port, (int32_t)extra_arg);
+		case DEVCTL_SET_READ_TIMEOUT:
+			file_arg->read_timeout = (uint32_t)extra_arg;
+			return 0;
 		default:
 			errno = EINVAL;
 			return PROS_ERR;
@@ -159,10 +326,55 @@ int dev_open_r(struct _reent* r, const char* path, int flags, int mode) {
 	} else {
 		port = path[0] - ASCII_ZERO;
 	}
-	serial_enable(port);
+	if (serial_enable(port) == PROS_ERR) {
+		r->_errno = errno;
+		return -1;
+	}
+
+	port_mutex_take(port - 1);
+	dev_port_s_t* state = dev_ports[port - 1];
+	if (state != NULL && state->closing) {
+		// still in use by tasks that were reading or writing when it was closed
+		port_mutex_give(port - 1);
+		r->_errno = EBUSY;
+		return -1;
+	}
+	if (state == NULL) {
+		state = (dev_port_s_t*)kmalloc(sizeof(dev_port_s_t));
+		if (state == NULL) {
+			port_mutex_give(port - 1);
+			r->_errno = ENOMEM;
+			return -1;
+		}
+		memset(state, 0, sizeof(*state));
+		state->rx = stream_buf_create(DEV_RX_BUFFER_SIZE, 1);
+		state->tx = stream_buf_create(DEV_TX_BUFFER_SIZE, 1);
+		state->read_mtx = mutex_create();
+		state->write_mtx = mutex_create();
+		if (!state->rx || !state->tx || !state->read_mtx || !state->write_mtx) {
+			dev_port_free(state);
+			port_mutex_give(port - 1);
+			r->_errno = ENOMEM;
+			return -1;
+		}
+		dev_ports[port - 1] = state;
+	}
+	state->refs++;
+	port_mutex_give(port - 1);
 
-	dev_file_arg_t* arg = (dev_file_arg_t*)kmalloc(sizeof(dev_file_arg_t));
+	dev_file_arg_t* arg = (dev_file_arg_t*)kpool_alloc(&dev_file_pool, sizeof(dev_file_arg_t));
+	if (arg == NULL) {
+		dev_port_unref(port - 1);
+		r->_errno = ENOMEM;
+		return -1;
+	}
 	arg->port = port;
 	arg->flags = flags;
-	return vfs_add_entry_r(r, dev_driver, arg);
+	arg->read_timeout = TIMEOUT_MAX;
+	int fd = vfs_add_entry_r(r, dev_driver, arg);
+	if (fd < 0) {
+		kpool_free(&dev_file_pool, arg);
+		dev_port_unref(port - 1);
+	}
+	return fd;
 }
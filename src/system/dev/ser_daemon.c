@@ -16,6 +16,7 @@
  */
 
 #include <errno.h>
+#include <string.h>
 
 #include "kapi.h"
 #include "system/dev/banners.h"
@@ -94,91 +95,114 @@ int32_t inp_buffer_available() {
 static task_stack_t ser_daemon_stack[TASK_STACK_DEPTH_MIN];
 static static_task_s_t ser_daemon_task_buffer;
 
-static inline uint8_t vex_read_char() {
-	int32_t b = vexSerialReadChar(1);
-	while (b == -1L) {
-		task_delay(1);
-		b = vexSerialReadChar(1);
+// maximum number of bytes drained from the VEX serial input in one pass
+#define INP_BATCH_SIZE 256
+
+// Command parser state. Commands may be split across batches, so this is kept
+// between passes over the input
+static uint8_t command_stack[MAX_COMMAND_LENGTH];
+static size_t command_stack_idx = 0;
+
+static uint8_t batch_buf[INP_BATCH_SIZE];
+// payload bytes to forward to the input buffer. Failed commands are replayed
+// in here too, so it may be slightly larger than a batch
+static uint8_t payload_buf[INP_BATCH_SIZE + MAX_COMMAND_LENGTH];
+
+// drains everything that's currently waiting on the serial line into buffer
+static size_t vex_read_available(uint8_t* buffer, size_t len) {
+	size_t read = 0;
+	while (read < len) {
+		int32_t b = vexSerialReadChar(1);
+		// Don't get rid of the literal type suffix, it ensures optimiziations don't
+		// break this condition
+		if (b == -1L) {
+			break;
+		}
+		buffer[read++] = (uint8_t)b;
 	}
-	// Don't get rid of the literal type suffix, it ensures optimiziations don't
-	// break this condition
-	return (uint8_t)b;
+	return read;
 }
 
-static void ser_daemon_task(void* ign) {
-	uint8_t command_stack[MAX_COMMAND_LENGTH];
-	size_t command_stack_idx = 0;
+// Feeds one byte into the command parser. Returns true if the byte was consumed
+// as part of a command. If the bytes on the command stack turn out not to be a
+// command, they're replayed as payload
+static bool parse_command_byte(uint8_t b, uint8_t* payload, size_t* payload_len) {
+	if (command_stack_idx == 0) {
+		if (b != 'p') {  // TODO: make the command prefix not typeable
+			return false;
+		}
+		command_stack[command_stack_idx++] = b;
+		return true;
+	}
+
+	command_stack[command_stack_idx++] = b;
+	if (command_stack_idx == 2) {
+		if (b != 'R') {
+			// empty out the command stack onto the input buffer since something
+			// wasn't right with the command
+			memcpy(payload + *payload_len, command_stack, command_stack_idx);
+			*payload_len += command_stack_idx;
+			command_stack_idx = 0;
+		}
+		return true;
+	}
+
+	switch (command_stack[2]) {
+		case 'a':
+			fprintf(stderr, "I'm alive!\n");
+			break;
+		case 'b':
+			task_delay(20);
+			print_small_banner();
+			break;
+		case 'B':
+			task_delay(20);
+			print_large_banner();
+			break;
+		case 'e':
+		case 'd':
+			// need to read the next 4 bytes (the stream id) before acting
+			if (command_stack_idx < 7) {
+				return true;
+			}
+			// the parameter expected to serctl is the stream id (a uint32_t), so
+			// we need to cast to a uint32_t pointer, dereference it, and cast to a
+			// void* to make the compiler happy
+			serctl(command_stack[2] == 'e' ? SERCTL_ACTIVATE : SERCTL_DEACTIVATE,
+			       (void*)(*(uint32_t*)(command_stack + 3)));
+			break;
+		case 'c':
+			serctl(SERCTL_ENABLE_COBS, NULL);
+			break;
+		case 'r':
+			serctl(SERCTL_DISABLE_COBS, NULL);
+			break;
+		default:
+			break;
+	}
+	command_stack_idx = 0;
+	return true;
+}
 
+static void ser_daemon_task(void* ign) {
 	print_large_banner();
 
 	while (1) {
-		uint8_t b = vex_read_char();
-		if (b == 'p') {  // TODO: make the command prefix not typeable
-			command_stack[command_stack_idx++] = b;
-			b = command_stack[command_stack_idx++] = vex_read_char();
-			if (b == 'R') {
-				b = command_stack[command_stack_idx++] = vex_read_char();
-				switch (b) {
-					case 'a':
-						fprintf(stderr, "I'm alive!\n");
-						command_stack_idx = 0;
-						break;
-					case 'b':
-						task_delay(20);
-						print_small_banner();
-						command_stack_idx = 0;
-						break;
-					case 'B':
-						task_delay(20);
-						print_large_banner();
-						command_stack_idx = 0;
-						break;
-					case 'e':
-						// read next 4 bytes
-						command_stack[command_stack_idx++] = vex_read_char();
-						command_stack[command_stack_idx++] = vex_read_char();
-						command_stack[command_stack_idx++] = vex_read_char();
-						command_stack[command_stack_idx++] = vex_read_char();
-						// the parameter expected to serctl is the stream id (a uint32_t), so
-						// we
-						// need to cast to a uint32_t pointer, dereference it, and cast to a
-						// void* to make the compiler happy
-						serctl(SERCTL_ACTIVATE, (void*)(*(uint32_t*)(command_stack + 3)));
-						// printf("enabled %s\n", command_stack + 3);
-						command_stack_idx = 0;
-						break;
-					case 'd':
-						// read next 4 bytes
-						command_stack[command_stack_idx++] = vex_read_char();
-						command_stack[command_stack_idx++] = vex_read_char();
-						command_stack[command_stack_idx++] = vex_read_char();
-						command_stack[command_stack_idx++] = vex_read_char();
-						serctl(SERCTL_DEACTIVATE, (void*)(*(uint32_t*)(command_stack + 3)));
-						// printf("disabled %s\n", command_stack+3);
-						command_stack_idx = 0;
-						break;
-					case 'c':
-						serctl(SERCTL_ENABLE_COBS, NULL);
-						command_stack_idx = 0;
-						break;
-					case 'r':
-						serctl(SERCTL_DISABLE_COBS, NULL);
-						command_stack_idx = 0;
-						break;
-					default:
-						command_stack_idx = 0;
-						break;
-				}
-			}
+		size_t len = vex_read_available(batch_buf, INP_BATCH_SIZE);
+		if (len == 0) {
+			task_delay(1);
+			continue;
+		}
 
-			for (size_t i = 0; i < command_stack_idx; i++) {
-				// empty out the command stack onto the input buffer since something
-				// wasn't right with the command
-				inp_buffer_post(command_stack[i]);
+		size_t payload_len = 0;
+		for (size_t i = 0; i < len; i++) {
+			if (!parse_command_byte(batch_buf[i], payload_buf, &payload_len)) {
+				payload_buf[payload_len++] = batch_buf[i];
 			}
-			command_stack_idx = 0;
-		} else {
-			inp_buffer_post(b);
+		}
+
+		if (payload_len) {
+			stream_buf_send(inp_stream, payload_buf, payload_len, TIMEOUT_MAX);
 		}
 	}
 }
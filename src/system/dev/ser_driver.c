@@ -17,6 +17,7 @@
 #include <string.h>
 
 #include "common/cobs.h"
+#include "common/linkedlist.h"
 #include "common/set.h"
 #include "common/string.h"
 #include "kapi.h"
@@ -38,11 +39,6 @@ typedef struct ser_file_arg {
 	enum { E_NOBLK_WRITE = 1 } flags;
 } ser_file_s_t;
 
-#define STDIN_STREAM_ID 0x706e6973   // 'sinp' little endian
-#define STDOUT_STREAM_ID 0x74756f73  // 'sout' little endian
-#define STDERR_STREAM_ID 0x72726573  // 'serr' little endian
-#define KDBG_STREAM_ID 0x6762646b    // 'kdbg' little endian
-
 // This array contains the serial driver's arguments for the 4 reserved file
 // descriptors. The fact that this array matches the order of the 4 reserved
 // file descriptors is mostly irrelevant. We do need to know which one is which,
@@ -54,17 +50,54 @@ static ser_file_s_t RESERVED_SER_FILES[] = {
     {.stream_id = KDBG_STREAM_ID, .flags = 0},
 };
 
+// arguments of the other streams opened through /ser
+#define SER_FILE_POOL_SIZE 8
+POOL_STATIC(ser_file_pool, sizeof(ser_file_s_t), SER_FILE_POOL_SIZE);
+
 // These mutexes are initialized in ser_driver_initialize
 static static_sem_s_t read_mtx_buf;
-static static_sem_s_t write_mtx_buf;
-static mutex_t read_mtx;   // ensures that only one read is happening at a time
-static mutex_t write_mtx;  // ensures that only one write is happening at a time
-
-// Write buffer as a stream buffer. Initialized below in ser_driver_initialize
-static static_stream_buf_s_t write_stream_buf;
-static uint8_t write_buf[VEX_SERIAL_BUFFER_SIZE + 1];
+static static_sem_s_t stream_mtx_buf;
+static static_sem_s_t task_bufs_mtx_buf;
+static mutex_t read_mtx;  // ensures that only one read is happening at a time
+// protects the stream table. Only ever held briefly, never while waiting for
+// room in the output queue
+static mutex_t stream_mtx;
+static mutex_t task_bufs_mtx;  // protects the list of task buffers
+
+// Output queue, one stream buffer per priority class so that bulk data on low
+// priority streams can't starve error messages. Each class has its own writer
+// mutex, so a writer waiting for room in a full class only holds up writers of
+// that class. Initialized below in ser_driver_initialize
+struct ser_output_class {
+	static_stream_buf_s_t stream_buf;
+	uint8_t buf[VEX_SERIAL_BUFFER_SIZE + 1];
+	stream_buf_t stream;
+	static_sem_s_t mtx_buf;
+	mutex_t mtx;          // held by the class's one writer, keeps packets whole
+	ser_stats_s_t stats;  // counts bytes on the wire (i.e. after COBS encoding)
+};
+static struct ser_output_class output_classes[SER_PRIORITY_CLASSES];
 static uint8_t write_scratch_buf[VEX_SERIAL_BUFFER_SIZE];  // scratch buffer
-static stream_buf_t write_stream;
+
+// Priority class which was left in the middle of a COBS packet by the last
+// flush, or -1. That class must be drained first so packets aren't interleaved
+static int32_t partial_packet_class = -1;
+
+// Per-stream output configuration and statistics. Entries are created the
+// first time a stream is written to or configured. Protected by stream_mtx
+#define SER_MAX_STREAM_ENTRIES 16
+struct ser_stream_entry {
+	uint32_t stream_id;
+	ser_priority_e_t priority;
+	ser_drop_policy_e_t drop_policy;
+	uint32_t queued;   // payload bytes accepted into the output queue
+	uint32_t dropped;  // payload bytes dropped
+};
+static struct ser_stream_entry stream_entries[SER_MAX_STREAM_ENTRIES];
+static size_t stream_entries_count = 0;
+// used for streams once the table is full
+static struct ser_stream_entry overflow_stream_entry = {
+    .stream_id = 0, .priority = E_SER_PRIORITY_LOW, .drop_policy = E_SER_DROP_BLOCK};
 
 // We maintain a set of streams which should actually be sent over the serial
 // line. This is maintained as a separate list and don't traverse through
@@ -90,6 +123,39 @@ static enum { E_COBS_ENABLED = 1 } ser_driver_runtime_config;
 // comes from ser_daemon
 extern int32_t inp_buffer_read(uint32_t timeout);
 
+// NOTE: can't just include task.h because of redefinition that goes on in kapi
+//       include chain, so we just prototype what we need here
+void* pvTaskGetThreadLocalStoragePointer(task_t xTaskToQuery, int32_t xIndex);
+void vTaskSetThreadLocalStoragePointer(task_t xTaskToSet, int32_t xIndex, void* pvValue);
+
+// thread local storage index of a task's output buffer. Indices 0 and 1 are
+// used by task_notify_when_deleting
+#define SER_TASK_BUF_TLSP_IDX 2
+
+// largest output buffer that a task may request
+#define SER_TASK_BUFFER_MAX 1024
+
+// Per-task output buffer, enabled with serctl(SERCTL_TASK_BUFFER, ...). Only
+// the owning task appends to the buffer. The system daemon may also empty it
+// (for the time-based flush policy), so appends happen with the scheduler
+// suspended and whoever flushes first claims the buffer with flushing
+struct ser_task_buf {
+	uint32_t stream_id;    // stream that the buffered data belongs to
+	uint32_t first_write;  // time at which the buffer became non-empty
+	ser_flush_policy_e_t policy;
+	uint32_t period;
+	size_t size;
+	size_t used;
+	bool flushing;
+	task_t flusher;  // the task holding the flushing claim
+	uint8_t data[];
+};
+
+// all of the task buffers, so that the system daemon can flush them on time.
+// Protected by task_bufs_mtx
+static linked_list_s_t* task_bufs;
+static uint8_t task_buf_scratch[SER_TASK_BUFFER_MAX];
+
 /******************************************************************************/
 /**                              Output queue                                **/
 /**                                                                          **/
@@ -99,16 +165,461 @@ extern int32_t inp_buffer_read(uint32_t timeout);
 /** underlying access to the write buffer, as opposed to calling queue_recv  **/
 /** a bunch of times                                                         **/
 /******************************************************************************/
-void ser_output_flush(void) {
-	size_t len = stream_buf_recv(write_stream, write_scratch_buf, vexSerialWriteFree(1), 0);
+static void ser_task_bufs_flush_expired(void);
+
+// Ships as much of a priority class as fits in free. Returns the number of
+// bytes taken from the class
+static size_t ser_output_flush_class(int32_t idx, size_t free) {
+	struct ser_output_class* c = &output_classes[idx];
+	size_t len = stream_buf_recv(c->stream, write_scratch_buf, free, 0);
+	if (len == 0) {
+		return 0;
+	}
+	// COBS packets end in a 0, and no other byte is 0
+	if ((ser_driver_runtime_config & E_COBS_ENABLED) && write_scratch_buf[len - 1] != 0) {
+		partial_packet_class = idx;
+	} else if (partial_packet_class == idx) {
+		partial_packet_class = -1;
+	}
+
 	uint32_t ret = vexSerialWriteBuffer(1, write_scratch_buf, len);
+	c->stats.sent += ret;
 	if (ret != len) {
+		c->stats.dropped += len - ret;
 		display_error("WARNING: some serial data has been dropped");
 	}
+	return len;
+}
+
+// Ships as much of the output queue as the VEX serial buffer can take. Takes no
+// locks, so the data abort handler uses it to get the crash report out
+void ser_output_flush_queue(void) {
+	size_t free = vexSerialWriteFree(1);
+	if (partial_packet_class >= 0) {
+		free -= ser_output_flush_class(partial_packet_class, free);
+		if (partial_packet_class >= 0) {
+			// still waiting on the rest of the packet
+			return;
+		}
+	}
+	for (int32_t i = 0; i < SER_PRIORITY_CLASSES && free > 0; i++) {
+		free -= ser_output_flush_class(i, free);
+		if (partial_packet_class >= 0) {
+			return;
+		}
+	}
+}
+
+// called by the system daemon before every vexBackgroundProcessing
+void ser_output_flush(void) {
+	ser_task_bufs_flush_expired();
+	ser_output_flush_queue();
+}
+
+static ser_priority_e_t ser_default_priority(uint32_t stream_id) {
+	switch (stream_id) {
+		case STDERR_STREAM_ID:
+			return E_SER_PRIORITY_HIGH;
+		case KDBG_STREAM_ID:
+			return E_SER_PRIORITY_MEDIUM;
+		case STDOUT_STREAM_ID:
+			return E_SER_PRIORITY_NORMAL;
+		default:
+			return E_SER_PRIORITY_LOW;
+	}
+}
+
+// finds the entry for a stream, or returns NULL. stream_mtx must be held
+static struct ser_stream_entry* ser_stream_entry_find(uint32_t stream_id) {
+	for (size_t i = 0; i < stream_entries_count; i++) {
+		if (stream_entries[i].stream_id == stream_id) {
+			return &stream_entries[i];
+		}
+	}
+	return NULL;
+}
+
+// finds (or creates) the entry for a stream. stream_mtx must be held
+static struct ser_stream_entry* ser_stream_entry_get(uint32_t stream_id) {
+	struct ser_stream_entry* found = ser_stream_entry_find(stream_id);
+	if (found != NULL) {
+		return found;
+	}
+	if (stream_entries_count == SER_MAX_STREAM_ENTRIES) {
+		return &overflow_stream_entry;
+	}
+	struct ser_stream_entry* entry = &stream_entries[stream_entries_count++];
+	entry->stream_id = stream_id;
+	entry->priority = ser_default_priority(stream_id);
+	entry->drop_policy = E_SER_DROP_BLOCK;
+	entry->queued = 0;
+	entry->dropped = 0;
+	return entry;
+}
+
+// How a write behaves when its priority class is busy or full
+enum ser_write_mode {
+	E_SER_WRITE_BLOCK,    // wait, unless the stream's drop policy says to drop
+	E_SER_WRITE_NOBLOCK,  // drop the packet
+	E_SER_WRITE_TRY,      // fail without dropping, the caller keeps the data
+};
+
+// Queues a packet in a priority class. The class's mutex must be held. Unless
+// block is set, the packet is only queued if it fits right away
+static bool ser_output_write(struct ser_output_class* c, const uint8_t* buffer, size_t size, bool block) {
+	if (!block) {
+		// we're the only writer, so the space can only grow after this check
+		if (stream_buf_get_unused(c->stream) < size) {
+			return false;
+		}
+		stream_buf_send(c->stream, buffer, size, 0);
+		return true;
+	}
+	// packets larger than the queue have to go in pieces. The flush keeps
+	// draining this class until the packet is complete
+	size_t sent = 0;
+	while (sent < size) {
+		size_t chunk = size - sent > VEX_SERIAL_BUFFER_SIZE ? VEX_SERIAL_BUFFER_SIZE : size - sent;
+		sent += stream_buf_send(c->stream, buffer + sent, chunk, TIMEOUT_MAX);
+	}
+	return true;
+}
+
+// Ships data for a stream to the output queue, COBS encoding it if enabled.
+// Packets of a class are queued whole and in the order their writers got the
+// class's mutex
+static bool ser_frame_write(uint32_t stream_id, const uint8_t* buf, size_t len, enum ser_write_mode mode) {
+	mutex_take(stream_mtx, TIMEOUT_MAX);
+	struct ser_stream_entry* entry = ser_stream_entry_get(stream_id);
+	const ser_priority_e_t priority = entry->priority;
+	const bool block = mode == E_SER_WRITE_BLOCK && entry->drop_policy == E_SER_DROP_BLOCK;
+	mutex_give(stream_mtx);
+
+	const bool cobs = ser_driver_runtime_config & E_COBS_ENABLED;
+	// allocate stack space for the buffer to be cobs encoded
+	const size_t size = cobs ? cobs_encode_measure(buf, len, stream_id) + 1 : len;
+	uint8_t cobs_buf[cobs ? size : 1];
+	const uint8_t* packet = buf;
+	if (cobs) {
+		cobs_encode(cobs_buf, buf, len, stream_id);
+		cobs_buf[size - 1] = 0;
+		packet = cobs_buf;
+	}
+
+	struct ser_output_class* c = &output_classes[priority];
+	bool queued = false;
+	if (mutex_take(c->mtx, block ? TIMEOUT_MAX : 0)) {
+		queued = ser_output_write(c, packet, size, block);
+		if (queued) {
+			c->stats.queued += size;
+		} else if (mode != E_SER_WRITE_TRY) {
+			c->stats.dropped += size;
+		}
+		mutex_give(c->mtx);
+	}
+	if (!queued && mode == E_SER_WRITE_TRY) {
+		return false;
+	}
+
+	mutex_take(stream_mtx, TIMEOUT_MAX);
+	if (queued) {
+		entry->queued += len;
+	} else {
+		entry->dropped += len;
+	}
+	mutex_give(stream_mtx);
+	return queued;
+}
+
+// Ends the packet that the output queue was in the middle of shipping, if any,
+// for when nothing else is ever going to run again: its writer can't queue the
+// rest, so the flush would wait for it forever. What there is of the packet is
+// shipped and followed by a delimiter, so that the host drops it
+void ser_output_end_partial(void) {
+	while (partial_packet_class >= 0) {
+		const int32_t idx = partial_packet_class;
+		const size_t free = vexSerialWriteFree(1);
+		if (free == 0) {
+			vexBackgroundProcessing();
+		} else if (stream_buf_get_used(output_classes[idx].stream) > 0) {
+			// clears partial_packet_class if this happens to finish the packet
+			ser_output_flush_class(idx, free);
+		} else {
+			uint8_t delimiter = 0;
+			vexSerialWriteBuffer(1, &delimiter, 1);
+			partial_packet_class = -1;
+		}
+	}
 }
 
-bool ser_output_write(const uint8_t* buffer, size_t size, bool noblock) {
-	return stream_buf_send(write_stream, buffer, size, noblock ? 0 : TIMEOUT_MAX);
+// Queues a packet for a stream when nothing else is ever going to run again,
+// such as in the malloc failed hook with the scheduler suspended. No locks are
+// taken and nothing blocks: while the stream's class is full, the output queue
+// is shipped right here instead of by the system daemon
+void ser_output_write_fatal(uint32_t stream_id, const uint8_t* buf, size_t len) {
+	const bool cobs = ser_driver_runtime_config & E_COBS_ENABLED;
+	const size_t size = cobs ? cobs_encode_measure(buf, len, stream_id) + 1 : len;
+	uint8_t cobs_buf[cobs ? size : 1];
+	const uint8_t* packet = buf;
+	if (cobs) {
+		cobs_encode(cobs_buf, buf, len, stream_id);
+		cobs_buf[size - 1] = 0;
+		packet = cobs_buf;
+	}
+
+	ser_output_end_partial();
+	struct ser_output_class* c = &output_classes[ser_default_priority(stream_id)];
+	while (stream_buf_get_unused(c->stream) < size) {
+		ser_output_flush_queue();
+		vexBackgroundProcessing();
+	}
+	stream_buf_send(c->stream, packet, size, 0);
+	c->stats.queued += size;
+}
+
+bool ser_stream_enabled(uint32_t stream_id) {
+	return list_contains(guaranteed_delivery_streams, guaranteed_delivery_streams_size, stream_id) ||
+	       set_contains(&enabled_streams_set, stream_id);
+}
+
+/******************************************************************************/
+/**                           Per-task buffering                             **/
+/**                                                                          **/
+/** Tasks may opt into their own output buffer so that many small writes    **/
+/** turn into one trip through the output queue and a single COBS frame     **/
+/******************************************************************************/
+static struct ser_task_buf* ser_task_buf_get(void) {
+	if (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+		return NULL;
+	}
+	return pvTaskGetThreadLocalStoragePointer(NULL, SER_TASK_BUF_TLSP_IDX);
+}
+
+// Claims a task buffer for flushing, so that the owning task and the system
+// daemon never ship the same data twice. A claim held by dead, a task that has
+// been deleted and will never give it back, is taken over
+static bool ser_task_buf_claim(struct ser_task_buf* tb, task_t dead) {
+	rtos_suspend_all();
+	const bool claimed = !tb->flushing || (dead != NULL && tb->flusher == dead);
+	if (claimed) {
+		tb->flushing = true;
+		tb->flusher = task_get_current();
+	}
+	rtos_resume_all();
+	return claimed;
+}
+
+// empties a task buffer onto the serial line. The buffer must be claimed. If
+// the data couldn't be shipped, it's dropped
+static bool ser_task_buf_ship(struct ser_task_buf* tb, bool noblock) {
+	bool ret = !tb->used ||
+	           ser_frame_write(tb->stream_id, tb->data, tb->used, noblock ? E_SER_WRITE_NOBLOCK : E_SER_WRITE_BLOCK);
+	tb->used = 0;
+	return ret;
+}
+
+static bool ser_task_buf_flush(struct ser_task_buf* tb, bool noblock) {
+	// the system daemon may be shipping the buffer, which never takes long
+	while (!ser_task_buf_claim(tb, NULL)) {
+		if (noblock) {
+			return false;
+		}
+		task_delay(1);
+	}
+	bool ret = ser_task_buf_ship(tb, noblock);
+	tb->flushing = false;
+	return ret;
+}
+
+// Returns the number of bytes accepted into the buffer. Once accepted, bytes
+// are either shipped or counted as dropped in the stream's statistics
+static int ser_task_buf_write(struct _reent* r, struct ser_task_buf* tb, const ser_file_s_t* file, const uint8_t* buf,
+                              const size_t len) {
+	const bool noblock = file->flags & E_NOBLK_WRITE;
+	// a buffer only ever holds data for one stream at a time
+	if (tb->used && tb->stream_id != file->stream_id) {
+		ser_task_buf_flush(tb, noblock);
+		if (tb->used) {
+			// the system daemon was flushing it and we may not block
+			r->_errno = EIO;
+			return 0;
+		}
+	}
+
+	size_t written = 0;
+	while (written < len) {
+		if (tb->used == tb->size) {
+			// full and couldn't be flushed without blocking
+			break;
+		}
+		size_t chunk = len - written;
+		if (chunk > tb->size - tb->used) {
+			chunk = tb->size - tb->used;
+		}
+		rtos_suspend_all();
+		if (tb->used == 0) {
+			tb->stream_id = file->stream_id;
+			tb->first_write = millis();
+		}
+		memcpy(tb->data + tb->used, buf + written, chunk);
+		tb->used += chunk;
+		rtos_resume_all();
+		written += chunk;
+
+		if (tb->used == tb->size) {
+			ser_task_buf_flush(tb, noblock);
+		}
+	}
+	if (written == 0 && len > 0) {
+		r->_errno = EIO;
+		return 0;
+	}
+
+	bool flush = false;
+	switch (tb->policy) {
+		case E_SER_FLUSH_LINE:
+			flush = memchr(buf, '\n', len) != NULL;
+			break;
+		case E_SER_FLUSH_TIME:
+			flush = millis() - tb->first_write >= tb->period;
+			break;
+		default:
+			break;
+	}
+	if (flush) {
+		ser_task_buf_flush(tb, noblock);
+	}
+	return written;
+}
+
+static void ser_task_buf_flush_expired_cb(ll_node_s_t* node, void* extra) {
+	struct ser_task_buf* tb = node->payload.data;
+	if (tb->policy != E_SER_FLUSH_TIME || !tb->used || millis() - tb->first_write < tb->period) {
+		return;
+	}
+	if (!ser_task_buf_claim(tb, NULL)) {
+		// the owning task is flushing it already
+		return;
+	}
+	// the owning task may be in the middle of appending, so take a snapshot
+	rtos_suspend_all();
+	const size_t len = tb->used;
+	const uint32_t stream_id = tb->stream_id;
+	memcpy(task_buf_scratch, tb->data, len);
+	rtos_resume_all();
+	// the daemon can't block, but the data mustn't be dropped either. If it
+	// can't be queued now, leave it in the buffer and try again on the next flush
+	if (ser_frame_write(stream_id, task_buf_scratch, len, E_SER_WRITE_TRY)) {
+		// keep anything the task appended since the snapshot
+		rtos_suspend_all();
+		tb->used -= len;
+		memmove(tb->data, tb->data + len, tb->used);
+		tb->first_write = millis();
+		rtos_resume_all();
+	}
+	tb->flushing = false;
+}
+
+// called by the system daemon to ship buffers whose flush period has elapsed
+static void ser_task_bufs_flush_expired(void) {
+	if (!mutex_take(task_bufs_mtx, 0)) {
+		// a buffer is being added or removed right now. try again next time
+		return;
+	}
+	linked_list_foreach(task_bufs, ser_task_buf_flush_expired_cb, NULL);
+	mutex_give(task_bufs_mtx);
+}
+
+// ships whatever is left in a task buffer and removes it from the list. The
+// buffer can be freed afterwards. Only the system daemon is waited on for the
+// claim, which it never holds for long, while one held by dead is taken over
+static void ser_task_buf_retire(struct ser_task_buf* tb, task_t dead, bool noblock) {
+	while (!ser_task_buf_claim(tb, dead)) {
+		task_delay(1);
+	}
+	ser_task_buf_ship(tb, noblock);
+	mutex_take(task_bufs_mtx, TIMEOUT_MAX);
+	linked_list_remove_data(task_bufs, tb);
+	mutex_give(task_bufs_mtx);
+}
+
+// removes the calling task's buffer (if any) and optionally creates a new one
+static int32_t ser_task_buf_configure(const ser_task_buffer_config_s_t* config) {
+	if (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+		errno = EACCES;
+		return PROS_ERR;
+	}
+	if (config != NULL && (config->size == 0 || config->size > SER_TASK_BUFFER_MAX ||
+	                       (config->flush_policy == E_SER_FLUSH_TIME && config->flush_period == 0))) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+
+	struct ser_task_buf* tb = NULL;
+	if (config != NULL) {
+		tb = kmalloc(sizeof(*tb) + config->size);
+		if (tb == NULL) {
+			errno = ENOMEM;
+			return PROS_ERR;
+		}
+		tb->stream_id = 0;
+		tb->first_write = 0;
+		tb->policy = config->flush_policy;
+		tb->period = config->flush_period;
+		tb->size = config->size;
+		tb->used = 0;
+		tb->flushing = false;
+	}
+
+	struct ser_task_buf* old = ser_task_buf_get();
+	if (old != NULL) {
+		ser_task_buf_retire(old, NULL, false);
+	}
+	if (tb != NULL) {
+		mutex_take(task_bufs_mtx, TIMEOUT_MAX);
+		linked_list_append_data(task_bufs, tb);
+		mutex_give(task_bufs_mtx);
+	}
+	vTaskSetThreadLocalStoragePointer(NULL, SER_TASK_BUF_TLSP_IDX, tb);
+	if (old != NULL) {
+		kfree(old);
+	}
+	return 0;
+}
+
+// Called by task_delete before the task is removed, so that its buffered output
+// isn't lost. Nothing here may block for long: the system daemon deletes the
+// competition task, and it is the one that drains the output queue. Whatever
+// doesn't fit in the queue right away is dropped and counted as such.
+//
+// A task deleting itself can't be in the middle of a flush, so its buffer is
+// shipped right away. Another task may be, holding the claim, and could run
+// again before it is removed. Its buffer is only taken away from it here, and
+// returned for ser_task_buf_deleted_hook() to ship once the task is gone
+void* ser_task_buf_delete_hook(task_t task) {
+	struct ser_task_buf* tb = pvTaskGetThreadLocalStoragePointer(task, SER_TASK_BUF_TLSP_IDX);
+	if (tb == NULL) {
+		return NULL;
+	}
+	vTaskSetThreadLocalStoragePointer(task, SER_TASK_BUF_TLSP_IDX, NULL);
+	if (task != NULL && task != task_get_current()) {
+		return tb;
+	}
+	ser_task_buf_retire(tb, NULL, true);
+	kfree(tb);
+	return NULL;
+}
+
+// Called by task_delete once task has been removed, with what
+// ser_task_buf_delete_hook() returned. The task will never release a claim it
+// held, so the claim is taken over
+void ser_task_buf_deleted_hook(void* buf, task_t task) {
+	struct ser_task_buf* tb = buf;
+	if (tb == NULL) {
+		return;
+	}
+	ser_task_buf_retire(tb, task, true);
+	kfree(tb);
 }
 
 /******************************************************************************/
@@ -149,54 +660,35 @@ int ser_read_r(struct _reent* r, void* const arg, uint8_t* buffer, const size_t
 int ser_write_r(struct _reent* r, void* const arg, const uint8_t* buf, const size_t len) {
 	const ser_file_s_t file = *(ser_file_s_t*)arg;
 
-	if (!list_contains(guaranteed_delivery_streams, guaranteed_delivery_streams_size, file.stream_id) &&
-	    !set_contains(&enabled_streams_set, file.stream_id)) {
+	if (!ser_stream_enabled(file.stream_id)) {
 		// the stream isn't a guaranteed delivery or hasn't been enabled so just
 		// pretend like the data was shipped just fine
 		return len;
 	}
 
-	if (ser_driver_runtime_config &= E_COBS_ENABLED) {
-		// allocate stack space for the buffer to be cobs encoded
-		const size_t cobs_len = cobs_encode_measure(buf, len, file.stream_id);
-		uint8_t cobs_buf[cobs_len + 1];
-
-		// need to guarantee writes are in order
-		if (!mutex_take(write_mtx, (file.flags & E_NOBLK_WRITE) ? 0 : TIMEOUT_MAX)) {
-			r->_errno = EACCES;
-			return 0;
-		}
-		cobs_encode(cobs_buf, buf, len, file.stream_id);
-		cobs_buf[cobs_len] = 0;
-
-		bool ret = ser_output_write(cobs_buf, cobs_len + 1, file.flags & E_NOBLK_WRITE);
-		mutex_give(write_mtx);
-
-		if (!ret) {
-			r->_errno = EIO;
-			return 0;
-		}
-		return len;
-	} else {
-		// need to guarantee writes are in order
-		if (!mutex_take(write_mtx, TIMEOUT_MAX)) {
-			r->_errno = EACCES;
-			return 0;
-		}
+	// stderr is never buffered so that errors make it out as soon as possible
+	struct ser_task_buf* tb = ser_task_buf_get();
+	if (tb != NULL && file.stream_id != STDERR_STREAM_ID) {
+		return ser_task_buf_write(r, tb, &file, buf, len);
+	}
 
-		bool ret = ser_output_write(buf, len, file.flags & E_NOBLK_WRITE);
+	bool ret = ser_frame_write(file.stream_id, buf, len,
+	                           (file.flags & E_NOBLK_WRITE) ? E_SER_WRITE_NOBLOCK : E_SER_WRITE_BLOCK);
 
-		mutex_give(write_mtx);
-		if (!ret) {
-			r->_errno = EIO;
-			return 0;
-		}
-		return len;
+	if (!ret) {
+		r->_errno = EIO;
+		return 0;
 	}
+	return len;
 }
 
 int ser_close_r(struct _reent* r, void* const arg) {
-	// This does nothing for now, may be implemented later
+	// the reserved streams are static and stay open
+	ser_file_s_t* file = (ser_file_s_t*)arg;
+	const size_t reserved = sizeof(RESERVED_SER_FILES) / sizeof(*RESERVED_SER_FILES);
+	if (file < RESERVED_SER_FILES || file >= RESERVED_SER_FILES + reserved) {
+		kpool_free(&ser_file_pool, file);
+	}
 	return 0;
 }
 
@@ -218,23 +710,23 @@ off_t ser_lseek_r(struct _reent* r, void* const arg, off_t ptr, int dir) {
 }
 
 int ser_ctl(void* const arg, const uint32_t cmd, void* const extra_arg) {
-	ser_file_s_t file = *(ser_file_s_t*)arg;
+	ser_file_s_t* file = (ser_file_s_t*)arg;
 	switch (cmd) {
 		case SERCTL_ACTIVATE:
-			if (!list_contains(guaranteed_delivery_streams, guaranteed_delivery_streams_size, (uint32_t)file.stream_id)) {
-				set_add(&enabled_streams_set, (uint32_t)file.stream_id);
+			if (!list_contains(guaranteed_delivery_streams, guaranteed_delivery_streams_size, (uint32_t)file->stream_id)) {
+				set_add(&enabled_streams_set, (uint32_t)file->stream_id);
 			}
 			return 0;
 		case SERCTL_DEACTIVATE:
-			if (!list_contains(guaranteed_delivery_streams, guaranteed_delivery_streams_size, (uint32_t)file.stream_id)) {
-				set_rm(&enabled_streams_set, (uint32_t)file.stream_id);
+			if (!list_contains(guaranteed_delivery_streams, guaranteed_delivery_streams_size, (uint32_t)file->stream_id)) {
+				set_rm(&enabled_streams_set, (uint32_t)file->stream_id);
 			}
 			return 0;
 		case SERCTL_BLKWRITE:
-			file.flags &= ~E_NOBLK_WRITE;
+			file->flags &= ~E_NOBLK_WRITE;
 			return 0;
 		case SERCTL_NOBLKWRITE:
-			file.flags |= E_NOBLK_WRITE;
+			file->flags |= E_NOBLK_WRITE;
 			return 0;
 		default:
 			errno = EINVAL;
@@ -286,9 +778,19 @@ int ser_open_r(struct _reent* r, const char* path, int flags, int mode) {
 		return STDERR_FILENO;
 	}
 
-	ser_file_s_t* arg = kmalloc(sizeof(*arg));
+	ser_file_s_t* arg = kpool_alloc(&ser_file_pool, sizeof(*arg));
+	if (arg == NULL) {
+		r->_errno = ENOMEM;
+		return -1;
+	}
+	arg->stream_id = 0;
+	arg->flags = 0;
 	memcpy(arg->stream, path, strlen(path));
-	return vfs_add_entry_r(r, ser_driver, arg);
+	int fd = vfs_add_entry_r(r, ser_driver, arg);
+	if (fd < 0) {
+		kpool_free(&ser_file_pool, arg);
+	}
+	return fd;
 }
 
 // control various components of the serial driver or a file
@@ -316,6 +818,69 @@ int32_t serctl(const uint32_t action, void* const extra_arg) {
 		case SERCTL_DISABLE_COBS:
 			ser_driver_runtime_config &= ~E_COBS_ENABLED;
 			return 0;
+		case SERCTL_CONFIGURE_STREAM: {
+			const ser_stream_config_s_t* config = extra_arg;
+			if (config == NULL || config->priority >= SER_PRIORITY_CLASSES || config->drop_policy > E_SER_DROP_NEWEST) {
+				errno = EINVAL;
+				return PROS_ERR;
+			}
+			mutex_take(stream_mtx, TIMEOUT_MAX);
+			struct ser_stream_entry* entry = ser_stream_entry_get(config->stream_id);
+			if (entry == &overflow_stream_entry) {
+				mutex_give(stream_mtx);
+				errno = ENOMEM;
+				return PROS_ERR;
+			}
+			entry->priority = config->priority;
+			entry->drop_policy = config->drop_policy;
+			mutex_give(stream_mtx);
+			return 0;
+		}
+		case SERCTL_GET_STATS: {
+			ser_stats_s_t* stats = extra_arg;
+			if (stats == NULL) {
+				errno = EINVAL;
+				return PROS_ERR;
+			}
+			for (size_t i = 0; i < SER_PRIORITY_CLASSES; i++) {
+				stats[i] = output_classes[i].stats;
+			}
+			return 0;
+		}
+		case SERCTL_GET_STREAM_STATS: {
+			ser_stream_stats_s_t* stats = extra_arg;
+			if (stats == NULL) {
+				errno = EINVAL;
+				return PROS_ERR;
+			}
+			// a stream that was never written to or configured has no entry, and
+			// querying it shouldn't use one up
+			mutex_take(stream_mtx, TIMEOUT_MAX);
+			struct ser_stream_entry* entry = ser_stream_entry_find(stats->stream_id);
+			if (entry != NULL) {
+				stats->priority = entry->priority;
+				stats->drop_policy = entry->drop_policy;
+				stats->queued = entry->queued;
+				stats->dropped = entry->dropped;
+			} else {
+				stats->priority = ser_default_priority(stats->stream_id);
+				stats->drop_policy = E_SER_DROP_BLOCK;
+				stats->queued = 0;
+				stats->dropped = 0;
+			}
+			mutex_give(stream_mtx);
+			return 0;
+		}
+		case SERCTL_TASK_BUFFER:
+			return ser_task_buf_configure((const ser_task_buffer_config_s_t*)extra_arg);
+		case SERCTL_TASK_FLUSH: {
+			struct ser_task_buf* tb = ser_task_buf_get();
+			if (tb != NULL && !ser_task_buf_flush(tb, false)) {
+				errno = EIO;
+				return PROS_ERR;
+			}
+			return 0;
+		}
 		default:
 			errno = EINVAL;
 			return PROS_ERR;
@@ -328,12 +893,19 @@ void ser_driver_initialize(void) {
 	ser_driver_runtime_config |= E_COBS_ENABLED;  // start with cobs enabled
 
 	read_mtx = mutex_create_static(&read_mtx_buf);
-	write_mtx = mutex_create_static(&write_mtx_buf);
+	stream_mtx = mutex_create_static(&stream_mtx_buf);
+	task_bufs_mtx = mutex_create_static(&task_bufs_mtx_buf);
+
+	task_bufs = linked_list_init();
 
 	set_initialize(&enabled_streams_set);
 	set_add(&enabled_streams_set, STDOUT_STREAM_ID);  // 'sout' little endian
 
-	write_stream = stream_buf_create_static(VEX_SERIAL_BUFFER_SIZE, 0, write_buf, &write_stream_buf);
+	for (size_t i = 0; i < SER_PRIORITY_CLASSES; i++) {
+		output_classes[i].stream = stream_buf_create_static(VEX_SERIAL_BUFFER_SIZE, 0, output_classes[i].buf,
+		                                                    &output_classes[i].stream_buf);
+		output_classes[i].mtx = mutex_create_static(&output_classes[i].mtx_buf);
+	}
 
 	vfs_update_entry(STDIN_FILENO, ser_driver, &(RESERVED_SER_FILES[0]));
 	vfs_update_entry(STDOUT_FILENO, ser_driver, &(RESERVED_SER_FILES[1]));
@@ -3,6 +3,25 @@
  *
  * Contains the driver for writing files to the microSD card.
  *
+ * Files opened for writing can be given a write-behind buffer with
+ * fdctl(USDCTL_SET_WRITE_BUFFER). Writes to such a file are copied into one of
+ * two RAM buffers, and the flush task writes a buffer to the card once it fills
+ * up (or once its data gets old) while the other one keeps accepting writes.
+ * The writer only ever waits for a memcpy, never for the card.
+ *
+ * Files opened read-only read ahead: small reads (such as the ones newlib's
+ * stdio makes through its small FILE buffer) are served from a chunk that is
+ * read from the card with a single call, and reads at least as big as a chunk
+ * go straight to the caller's buffer. See USDCTL_SET_READ_AHEAD.
+ *
+ * Locking: VEXos's FatFs is not reentrant, so every vexFile* call is made with
+ * usd_fs_mtx held, and only for the duration of that call. Each file also has
+ * its own lock that is held for a whole driver operation, so operations on one
+ * file happen in order while other files are accessed concurrently. A
+ * write-behind buffer additionally has an I/O lock which is held while its data
+ * is written to the card, so the flush task never takes the file's lock and
+ * buffered writes never wait for the card.
+ *
  * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
  * All rights reserved.
  *
@@ -25,13 +44,48 @@
 #include "system/optimizers.h"
 #include "v5_api.h"
 
+// the card is written in whole sectors when possible
+#define USD_SECTOR_SIZE 512
+// how old buffered data may get before the flush task writes it out
+#define USD_FLUSH_PERIOD 100
+// read-ahead chunk size of files opened read-only
+#define USD_READ_AHEAD_DEFAULT 4096
+
+typedef struct usd_write_buffer {
+	FIL* fptr;
+	uint8_t* data[2];
+	uint32_t size;
+	uint8_t fill;          // index of the buffer that writes go into
+	uint32_t fill_len;     // bytes in data[fill]
+	uint32_t fill_start;   // when the first byte went into data[fill]
+	uint32_t pending_len;  // bytes in data[fill ^ 1] waiting for the card, 0 if it is free
+	usd_buffer_stats_s_t stats;
+	mutex_t mtx;     // protects the fields above. Never held while the card is accessed
+	mutex_t io_mtx;  // held while buffered data is written to the card
+	struct usd_write_buffer* next;
+} usd_write_buffer_s_t;
+
 typedef struct usd_file_arg {
 	FIL* ifi_fptr;
+	bool writable;
+	mutex_t mtx;                         // held for the duration of every operation on the file
+	usd_write_buffer_s_t* write_buffer;  // NULL unless the file is buffered
+	uint32_t read_ahead;                 // read-ahead chunk size, 0 if disabled
+	uint8_t* ra_buf;                     // allocated on the first small read
+	uint32_t ra_pos;                     // next unread byte in ra_buf
+	uint32_t ra_len;                     // bytes in ra_buf. The card's position is just past them
 } usd_file_arg_t;
 
+// VEXos allows 8 open files
+#define USD_FILE_POOL_SIZE 8
+POOL_STATIC(usd_file_pool, sizeof(usd_file_arg_t), USD_FILE_POOL_SIZE);
+
 static const int FRESULTMAP[] = {0,       EIO,    EINVAL, EBUSY, ENOENT,  ENOENT, EINVAL, EACCES,  // FR_DENIED
                                  EEXIST,  EINVAL, EROFS,  ENXIO, ENOBUFS, ENXIO,  EIO,    EACCES,  // FR_LOCKED
                                  ENOBUFS, ENFILE, EINVAL};
+#define FRESULT_ERRNO(result) \
+	((uint32_t)(result) < sizeof(FRESULTMAP) / sizeof(*FRESULTMAP) ? FRESULTMAP[result] : EIO)
+
 enum fa_flags {
 	FA_READ = 1 << 0,
 	FA_WRITE = 1 << 1,
@@ -40,32 +94,328 @@ enum fa_flags {
 	FA_CREATE_NEW = 1 << 4
 };
 
+/******************************************************************************/
+/**                           Write-behind buffers                           **/
+/******************************************************************************/
+static task_stack_t usd_flush_task_stack[TASK_STACK_DEPTH_MIN];
+static static_task_s_t usd_flush_task_buffer;
+static task_t usd_flush_task;
+
+static usd_write_buffer_s_t* usd_buffers;  // every buffered file
+static static_sem_s_t usd_buffers_mtx_buf;
+static mutex_t usd_buffers_mtx;  // protects usd_buffers
+
+static static_sem_s_t usd_fs_mtx_buf;
+static mutex_t usd_fs_mtx;  // held around every call into VEXos's FatFs
+
+// hands the buffer being filled to the flush task. Must be called with mtx
+// held and the other buffer free
+static inline void _usd_buffer_swap(usd_write_buffer_s_t* wb) {
+	wb->pending_len = wb->fill_len;
+	wb->fill ^= 1;
+	wb->fill_len = 0;
+}
+
+// Writes the pending buffer to the card. If there is none, the buffer being
+// filled is written instead if force is set or its data is old enough. Must be
+// called with io_mtx held
+static void _usd_buffer_write_out(usd_write_buffer_s_t* wb, bool force) {
+	mutex_take(wb->mtx, TIMEOUT_MAX);
+	if (wb->pending_len == 0 && wb->fill_len > 0 && (force || millis() - wb->fill_start >= USD_FLUSH_PERIOD)) {
+		_usd_buffer_swap(wb);
+	}
+	uint32_t len = wb->pending_len;
+	uint8_t* data = wb->data[wb->fill ^ 1];
+	mutex_give(wb->mtx);
+	if (len == 0) {
+		return;
+	}
+
+	mutex_take(usd_fs_mtx, TIMEOUT_MAX);
+	int32_t written = vexFileWrite((char*)data, 1, len, wb->fptr);
+	mutex_give(usd_fs_mtx);
+
+	mutex_take(wb->mtx, TIMEOUT_MAX);
+	wb->pending_len = 0;
+	if (written > 0) {
+		wb->stats.flushed += written;
+	}
+	if (written != (int32_t)len) {
+		wb->stats.errors++;
+	}
+	mutex_give(wb->mtx);
+}
+
+// writes everything buffered so far to the card. Called with the file's lock
+// held, so nothing new is buffered in the meantime
+static void _usd_buffer_flush(usd_write_buffer_s_t* wb) {
+	mutex_take(wb->io_mtx, TIMEOUT_MAX);
+	// once for the pending buffer, once for the one being filled
+	_usd_buffer_write_out(wb, true);
+	_usd_buffer_write_out(wb, true);
+	mutex_give(wb->io_mtx);
+}
+
+static int _usd_buffered_write(struct _reent* r, usd_write_buffer_s_t* wb, const uint8_t* buf, const size_t len) {
+	size_t written = 0;
+	bool notify = false;
+	mutex_take(wb->mtx, TIMEOUT_MAX);
+	while (written < len) {
+		if (wb->fill_len == wb->size) {
+			if (wb->pending_len != 0) {
+				// both buffers are full, the card can't keep up
+				break;
+			}
+			_usd_buffer_swap(wb);
+			notify = true;
+		}
+		if (wb->fill_len == 0) {
+			wb->fill_start = millis();
+		}
+		size_t chunk = wb->size - wb->fill_len;
+		if (chunk > len - written) {
+			chunk = len - written;
+		}
+		memcpy(wb->data[wb->fill] + wb->fill_len, buf + written, chunk);
+		wb->fill_len += chunk;
+		written += chunk;
+	}
+	if (wb->fill_len == wb->size && wb->pending_len == 0) {
+		_usd_buffer_swap(wb);
+		notify = true;
+	}
+	uint32_t buffered = wb->fill_len + wb->pending_len;
+	if (buffered > wb->stats.high_water) {
+		wb->stats.high_water = buffered;
+	}
+	if (written < len) {
+		wb->stats.overruns++;
+	}
+	mutex_give(wb->mtx);
+
+	if (notify) {
+		task_notify(usd_flush_task);
+	}
+	if (written == 0 && len > 0) {
+		r->_errno = EAGAIN;
+		return -1;
+	}
+	return written;
+}
+
+static void usd_flush_task_fn(void* ign) {
+	while (true) {
+		// woken early whenever a buffer fills up
+		task_notify_take(true, USD_FLUSH_PERIOD);
+		mutex_take(usd_buffers_mtx, TIMEOUT_MAX);
+		for (usd_write_buffer_s_t* wb = usd_buffers; wb != NULL; wb = wb->next) {
+			mutex_take(wb->io_mtx, TIMEOUT_MAX);
+			_usd_buffer_write_out(wb, false);
+			mutex_give(wb->io_mtx);
+		}
+		mutex_give(usd_buffers_mtx);
+	}
+}
+
+static void _usd_buffer_free(usd_write_buffer_s_t* wb) {
+	if (wb->mtx) mutex_delete(wb->mtx);
+	if (wb->io_mtx) mutex_delete(wb->io_mtx);
+	kfree(wb->data[0]);
+	kfree(wb->data[1]);
+	kfree(wb);
+}
+
+// flushes and removes the file's write-behind buffer, if it has one. Called
+// with the file's lock held
+static void _usd_buffer_disable(usd_file_arg_t* file_arg) {
+	usd_write_buffer_s_t* wb = file_arg->write_buffer;
+	if (wb == NULL) {
+		return;
+	}
+	mutex_take(usd_buffers_mtx, TIMEOUT_MAX);
+	for (usd_write_buffer_s_t** it = &usd_buffers; *it != NULL; it = &(*it)->next) {
+		if (*it == wb) {
+			*it = wb->next;
+			break;
+		}
+	}
+	mutex_give(usd_buffers_mtx);
+	_usd_buffer_flush(wb);
+	file_arg->write_buffer = NULL;
+	_usd_buffer_free(wb);
+}
+
+static int _usd_buffer_enable(usd_file_arg_t* file_arg, uint32_t size) {
+	if (!file_arg->writable) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	_usd_buffer_disable(file_arg);
+	if (size == 0) {
+		return 0;
+	}
+	size = (size + USD_SECTOR_SIZE - 1) & ~(USD_SECTOR_SIZE - 1);
+
+	usd_write_buffer_s_t* wb = (usd_write_buffer_s_t*)kmalloc(sizeof(*wb));
+	if (wb == NULL) {
+		errno = ENOMEM;
+		return PROS_ERR;
+	}
+	memset(wb, 0, sizeof(*wb));
+	wb->fptr = file_arg->ifi_fptr;
+	wb->size = size;
+	wb->data[0] = (uint8_t*)kmalloc(size);
+	wb->data[1] = (uint8_t*)kmalloc(size);
+	wb->mtx = mutex_create();
+	wb->io_mtx = mutex_create();
+	if (!wb->data[0] || !wb->data[1] || !wb->mtx || !wb->io_mtx) {
+		_usd_buffer_free(wb);
+		errno = ENOMEM;
+		return PROS_ERR;
+	}
+
+	file_arg->write_buffer = wb;
+	mutex_take(usd_buffers_mtx, TIMEOUT_MAX);
+	wb->next = usd_buffers;
+	usd_buffers = wb;
+	mutex_give(usd_buffers_mtx);
+	return 0;
+}
+
+void usd_initialize(void) {
+	usd_fs_mtx = mutex_create_static(&usd_fs_mtx_buf);
+	usd_buffers_mtx = mutex_create_static(&usd_buffers_mtx_buf);
+	usd_flush_task = task_create_static(usd_flush_task_fn, NULL, TASK_PRIORITY_MIN + 1, TASK_STACK_DEPTH_MIN,
+	                                    "microSD Flush (PROS)", usd_flush_task_stack, &usd_flush_task_buffer);
+}
+
+/******************************************************************************/
+/**                                Read-ahead                                **/
+/******************************************************************************/
+// Drops the read-ahead chunk, moving the card's position back to the first
+// unread byte. Called with the file's lock held
+static void _usd_read_ahead_discard(usd_file_arg_t* file_arg) {
+	uint32_t unread = file_arg->ra_len - file_arg->ra_pos;
+	if (unread > 0) {
+		mutex_take(usd_fs_mtx, TIMEOUT_MAX);
+		vexFileSeek(file_arg->ifi_fptr, vexFileTell(file_arg->ifi_fptr) - unread, SEEK_SET);
+		mutex_give(usd_fs_mtx);
+	}
+	file_arg->ra_pos = file_arg->ra_len = 0;
+}
+
+static int _usd_read_ahead_set(usd_file_arg_t* file_arg, uint32_t size) {
+	if (file_arg->writable && size != 0) {
+		// reads and writes would see different positions
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	_usd_read_ahead_discard(file_arg);
+	kfree(file_arg->ra_buf);
+	file_arg->ra_buf = NULL;
+	file_arg->read_ahead = size;
+	return 0;
+}
+
+static int32_t _usd_read_ahead(usd_file_arg_t* file_arg, uint8_t* buffer, const size_t len) {
+	size_t copied = file_arg->ra_len - file_arg->ra_pos;
+	if (copied > len) {
+		copied = len;
+	}
+	if (copied > 0) {
+		memcpy(buffer, file_arg->ra_buf + file_arg->ra_pos, copied);
+		file_arg->ra_pos += copied;
+	}
+	if (copied == len) {
+		return copied;
+	}
+
+	// the chunk has been used up
+	size_t remaining = len - copied;
+	if (file_arg->ra_buf == NULL && remaining < file_arg->read_ahead) {
+		file_arg->ra_buf = (uint8_t*)kmalloc(file_arg->read_ahead);
+	}
+	int32_t result;
+	mutex_take(usd_fs_mtx, TIMEOUT_MAX);
+	if (remaining >= file_arg->read_ahead || file_arg->ra_buf == NULL) {
+		// a chunk wouldn't save any calls
+		result = vexFileRead((char*)buffer + copied, 1, remaining, file_arg->ifi_fptr);
+		mutex_give(usd_fs_mtx);
+		file_arg->ra_pos = file_arg->ra_len = 0;
+		if (result > 0) {
+			copied += result;
+		}
+	} else {
+		result = vexFileRead((char*)file_arg->ra_buf, 1, file_arg->read_ahead, file_arg->ifi_fptr);
+		mutex_give(usd_fs_mtx);
+		file_arg->ra_pos = 0;
+		file_arg->ra_len = result > 0 ? result : 0;
+		size_t chunk = file_arg->ra_len < remaining ? file_arg->ra_len : remaining;
+		memcpy(buffer + copied, file_arg->ra_buf, chunk);
+		file_arg->ra_pos = chunk;
+		copied += chunk;
+	}
+	return copied > 0 ? (int32_t)copied : result;
+}
+
 /******************************************************************************/
 /**                         newlib driver functions                          **/
 /******************************************************************************/
 int usd_read_r(struct _reent* r, void* const arg, uint8_t* buffer, const size_t len) {
 	usd_file_arg_t* file_arg = (usd_file_arg_t*)arg;
-	// TODO: mutex here. Global or file lock?
-	int32_t result = vexFileRead((char*)buffer, sizeof(*buffer), len, file_arg->ifi_fptr);
+	mutex_take(file_arg->mtx, TIMEOUT_MAX);
+	int32_t result;
+	if (file_arg->read_ahead > 0) {
+		result = _usd_read_ahead(file_arg, buffer, len);
+	} else {
+		mutex_take(usd_fs_mtx, TIMEOUT_MAX);
+		result = vexFileRead((char*)buffer, sizeof(*buffer), len, file_arg->ifi_fptr);
+		mutex_give(usd_fs_mtx);
+	}
+	mutex_give(file_arg->mtx);
 	return result;
 }
 
 int usd_write_r(struct _reent* r, void* const arg, const uint8_t* buf, const size_t len) {
 	usd_file_arg_t* file_arg = (usd_file_arg_t*)arg;
-	// TODO: mutex here. Global or file lock?
-	int32_t result = vexFileWrite((char*)buf, sizeof(*buf), len, file_arg->ifi_fptr);
+	int32_t result;
+	mutex_take(file_arg->mtx, TIMEOUT_MAX);
+	if (file_arg->write_buffer != NULL) {
+		result = _usd_buffered_write(r, file_arg->write_buffer, buf, len);
+	} else {
+		mutex_take(usd_fs_mtx, TIMEOUT_MAX);
+		result = vexFileWrite((char*)buf, sizeof(*buf), len, file_arg->ifi_fptr);
+		mutex_give(usd_fs_mtx);
+	}
+	mutex_give(file_arg->mtx);
 	return result;
 }
 
 int usd_close_r(struct _reent* r, void* const arg) {
 	usd_file_arg_t* file_arg = (usd_file_arg_t*)arg;
+	mutex_take(file_arg->mtx, TIMEOUT_MAX);
+	_usd_buffer_disable(file_arg);
+	mutex_take(usd_fs_mtx, TIMEOUT_MAX);
 	vexFileClose(file_arg->ifi_fptr);
+	mutex_give(usd_fs_mtx);
+	mutex_give(file_arg->mtx);
+	mutex_delete(file_arg->mtx);
+	kfree(file_arg->ra_buf);
+	kpool_free(&usd_file_pool, file_arg);
 	return 0;
 }
 
 int usd_fstat_r(struct _reent* r, void* const arg, struct stat* st) {
 	usd_file_arg_t* file_arg = (usd_file_arg_t*)arg;
+	mutex_take(file_arg->mtx, TIMEOUT_MAX);
+	if (file_arg->write_buffer != NULL) {
+		// the size on the card should include everything written so far
+		_usd_buffer_flush(file_arg->write_buffer);
+	}
+	mutex_take(usd_fs_mtx, TIMEOUT_MAX);
 	st->st_size = vexFileSize(file_arg->ifi_fptr);
+	mutex_give(usd_fs_mtx);
+	mutex_give(file_arg->mtx);
 	return 0;
 }
 
@@ -75,17 +425,75 @@ int usd_isatty_r(struct _reent* r, void* const arg) {
 
 off_t usd_lseek_r(struct _reent* r, void* const arg, off_t ptr, int dir) {
 	usd_file_arg_t* file_arg = (usd_file_arg_t*)arg;
-	// TODO: mutex here. Global or file lock?
+	mutex_take(file_arg->mtx, TIMEOUT_MAX);
+	if (file_arg->write_buffer != NULL) {
+		// buffered data belongs at the current position
+		_usd_buffer_flush(file_arg->write_buffer);
+	}
+	if (file_arg->ra_len > 0) {
+		mutex_take(usd_fs_mtx, TIMEOUT_MAX);
+		uint32_t chunk_end = vexFileTell(file_arg->ifi_fptr);
+		mutex_give(usd_fs_mtx);
+		uint32_t chunk_start = chunk_end - file_arg->ra_len;
+		uint32_t pos = chunk_start + file_arg->ra_pos;
+		uint32_t target = dir == SEEK_SET ? (uint32_t)ptr : dir == SEEK_CUR ? pos + ptr : UINT32_MAX;
+		if (target >= chunk_start && target <= chunk_end) {
+			// within the chunk, so nothing needs to be read again. This also makes
+			// ftell() cheap
+			file_arg->ra_pos = target - chunk_start;
+			mutex_give(file_arg->mtx);
+			return target;
+		}
+		_usd_read_ahead_discard(file_arg);
+	}
+	mutex_take(usd_fs_mtx, TIMEOUT_MAX);
 	FRESULT result = vexFileSeek(file_arg->ifi_fptr, ptr, dir);
+	off_t pos = result == FR_OK ? (off_t)vexFileTell(file_arg->ifi_fptr) : (off_t)-1;
+	mutex_give(usd_fs_mtx);
+	mutex_give(file_arg->mtx);
 	if (result != FR_OK) {
-		r->_errno = FRESULTMAP[result];
-		return (off_t)-1;
+		r->_errno = FRESULT_ERRNO(result);
 	}
-	return vexFileTell(file_arg->ifi_fptr);
+	return pos;
 }
 
 int usd_ctl(void* const arg, const uint32_t cmd, void* const extra_arg) {
-	return 0;
+	usd_file_arg_t* file_arg = (usd_file_arg_t*)arg;
+	int ret = 0;
+	mutex_take(file_arg->mtx, TIMEOUT_MAX);
+	usd_write_buffer_s_t* wb = file_arg->write_buffer;
+	switch (cmd) {
+		case USDCTL_SET_WRITE_BUFFER:
+			ret = _usd_buffer_enable(file_arg, (uint32_t)extra_arg);
+			break;
+		case USDCTL_SET_READ_AHEAD:
+			ret = _usd_read_ahead_set(file_arg, (uint32_t)extra_arg);
+			break;
+		case USDCTL_FLUSH:
+			if (wb != NULL) {
+				_usd_buffer_flush(wb);
+			}
+			break;
+		case USDCTL_GET_BUFFER_STATS: {
+			usd_buffer_stats_s_t* stats = (usd_buffer_stats_s_t*)extra_arg;
+			if (stats == NULL) {
+				errno = EINVAL;
+				ret = PROS_ERR;
+			} else if (wb == NULL) {
+				memset(stats, 0, sizeof(*stats));
+			} else {
+				mutex_take(wb->mtx, TIMEOUT_MAX);
+				*stats = wb->stats;
+				stats->buffered = wb->fill_len + wb->pending_len;
+				mutex_give(wb->mtx);
+			}
+			break;
+		}
+		default:
+			break;
+	}
+	mutex_give(file_arg->mtx);
+	return ret;
 }
 
 /******************************************************************************/
@@ -102,15 +510,41 @@ const struct fs_driver _usd_driver = {.close_r = usd_close_r,
 const struct fs_driver* const usd_driver = &_usd_driver;
 
 int usd_open_r(struct _reent* r, const char* path, int flags, int mode) {
-	FRESULT result = vexFileMountSD();
-	if (result != F_OK) {
-		r->_errno = FRESULTMAP[result];
+	int accmode = flags & O_ACCMODE;
+	// VEXos has no read/write mode, and files opened with its write modes can't
+	// be read, so O_RDWR can't be supported
+	if (accmode != O_RDONLY && accmode != O_WRONLY) {
+		r->_errno = EINVAL;
 		return -1;
 	}
 
-	usd_file_arg_t* file_arg = kmalloc(sizeof(*file_arg));
+	usd_file_arg_t* file_arg = kpool_alloc(&usd_file_pool, sizeof(*file_arg));
+	if (file_arg == NULL) {
+		r->_errno = ENOMEM;
+		return -1;
+	}
+	file_arg->writable = accmode != O_RDONLY;
+	file_arg->write_buffer = NULL;
+	file_arg->read_ahead = file_arg->writable ? 0 : USD_READ_AHEAD_DEFAULT;
+	file_arg->ra_buf = NULL;
+	file_arg->ra_pos = file_arg->ra_len = 0;
+	file_arg->mtx = mutex_create();
+	if (file_arg->mtx == NULL) {
+		kpool_free(&usd_file_pool, file_arg);
+		r->_errno = ENOMEM;
+		return -1;
+	}
 
-	switch (flags & O_ACCMODE) {
+	mutex_take(usd_fs_mtx, TIMEOUT_MAX);
+	FRESULT result = vexFileMountSD();
+	if (result != FR_OK) {
+		mutex_give(usd_fs_mtx);
+		mutex_delete(file_arg->mtx);
+		kpool_free(&usd_file_pool, file_arg);
+		r->_errno = FRESULT_ERRNO(result);
+		return -1;
+	}
+	switch (accmode) {
 		case O_RDONLY:
 			file_arg->ifi_fptr = vexFileOpen(path, "");  // mode is ignored
 			break;
@@ -121,14 +555,23 @@ int usd_open_r(struct _reent* r, const char* path, int flags, int mode) {
 				file_arg->ifi_fptr = vexFileOpenCreate(path);
 			}
 			break;
-		default:
-			r->_errno = EINVAL;
-			return -1;
 	}
+	mutex_give(usd_fs_mtx);
 
 	if (!file_arg->ifi_fptr) {
+		mutex_delete(file_arg->mtx);
+		kpool_free(&usd_file_pool, file_arg);
 		r->_errno = ENFILE;  // up to 8 files max as of vexOS 0.7.4b55
 		return -1;
 	}
-	return vfs_add_entry_r(r, usd_driver, file_arg);
+
+	int fd = vfs_add_entry_r(r, usd_driver, file_arg);
+	if (fd < 0) {
+		mutex_take(usd_fs_mtx, TIMEOUT_MAX);
+		vexFileClose(file_arg->ifi_fptr);
+		mutex_give(usd_fs_mtx);
+		mutex_delete(file_arg->mtx);
+		kpool_free(&usd_file_pool, file_arg);
+	}
+	return fd;
 }
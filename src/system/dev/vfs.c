@@ -35,7 +35,13 @@
 #include "v5_api.h"
 
 #define MAX_FILELEN 128
-#define MAX_FILES_OPEN 31
+
+// Size of the file table, including the reserved file numbers. Can be
+// overridden at build time with -DVFS_MAX_FILES=N
+#ifndef VFS_MAX_FILES
+#define VFS_MAX_FILES 64
+#endif
+#define MAX_FILES_OPEN VFS_MAX_FILES
 
 #define RESERVED_FILENOS 4  // reserve stdin, stdout, stderr, kdbg
 
@@ -54,6 +60,7 @@ void vfs_initialize(void) {
 	gid_init(&file_table_gids);
 
 	ser_initialize();
+	usd_initialize();
 
 	// Force _GLOBAL_REENT initialization for C++ stdio to work. See D97
 	extern void __sinit(struct _reent * s);
@@ -192,3 +199,15 @@ int32_t fdctl(int file, const uint32_t action, void* const extra_arg) {
 	}
 	return file_table[file].driver->ctl(file_table[file].arg, action, extra_arg);
 }
+
+int fsync(int file) {
+	if (file < 0 || !gid_check(&file_table_gids, file)) {
+		errno = EBADF;
+		return -1;
+	}
+	// only microSD files buffer data on the brain
+	if (file_table[file].driver == usd_driver) {
+		return usd_driver->ctl(file_table[file].arg, USDCTL_FLUSH, NULL);
+	}
+	return 0;
+}
@@ -0,0 +1,397 @@
+/**
+ * \file system/heap_stats.c
+ *
+ * Kernel heap statistics and leak report
+ *
+ * The state of the heap (free space, largest free block, fragmentation) is
+ * computed by walking its blocks, which both kernel heaps support. When the
+ * kernel is built with -DPROS_HEAP_STATS, the heaps also tag every block with
+ * the TCB number of the task that allocated it and the address kmalloc() was
+ * called from, and every allocation is counted here by size. TCB numbers are
+ * never reused, so memory left behind by a deleted task is never attributed to
+ * a new task that happens to get the same TCB.
+ *
+ * Everything is gathered into static buffers with the scheduler suspended, so
+ * no locks are needed. When a kernel allocation fails, the malloc failed hook
+ * prints the same report straight to the serial port before halting.
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "kapi.h"
+#include "rtos/tcb.h"
+#include "system/dev/ser.h"
+#include "system/heap_stats.h"
+#include "v5_api.h"
+
+#define HEAP_REPORT_CHUNK 16  // allocations gathered per walk by heap_report
+#define HEAP_REPORT_LINE 96
+
+// the owner entries of tasks that aren't running anymore, after the live tasks
+#define OWNER_DELETED TASK_USAGE_MAX_TASKS
+#define OWNER_STARTUP (TASK_USAGE_MAX_TASKS + 1)
+#define OWNER_COUNT (TASK_USAGE_MAX_TASKS + 2)
+
+typedef struct report_out {
+	void (*write)(struct report_out* out, const char* text, size_t len);
+	int fd;
+	bool ok;
+} report_out_s_t;
+
+typedef struct stats_walk {
+	heap_stats_s_t* stats;
+	size_t largest_total;
+} stats_walk_s_t;
+
+static bool reporting;
+
+#ifdef PROS_HEAP_STATS
+static uint32_t failures;
+static uint32_t histogram[HEAP_HISTOGRAM_BUCKETS];
+static size_t failed_size;
+static heap_tag_s_t failed_tag;
+
+// only used with the scheduler suspended
+static task_status_s_t status[TASK_USAGE_MAX_TASKS];
+static uint32_t status_count;
+static struct {
+	uint32_t bytes;
+	uint32_t count;
+} owners[OWNER_COUNT];
+static char chunk_names[HEAP_REPORT_CHUNK][TASK_NAME_MAX_LEN];
+static heap_allocation_s_t chunk[HEAP_REPORT_CHUNK];
+static heap_task_usage_s_t task_usage[OWNER_COUNT];
+
+void heap_stats_malloc(size_t size, heap_tag_s_t* tag, void* caller) {
+	uint32_t owner = xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED ? 0 : pxCurrentTCB->uxTCBNumber;
+	if (tag == NULL) {
+		failures++;
+		failed_size = size;
+		failed_tag.owner = owner;
+		failed_tag.caller = (uint32_t)caller;
+		return;
+	}
+	tag->owner = owner;
+	tag->caller = (uint32_t)caller;
+	uint32_t bucket = size <= 16 ? 0 : 28 - __builtin_clz(size - 1);
+	histogram[bucket < HEAP_HISTOGRAM_BUCKETS ? bucket : HEAP_HISTOGRAM_BUCKETS - 1]++;
+}
+
+static void _read_status(void) {
+	status_count = uxTaskGetSystemState(status, TASK_USAGE_MAX_TASKS, NULL);
+}
+
+// the index into owners of a block's owner
+static uint32_t _owner_index(uint32_t owner) {
+	if (owner == 0) {
+		return OWNER_STARTUP;
+	}
+	for (uint32_t i = 0; i < status_count; i++) {
+		if (status[i].number == owner) {
+			return i;
+		}
+	}
+	return OWNER_DELETED;
+}
+
+static const char* _owner_name(uint32_t index) {
+	if (index < status_count) {
+		return status[index].name;
+	}
+	return index == OWNER_STARTUP ? "(startup)" : "(deleted)";
+}
+
+static void _task_usage_cb(const heap_block_info_s_t* block, void* arg) {
+	if (block->allocated) {
+		uint32_t i = _owner_index(block->tag->owner);
+		owners[i].bytes += block->size;
+		owners[i].count++;
+	}
+}
+
+// with the scheduler suspended
+static uint32_t _collect_task_usage(heap_task_usage_s_t* usage, uint32_t max) {
+	_read_status();
+	memset(owners, 0, sizeof(owners));
+	heap_walk(_task_usage_cb, NULL);
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < OWNER_COUNT && count < max; i++) {
+		if (owners[i].count == 0) {
+			continue;
+		}
+		usage[count].task = i < status_count ? status[i].handle : NULL;
+		strncpy(usage[count].name, _owner_name(i), TASK_NAME_MAX_LEN - 1);
+		usage[count].name[TASK_NAME_MAX_LEN - 1] = '\0';
+		usage[count].bytes = owners[i].bytes;
+		usage[count].count = owners[i].count;
+		count++;
+	}
+	return count;
+}
+
+typedef struct allocations_walk {
+	heap_allocation_s_t* out;
+	char (*names)[TASK_NAME_MAX_LEN];
+	uint32_t skip;
+	uint32_t max;
+	uint32_t count;
+} allocations_walk_s_t;
+
+static void _allocations_cb(const heap_block_info_s_t* block, void* arg) {
+	allocations_walk_s_t* walk = arg;
+	if (!block->allocated) {
+		return;
+	}
+	if (walk->count >= walk->skip && walk->count - walk->skip < walk->max) {
+		uint32_t i = walk->count - walk->skip;
+		uint32_t owner = _owner_index(block->tag->owner);
+		walk->out[i].address = block->ptr;
+		walk->out[i].size = block->size;
+		walk->out[i].task = owner < status_count ? status[owner].handle : NULL;
+		walk->out[i].caller = block->tag->caller;
+		if (walk->names) {
+			strncpy(walk->names[i], _owner_name(owner), TASK_NAME_MAX_LEN - 1);
+			walk->names[i][TASK_NAME_MAX_LEN - 1] = '\0';
+		}
+	}
+	walk->count++;
+}
+
+// with the scheduler suspended. Returns the number of allocated blocks
+static uint32_t _collect_allocations(heap_allocation_s_t* out, char (*names)[TASK_NAME_MAX_LEN], uint32_t skip,
+                                     uint32_t max) {
+	allocations_walk_s_t walk = {.out = out, .names = names, .skip = skip, .max = max, .count = 0};
+	_read_status();
+	heap_walk(_allocations_cb, &walk);
+	return walk.count;
+}
+#endif
+
+static void _stats_cb(const heap_block_info_s_t* block, void* arg) {
+	stats_walk_s_t* walk = arg;
+	if (block->allocated) {
+		walk->stats->allocations++;
+		return;
+	}
+	walk->stats->free += block->total;
+	walk->stats->free_blocks++;
+	if (block->total > walk->largest_total) {
+		walk->largest_total = block->total;
+		walk->stats->largest_free = block->size;
+	}
+}
+
+static void _get_stats(heap_stats_s_t* stats) {
+	stats_walk_s_t walk = {.stats = stats, .largest_total = 0};
+	memset(stats, 0, sizeof(*stats));
+	heap_walk(_stats_cb, &walk);
+	stats->size = configTOTAL_HEAP_SIZE;
+	stats->minimum_free = xPortGetMinimumEverFreeHeapSize();
+	if (stats->free > 0) {
+		stats->fragmentation = 100 - (uint64_t)100 * walk.largest_total / stats->free;
+	}
+#ifdef PROS_HEAP_STATS
+	rtos_suspend_all();
+	stats->failures = failures;
+	memcpy(stats->histogram, histogram, sizeof(histogram));
+	rtos_resume_all();
+#endif
+}
+
+int32_t heap_get_stats(heap_stats_s_t* stats) {
+	if (stats == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	_get_stats(stats);
+	return PROS_SUCCESS;
+}
+
+int32_t heap_get_task_usage(heap_task_usage_s_t* usage, uint32_t max) {
+	if (usage == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+#ifdef PROS_HEAP_STATS
+	rtos_suspend_all();
+	uint32_t count = _collect_task_usage(usage, max);
+	rtos_resume_all();
+	return count;
+#else
+	errno = ENOSYS;
+	return PROS_ERR;
+#endif
+}
+
+int32_t heap_get_allocations(heap_allocation_s_t* allocations, uint32_t max) {
+	if (allocations == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+#ifdef PROS_HEAP_STATS
+	rtos_suspend_all();
+	uint32_t count = _collect_allocations(allocations, NULL, 0, max);
+	rtos_resume_all();
+	return count;
+#else
+	errno = ENOSYS;
+	return PROS_ERR;
+#endif
+}
+
+static void _report_printf(report_out_s_t* out, const char* fmt, ...) {
+	char line[HEAP_REPORT_LINE];
+	va_list args;
+	va_start(args, fmt);
+	int len = vsnprintf(line, sizeof(line), fmt, args);
+	va_end(args);
+	if (len > 0) {
+		out->write(out, line, len < (int)sizeof(line) ? (size_t)len : sizeof(line) - 1);
+	}
+}
+
+static void _report_stats(report_out_s_t* out, const heap_stats_s_t* stats) {
+	_report_printf(out, "kernel heap: %lu of %lu bytes free, minimum ever %lu\n", stats->free, stats->size,
+	               stats->minimum_free);
+	_report_printf(out, "largest free block %lu bytes, %lu free blocks, %lu%% fragmented, %lu allocations\n",
+	               stats->largest_free, stats->free_blocks, stats->fragmentation, stats->allocations);
+#ifdef PROS_HEAP_STATS
+	_report_printf(out, "%lu failed allocations", stats->failures);
+	if (stats->failures > 0) {
+		char name[TASK_NAME_MAX_LEN];
+		rtos_suspend_all();
+		size_t size = failed_size;
+		uint32_t caller = failed_tag.caller;
+		_read_status();
+		strncpy(name, _owner_name(_owner_index(failed_tag.owner)), TASK_NAME_MAX_LEN - 1);
+		rtos_resume_all();
+		name[TASK_NAME_MAX_LEN - 1] = '\0';
+		_report_printf(out, ", the last of %u bytes by %s from 0x%08lx", size, name, caller);
+	}
+	_report_printf(out, "\nallocations by size:\n");
+	for (uint32_t i = 0; i < HEAP_HISTOGRAM_BUCKETS; i++) {
+		if (i < HEAP_HISTOGRAM_BUCKETS - 1) {
+			_report_printf(out, "  <= %6lu: %lu\n", 16ul << i, stats->histogram[i]);
+		} else {
+			_report_printf(out, "  >  %6lu: %lu\n", 16ul << (i - 1), stats->histogram[i]);
+		}
+	}
+#endif
+}
+
+#ifdef PROS_HEAP_STATS
+static void _report_task_usage(report_out_s_t* out, const heap_task_usage_s_t* usage, uint32_t count) {
+	_report_printf(out, "memory by task:\n");
+	for (uint32_t i = 0; i < count; i++) {
+		_report_printf(out, "  %-32s %8lu bytes in %lu blocks\n", usage[i].name, usage[i].bytes, usage[i].count);
+	}
+	_report_printf(out, "allocated blocks (address, size, caller, task):\n");
+}
+
+static void _report_allocation(report_out_s_t* out, const heap_allocation_s_t* allocation, const char* name) {
+	_report_printf(out, "  %p %8lu 0x%08lx %s\n", allocation->address, allocation->size, allocation->caller, name);
+}
+#endif
+
+static void _file_write(report_out_s_t* out, const char* text, size_t len) {
+	if (out->ok && write(out->fd, text, len) != (ssize_t)len) {
+		out->ok = false;
+	}
+}
+
+int32_t heap_report(const char* path) {
+	if (path == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	if (__atomic_exchange_n(&reporting, true, __ATOMIC_ACQUIRE)) {
+		errno = EBUSY;
+		return PROS_ERR;
+	}
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC);
+	if (fd < 0) {
+		__atomic_store_n(&reporting, false, __ATOMIC_RELEASE);
+		return PROS_ERR;
+	}
+	report_out_s_t out = {.write = _file_write, .fd = fd, .ok = true};
+
+	heap_stats_s_t stats;
+	_get_stats(&stats);
+	_report_stats(&out, &stats);
+
+#ifdef PROS_HEAP_STATS
+	rtos_suspend_all();
+	uint32_t count = _collect_task_usage(task_usage, OWNER_COUNT);
+	rtos_resume_all();
+	_report_task_usage(&out, task_usage, count);
+
+	// the blocks are gathered a chunk at a time, so a block may be missed or
+	// listed twice if the heap changes while the report is written
+	uint32_t listed = 0;
+	while (out.ok) {
+		rtos_suspend_all();
+		uint32_t total = _collect_allocations(chunk, chunk_names, listed, HEAP_REPORT_CHUNK);
+		rtos_resume_all();
+		uint32_t n = total > listed ? total - listed : 0;
+		if (n > HEAP_REPORT_CHUNK) {
+			n = HEAP_REPORT_CHUNK;
+		}
+		for (uint32_t i = 0; i < n; i++) {
+			_report_allocation(&out, &chunk[i], chunk_names[i]);
+		}
+		listed += n;
+		if (n < HEAP_REPORT_CHUNK) {
+			break;
+		}
+	}
+#endif
+
+	close(fd);
+	__atomic_store_n(&reporting, false, __ATOMIC_RELEASE);
+	if (!out.ok) {
+		errno = EIO;
+		return PROS_ERR;
+	}
+	return PROS_SUCCESS;
+}
+
+// sends the report on stderr, framed like any other kernel output. Nothing else
+// runs while it is printed, so the system daemon won't ship it
+static void _serial_write(report_out_s_t* out, const char* text, size_t len) {
+	ser_output_write_fatal(STDERR_STREAM_ID, (const uint8_t*)text, len);
+}
+
+#ifdef PROS_HEAP_STATS
+static void _fatal_allocation_cb(const heap_block_info_s_t* block, void* arg) {
+	if (block->allocated) {
+		uint32_t owner = _owner_index(block->tag->owner);
+		heap_allocation_s_t allocation = {
+		    .address = block->ptr, .size = block->size, .task = NULL, .caller = block->tag->caller};
+		_report_allocation(arg, &allocation, _owner_name(owner));
+	}
+}
+#endif
+
+void heap_stats_print_fatal(void) {
+	report_out_s_t out = {.write = _serial_write, .fd = -1, .ok = true};
+	_report_printf(&out, "\nFATAL ERROR!! The kernel heap is out of memory\n");
+	heap_stats_s_t stats;
+	_get_stats(&stats);
+	_report_stats(&out, &stats);
+#ifdef PROS_HEAP_STATS
+	uint32_t count = _collect_task_usage(task_usage, OWNER_COUNT);
+	_report_task_usage(&out, task_usage, count);
+	heap_walk(_fatal_allocation_cb, &out);
+#endif
+}
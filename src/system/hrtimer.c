@@ -0,0 +1,356 @@
+/**
+ * \file system/hrtimer.c
+ *
+ * High-resolution timers
+ *
+ * The RTOS tick comes from the Cortex-A9 private timer. High-resolution timers
+ * use the comparator of the global timer instead. The global timer is a
+ * free-running 64-bit counter shared by both cores, and each core has its own
+ * comparator. Only this core's comparator and its interrupt are touched here,
+ * never the counter.
+ *
+ * Started timers are kept in a list sorted by deadline, and the comparator is
+ * set to the earliest one. Deadlines are micros() values: the comparator value
+ * is computed from the number of global timer ticks per microsecond, which is
+ * measured against micros() shortly after startup. It is rounded down, so the
+ * interrupt fires early rather than late, and the handler re-arms the
+ * comparator for whatever is left.
+ *
+ * The interrupt handler wakes tasks waiting in hrtimer_wait_until() directly.
+ * Timer callbacks are moved to a pending list instead and run by the
+ * high-resolution timer task, at the highest priority, so that they can use
+ * the rest of the PROS API.
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "kapi.h"
+#include "system/hrtimer.h"
+
+// NOTE: can't include queue.h or task.h from here, see kapi.h
+int32_t xQueueGiveFromISR(queue_t queue, int32_t* const higher_priority_task_woken);
+void vTaskNotifyGiveFromISR(task_t task, int32_t* higher_priority_task_woken);
+
+// Cortex-A9 global timer, see the Cortex-A9 MPCore TRM, section 4.4
+#define GTIMER_BASE 0xF8F00200
+#define GTIMER_COUNTER_LO (*(volatile uint32_t*)(GTIMER_BASE + 0x00))
+#define GTIMER_COUNTER_HI (*(volatile uint32_t*)(GTIMER_BASE + 0x04))
+#define GTIMER_CONTROL (*(volatile uint32_t*)(GTIMER_BASE + 0x08))
+#define GTIMER_STATUS (*(volatile uint32_t*)(GTIMER_BASE + 0x0C))
+#define GTIMER_COMPARE_LO (*(volatile uint32_t*)(GTIMER_BASE + 0x10))
+#define GTIMER_COMPARE_HI (*(volatile uint32_t*)(GTIMER_BASE + 0x14))
+#define GTIMER_ENABLE (1 << 0)
+#define GTIMER_COMPARE_ENABLE (1 << 1)
+#define GTIMER_IRQ_ENABLE (1 << 2)
+#define GTIMER_EVENT (1 << 0)
+
+// GIC distributor registers of the comparator interrupt
+#define GIC_SET_ENABLE (*(volatile uint32_t*)(configINTERRUPT_CONTROLLER_BASE_ADDRESS + 0x100))
+#define GIC_PRIORITY (*(volatile uint8_t*)(configINTERRUPT_CONTROLLER_BASE_ADDRESS + 0x400 + HRTIMER_INTERRUPT_ID))
+
+// one level above the tick, and still low enough to use the FromISR functions
+#define HRTIMER_INTERRUPT_PRIORITY ((portLOWEST_USABLE_INTERRUPT_PRIORITY - 1) << portPRIORITY_SHIFT)
+
+// the global timer runs at half the CPU clock, which is used until the rate
+// has been measured over HRTIMER_CALIBRATION_US
+#define HRTIMER_DEFAULT_TICKS_PER_US 333
+#define HRTIMER_CALIBRATION_US 100000
+// the comparator is never set closer than this to the current count, so that
+// the count can't pass it while it is being written
+#define HRTIMER_MIN_TICKS 200
+
+#define HRTIMER_TASK_STACK_DEPTH 0x800
+
+enum { HRTIMER_IDLE = 0, HRTIMER_ARMED, HRTIMER_PENDING, HRTIMER_RUNNING };
+
+// a task blocked in hrtimer_wait_until(). Its timer has no callback, and its
+// argument is the waiter
+typedef struct waiter {
+	hrtimer_s_t timer;
+	task_t task;
+	sem_t sem;
+	static_sem_s_t sem_buffer;
+} waiter_s_t;
+
+static bool available;
+static hrtimer_s_t* armed;  // sorted by deadline
+static hrtimer_s_t* pending_head;
+static hrtimer_s_t* pending_tail;
+
+static uint32_t ticks_per_us = HRTIMER_DEFAULT_TICKS_PER_US;
+static bool calibrated;
+static uint64_t calibration_us;
+static uint64_t calibration_ticks;
+
+static task_stack_t hrtimer_task_stack[HRTIMER_TASK_STACK_DEPTH];
+static static_task_s_t hrtimer_task_buffer;
+static task_t hrtimer_task;
+
+static uint64_t _counter(void) {
+	uint32_t hi, lo;
+	do {
+		hi = GTIMER_COUNTER_HI;
+		lo = GTIMER_COUNTER_LO;
+	} while (hi != GTIMER_COUNTER_HI);
+	return ((uint64_t)hi << 32) | lo;
+}
+
+// sets the comparator for the earliest timer, or disables it if there are no
+// timers. Called with interrupts masked
+static void _arm(void) {
+	if (armed == NULL) {
+		GTIMER_CONTROL &= ~(GTIMER_COMPARE_ENABLE | GTIMER_IRQ_ENABLE);
+		return;
+	}
+	uint64_t now = micros();
+	uint64_t count = _counter();
+	if (!calibrated && now - calibration_us >= HRTIMER_CALIBRATION_US) {
+		uint64_t rate = (count - calibration_ticks) / (now - calibration_us);
+		ticks_per_us = rate > 0 ? rate : 1;
+		calibrated = true;
+	}
+
+	uint64_t delay = armed->_deadline > now ? (armed->_deadline - now) * ticks_per_us : 0;
+	uint64_t compare = count + (delay > HRTIMER_MIN_TICKS ? delay : HRTIMER_MIN_TICKS);
+	GTIMER_CONTROL &= ~GTIMER_COMPARE_ENABLE;
+	GTIMER_COMPARE_LO = (uint32_t)compare;
+	GTIMER_COMPARE_HI = (uint32_t)(compare >> 32);
+	GTIMER_CONTROL |= GTIMER_COMPARE_ENABLE | GTIMER_IRQ_ENABLE;
+}
+
+// called with interrupts masked
+static void _insert(hrtimer_s_t* timer) {
+	hrtimer_s_t** link = &armed;
+	while (*link != NULL && (*link)->_deadline <= timer->_deadline) {
+		link = &(*link)->_next;
+	}
+	timer->_next = *link;
+	*link = timer;
+	timer->_state = HRTIMER_ARMED;
+	if (armed == timer) {
+		_arm();
+	}
+}
+
+// called with interrupts masked
+static void _remove(hrtimer_s_t* timer) {
+	if (timer->_state == HRTIMER_ARMED) {
+		bool first = armed == timer;
+		for (hrtimer_s_t** link = &armed; *link != NULL; link = &(*link)->_next) {
+			if (*link == timer) {
+				*link = timer->_next;
+				break;
+			}
+		}
+		if (first) {
+			_arm();
+		}
+	} else if (timer->_state == HRTIMER_PENDING) {
+		hrtimer_s_t* previous = NULL;
+		for (hrtimer_s_t* t = pending_head; t != NULL; previous = t, t = t->_next) {
+			if (t == timer) {
+				if (previous == NULL) {
+					pending_head = t->_next;
+				} else {
+					previous->_next = t->_next;
+				}
+				if (pending_tail == t) {
+					pending_tail = previous;
+				}
+				break;
+			}
+		}
+	}
+	timer->_state = HRTIMER_IDLE;
+}
+
+void hrtimer_interrupt(void) {
+	int32_t woken = false;
+	bool notify = false;
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	GTIMER_STATUS = GTIMER_EVENT;
+	uint64_t now = micros();
+	while (armed != NULL && armed->_deadline <= now) {
+		hrtimer_s_t* timer = armed;
+		armed = timer->_next;
+		timer->_next = NULL;
+		if (timer->_callback == NULL) {
+			timer->_state = HRTIMER_IDLE;
+			xQueueGiveFromISR(((waiter_s_t*)timer->_arg)->sem, &woken);
+		} else {
+			timer->_state = HRTIMER_PENDING;
+			if (pending_tail == NULL) {
+				pending_head = timer;
+			} else {
+				pending_tail->_next = timer;
+			}
+			pending_tail = timer;
+			notify = true;
+		}
+	}
+	// also called when the interrupt came early, to wait for the rest
+	_arm();
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+
+	if (notify) {
+		vTaskNotifyGiveFromISR(hrtimer_task, &woken);
+	}
+	portYIELD_FROM_ISR(woken);
+}
+
+static void _hrtimer_task(void* ign) {
+	for (;;) {
+		task_notify_take(true, TIMEOUT_MAX);
+		for (;;) {
+			uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+			hrtimer_s_t* timer = pending_head;
+			hrtimer_fn_t callback = NULL;
+			void* arg = NULL;
+			if (timer != NULL) {
+				pending_head = timer->_next;
+				if (pending_head == NULL) {
+					pending_tail = NULL;
+				}
+				timer->_state = HRTIMER_RUNNING;
+				callback = timer->_callback;
+				arg = timer->_arg;
+			}
+			portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+			if (timer == NULL) {
+				break;
+			}
+
+			callback(arg);
+
+			mask = portSET_INTERRUPT_MASK_FROM_ISR();
+			// the callback may have stopped or restarted the timer
+			if (timer->_state == HRTIMER_RUNNING) {
+				if (timer->_period != 0) {
+					uint64_t now = micros();
+					do {
+						timer->_deadline += timer->_period;
+					} while (timer->_deadline <= now);
+					_insert(timer);
+				} else {
+					timer->_state = HRTIMER_IDLE;
+				}
+			}
+			portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+		}
+	}
+}
+
+void hrtimer_initialize(void) {
+	// an enabled comparator interrupt means the firmware is using it
+	if (GIC_SET_ENABLE & (1 << HRTIMER_INTERRUPT_ID)) {
+		kprint("[HRTIMER] global timer interrupt is in use, high-resolution timers are disabled");
+		return;
+	}
+	GTIMER_CONTROL &= ~(GTIMER_COMPARE_ENABLE | GTIMER_IRQ_ENABLE);
+	GTIMER_CONTROL |= GTIMER_ENABLE;
+	GTIMER_STATUS = GTIMER_EVENT;
+	calibration_us = micros();
+	calibration_ticks = _counter();
+
+	hrtimer_task = task_create_static(_hrtimer_task, NULL, TASK_PRIORITY_MAX - 1, HRTIMER_TASK_STACK_DEPTH,
+	                                  "HR Timer (PROS)", hrtimer_task_stack, &hrtimer_task_buffer);
+
+	GIC_PRIORITY = HRTIMER_INTERRUPT_PRIORITY;
+	GIC_SET_ENABLE = 1 << HRTIMER_INTERRUPT_ID;
+	available = true;
+}
+
+int32_t hrtimer_start(hrtimer_s_t* timer, uint64_t deadline, uint32_t period, hrtimer_fn_t callback, void* arg) {
+	if (timer == NULL || callback == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	if (!available) {
+		errno = ENXIO;
+		return PROS_ERR;
+	}
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	_remove(timer);
+	timer->_deadline = deadline;
+	timer->_period = period;
+	timer->_callback = callback;
+	timer->_arg = arg;
+	_insert(timer);
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+	return PROS_SUCCESS;
+}
+
+int32_t hrtimer_stop(hrtimer_s_t* timer) {
+	if (timer == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	_remove(timer);
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+	return PROS_SUCCESS;
+}
+
+void hrtimer_wait_until(uint64_t deadline) {
+	uint64_t now = micros();
+	if (deadline <= now) {
+		return;
+	}
+	bool scheduling = xTaskGetSchedulerState() == taskSCHEDULER_RUNNING;
+	if (scheduling && deadline - now >= 1000) {
+		// the whole milliseconds go to task_delay(), which returns up to a tick
+		// early but never late
+		task_delay((deadline - now) / 1000);
+		now = micros();
+		if (deadline <= now) {
+			return;
+		}
+	}
+	if (!available || !scheduling) {
+		// only what's left of the last tick or so is spun
+		while (now < deadline) {
+			asm("YIELD");
+			now = micros();
+		}
+		return;
+	}
+
+	waiter_s_t waiter;
+	waiter.task = task_get_current();
+	waiter.sem = sem_create_static(1, 0, &waiter.sem_buffer);
+	waiter.timer._state = HRTIMER_IDLE;
+	waiter.timer._deadline = deadline;
+	waiter.timer._period = 0;
+	waiter.timer._callback = NULL;
+	waiter.timer._arg = &waiter;
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	_insert(&waiter.timer);
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+	sem_wait(waiter.sem, TIMEOUT_MAX);
+}
+
+void hrtimer_task_delete_hook(task_t task) {
+	// a deleted task's waiter is on its stack, which is about to be freed. A
+	// task deleting itself can't be waiting
+	if (task == NULL) {
+		return;
+	}
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	for (hrtimer_s_t* timer = armed; timer != NULL; timer = timer->_next) {
+		if (timer->_callback == NULL && ((waiter_s_t*)timer->_arg)->task == task) {
+			_remove(timer);
+			break;
+		}
+	}
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+}
+
+void task_delay_us_until(uint64_t* const prev_time, const uint32_t delta) {
+	*prev_time += delta;
+	hrtimer_wait_until(*prev_time);
+}
@@ -0,0 +1,147 @@
+/**
+ * \file system/klog.c
+ *
+ * Deferred kernel logging
+ *
+ * Call sites only record the address of a format string, a timestamp, and up
+ * to KLOG_MAX_ARGS raw 32-bit arguments into a lock-free ring buffer. A low
+ * priority daemon drains the ring and either formats the records onto the
+ * kdbg stream, or ships the raw records over the 'klog' stream so that they
+ * can be formatted on the host by tools/klog_decode.py. When neither stream
+ * is enabled, records are simply discarded without ever being formatted.
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "kapi.h"
+#include "system/dev/ser.h"
+#include "system/klog.h"
+#include "system/optimizers.h"
+#include "v5_api.h"
+
+// must be a power of 2 so that the free-running indices wrap correctly
+#define KLOG_BUFFER_LENGTH 128
+
+// longest line that the daemon will format onto the kdbg stream
+#define KLOG_LINE_LENGTH 160
+
+// how often the daemon checks for records when the ring is empty
+#define KLOG_DAEMON_PERIOD 10
+
+typedef struct klog_record_s {
+	// sequence number of the record, written last by the producer. The record
+	// in slot (i % KLOG_BUFFER_LENGTH) is complete when seq == i + 1
+	uint32_t seq;
+	const char* fmt;
+	uint32_t timestamp;  // microseconds (low 32 bits)
+	uint8_t level;
+	uint8_t nargs;
+	uint16_t reserved;
+	uint32_t args[KLOG_MAX_ARGS];
+} klog_record_s_t;
+
+// Wire format of a record on the 'klog' stream (all fields little endian):
+//   fmt address (4), timestamp (4), level (1), nargs (1), reserved (2),
+//   followed by nargs 32-bit arguments
+#define KLOG_WIRE_HEADER_SIZE 12
+
+static klog_record_s_t klog_buffer[KLOG_BUFFER_LENGTH];
+static uint32_t klog_head;  // next slot to be claimed by a producer
+static uint32_t klog_tail;  // next slot to be consumed by the daemon
+static uint32_t klog_dropped;
+
+void klog_record(uint32_t level, const char* fmt, uint32_t nargs, ...) {
+	uint32_t head = __atomic_load_n(&klog_head, __ATOMIC_RELAXED);
+	do {
+		if (unlikely(head - __atomic_load_n(&klog_tail, __ATOMIC_ACQUIRE) >= KLOG_BUFFER_LENGTH)) {
+			__atomic_add_fetch(&klog_dropped, 1, __ATOMIC_RELAXED);
+			return;
+		}
+	} while (!__atomic_compare_exchange_n(&klog_head, &head, head + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+	klog_record_s_t* rec = &klog_buffer[head % KLOG_BUFFER_LENGTH];
+	rec->fmt = fmt;
+	rec->timestamp = (uint32_t)vexSystemHighResTimeGet();
+	rec->level = level;
+	rec->nargs = nargs > KLOG_MAX_ARGS ? KLOG_MAX_ARGS : nargs;
+
+	va_list args;
+	va_start(args, nargs);
+	for (uint32_t i = 0; i < rec->nargs; i++) {
+		rec->args[i] = va_arg(args, uint32_t);
+	}
+	va_end(args);
+
+	__atomic_store_n(&rec->seq, head + 1, __ATOMIC_RELEASE);
+}
+
+uint32_t klog_get_dropped(void) {
+	return __atomic_load_n(&klog_dropped, __ATOMIC_RELAXED);
+}
+
+/******************************************************************************/
+/**                               Log Daemon                                 **/
+/******************************************************************************/
+static task_stack_t klog_daemon_stack[TASK_STACK_DEPTH_MIN];
+static static_task_s_t klog_daemon_task_buffer;
+
+static const char* const level_names[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+
+static void klog_emit(int raw_fd, const klog_record_s_t* rec) {
+	if (raw_fd >= 0 && ser_stream_enabled(KLOG_STREAM_ID)) {
+		uint8_t wire[KLOG_WIRE_HEADER_SIZE + sizeof(rec->args)];
+		memcpy(wire, &rec->fmt, KLOG_WIRE_HEADER_SIZE);
+		memcpy(wire + KLOG_WIRE_HEADER_SIZE, rec->args, rec->nargs * sizeof(*rec->args));
+		write(raw_fd, wire, KLOG_WIRE_HEADER_SIZE + rec->nargs * sizeof(*rec->args));
+	}
+	if (ser_stream_enabled(KDBG_STREAM_ID)) {
+		char line[KLOG_LINE_LENGTH];
+		int len = snprintf(line, sizeof(line), "[%s] %lu.%06lu ", level_names[rec->level & 3], rec->timestamp / 1000000,
+		                   rec->timestamp % 1000000);
+		// unused trailing arguments are ignored by snprintf
+		len += snprintf(line + len, sizeof(line) - len - 1, rec->fmt, rec->args[0], rec->args[1], rec->args[2],
+		                rec->args[3]);
+		if (len > (int)sizeof(line) - 2) {
+			len = sizeof(line) - 2;
+		}
+		line[len++] = '\n';
+		// a single write so that the line ends up in a single COBS frame
+		write(KDBG_FILENO, line, len);
+	}
+}
+
+static void klog_daemon_task(void* ign) {
+	int raw_fd = open("/ser/klog", O_WRONLY);
+	uint32_t last_dropped = 0;
+
+	while (1) {
+		uint32_t tail = klog_tail;
+		klog_record_s_t* rec = &klog_buffer[tail % KLOG_BUFFER_LENGTH];
+		if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != tail + 1) {
+			uint32_t dropped = klog_get_dropped();
+			if (dropped != last_dropped && ser_stream_enabled(KDBG_STREAM_ID)) {
+				dprintf(KDBG_FILENO, "[klog] %lu records dropped\n", dropped - last_dropped);
+			}
+			last_dropped = dropped;
+			task_delay(KLOG_DAEMON_PERIOD);
+			continue;
+		}
+
+		klog_emit(raw_fd, rec);
+		__atomic_store_n(&klog_tail, tail + 1, __ATOMIC_RELEASE);
+	}
+}
+
+void klog_initialize(void) {
+	task_create_static(klog_daemon_task, NULL, TASK_PRIORITY_MIN, TASK_STACK_DEPTH_MIN, "Log Daemon (PROS)",
+	                   klog_daemon_stack, &klog_daemon_task_buffer);
+}
@@ -21,6 +21,7 @@
 #include <stdio.h>
 
 #include "rtos/task.h"
+#include "system/hrtimer.h"
 #include "v5_api.h"
 
 #include "hot.h"
@@ -36,14 +37,10 @@ void _exit(int status) {
 }
 
 int usleep( useconds_t period ) {
-	// Compromise: If the delay is in microsecond range, it will block threads.
-	// if not, it will not block threads but not be accurate to the microsecond range.
-	if(period >= 1000) {
-		task_delay (period / SEC_TO_MSEC);
-		return 0;
-	}
-	uint64_t endTime = vexSystemHighResTimeGet() + period;
-	while(vexSystemHighResTimeGet() < endTime) asm("YIELD");
+	// blocks on the high-resolution timer, so other tasks can run even during
+	// sub-millisecond sleeps. Without the timer, only the part of the sleep
+	// that task_delay() can't cover is spun
+	hrtimer_wait_until(vexSystemHighResTimeGet() + period);
 	return 0;
 }
 
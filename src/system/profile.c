@@ -0,0 +1,239 @@
+/**
+ * \file system/profile.c
+ *
+ * Statistical PC-sampling profiler
+ *
+ * The outermost interrupt saves the registers of the code it interrupted (see
+ * FreeRTOS_IRQ_Handler in rtos/portASM.S). Every period ticks, the tick hook
+ * takes the interrupted PC as a sample and counts it in a hash table, so a
+ * sample costs a handful of loads and stores. Optionally, a few return
+ * addresses of the interrupted task are collected with the EHABI unwinder and
+ * counted as well, which gives inclusive ("total") counts for the callers.
+ * Unwinding is far more expensive than taking the PC, so keep the depth small
+ * or the period long when the profiler is left enabled.
+ *
+ * Nothing is symbolized on the brain. profile_dump() writes the table, and
+ * tools/profile_report.py resolves the addresses against the program's ELF.
+ *
+ * Dump format (little endian):
+ *
+ *   "PPRF" | version (1) | depth (1) | reserved (2) | period (4) |
+ *   samples (4) | kernel samples (4) | dropped (4) | entry count (4) |
+ *   per entry: address (4) | self count (4) | total count (4)
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "kapi.h"
+
+// Number of distinct addresses the profiler can count. Must be a power of two.
+// Can be overridden with -DPROFILE_TABLE_SIZE=n
+#ifndef PROFILE_TABLE_SIZE
+#define PROFILE_TABLE_SIZE 2048
+#endif
+
+#define PROFILE_DUMP_MAGIC "PPRF"
+#define PROFILE_DUMP_VERSION 1
+#define PROFILE_DUMP_CHUNK 64  // entries per write
+#define PROFILE_PROBES 16      // slots tried before an address is dropped
+
+// CPSR mode bits of code running in a task
+#define MODE_MASK 0x1F
+#define MODE_USR 0x10
+#define MODE_SYS 0x1F
+
+_Static_assert((PROFILE_TABLE_SIZE & (PROFILE_TABLE_SIZE - 1)) == 0, "PROFILE_TABLE_SIZE must be a power of two");
+
+// r4-r11, sp, lr, spsr, pc of the interrupted code, from rtos/port.c
+extern volatile uint32_t ulPortInterruptedContext[12];
+#define CONTEXT_SPSR 10
+#define CONTEXT_PC 11
+// from system/unwind.c
+extern uint32_t unwind_interrupted_task(const volatile uint32_t* context, uint32_t* pcs, uint32_t max);
+
+typedef struct profile_entry {
+	uint32_t addr;
+	uint32_t self;   // samples that interrupted this address
+	uint32_t total;  // samples with this address anywhere on the stack
+} profile_entry_s_t;
+
+static profile_entry_s_t* profile_table;  // allocated by the first profile_start
+static profile_stats_s_t profile_stats;
+static uint32_t profile_period;
+static uint32_t profile_depth;
+static uint32_t profile_countdown;
+static bool profile_running;
+static bool profile_dumping;
+
+// counts addr in the table. Only called from the tick interrupt
+static bool _profile_count(uint32_t addr, bool self) {
+	uint32_t slot = (addr * 2654435761u) & (PROFILE_TABLE_SIZE - 1);
+	for (uint32_t i = 0; i < PROFILE_PROBES; i++) {
+		profile_entry_s_t* entry = &profile_table[(slot + i) & (PROFILE_TABLE_SIZE - 1)];
+		if (entry->addr == 0) {
+			entry->addr = addr;
+		}
+		if (entry->addr == addr) {
+			entry->self += self;
+			entry->total++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void profile_tick(void) {
+	if (!profile_running || --profile_countdown > 0) {
+		return;
+	}
+	profile_countdown = profile_period;
+	profile_stats.samples++;
+
+	uint32_t mode = ulPortInterruptedContext[CONTEXT_SPSR] & MODE_MASK;
+	bool in_task = mode == MODE_SYS || mode == MODE_USR;
+	if (!in_task) {
+		profile_stats.kernel++;
+	}
+	bool ok = _profile_count(ulPortInterruptedContext[CONTEXT_PC], true);
+	if (profile_depth > 0 && in_task) {
+		uint32_t pcs[PROFILE_MAX_DEPTH];
+		uint32_t count = unwind_interrupted_task(ulPortInterruptedContext, pcs, profile_depth);
+		for (uint32_t i = 0; i < count; i++) {
+			ok &= _profile_count(pcs[i], false);
+		}
+	}
+	if (!ok) {
+		profile_stats.dropped++;
+	}
+}
+
+int32_t profile_start(uint32_t period, uint32_t depth) {
+	if (period == 0 || depth > PROFILE_MAX_DEPTH) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	if (profile_table == NULL) {
+		profile_entry_s_t* table = kmalloc(PROFILE_TABLE_SIZE * sizeof(*table));
+		if (table == NULL) {
+			errno = ENOMEM;
+			return PROS_ERR;
+		}
+		memset(table, 0, PROFILE_TABLE_SIZE * sizeof(*table));
+		profile_table = table;
+	}
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	profile_period = period;
+	profile_depth = depth;
+	profile_countdown = period;
+	profile_running = true;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+	return PROS_SUCCESS;
+}
+
+int32_t profile_stop(void) {
+	__atomic_store_n(&profile_running, false, __ATOMIC_RELAXED);
+	return PROS_SUCCESS;
+}
+
+int32_t profile_clear(void) {
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	if (profile_table != NULL) {
+		memset(profile_table, 0, PROFILE_TABLE_SIZE * sizeof(*profile_table));
+	}
+	memset(&profile_stats, 0, sizeof(profile_stats));
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+	return PROS_SUCCESS;
+}
+
+int32_t profile_get_stats(profile_stats_s_t* stats) {
+	if (stats == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	*stats = profile_stats;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+	return PROS_SUCCESS;
+}
+
+// writes the non-empty entries of the table to fd
+static bool _profile_write(int fd) {
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < PROFILE_TABLE_SIZE; i++) {
+		count += profile_table[i].addr != 0;
+	}
+
+	uint8_t header[28];
+	memcpy(header, PROFILE_DUMP_MAGIC, 4);
+	header[4] = PROFILE_DUMP_VERSION;
+	header[5] = profile_depth;
+	header[6] = header[7] = 0;
+	memcpy(header + 8, &profile_period, 4);
+	memcpy(header + 12, &profile_stats.samples, 4);
+	memcpy(header + 16, &profile_stats.kernel, 4);
+	memcpy(header + 20, &profile_stats.dropped, 4);
+	memcpy(header + 24, &count, 4);
+	if (write(fd, header, sizeof(header)) != sizeof(header)) {
+		return false;
+	}
+
+	static profile_entry_s_t chunk[PROFILE_DUMP_CHUNK];
+	uint32_t used = 0;
+	for (uint32_t i = 0; i < PROFILE_TABLE_SIZE; i++) {
+		if (profile_table[i].addr != 0) {
+			chunk[used++] = profile_table[i];
+		}
+		if (used == PROFILE_DUMP_CHUNK || (i == PROFILE_TABLE_SIZE - 1 && used > 0)) {
+			ssize_t len = used * sizeof(*chunk);
+			if (write(fd, chunk, len) != len) {
+				return false;
+			}
+			used = 0;
+		}
+	}
+	return true;
+}
+
+int32_t profile_dump(const char* path) {
+	if (path == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	if (profile_table == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	if (__atomic_exchange_n(&profile_dumping, true, __ATOMIC_ACQUIRE)) {
+		errno = EBUSY;
+		return PROS_ERR;
+	}
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC);
+	if (fd < 0) {
+		__atomic_store_n(&profile_dumping, false, __ATOMIC_RELEASE);
+		return PROS_ERR;
+	}
+
+	// pause sampling so the table holds still while it is written
+	bool running = __atomic_exchange_n(&profile_running, false, __ATOMIC_RELAXED);
+	bool ok = _profile_write(fd);
+	close(fd);
+	if (running) {
+		__atomic_store_n(&profile_running, true, __ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&profile_dumping, false, __ATOMIC_RELEASE);
+
+	if (!ok) {
+		errno = EIO;
+		return PROS_ERR;
+	}
+	return PROS_SUCCESS;
+}
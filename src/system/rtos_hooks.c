@@ -18,6 +18,8 @@
 #include "rtos/semphr.h"
 #include "rtos/task.h"
 #include "rtos/tcb.h"
+#include "system/heap_stats.h"
+#include "system/hrtimer.h"
 
 #include "v5_api.h"
 #include "v5_color.h"
@@ -34,10 +36,15 @@ void DataAbortInterrupt() {
 	asm("add %0,sp,#8\n" : "=r"(sp));
 	extern void report_data_abort(uint32_t);
 	report_data_abort(sp);
+	// a task stopped halfway through queuing a packet would hold up the report
+	extern void ser_output_end_partial(void);
+	ser_output_end_partial();
 	for (;;) {
 		vexBackgroundProcessing();
-		extern void ser_output_flush();
-		ser_output_flush();
+		// only drain the output queue. Task buffers need the serial driver's
+		// mutexes and the scheduler, which aren't safe to touch from abort mode
+		extern void ser_output_flush_queue(void);
+		ser_output_flush_queue();
 	}
 }
 // Replacement for PrefetchAbortInterrupt
@@ -72,7 +79,19 @@ void rtos_tick_interrupt_clear() {
 }
 
 void vApplicationFPUSafeIRQHandler(uint32_t ulICCIAR) {
-	vexSystemApplicationIRQHandler(ulICCIAR);
+	// the low 10 bits of the acknowledge register are the interrupt ID
+	uint32_t id = ulICCIAR & 0x3FF;
+#ifdef PROS_TRACE
+	trace_record(TRACE_EVENT_ISR_ENTER, 0, id);
+#endif
+	if (id == HRTIMER_INTERRUPT_ID) {
+		hrtimer_interrupt();
+	} else {
+		vexSystemApplicationIRQHandler(ulICCIAR);
+	}
+#ifdef PROS_TRACE
+	trace_record(TRACE_EVENT_ISR_EXIT, 0, id);
+#endif
 }
 
 void vInitialiseTimerForRunTimeStats(void) {
@@ -85,10 +104,18 @@ void vApplicationMallocFailedHook(void) {
 	// FreeRTOS API functions that create tasks, queues, software timers, and
 	// semaphores.  The size of the FreeRTOS heap is set by the
 	// configTOTAL_HEAP_SIZE configuration constant in FreeRTOSConfig.h.
+	//
+	// Print what the heap is being used for (see system/heap_stats.c) before
+	// halting. Other tasks are kept from running while it is printed
+	rtos_suspend_all();
+	heap_stats_print_fatal();
 	taskDISABLE_INTERRUPTS();
-
-	for (;;)
-		;
+	extern void ser_output_flush_queue(void);
+	for (;;) {
+		vexBackgroundProcessing();
+		// ship the rest of the report, which went through the output queue
+		ser_output_flush_queue();
+	}
 }
 
 void vApplicationStackOverflowHook(task_t pxTask, char* pcTaskName) {
@@ -123,6 +150,12 @@ void vApplicationIdleHook(void) {
 	(void)xFreeHeapSpace;
 }
 
+void vApplicationTickHook(void) {
+	// Called from the tick interrupt. Keep this short
+	extern void profile_tick(void);
+	profile_tick();
+}
+
 void vAssertCalled(const char* pcFile, unsigned long ulLine) {
 	volatile unsigned long ul = 0;
 
@@ -20,6 +20,9 @@
 
 extern void rtos_initialize();
 extern void vfs_initialize();
+extern void klog_initialize();
+extern void datalog_initialize();
+extern void hrtimer_initialize();
 extern void system_daemon_initialize();
 extern void graphical_context_daemon_initialize(void);
 extern void display_initialize(void);
@@ -38,6 +41,12 @@ __attribute__((constructor(101))) static void pros_init(void) {
 
 	vfs_initialize();
 
+	klog_initialize();
+
+	datalog_initialize();
+
+	hrtimer_initialize();
+
 	vdml_initialize();
 
 	graphical_context_daemon_initialize();
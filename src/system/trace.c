@@ -0,0 +1,283 @@
+/**
+ * \file system/trace.c
+ *
+ * RTOS trace recorder
+ *
+ * When the kernel is built with -DPROS_TRACE, the FreeRTOS trace hooks (see
+ * system/trace.h) append a compact binary event to a ring buffer in RAM for
+ * every context switch, queue/mutex operation, priority inheritance, delay,
+ * task notification and interrupt. Recording starts at boot and the newest
+ * TRACE_BUFFER_EVENTS events are kept.
+ *
+ * trace_trigger() freezes the buffer a given number of events after the
+ * trigger, so a program can capture what led up to (and followed) a rare
+ * condition. trace_dump() writes the buffer to a file or serial stream, and
+ * tools/trace_to_perfetto.py converts the dump to the Chrome trace format,
+ * which can be opened in https://ui.perfetto.dev
+ *
+ * Dump format (little endian):
+ *
+ *   "PTRC" | version (1) | event size (1) | reserved (2) |
+ *   recorded (4) | event count (4) | task count (4) |
+ *   per task: handle (4) | priority (1) | name length (1) | name
+ *   per event, oldest first: timestamp us (4) | object (4) | event (1) |
+ *                            value (1) | reserved (2)
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "kapi.h"
+#include "system/trace.h"
+#include "v5_api.h"
+
+#ifdef PROS_TRACE
+
+#define TRACE_DUMP_MAGIC "PTRC"
+#define TRACE_DUMP_VERSION 1
+#define TRACE_DUMP_CHUNK 64  // events per write, so serial packets stay small
+
+#define TRACE_STOPPED 0
+#define TRACE_RUNNING 1
+#define TRACE_TRIGGERED 2
+
+_Static_assert((TRACE_BUFFER_EVENTS & (TRACE_BUFFER_EVENTS - 1)) == 0,
+               "TRACE_BUFFER_EVENTS must be a power of two");
+
+typedef struct trace_event {
+	uint32_t timestamp;
+	uint32_t object;
+	uint8_t event;
+	uint8_t value;
+	uint16_t reserved;
+} trace_event_s_t;
+
+_Static_assert(sizeof(trace_event_s_t) == 12, "trace events must be 12 bytes");
+
+static trace_event_s_t trace_buffer[TRACE_BUFFER_EVENTS];
+// Everything below is only modified with interrupts masked
+static uint32_t trace_count;      // events recorded since the last clear
+static uint32_t trace_remaining;  // events left to record once triggered
+static uint8_t trace_state = TRACE_RUNNING;
+static bool trace_dumping;
+
+static task_usage_s_t dump_tasks[TASK_USAGE_MAX_TASKS];
+
+// appends an event. Must be called with interrupts masked
+static inline void _trace_append(uint8_t event, uint8_t value, uint32_t object) {
+	trace_event_s_t* e = &trace_buffer[trace_count % TRACE_BUFFER_EVENTS];
+	e->timestamp = (uint32_t)vexSystemHighResTimeGet();
+	e->object = object;
+	e->event = event;
+	e->value = value;
+	e->reserved = 0;
+	trace_count++;
+	if (trace_state == TRACE_TRIGGERED && --trace_remaining == 0) {
+		trace_state = TRACE_STOPPED;
+	}
+}
+
+void trace_record(uint8_t event, uint8_t value, uint32_t object) {
+	if (trace_state == TRACE_STOPPED) {
+		return;
+	}
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	if (trace_state != TRACE_STOPPED) {
+		_trace_append(event, value, object);
+	}
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+}
+
+void trace_mark(uint8_t id, uint32_t value) {
+	trace_record(TRACE_EVENT_USER, id, value);
+}
+
+int32_t trace_start(void) {
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	trace_state = TRACE_RUNNING;
+	trace_remaining = 0;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+	return PROS_SUCCESS;
+}
+
+int32_t trace_stop(void) {
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	trace_state = TRACE_STOPPED;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+	return PROS_SUCCESS;
+}
+
+int32_t trace_clear(void) {
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	trace_count = 0;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+	return PROS_SUCCESS;
+}
+
+int32_t trace_trigger(uint32_t post_events) {
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	bool armed = trace_state == TRACE_RUNNING;
+	if (armed) {
+		_trace_append(TRACE_EVENT_TRIGGER, 0, post_events);
+		if (post_events == 0) {
+			trace_state = TRACE_STOPPED;
+		} else {
+			trace_state = TRACE_TRIGGERED;
+			trace_remaining = post_events;
+		}
+	}
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+	return armed ? 1 : 0;
+}
+
+int32_t trace_get_stats(trace_stats_s_t* stats) {
+	if (stats == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	stats->recorded = trace_count;
+	stats->buffered = trace_count < TRACE_BUFFER_EVENTS ? trace_count : TRACE_BUFFER_EVENTS;
+	stats->remaining = trace_state == TRACE_TRIGGERED ? trace_remaining : 0;
+	stats->running = trace_state != TRACE_STOPPED;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+	return PROS_SUCCESS;
+}
+
+// writes the whole buffer to fd, returning false if a write failed
+static bool _trace_write(int fd, uint32_t recorded, uint32_t count) {
+	uint32_t task_count = task_get_usage_all(dump_tasks, TASK_USAGE_MAX_TASKS);
+	if (task_count == PROS_ERR) {
+		task_count = 0;
+	}
+
+	uint8_t header[20];
+	memcpy(header, TRACE_DUMP_MAGIC, 4);
+	header[4] = TRACE_DUMP_VERSION;
+	header[5] = sizeof(trace_event_s_t);
+	header[6] = header[7] = 0;
+	memcpy(header + 8, &recorded, 4);
+	memcpy(header + 12, &count, 4);
+	memcpy(header + 16, &task_count, 4);
+	if (write(fd, header, sizeof(header)) != sizeof(header)) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < task_count; i++) {
+		uint8_t entry[6 + TASK_NAME_MAX_LEN];
+		uint32_t handle = (uint32_t)dump_tasks[i].task;
+		size_t name_len = strlen(dump_tasks[i].name);
+		memcpy(entry, &handle, 4);
+		entry[4] = dump_tasks[i].priority;
+		entry[5] = name_len;
+		memcpy(entry + 6, dump_tasks[i].name, name_len);
+		if (write(fd, entry, 6 + name_len) != (ssize_t)(6 + name_len)) {
+			return false;
+		}
+	}
+
+	// oldest first. The buffer isn't being written to, so it can be read directly
+	uint32_t index = recorded - count;
+	while (count > 0) {
+		uint32_t start = index % TRACE_BUFFER_EVENTS;
+		uint32_t n = count < TRACE_DUMP_CHUNK ? count : TRACE_DUMP_CHUNK;
+		if (n > TRACE_BUFFER_EVENTS - start) {
+			n = TRACE_BUFFER_EVENTS - start;
+		}
+		size_t len = n * sizeof(trace_event_s_t);
+		if (write(fd, &trace_buffer[start], len) != (ssize_t)len) {
+			return false;
+		}
+		index += n;
+		count -= n;
+	}
+	return true;
+}
+
+int32_t trace_dump(const char* path) {
+	if (path == NULL) {
+		errno = EINVAL;
+		return PROS_ERR;
+	}
+	if (__atomic_exchange_n(&trace_dumping, true, __ATOMIC_ACQUIRE)) {
+		errno = EBUSY;
+		return PROS_ERR;
+	}
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC);
+	if (fd < 0) {
+		__atomic_store_n(&trace_dumping, false, __ATOMIC_RELEASE);
+		return PROS_ERR;
+	}
+
+	// pause recording so the buffer holds still while it is written. A trace
+	// that was running picks up again afterwards
+	uint32_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	uint8_t state = trace_state;
+	trace_state = TRACE_STOPPED;
+	uint32_t recorded = trace_count;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+
+	uint32_t count = recorded < TRACE_BUFFER_EVENTS ? recorded : TRACE_BUFFER_EVENTS;
+	bool ok = _trace_write(fd, recorded, count);
+	close(fd);
+
+	mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	if (trace_state == TRACE_STOPPED) {
+		trace_state = state;
+	}
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+	__atomic_store_n(&trace_dumping, false, __ATOMIC_RELEASE);
+
+	if (!ok) {
+		errno = EIO;
+		return PROS_ERR;
+	}
+	return PROS_SUCCESS;
+}
+
+#else  // PROS_TRACE
+
+// The kernel was built without the trace hooks, so there is nothing to record
+
+void trace_record(uint8_t event, uint8_t value, uint32_t object) {}
+
+void trace_mark(uint8_t id, uint32_t value) {}
+
+int32_t trace_start(void) {
+	errno = ENOSYS;
+	return PROS_ERR;
+}
+
+int32_t trace_stop(void) {
+	errno = ENOSYS;
+	return PROS_ERR;
+}
+
+int32_t trace_clear(void) {
+	errno = ENOSYS;
+	return PROS_ERR;
+}
+
+int32_t trace_trigger(uint32_t post_events) {
+	return 0;
+}
+
+int32_t trace_get_stats(trace_stats_s_t* stats) {
+	errno = ENOSYS;
+	return PROS_ERR;
+}
+
+int32_t trace_dump(const char* path) {
+	errno = ENOSYS;
+	return PROS_ERR;
+}
+
+#endif  // PROS_TRACE
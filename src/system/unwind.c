@@ -218,3 +218,58 @@ void backtrace_task(task_t task) {
 	__gnu_Unwind_Backtrace(trace_fn, NULL, &vrs);
 	printf("finished trace\n");
 }
+
+/******************************************************************************/
+/**                           Profiler Unwinding                             **/
+/**                                                                          **/
+/** Collects the return addresses of the task interrupted by the tick for    **/
+/** the sampling profiler (system/profile.c)                                 **/
+/******************************************************************************/
+struct unwind_collect {
+	uint32_t* pcs;
+	uint32_t count;
+	uint32_t max;
+	uint32_t sp;
+	bool first;
+};
+
+static _Unwind_Reason_Code collect_fn(_Unwind_Context* unwind_ctx, void* d) {
+	struct unwind_collect* collect = (struct unwind_collect*)d;
+	// frames only ever get higher on a task's stack, so anything else means the
+	// unwinder has gone off the rails and following it could fault
+	uint32_t sp = _Unwind_GetGR(unwind_ctx, 13);
+	if (sp < collect->sp || sp < (uint32_t)pxCurrentTCB->pxStack) {
+		return _URC_FAILURE;
+	}
+	collect->sp = sp;
+	// the first frame is the interrupted PC itself, which the profiler has
+	if (collect->first) {
+		collect->first = false;
+		return _URC_NO_REASON;
+	}
+	uint32_t pc = _Unwind_GetIP(unwind_ctx);
+	extern void task_clean_up();
+	if (pc == (uint32_t)task_clean_up) {
+		return _URC_FAILURE;
+	}
+	collect->pcs[collect->count++] = pc;
+	return collect->count < collect->max ? _URC_NO_REASON : _URC_FAILURE;
+}
+
+// context is ulPortInterruptedContext: r4-r11, sp, lr, spsr, pc. Must be called
+// from the tick interrupt, since it walks the stack of pxCurrentTCB
+uint32_t unwind_interrupted_task(const volatile uint32_t* context, uint32_t* pcs, uint32_t max) {
+	struct phase2_vrs vrs = {0};
+	for (size_t i = 0; i < 8; i++) {
+		vrs.core.r[4 + i] = context[i];
+	}
+	vrs.core.r[13] = context[8];
+	vrs.core.r[14] = context[9];
+	vrs.core.r[15] = context[11];
+
+	struct unwind_collect collect = {.pcs = pcs, .count = 0, .max = max, .sp = context[8], .first = true};
+	if (max > 0 && pxCurrentTCB) {
+		__gnu_Unwind_Backtrace(collect_fn, &collect, &vrs);
+	}
+	return collect.count;
+}
@@ -0,0 +1,118 @@
+#include <stdio.h>
+
+#include "kapi.h"
+
+// Measures the latency of kmalloc/kfree under a workload that fragments the
+// kernel heap. Run it on a kernel built normally (heap_4) and on one built with
+// -DPROS_HEAP_TLSF, and compare the worst cases printed to the terminal.
+//
+// Samples during which the tick interrupt fired are thrown out, since they
+// measure the tick rather than the heap. Other interrupts still add some noise.
+
+#define SLOTS 1024
+#define ROUNDS 200000
+#define CPU_MHZ 667
+
+static void* slots[SLOTS];
+
+typedef struct {
+	uint64_t total;
+	uint32_t count;
+	uint32_t worst;
+	uint32_t over_10us;
+} latency_s_t;
+
+static inline void cycles_init(void) {
+	// enable and reset the cycle counter (PMCR.E | PMCR.C, PMCNTENSET.C)
+	asm volatile("mcr p15, 0, %0, c9, c12, 0" ::"r"(0x5));
+	asm volatile("mcr p15, 0, %0, c9, c12, 1" ::"r"(0x80000000));
+}
+
+static inline uint32_t cycles(void) {
+	uint32_t value;
+	asm volatile("mrc p15, 0, %0, c9, c13, 0" : "=r"(value));
+	return value;
+}
+
+static uint32_t rng_state = 0x2545F491;
+static uint32_t rng(void) {
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+// mostly small objects (queues, file args, LVGL objects), some buffers, and
+// the occasional task stack
+static size_t random_size(void) {
+	uint32_t kind = rng() % 100;
+	if (kind < 80) return 16 + rng() % 240;
+	if (kind < 98) return 256 + rng() % 1792;
+	return 2048 + rng() % 6144;
+}
+
+static void record(latency_s_t* latency, uint32_t tick, uint32_t elapsed) {
+	if (millis() != tick) {
+		return;
+	}
+	latency->total += elapsed;
+	latency->count++;
+	if (elapsed > latency->worst) latency->worst = elapsed;
+	if (elapsed > 10 * CPU_MHZ) latency->over_10us++;
+}
+
+static void print_latency(const char* name, const latency_s_t* latency) {
+	printf("%s: %lu samples, avg %lu cycles, worst %lu cycles (%lu us), %lu over 10 us\n", name, latency->count,
+	       (uint32_t)(latency->total / (latency->count ? latency->count : 1)), latency->worst,
+	       latency->worst / CPU_MHZ, latency->over_10us);
+}
+
+void opcontrol() {
+	latency_s_t alloc = {0}, release = {0};
+	uint32_t failures = 0;
+	cycles_init();
+	task_set_priority(NULL, TASK_PRIORITY_MAX - 1);
+
+	// fill every slot, then free every other one so the heap is full of holes
+	for (size_t i = 0; i < SLOTS; i++) {
+		slots[i] = kmalloc(random_size());
+	}
+	for (size_t i = 0; i < SLOTS; i += 2) {
+		kfree(slots[i]);
+		slots[i] = NULL;
+	}
+
+	for (uint32_t round = 0; round < ROUNDS; round++) {
+		size_t i = rng() % SLOTS;
+		uint32_t tick = millis();
+		if (slots[i]) {
+			uint32_t start = cycles();
+			kfree(slots[i]);
+			record(&release, tick, cycles() - start);
+			slots[i] = NULL;
+		} else {
+			size_t size = random_size();
+			uint32_t start = cycles();
+			slots[i] = kmalloc(size);
+			record(&alloc, tick, cycles() - start);
+			failures += slots[i] == NULL;
+		}
+		if (round % 10000 == 0) {
+			task_delay(1);  // let the rest of the system run
+		}
+	}
+
+#ifdef PROS_HEAP_TLSF
+	printf("heap_tlsf\n");
+#else
+	printf("heap_4\n");
+#endif
+	print_latency("kmalloc", &alloc);
+	print_latency("kfree", &release);
+	printf("%lu failed allocations, %u bytes free, %u bytes minimum ever free\n", failures, xPortGetFreeHeapSize(),
+	       xPortGetMinimumEverFreeHeapSize());
+
+	for (size_t i = 0; i < SLOTS; i++) {
+		kfree(slots[i]);
+	}
+}
@@ -0,0 +1,127 @@
+/**
+ * \file tests/serial_frame.c
+ *
+ * Test code for the packet framing codec and generic serial framed mode
+ *
+ * The codec checks only depend on src/common, so they can also be run on a
+ * host:
+ *   gcc -DFRAME_HOST_TEST -iquote include -iquote include/common \
+ *       src/tests/serial_frame.c src/common/frame.c src/common/cobs.c \
+ *       src/common/crc.c && ./a.out
+ *
+ * NOTE: On the brain, there should be a cable plugged into ports 1 and 2,
+ * connecting them together
+ *
+ * \copyright Copyright (c) 2017-2023, Purdue University ACM SIGBots.
+ * All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "common/crc.h"
+#include "common/frame.h"
+
+#define MAX_LEN 600
+
+static uint8_t payload[MAX_LEN + FRAME_CRC32];
+static uint8_t encoded[FRAME_ENCODE_MEASURE_MAX(MAX_LEN, FRAME_CRC32)];
+static uint8_t decoded[FRAME_DECODE_BUFFER_SIZE(MAX_LEN, FRAME_CRC32)];
+
+static bool test_crc(void) {
+	const uint8_t check[] = "123456789";
+	// standard check values of CRC-16/CCITT-FALSE and CRC-32
+	return crc16(CRC16_INIT, check, 9) == 0x29B1 && (crc32(CRC32_INIT, check, 9) ^ 0xFFFFFFFF) == 0xCBF43926;
+}
+
+static bool test_round_trip(uint8_t crc_size) {
+	frame_decoder_s_t decoder;
+	frame_decoder_init(&decoder, decoded, sizeof(decoded), crc_size);
+
+	for (size_t len = 0; len <= MAX_LEN; len += 13) {
+		for (size_t i = 0; i < len; i++) {
+			payload[i] = i % 7 == 0 ? 0 : i;
+		}
+		size_t n = frame_encode(encoded, len, payload, len, crc_size);
+
+		// garbage before the frame must be discarded on the first delimiter
+		frame_decode_byte(&decoder, 0x42);
+		frame_decode_byte(&decoder, 0);
+		for (size_t i = 0; i < n; i++) {
+			if (i < n - 1 && encoded[i] == 0) {
+				printf("len %u: delimiter inside frame\n", len);
+				return false;
+			}
+			if (frame_decode_byte(&decoder, encoded[i]) != (i == n - 1)) {
+				printf("len %u: frame not completed at its delimiter\n", len);
+				return false;
+			}
+		}
+		if (decoder.len != len || frame_decoder_get_id(&decoder) != len || memcmp(decoded + FRAME_ID_SIZE, payload, len)) {
+			printf("len %u: payload mismatch\n", len);
+			return false;
+		}
+
+		// flipping a bit must never produce a frame (avoid creating a delimiter)
+		encoded[n / 2] ^= encoded[n / 2] == 0x10 ? 0x01 : 0x10;
+		for (size_t i = 0; i < n; i++) {
+			if (frame_decode_byte(&decoder, encoded[i])) {
+				printf("len %u: corrupted frame accepted\n", len);
+				return false;
+			}
+		}
+	}
+	return decoder.resyncs + decoder.crc_errors > 0;
+}
+
+static bool test_codec(void) {
+	bool pass = true;
+	pass &= test_crc();
+	pass &= test_round_trip(FRAME_CRC16);
+	pass &= test_round_trip(FRAME_CRC32);
+	printf("frame codec: %s\n", pass ? "PASS" : "FAIL");
+	return pass;
+}
+
+#ifdef FRAME_HOST_TEST
+int main(void) {
+	return test_codec() ? 0 : 1;
+}
+#else
+#include "main.h"
+
+void opcontrol() {
+	test_codec();
+
+	serial_enable(1);
+	serial_enable(2);
+	serial_set_baudrate(1, 921600);
+	serial_set_baudrate(2, 921600);
+	task_delay(10);
+	serial_frame_enable(1, 64, 8, E_SERIAL_FRAME_CRC32);
+	serial_frame_enable(2, 64, 8, E_SERIAL_FRAME_CRC32);
+
+	uint8_t out[64], in[64];
+	uint32_t id, failures = 0;
+	for (uint32_t i = 0; i < 1000; i++) {
+		for (size_t j = 0; j < sizeof(out); j++) {
+			out[j] = i + j;
+		}
+		while (serial_frame_write(1, i, out, i % sizeof(out)) == PROS_ERR) {
+			task_delay(1);
+		}
+		int32_t len = serial_frame_read(2, &id, in, sizeof(in), 100);
+		if (len != (int32_t)(i % sizeof(out)) || id != i || memcmp(in, out, len)) {
+			failures++;
+		}
+	}
+
+	serial_frame_stats_s_t stats;
+	serial_frame_get_stats(2, &stats);
+	printf("framed mode: %lu failures, %lu frames, %lu crc errors, %lu resyncs, %lu overflows, %lu dropped\n", failures,
+	       stats.frames, stats.crc_errors, stats.resyncs, stats.overflows, stats.dropped);
+}
+#endif
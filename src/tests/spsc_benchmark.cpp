@@ -0,0 +1,204 @@
+#include <cstdio>
+
+#include "kapi.h"
+#include "pros/spsc.hpp"
+
+// Compares pros::SpscQueue and pros::SpscByteRing with kernel queues and
+// stream buffers carrying the same 4-byte items:
+// - push/pop: the cost of adding and taking one item in the same task
+// - throughput: items per second from a producer task to a consumer task at
+//   the same priority, both blocking when the queue is full or empty
+// - wake latency: cycles from a push to a blocked, higher priority consumer
+//   running with the item
+// Results are printed to the terminal.
+
+#define DEPTH 64
+#define ROUNDS 100000
+#define ITEMS 200000
+#define CPU_MHZ 667
+
+using namespace pros::c;
+
+static inline void cycles_init(void) {
+	// enable and reset the cycle counter (PMCR.E | PMCR.C, PMCNTENSET.C)
+	asm volatile("mcr p15, 0, %0, c9, c12, 0" ::"r"(0x5));
+	asm volatile("mcr p15, 0, %0, c9, c12, 1" ::"r"(0x80000000));
+}
+
+static inline uint32_t cycles(void) {
+	uint32_t value;
+	asm volatile("mrc p15, 0, %0, c9, c13, 0" : "=r"(value));
+	return value;
+}
+
+// Each channel wraps one mechanism behind the same four calls, so every
+// benchmark below runs the same code against all of them.
+struct spsc_queue_channel {
+	pros::SpscQueue<uint32_t, DEPTH> queue;
+	static constexpr const char* name = "SpscQueue";
+	bool try_send(uint32_t item) {
+		return queue.push(item);
+	}
+	bool try_recv(uint32_t* item) {
+		std::optional<uint32_t> value = queue.pop();
+		if (value) *item = *value;
+		return value.has_value();
+	}
+	void send(uint32_t item) {
+		queue.push(item, TIMEOUT_MAX);
+	}
+	void recv(uint32_t* item) {
+		*item = *queue.pop(TIMEOUT_MAX);
+	}
+};
+
+struct spsc_ring_channel {
+	pros::SpscByteRing<DEPTH * sizeof(uint32_t)> ring;
+	static constexpr const char* name = "SpscByteRing";
+	bool try_send(uint32_t item) {
+		return ring.write(&item, sizeof(item)) == sizeof(item);
+	}
+	bool try_recv(uint32_t* item) {
+		return ring.read(item, sizeof(*item)) == sizeof(*item);
+	}
+	void send(uint32_t item) {
+		ring.write(&item, sizeof(item), TIMEOUT_MAX);
+	}
+	void recv(uint32_t* item) {
+		// the producer only writes whole items, so a partial read can't happen
+		ring.read(item, sizeof(*item), TIMEOUT_MAX);
+	}
+};
+
+struct queue_channel {
+	queue_t queue = queue_create(DEPTH, sizeof(uint32_t));
+	static constexpr const char* name = "queue";
+	~queue_channel() {
+		queue_delete(queue);
+	}
+	bool try_send(uint32_t item) {
+		return queue_append(queue, &item, 0);
+	}
+	bool try_recv(uint32_t* item) {
+		return queue_recv(queue, item, 0);
+	}
+	void send(uint32_t item) {
+		queue_append(queue, &item, TIMEOUT_MAX);
+	}
+	void recv(uint32_t* item) {
+		queue_recv(queue, item, TIMEOUT_MAX);
+	}
+};
+
+struct stream_buf_channel {
+	stream_buf_t buffer = stream_buf_create(DEPTH * sizeof(uint32_t), sizeof(uint32_t));
+	static constexpr const char* name = "stream_buf";
+	~stream_buf_channel() {
+		stream_buf_delete(buffer);
+	}
+	bool try_send(uint32_t item) {
+		return stream_buf_send(buffer, &item, sizeof(item), 0) == sizeof(item);
+	}
+	bool try_recv(uint32_t* item) {
+		return stream_buf_recv(buffer, item, sizeof(*item), 0) == sizeof(*item);
+	}
+	void send(uint32_t item) {
+		stream_buf_send(buffer, &item, sizeof(item), TIMEOUT_MAX);
+	}
+	void recv(uint32_t* item) {
+		stream_buf_recv(buffer, item, sizeof(*item), TIMEOUT_MAX);
+	}
+};
+
+template <typename Channel>
+static void bench_push_pop() {
+	Channel channel;
+	uint32_t item = 0;
+	uint32_t start = cycles();
+	for (uint32_t i = 0; i < ROUNDS; i++) {
+		channel.try_send(i);
+		channel.try_recv(&item);
+	}
+	uint32_t elapsed = cycles() - start;
+	printf("%-12s push/pop: %lu cycles per pair\n", Channel::name, elapsed / ROUNDS);
+}
+
+template <typename Channel>
+static void bench_throughput() {
+	Channel channel;
+	task_t main_task = task_get_current();
+	uint32_t priority = task_get_priority(NULL);
+	uint32_t sum = 0;
+
+	pros::Task consumer(
+	    [&] {
+		    uint32_t item;
+		    for (uint32_t i = 0; i < ITEMS; i++) {
+			    channel.recv(&item);
+			    sum += item;
+		    }
+		    task_notify(main_task);
+	    },
+	    priority, TASK_STACK_DEPTH_DEFAULT, "spsc consumer");
+	uint32_t start = millis();
+	pros::Task producer(
+	    [&] {
+		    for (uint32_t i = 0; i < ITEMS; i++) {
+			    channel.send(i);
+		    }
+	    },
+	    priority, TASK_STACK_DEPTH_DEFAULT, "spsc producer");
+
+	task_notify_take(true, TIMEOUT_MAX);
+	uint32_t elapsed = millis() - start;
+	printf("%-12s throughput: %lu items/s%s\n", Channel::name, ITEMS * 1000 / (elapsed ? elapsed : 1),
+	       sum == (uint32_t)((uint64_t)ITEMS * (ITEMS - 1) / 2) ? "" : " (items lost!)");
+	task_delay(10);  // let both tasks finish exiting
+}
+
+template <typename Channel>
+static void bench_wake_latency() {
+	Channel channel;
+	task_t main_task = task_get_current();
+	uint32_t worst = 0;
+	uint64_t total = 0;
+
+	pros::Task consumer(
+	    [&] {
+		    uint32_t stamp;
+		    for (uint32_t i = 0; i < 1000; i++) {
+			    channel.recv(&stamp);
+			    uint32_t elapsed = cycles() - stamp;
+			    total += elapsed;
+			    if (elapsed > worst) worst = elapsed;
+		    }
+		    task_notify(main_task);
+	    },
+	    TASK_PRIORITY_MAX - 1, TASK_STACK_DEPTH_DEFAULT, "spsc consumer");
+
+	for (uint32_t i = 0; i < 1000; i++) {
+		task_delay(1);  // make sure the consumer is blocked again
+		channel.send(cycles());
+	}
+	task_notify_take(true, TIMEOUT_MAX);
+	printf("%-12s wake latency: avg %lu cycles, worst %lu cycles (%lu us)\n", Channel::name, (uint32_t)(total / 1000),
+	       worst, worst / CPU_MHZ);
+	task_delay(10);
+}
+
+template <typename Channel>
+static void bench_all() {
+	bench_push_pop<Channel>();
+	bench_throughput<Channel>();
+	bench_wake_latency<Channel>();
+}
+
+void opcontrol() {
+	cycles_init();
+	task_set_priority(NULL, TASK_PRIORITY_DEFAULT);
+
+	bench_all<spsc_queue_channel>();
+	bench_all<queue_channel>();
+	bench_all<spsc_ring_channel>();
+	bench_all<stream_buf_channel>();
+}
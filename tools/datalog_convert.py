@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+"""
+Converts a binary log written by the PROS data logger (see src/system/datalog.c)
+to CSV or Parquet, checking every block of records against its sync marker.
+
+Blocks whose checksum doesn't match are skipped (or kept with --keep-corrupt),
+and the converter resynchronizes on the next sync marker. Records after the
+last sync marker, e.g. when the brain lost power while logging, can't be
+checked and are only kept with --keep-unverified.
+
+Usage: datalog_convert.py [--format csv|parquet] [--keep-corrupt]
+                          [--keep-unverified] <log.plog> <output>
+"""
+
+import argparse
+import csv
+import struct
+import sys
+import zlib
+
+MAGIC = b"PLOG"
+SYNC_MAGIC = b"PLSY"
+VERSION = 1
+HEADER = struct.Struct("<4sBBHII")
+SYNC = struct.Struct("<4sIII")
+TYPES = {0: ("i", "int32"), 1: ("f", "float32")}
+
+
+class LogError(Exception):
+    pass
+
+
+def parse_header(data):
+    if len(data) < HEADER.size or data[:4] != MAGIC:
+        raise LogError("not a PROS data log")
+    _, version, count, record_size, period, start = HEADER.unpack_from(data)
+    if version != VERSION:
+        raise LogError("unsupported log version {}".format(version))
+    offset = HEADER.size
+    channels = []
+    for _ in range(count):
+        kind, name_len = data[offset], data[offset + 1]
+        name = data[offset + 2:offset + 2 + name_len].decode("utf-8", "replace")
+        if kind not in TYPES:
+            raise LogError("channel {} has unknown type {}".format(name, kind))
+        channels.append((name, kind))
+        offset += 2 + name_len
+    (crc,) = struct.unpack_from("<I", data, offset)
+    if zlib.crc32(data[:offset]) != crc:
+        raise LogError("header checksum mismatch")
+    if record_size != 4 + 4 * count:
+        raise LogError("record size {} doesn't match {} channels".format(record_size, count))
+    return {"channels": channels, "record_size": record_size, "period": period, "start": start}, offset + 4
+
+
+def read_blocks(data, offset, record_size):
+    """Yields (records, status) for every block of records, where status is
+    "ok", "corrupt" or "unverified" """
+    block_start = offset
+    while offset < len(data):
+        if data[offset:offset + 4] == SYNC_MAGIC and offset + SYNC.size <= len(data):
+            _, index, dropped, crc = SYNC.unpack_from(data, offset)
+            block = data[block_start:offset]
+            if len(block) % record_size == 0 and zlib.crc32(block) == crc:
+                yield block, "ok", dropped
+                offset += SYNC.size
+                block_start = offset
+                continue
+        if offset + record_size > len(data):
+            break
+        offset += record_size
+        # A block holds at most 64 records. If no matching sync marker shows up
+        # by then, the block was damaged: search for the next marker
+        if offset - block_start > 64 * record_size:
+            next_sync = data.find(SYNC_MAGIC, block_start + 1)
+            if next_sync < 0:
+                break
+            yield data[block_start:next_sync], "corrupt", None
+            offset = next_sync + SYNC.size
+            block_start = offset
+    if block_start < len(data):
+        yield data[block_start:], "unverified", None
+
+
+def decode(path, keep_corrupt, keep_unverified):
+    with open(path, "rb") as f:
+        data = f.read()
+    header, offset = parse_header(data)
+    record_size = header["record_size"]
+    fmt = struct.Struct("<I" + "".join(TYPES[kind][0] for _, kind in header["channels"]))
+    rows = []
+    report = {"ok": 0, "corrupt": 0, "unverified": 0, "dropped": 0}
+    wraps = 0
+    last_timestamp = None
+    for block, status, dropped in read_blocks(data, offset, record_size):
+        whole = len(block) - len(block) % record_size
+        report[status] += whole // record_size
+        if dropped is not None:
+            report["dropped"] = dropped
+        if status == "corrupt" and not keep_corrupt or status == "unverified" and not keep_unverified:
+            continue
+        for i in range(0, whole, record_size):
+            timestamp, *values = fmt.unpack_from(block, i)
+            # the timestamp is the low 32 bits of micros()
+            if last_timestamp is not None and timestamp < last_timestamp:
+                wraps += 1
+            last_timestamp = timestamp
+            rows.append([timestamp + (wraps << 32)] + values)
+    return header, rows, report
+
+
+def write_csv(path, header, rows):
+    with open(path, "w", newline="") as f:
+        writer = csv.writer(f)
+        writer.writerow(["time_us"] + [name for name, _ in header["channels"]])
+        writer.writerows(rows)
+
+
+def write_parquet(path, header, rows):
+    import pyarrow as pa
+    import pyarrow.parquet as pq
+
+    columns = {"time_us": pa.array([row[0] for row in rows], pa.uint64())}
+    for i, (name, kind) in enumerate(header["channels"]):
+        columns[name] = pa.array([row[i + 1] for row in rows], getattr(pa, TYPES[kind][1])())
+    pq.write_table(pa.table(columns), path)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--format", choices=["csv", "parquet"], default="csv")
+    parser.add_argument("--keep-corrupt", action="store_true", help="keep records that failed their checksum")
+    parser.add_argument("--keep-unverified", action="store_true", help="keep records after the last sync marker")
+    parser.add_argument("log")
+    parser.add_argument("output")
+    args = parser.parse_args()
+
+    try:
+        header, rows, report = decode(args.log, args.keep_corrupt, args.keep_unverified)
+    except LogError as e:
+        print("{}: {}".format(args.log, e), file=sys.stderr)
+        return 1
+    (write_parquet if args.format == "parquet" else write_csv)(args.output, header, rows)
+    print(
+        "{} channels, {} ms period: {} records ok, {} corrupt, {} unverified, {} dropped on the brain".format(
+            len(header["channels"]), header["period"], report["ok"], report["corrupt"], report["unverified"],
+            report["dropped"]),
+        file=sys.stderr)
+    return 1 if report["corrupt"] else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""
+Decodes raw records captured from the PROS 'klog' serial stream.
+
+The kernel only ships the address of each log message's format string along
+with its raw arguments (see src/system/klog.c). This script resolves those
+addresses against the ELF that was uploaded to the brain and formats the
+messages on the host.
+
+Usage: klog_decode.py <program.elf> <klog-stream-capture.bin>
+"""
+
+import re
+import struct
+import sys
+
+from elftools.elf.elffile import ELFFile
+
+HEADER = struct.Struct("<IIBBH")
+CONVERSION = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|z|t|j)?([diouxXcsp%])")
+LEVELS = ["DEBUG", "INFO", "WARN", "ERROR"]
+
+
+class StringTable:
+    """Reads NUL terminated strings out of the loadable sections of an ELF"""
+
+    def __init__(self, path):
+        self.sections = []
+        with open(path, "rb") as f:
+            elf = ELFFile(f)
+            for section in elf.iter_sections():
+                if section["sh_addr"] and section["sh_type"] == "SHT_PROGBITS":
+                    self.sections.append((section["sh_addr"], section.data()))
+
+    def lookup(self, addr):
+        for base, data in self.sections:
+            if base <= addr < base + len(data):
+                end = data.index(b"\0", addr - base)
+                return data[addr - base:end].decode("utf-8", "replace")
+        return None
+
+
+def format_record(strings, fmt, args):
+    args = list(args)
+
+    def convert(match):
+        flags, _, conv = match.groups()
+        if conv == "%":
+            return "%"
+        value = args.pop(0) if args else 0
+        if conv == "s":
+            return strings.lookup(value) or "<0x{:08x}>".format(value)
+        if conv == "p":
+            return "0x{:08x}".format(value)
+        if conv == "c":
+            return chr(value & 0xFF)
+        if conv in "di" and value & 0x80000000:
+            value -= 1 << 32
+        return ("%" + flags + (conv if conv in "xXo" else "d")) % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def decode(strings, data):
+    offset = 0
+    while offset + HEADER.size <= len(data):
+        fmt_addr, timestamp, level, nargs, _ = HEADER.unpack_from(data, offset)
+        offset += HEADER.size
+        args = struct.unpack_from("<{}I".format(nargs), data, offset)
+        offset += 4 * nargs
+        fmt = strings.lookup(fmt_addr)
+        if fmt is None:
+            message = "<unknown format string 0x{:08x}> {}".format(fmt_addr, args)
+        else:
+            message = format_record(strings, fmt, args)
+        level_name = LEVELS[level] if level < len(LEVELS) else str(level)
+        yield "[{}] {}.{:06d} {}".format(level_name, timestamp // 1000000, timestamp % 1000000, message)
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__.strip())
+        return 1
+    strings = StringTable(sys.argv[1])
+    with open(sys.argv[2], "rb") as f:
+        data = f.read()
+    for line in decode(strings, data):
+        print(line)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""
+Lists the hottest functions of a profile written by profile_dump() (see
+src/system/profile.c), resolving the sampled addresses against the ELF files
+that were uploaded to the brain.
+
+"self" counts the samples that were executing in a function, and "total" also
+counts the samples where the function was further up the call stack, which is
+only known when the profile was taken with a depth greater than 0. For hot/cold
+projects, pass both bin/cold.package.elf and bin/hot.package.elf.
+
+Usage: profile_report.py [--top N] [--sort self|total] <profile.pprf> <program.elf>...
+"""
+
+import argparse
+import bisect
+import struct
+import sys
+
+from elftools.elf.elffile import ELFFile
+from elftools.elf.sections import SymbolTableSection
+
+MAGIC = b"PPRF"
+VERSION = 1
+HEADER = struct.Struct("<4sBBHIIIII")
+ENTRY = struct.Struct("<III")
+
+
+class ProfileError(Exception):
+    pass
+
+
+class Symbols:
+    """Maps addresses to the functions of one or more ELF files"""
+
+    def __init__(self, paths):
+        functions = []
+        for path in paths:
+            with open(path, "rb") as f:
+                elf = ELFFile(f)
+                for section in elf.iter_sections():
+                    if not isinstance(section, SymbolTableSection):
+                        continue
+                    for symbol in section.iter_symbols():
+                        if symbol["st_info"]["type"] == "STT_FUNC" and symbol["st_value"]:
+                            # the low bit marks Thumb functions
+                            start = symbol["st_value"] & ~1
+                            functions.append((start, start + max(symbol["st_size"], 1), symbol.name))
+        functions.sort()
+        self.starts = [start for start, _, _ in functions]
+        self.functions = functions
+
+    def lookup(self, addr):
+        i = bisect.bisect_right(self.starts, addr) - 1
+        if i >= 0:
+            start, end, name = self.functions[i]
+            if start <= addr < end:
+                return name
+        return None
+
+
+def parse(data):
+    if len(data) < HEADER.size or data[:4] != MAGIC:
+        raise ProfileError("not a PROS profile")
+    _, version, depth, _, period, samples, kernel, dropped, count = HEADER.unpack_from(data)
+    if version != VERSION:
+        raise ProfileError("unsupported profile version {}".format(version))
+    if HEADER.size + count * ENTRY.size > len(data):
+        raise ProfileError("profile is truncated")
+    entries = [ENTRY.unpack_from(data, HEADER.size + i * ENTRY.size) for i in range(count)]
+    return {"depth": depth, "period": period, "samples": samples, "kernel": kernel, "dropped": dropped,
+            "entries": entries}
+
+
+def aggregate(profile, symbols):
+    functions = {}
+    for addr, self_count, total in profile["entries"]:
+        # return addresses point after the call, which may be the start of the
+        # next function, so look up the byte before them
+        callers = total - self_count
+        for lookup_addr, count, is_self in ((addr, self_count, True), (addr - 1, callers, False)):
+            if count == 0:
+                continue
+            name = symbols.lookup(lookup_addr) or "0x{:08x}".format(addr)
+            stats = functions.setdefault(name, [0, 0])
+            if is_self:
+                stats[0] += count
+            stats[1] += count
+    return functions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--top", type=int, default=30, help="number of functions to list")
+    parser.add_argument("--sort", choices=["self", "total"], default="self")
+    parser.add_argument("profile")
+    parser.add_argument("elf", nargs="+")
+    args = parser.parse_args()
+
+    with open(args.profile, "rb") as f:
+        data = f.read()
+    try:
+        profile = parse(data)
+    except ProfileError as e:
+        print("{}: {}".format(args.profile, e), file=sys.stderr)
+        return 1
+    functions = aggregate(profile, Symbols(args.elf))
+
+    samples = profile["samples"] or 1
+    print("{} samples every {} ms, {} in exception handlers, {} dropped, depth {}".format(
+        profile["samples"], profile["period"], profile["kernel"], profile["dropped"], profile["depth"]))
+    print("{:>8} {:>7} {:>8} {:>7}  {}".format("self", "self%", "total", "total%", "function"))
+    key = (lambda item: item[1][0]) if args.sort == "self" else (lambda item: item[1][1])
+    for name, (self_count, total) in sorted(functions.items(), key=key, reverse=True)[:args.top]:
+        print("{:>8} {:>6.2f}% {:>8} {:>6.2f}%  {}".format(self_count, 100.0 * self_count / samples, total,
+                                                          100.0 * total / samples, name))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+"""
+Formats the binary records written by the PROS task usage log (see
+task_usage_log_start() and src/rtos/task_usage.c) as a table per record.
+
+Usage: task_usage_decode.py <capture.bin>
+"""
+
+import struct
+import sys
+
+MAGIC = b"TUSG"
+HEADER = struct.Struct("<4sIB")
+TASK = struct.Struct("<BBHIHB")
+STATES = ["running", "ready", "blocked", "suspended", "deleted", "invalid"]
+
+
+def decode(data):
+    offset = data.find(MAGIC)
+    while 0 <= offset and offset + HEADER.size <= len(data):
+        _, timestamp, count = HEADER.unpack_from(data, offset)
+        offset += HEADER.size
+        tasks = []
+        for _ in range(count):
+            if offset + TASK.size > len(data):
+                return
+            state, priority, stack, run_time, share, name_len = TASK.unpack_from(data, offset)
+            offset += TASK.size
+            name = data[offset:offset + name_len].decode("utf-8", "replace")
+            offset += name_len
+            tasks.append((name, state, priority, stack, run_time, share / 100))
+        yield timestamp, tasks
+        offset = data.find(MAGIC, offset)
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__.strip())
+        return 1
+    with open(sys.argv[1], "rb") as f:
+        data = f.read()
+    for timestamp, tasks in decode(data):
+        print("t = {}.{:03d} s".format(timestamp // 1000, timestamp % 1000))
+        print("  {:<32} {:<9} {:>4} {:>7} {:>12} {:>7}".format("task", "state", "prio", "stack", "run time", "cpu %"))
+        for name, state, priority, stack, run_time, share in sorted(tasks, key=lambda t: -t[5]):
+            state_name = STATES[state] if state < len(STATES) else str(state)
+            print("  {:<32} {:<9} {:>4} {:>7} {:>12} {:>7.2f}".format(name, state_name, priority, stack, run_time,
+                                                                       share))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,213 @@
+#!/usr/bin/env python3
+"""
+Converts an RTOS trace dump written by trace_dump() (see src/system/trace.c) to
+the Chrome trace event format, which can be opened in https://ui.perfetto.dev
+or chrome://tracing.
+
+Every task gets a track showing when it was running, with instant events for
+the queue, mutex, semaphore and notification operations it performed. Interrupt
+handlers get a track of their own. A dump captured from a serial stream must
+contain only the bytes of that stream.
+
+Usage: trace_to_perfetto.py <trace.ptrc> <output.json>
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = b"PTRC"
+VERSION = 1
+HEADER = struct.Struct("<4sBBHIII")
+EVENT = struct.Struct("<IIBBH")
+
+# Keep in sync with include/system/trace.h
+TASK_SWITCH = 1
+TASK_CREATE = 2
+TASK_DELETE = 3
+TASK_DELAY = 4
+PRIO_INHERIT = 5
+PRIO_DISINHERIT = 6
+QUEUE_SEND = 7
+QUEUE_RECEIVE = 8
+QUEUE_BLOCK_SEND = 9
+QUEUE_BLOCK_RECEIVE = 10
+QUEUE_FAILED = 11
+NOTIFY = 12
+NOTIFY_BLOCK = 13
+ISR_ENTER = 14
+ISR_EXIT = 15
+USER = 16
+TRIGGER = 17
+
+# queue types from rtos/queue.h, with the names of sends and receives
+QUEUE_TYPES = {
+    0: ("queue", "send", "receive"),
+    1: ("mutex", "give", "take"),
+    2: ("semaphore", "post", "wait"),
+    3: ("semaphore", "post", "wait"),
+    4: ("mutex", "give", "take"),
+}
+
+PID = 1
+ISR_TID = 0
+
+
+class TraceError(Exception):
+    pass
+
+
+def parse(data):
+    if len(data) < HEADER.size or data[:4] != MAGIC:
+        raise TraceError("not a PROS trace dump")
+    _, version, event_size, _, recorded, count, task_count = HEADER.unpack_from(data)
+    if version != VERSION or event_size != EVENT.size:
+        raise TraceError("unsupported trace version {}".format(version))
+    offset = HEADER.size
+    tasks = {}
+    for _ in range(task_count):
+        handle, priority, name_len = struct.unpack_from("<IBB", data, offset)
+        name = data[offset + 6:offset + 6 + name_len].decode("utf-8", "replace")
+        tasks[handle] = (name, priority)
+        offset += 6 + name_len
+    if offset + count * EVENT.size > len(data):
+        count = (len(data) - offset) // EVENT.size
+        print("trace is truncated, converting the first {} events".format(count), file=sys.stderr)
+    events = [EVENT.unpack_from(data, offset + i * EVENT.size) for i in range(count)]
+    return {"recorded": recorded, "tasks": tasks, "events": events}
+
+
+class Converter:
+    def __init__(self, tasks):
+        self.tasks = tasks
+        self.tids = {}
+        self.out = []
+        self.running = None  # (handle, start)
+        self.isr_stack = []  # [(irq, start)]
+        self.out.append({"ph": "M", "name": "process_name", "pid": PID, "args": {"name": "V5 Brain"}})
+        self.thread_name(ISR_TID, "Interrupts")
+
+    def thread_name(self, tid, name):
+        self.out.append({"ph": "M", "name": "thread_name", "pid": PID, "tid": tid, "args": {"name": name}})
+
+    def tid(self, handle):
+        if handle not in self.tids:
+            self.tids[handle] = len(self.tids) + 1
+            name = self.tasks.get(handle, ("task 0x{:08x}".format(handle), None))[0]
+            self.thread_name(self.tids[handle], name)
+        return self.tids[handle]
+
+    def current_tid(self):
+        if self.isr_stack:
+            return ISR_TID
+        return self.tid(self.running[0]) if self.running else ISR_TID
+
+    def slice(self, tid, name, start, end, args=None):
+        event = {"ph": "X", "name": name, "pid": PID, "tid": tid, "ts": start, "dur": max(end - start, 0)}
+        if args:
+            event["args"] = args
+        self.out.append(event)
+
+    def instant(self, name, ts, args=None, tid=None, scope="t"):
+        event = {"ph": "i", "s": scope, "name": name, "pid": PID, "tid": self.current_tid() if tid is None else tid,
+                 "ts": ts}
+        if args:
+            event["args"] = args
+        self.out.append(event)
+
+    def task_label(self, handle):
+        return self.tasks.get(handle, ("0x{:08x}".format(handle), None))[0]
+
+    def event(self, ts, kind, value, obj):
+        if kind == TASK_SWITCH:
+            if self.running:
+                handle, start = self.running
+                self.slice(self.tid(handle), "running", start, ts)
+            self.running = (obj, ts)
+            self.tid(obj)
+        elif kind == ISR_ENTER:
+            self.isr_stack.append((obj, ts))
+        elif kind == ISR_EXIT:
+            if self.isr_stack:
+                irq, start = self.isr_stack.pop()
+                self.slice(ISR_TID, "IRQ {}".format(irq), start, ts)
+        elif kind in (QUEUE_SEND, QUEUE_RECEIVE, QUEUE_BLOCK_SEND, QUEUE_BLOCK_RECEIVE, QUEUE_FAILED):
+            kind_name, send, receive = QUEUE_TYPES.get(value, ("queue", "send", "receive"))
+            op = {
+                QUEUE_SEND: send,
+                QUEUE_RECEIVE: receive,
+                QUEUE_BLOCK_SEND: "block on " + send,
+                QUEUE_BLOCK_RECEIVE: "block on " + receive,
+                QUEUE_FAILED: send + "/" + receive + " failed",
+            }[kind]
+            self.instant("{} {}".format(kind_name, op), ts, {kind_name: "0x{:08x}".format(obj)})
+        elif kind in (PRIO_INHERIT, PRIO_DISINHERIT):
+            what = "inherited" if kind == PRIO_INHERIT else "restored"
+            self.instant("priority {} ({})".format(what, value), ts, {"holder": self.task_label(obj)},
+                         tid=self.tid(obj))
+        elif kind == TASK_DELAY:
+            self.instant("delay", ts, {"wake tick": obj})
+        elif kind == NOTIFY:
+            self.instant("notify", ts, {"task": self.task_label(obj)})
+        elif kind == NOTIFY_BLOCK:
+            self.instant("block on notification", ts)
+        elif kind == TASK_CREATE:
+            self.instant("create", ts, {"task": self.task_label(obj), "priority": value})
+        elif kind == TASK_DELETE:
+            self.instant("delete", ts, {"task": self.task_label(obj)})
+        elif kind == USER:
+            self.instant("mark {}".format(value), ts, {"value": obj})
+        elif kind == TRIGGER:
+            self.instant("trigger", ts, {"events after": obj}, scope="g")
+        else:
+            self.instant("unknown event {}".format(kind), ts, {"value": value, "object": obj})
+
+    def finish(self, ts):
+        if self.running:
+            handle, start = self.running
+            self.slice(self.tid(handle), "running", start, ts)
+        while self.isr_stack:
+            irq, start = self.isr_stack.pop()
+            self.slice(ISR_TID, "IRQ {}".format(irq), start, ts)
+
+
+def convert(trace):
+    converter = Converter(trace["tasks"])
+    wraps = 0
+    last = None
+    ts = 0
+    for timestamp, obj, kind, value, _ in trace["events"]:
+        # timestamps are the low 32 bits of the microsecond timer
+        if last is not None and timestamp < last:
+            wraps += 1
+        last = timestamp
+        ts = timestamp + (wraps << 32)
+        converter.event(ts, kind, value, obj)
+    converter.finish(ts)
+    return converter.out
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("trace")
+    parser.add_argument("output")
+    args = parser.parse_args()
+
+    with open(args.trace, "rb") as f:
+        data = f.read()
+    try:
+        trace = parse(data)
+    except TraceError as e:
+        print("{}: {}".format(args.trace, e), file=sys.stderr)
+        return 1
+    with open(args.output, "w") as f:
+        json.dump({"traceEvents": convert(trace), "displayTimeUnit": "ms"}, f)
+    print("{} events ({} recorded on the brain), {} tasks".format(len(trace["events"]), trace["recorded"],
+                                                                 len(trace["tasks"])),
+          file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())